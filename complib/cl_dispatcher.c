@@ -44,6 +44,7 @@
 #endif				/* HAVE_CONFIG_H */
 
 #include <stdlib.h>
+#include <stdint.h>
 #include <complib/cl_dispatcher.h>
 #include <complib/cl_thread.h>
 #include <complib/cl_timer.h>
@@ -56,13 +57,81 @@
 #define CL_DISP_INITIAL_REG_COUNT   16
 #define CL_DISP_REG_GROW_SIZE       16
 
+/********************************************************************
+   __cl_disp_get_home_queue
+
+   Description:
+   Returns the index of the queue owned by the calling worker thread,
+   assigning the next one on the first call.
+
+   Inputs:
+   p_disp - Pointer to Dispatcher object
+
+   Returns:
+   Index of the queue of the calling thread
+********************************************************************/
+static uint32_t __cl_disp_get_home_queue(IN cl_dispatcher_t * const p_disp)
+{
+	uintptr_t idx;
+
+	idx = (uintptr_t) pthread_getspecific(p_disp->worker_key);
+	if (!idx) {
+		idx = (uint32_t) cl_atomic_inc(&p_disp->next_worker);
+		pthread_setspecific(p_disp->worker_key, (void *)idx);
+	}
+	return (uint32_t) ((idx - 1) % p_disp->num_queues);
+}
+
+/********************************************************************
+   __cl_disp_pop
+
+   Description:
+   Pops the message at the head of a queue, if any.
+
+   Inputs:
+   p_queue - Pointer to the queue
+   stolen - TRUE if the caller does not own the queue
+
+   Returns:
+   The message, or NULL if the queue is empty
+********************************************************************/
+static cl_disp_msg_t *__cl_disp_pop(IN cl_disp_queue_t * const p_queue,
+				    IN const boolean_t stolen)
+{
+	cl_disp_msg_t *p_msg;
+	uint64_t now, queue_time;
+
+	cl_spinlock_acquire(&p_queue->lock);
+	if (!cl_qlist_count(&p_queue->msg_fifo)) {
+		cl_spinlock_release(&p_queue->lock);
+		return NULL;
+	}
+	p_msg = (cl_disp_msg_t *) cl_qlist_remove_head(&p_queue->msg_fifo);
+
+	/* we track the time the last message spent in the queue */
+	now = cl_get_time_stamp();
+	queue_time = now - p_msg->in_time;
+	p_queue->last_pop_time = now;
+	p_queue->stats.last_msg_queue_time_us = queue_time;
+	if (queue_time > p_queue->stats.max_msg_queue_time_us)
+		p_queue->stats.max_msg_queue_time_us = queue_time;
+	if (stolen)
+		p_queue->stats.msgs_stolen++;
+	cl_spinlock_release(&p_queue->lock);
+
+	return p_msg;
+}
+
 /********************************************************************
    __cl_disp_worker
 
    Description:
-   This function takes messages off the FIFO and calls Processmsg()
+   This function takes messages off the FIFOs and calls Processmsg()
    This function executes as passive level.
 
+   The worker first drains its own queue and then steals from the
+   other queues, until all of them are empty.
+
    Inputs:
    p_disp - Pointer to Dispatcher object
 
@@ -76,25 +145,25 @@ void __cl_disp_worker(IN void *context)
 {
 	cl_disp_msg_t *p_msg;
 	cl_dispatcher_t *p_disp = (cl_dispatcher_t *) context;
+	cl_disp_queue_t *p_queue;
+	uint32_t home, i;
 
-	cl_spinlock_acquire(&p_disp->lock);
+	home = __cl_disp_get_home_queue(p_disp);
 
-	/* Process the FIFO until we drain it dry. */
-	while (cl_qlist_count(&p_disp->msg_fifo)) {
-		/* Pop the message at the head from the FIFO. */
-		p_msg =
-		    (cl_disp_msg_t *) cl_qlist_remove_head(&p_disp->msg_fifo);
-
-		/* we track the time the last message spent in the queue */
-		p_disp->last_msg_queue_time_us =
-		    cl_get_time_stamp() - p_msg->in_time;
+	for (;;) {
+		p_msg = __cl_disp_pop(&p_disp->queues[home], FALSE);
+		for (i = 1; !p_msg && i < p_disp->num_queues; i++)
+			p_msg = __cl_disp_pop(&p_disp->queues
+					      [(home + i) % p_disp->num_queues],
+					      TRUE);
+		/* All the FIFOs are drained dry. */
+		if (!p_msg)
+			break;
 
 		/*
-		 * Release the spinlock while the message is processed.
-		 * The user's callback may reenter the dispatcher
-		 * and cause the lock to be reaquired.
+		 * No lock is held while the message is processed.
+		 * The user's callback may reenter the dispatcher.
 		 */
-		cl_spinlock_release(&p_disp->lock);
 		p_msg->p_dest_reg->pfn_rcv_callback((void *)p_msg->p_dest_reg->
 						    context,
 						    (void *)p_msg->p_data);
@@ -108,14 +177,12 @@ void __cl_disp_worker(IN void *context)
 			cl_atomic_dec(&p_msg->p_src_reg->ref_cnt);
 		}
 
-		/* Grab the lock for the next iteration through the list. */
-		cl_spinlock_acquire(&p_disp->lock);
-
-		/* Return this message to the pool. */
-		cl_qpool_put(&p_disp->msg_pool, (cl_pool_item_t *) p_msg);
+		/* Return this message to the pool of its queue. */
+		p_queue = p_msg->p_queue;
+		cl_spinlock_acquire(&p_queue->lock);
+		cl_qpool_put(&p_queue->msg_pool, (cl_pool_item_t *) p_msg);
+		cl_spinlock_release(&p_queue->lock);
 	}
-
-	cl_spinlock_release(&p_disp->lock);
 }
 
 void cl_disp_construct(IN cl_dispatcher_t * const p_disp)
@@ -124,9 +191,12 @@ void cl_disp_construct(IN cl_dispatcher_t * const p_disp)
 
 	cl_qlist_init(&p_disp->reg_list);
 	cl_ptr_vector_construct(&p_disp->reg_vec);
-	cl_qlist_init(&p_disp->msg_fifo);
-	cl_spinlock_construct(&p_disp->lock);
-	cl_qpool_construct(&p_disp->msg_pool);
+	cl_plock_construct(&p_disp->lock);
+	p_disp->queues = NULL;
+	p_disp->num_queues = 0;
+	p_disp->next_queue = 0;
+	p_disp->next_worker = 0;
+	p_disp->worker_key_created = FALSE;
 }
 
 void cl_disp_shutdown(IN cl_dispatcher_t * const p_disp)
@@ -146,11 +216,23 @@ void cl_disp_shutdown(IN cl_dispatcher_t * const p_disp)
 
 void cl_disp_destroy(IN cl_dispatcher_t * const p_disp)
 {
+	uint32_t i;
+
 	CL_ASSERT(p_disp);
 
-	cl_spinlock_destroy(&p_disp->lock);
-	/* Destroy the message pool */
-	cl_qpool_destroy(&p_disp->msg_pool);
+	cl_plock_destroy(&p_disp->lock);
+	/* Destroy the queues and their message pools */
+	for (i = 0; i < p_disp->num_queues; i++) {
+		cl_spinlock_destroy(&p_disp->queues[i].lock);
+		cl_qpool_destroy(&p_disp->queues[i].msg_pool);
+	}
+	free(p_disp->queues);
+	p_disp->queues = NULL;
+	p_disp->num_queues = 0;
+	if (p_disp->worker_key_created) {
+		pthread_key_delete(p_disp->worker_key);
+		p_disp->worker_key_created = FALSE;
+	}
 	/* Destroy the pointer vector of registrants. */
 	cl_ptr_vector_destroy(&p_disp->reg_vec);
 }
@@ -159,25 +241,56 @@ cl_status_t cl_disp_init(IN cl_dispatcher_t * const p_disp,
 			 IN const uint32_t thread_count,
 			 IN const char *const name)
 {
+	cl_disp_queue_t *p_queue;
 	cl_status_t status;
+	uint32_t count, i;
 
 	CL_ASSERT(p_disp);
 
 	cl_disp_construct(p_disp);
 
-	status = cl_spinlock_init(&p_disp->lock);
+	status = cl_plock_init(&p_disp->lock);
 	if (status != CL_SUCCESS) {
 		cl_disp_destroy(p_disp);
 		return (status);
 	}
 
-	/* Specify no upper limit to the number of messages in the pool */
-	status = cl_qpool_init(&p_disp->msg_pool, CL_DISP_INITIAL_MSG_COUNT,
-			       0, CL_DISP_MSG_GROW_SIZE, sizeof(cl_disp_msg_t),
-			       NULL, NULL, NULL);
-	if (status != CL_SUCCESS) {
+	if (pthread_key_create(&p_disp->worker_key, NULL)) {
 		cl_disp_destroy(p_disp);
-		return (status);
+		return (CL_INSUFFICIENT_RESOURCES);
+	}
+	p_disp->worker_key_created = TRUE;
+
+	/* One queue per worker thread */
+	count = thread_count ? thread_count : cl_proc_count();
+	p_disp->queues = calloc(count, sizeof(*p_disp->queues));
+	if (!p_disp->queues) {
+		cl_disp_destroy(p_disp);
+		return (CL_INSUFFICIENT_MEMORY);
+	}
+
+	for (i = 0; i < count; i++) {
+		p_queue = &p_disp->queues[i];
+		cl_qlist_init(&p_queue->msg_fifo);
+		cl_spinlock_construct(&p_queue->lock);
+		cl_qpool_construct(&p_queue->msg_pool);
+		p_disp->num_queues++;
+
+		status = cl_spinlock_init(&p_queue->lock);
+		if (status != CL_SUCCESS) {
+			cl_disp_destroy(p_disp);
+			return (status);
+		}
+
+		/* Specify no upper limit to the number of messages in the pool */
+		status = cl_qpool_init(&p_queue->msg_pool,
+				       CL_DISP_INITIAL_MSG_COUNT, 0,
+				       CL_DISP_MSG_GROW_SIZE,
+				       sizeof(cl_disp_msg_t), NULL, NULL, NULL);
+		if (status != CL_SUCCESS) {
+			cl_disp_destroy(p_disp);
+			return (status);
+		}
 	}
 
 	status = cl_ptr_vector_init(&p_disp->reg_vec, CL_DISP_INITIAL_REG_COUNT,
@@ -187,7 +300,7 @@ cl_status_t cl_disp_init(IN cl_dispatcher_t * const p_disp,
 		return (status);
 	}
 
-	status = cl_thread_pool_init(&p_disp->worker_threads, thread_count,
+	status = cl_thread_pool_init(&p_disp->worker_threads, count,
 				     __cl_disp_worker, p_disp, name);
 	if (status != CL_SUCCESS)
 		cl_disp_destroy(p_disp);
@@ -207,18 +320,18 @@ cl_disp_reg_handle_t cl_disp_register(IN cl_dispatcher_t * const p_disp,
 	CL_ASSERT(p_disp);
 
 	/* Check that the requested registrant ID is available. */
-	cl_spinlock_acquire(&p_disp->lock);
+	cl_plock_excl_acquire(&p_disp->lock);
 	if ((msg_id != CL_DISP_MSGID_NONE) &&
 	    (msg_id < cl_ptr_vector_get_size(&p_disp->reg_vec)) &&
 	    (cl_ptr_vector_get(&p_disp->reg_vec, msg_id))) {
-		cl_spinlock_release(&p_disp->lock);
+		cl_plock_release(&p_disp->lock);
 		return (NULL);
 	}
 
 	/* Get a registration info from the pool. */
 	p_reg = (cl_disp_reg_info_t *) malloc(sizeof(cl_disp_reg_info_t));
 	if (!p_reg) {
-		cl_spinlock_release(&p_disp->lock);
+		cl_plock_release(&p_disp->lock);
 		return (NULL);
 	} else {
 		memset(p_reg, 0, sizeof(cl_disp_reg_info_t));
@@ -239,12 +352,12 @@ cl_disp_reg_handle_t cl_disp_register(IN cl_dispatcher_t * const p_disp,
 		status = cl_ptr_vector_set(&p_disp->reg_vec, msg_id, p_reg);
 		if (status != CL_SUCCESS) {
 			free(p_reg);
-			cl_spinlock_release(&p_disp->lock);
+			cl_plock_release(&p_disp->lock);
 			return (NULL);
 		}
 	}
 
-	cl_spinlock_release(&p_disp->lock);
+	cl_plock_release(&p_disp->lock);
 
 	return (p_reg);
 }
@@ -261,7 +374,7 @@ void cl_disp_unregister(IN const cl_disp_reg_handle_t handle)
 	p_disp = p_reg->p_disp;
 	CL_ASSERT(p_disp);
 
-	cl_spinlock_acquire(&p_disp->lock);
+	cl_plock_excl_acquire(&p_disp->lock);
 	/*
 	 * Clear the registrant vector entry.  This will cause any further
 	 * post calls to fail.
@@ -271,17 +384,17 @@ void cl_disp_unregister(IN const cl_disp_reg_handle_t handle)
 			  cl_ptr_vector_get_size(&p_disp->reg_vec));
 		cl_ptr_vector_set(&p_disp->reg_vec, p_reg->msg_id, NULL);
 	}
-	cl_spinlock_release(&p_disp->lock);
+	cl_plock_release(&p_disp->lock);
 
 	while (p_reg->ref_cnt > 0)
 		cl_thread_suspend(1);
 
-	cl_spinlock_acquire(&p_disp->lock);
+	cl_plock_excl_acquire(&p_disp->lock);
 	/* Remove the registrant from the list. */
 	cl_qlist_remove_item(&p_disp->reg_list, (cl_list_item_t *) p_reg);
 	free(p_reg);
 
-	cl_spinlock_release(&p_disp->lock);
+	cl_plock_release(&p_disp->lock);
 }
 
 cl_status_t cl_disp_post(IN const cl_disp_reg_handle_t handle,
@@ -293,29 +406,41 @@ cl_status_t cl_disp_post(IN const cl_disp_reg_handle_t handle,
 	cl_disp_reg_info_t *p_src_reg = (cl_disp_reg_info_t *) handle;
 	cl_disp_reg_info_t *p_dest_reg;
 	cl_dispatcher_t *p_disp;
+	cl_disp_queue_t *p_queue;
 	cl_disp_msg_t *p_msg;
+	uint32_t depth;
 
 	p_disp = handle->p_disp;
 	CL_ASSERT(p_disp);
 	CL_ASSERT(msg_id != CL_DISP_MSGID_NONE);
 
-	cl_spinlock_acquire(&p_disp->lock);
+	cl_plock_acquire(&p_disp->lock);
 	/* Check that the recipient exists. */
 	if (cl_ptr_vector_get_size(&p_disp->reg_vec) <= msg_id) {
-		cl_spinlock_release(&p_disp->lock);
+		cl_plock_release(&p_disp->lock);
 		return (CL_NOT_FOUND);
 	}
 
 	p_dest_reg = cl_ptr_vector_get(&p_disp->reg_vec, msg_id);
 	if (!p_dest_reg) {
-		cl_spinlock_release(&p_disp->lock);
+		cl_plock_release(&p_disp->lock);
 		return (CL_NOT_FOUND);
 	}
 
+	/* Pick the queue of the message. */
+	if (p_dest_reg->affinity)
+		p_queue = &p_disp->queues[msg_id % p_disp->num_queues];
+	else
+		p_queue = &p_disp->queues[(uint32_t)
+					  cl_atomic_inc(&p_disp->next_queue) %
+					  p_disp->num_queues];
+
 	/* Get a free message from the pool. */
-	p_msg = (cl_disp_msg_t *) cl_qpool_get(&p_disp->msg_pool);
+	cl_spinlock_acquire(&p_queue->lock);
+	p_msg = (cl_disp_msg_t *) cl_qpool_get(&p_queue->msg_pool);
 	if (!p_msg) {
-		cl_spinlock_release(&p_disp->lock);
+		cl_spinlock_release(&p_queue->lock);
+		cl_plock_release(&p_disp->lock);
 		return (CL_INSUFFICIENT_MEMORY);
 	}
 
@@ -325,6 +450,7 @@ cl_status_t cl_disp_post(IN const cl_disp_reg_handle_t handle,
 	p_msg->p_data = p_data;
 	p_msg->pfn_xmt_callback = pfn_callback;
 	p_msg->context = context;
+	p_msg->p_queue = p_queue;
 	p_msg->in_time = cl_get_time_stamp();
 
 	/*
@@ -338,8 +464,13 @@ cl_status_t cl_disp_post(IN const cl_disp_reg_handle_t handle,
 	cl_atomic_inc(&p_dest_reg->ref_cnt);
 
 	/* Queue the message in the FIFO. */
-	cl_qlist_insert_tail(&p_disp->msg_fifo, (cl_list_item_t *) p_msg);
-	cl_spinlock_release(&p_disp->lock);
+	cl_qlist_insert_tail(&p_queue->msg_fifo, (cl_list_item_t *) p_msg);
+	p_queue->stats.msgs_posted++;
+	depth = cl_qlist_count(&p_queue->msg_fifo);
+	if (depth > p_queue->stats.max_depth)
+		p_queue->stats.max_depth = depth;
+	cl_spinlock_release(&p_queue->lock);
+	cl_plock_release(&p_disp->lock);
 
 	/* Signal the thread pool that there is work to be done. */
 	cl_thread_pool_signal(&p_disp->worker_threads);
@@ -351,15 +482,57 @@ void cl_disp_get_queue_status(IN const cl_disp_reg_handle_t handle,
 			      OUT uint64_t * p_last_msg_queue_time_ms)
 {
 	cl_dispatcher_t *p_disp = ((cl_disp_reg_info_t *) handle)->p_disp;
-
-	cl_spinlock_acquire(&p_disp->lock);
+	cl_disp_queue_t *p_queue;
+	uint64_t last_pop_time = 0, last_msg_queue_time_us = 0;
+	uint32_t num_queued_msgs = 0, i;
+
+	for (i = 0; i < p_disp->num_queues; i++) {
+		p_queue = &p_disp->queues[i];
+		cl_spinlock_acquire(&p_queue->lock);
+		num_queued_msgs += cl_qlist_count(&p_queue->msg_fifo);
+		/* report the message popped last from any queue */
+		if (p_queue->last_pop_time >= last_pop_time) {
+			last_pop_time = p_queue->last_pop_time;
+			last_msg_queue_time_us =
+			    p_queue->stats.last_msg_queue_time_us;
+		}
+		cl_spinlock_release(&p_queue->lock);
+	}
 
 	if (p_last_msg_queue_time_ms)
-		*p_last_msg_queue_time_ms =
-		    p_disp->last_msg_queue_time_us / 1000;
+		*p_last_msg_queue_time_ms = last_msg_queue_time_us / 1000;
 
 	if (p_num_queued_msgs)
-		*p_num_queued_msgs = cl_qlist_count(&p_disp->msg_fifo);
+		*p_num_queued_msgs = num_queued_msgs;
+}
+
+void cl_disp_set_affinity(IN const cl_disp_reg_handle_t handle,
+			  IN const boolean_t affinity)
+{
+	cl_disp_reg_info_t *p_reg = (cl_disp_reg_info_t *) handle;
+
+	cl_plock_excl_acquire(&p_reg->p_disp->lock);
+	p_reg->affinity = affinity;
+	cl_plock_release(&p_reg->p_disp->lock);
+}
+
+cl_status_t cl_disp_get_queue_stats(IN cl_dispatcher_t * const p_disp,
+				    IN const uint32_t queue,
+				    OUT cl_disp_queue_stats_t * p_stats)
+{
+	cl_disp_queue_t *p_queue;
+
+	CL_ASSERT(p_disp);
+	CL_ASSERT(p_stats);
+
+	if (queue >= p_disp->num_queues)
+		return (CL_INVALID_PARAMETER);
 
-	cl_spinlock_release(&p_disp->lock);
+	p_queue = &p_disp->queues[queue];
+	cl_spinlock_acquire(&p_queue->lock);
+	*p_stats = p_queue->stats;
+	p_stats->depth = cl_qlist_count(&p_queue->msg_fifo);
+	cl_spinlock_release(&p_queue->lock);
+
+	return (CL_SUCCESS);
 }
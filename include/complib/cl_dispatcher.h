@@ -41,11 +41,13 @@
 #ifndef _CL_DISPATCHER_H_
 #define _CL_DISPATCHER_H_
 
+#include <pthread.h>
 #include <complib/cl_atomic.h>
 #include <complib/cl_threadpool.h>
 #include <complib/cl_qlist.h>
 #include <complib/cl_qpool.h>
 #include <complib/cl_spinlock.h>
+#include <complib/cl_passivelock.h>
 #include <complib/cl_ptr_vector.h>
 
 #ifdef __cplusplus
@@ -195,6 +197,91 @@ typedef void
 *	Dispatcher, cl_disp_post
 *********/
 
+/****s* Component Library: Dispatcher/cl_disp_queue_stats_t
+* NAME
+*	cl_disp_queue_stats_t
+*
+* DESCRIPTION
+*	Statistics of one Dispatcher message queue.
+*
+* SYNOPSIS
+*/
+typedef struct _cl_disp_queue_stats {
+	uint32_t depth;
+	uint32_t max_depth;
+	uint64_t msgs_posted;
+	uint64_t msgs_stolen;
+	uint64_t last_msg_queue_time_us;
+	uint64_t max_msg_queue_time_us;
+} cl_disp_queue_stats_t;
+/*
+* FIELDS
+*	depth
+*		Number of messages currently in the queue.
+*
+*	max_depth
+*		Highest number of messages ever in the queue.
+*
+*	msgs_posted
+*		Number of messages posted to the queue.
+*
+*	msgs_stolen
+*		Number of messages taken from the queue by a worker thread
+*		other than the one owning it.
+*
+*	last_msg_queue_time_us
+*		The time that the last message spent in the queue in usec.
+*
+*	max_msg_queue_time_us
+*		The longest time a message spent in the queue in usec.
+*
+* SEE ALSO
+*	Dispatcher, cl_disp_get_queue_stats
+*********/
+
+/****s* Component Library: Dispatcher/cl_disp_queue_t
+* NAME
+*	cl_disp_queue_t
+*
+* DESCRIPTION
+*	One message queue of the Dispatcher.
+*
+*	The cl_disp_queue_t structure is for internal use by the
+*	Dispatcher only.
+*
+* SYNOPSIS
+*/
+typedef struct _cl_disp_queue {
+	cl_spinlock_t lock;
+	cl_qlist_t msg_fifo;
+	cl_qpool_t msg_pool;
+	uint64_t last_pop_time;
+	cl_disp_queue_stats_t stats;
+} cl_disp_queue_t;
+/*
+* FIELDS
+*	lock
+*		Spinlock to guard the queue.
+*
+*	msg_fifo
+*		FIFO of messages posted to this queue.  New messages are
+*		posted to the tail of the FIFO.  Worker threads pull messages
+*		from the front.
+*
+*	msg_pool
+*		Pool of message objects for this queue.
+*
+*	last_pop_time
+*		The time stamp at which the last message was pulled from
+*		the queue.
+*
+*	stats
+*		Queue statistics.
+*
+* SEE ALSO
+*	Dispatcher
+*********/
+
 /****s* Component Library: Dispatcher/cl_dispatcher_t
 * NAME
 *	cl_dispatcher_t
@@ -210,18 +297,22 @@ typedef void
 * SYNOPSIS
 */
 typedef struct _cl_dispatcher {
-	cl_spinlock_t lock;
+	cl_plock_t lock;
 	cl_ptr_vector_t reg_vec;
 	cl_qlist_t reg_list;
 	cl_thread_pool_t worker_threads;
-	cl_qlist_t msg_fifo;
-	cl_qpool_t msg_pool;
-	uint64_t last_msg_queue_time_us;
+	cl_disp_queue_t *queues;
+	uint32_t num_queues;
+	atomic32_t next_queue;
+	atomic32_t next_worker;
+	pthread_key_t worker_key;
+	boolean_t worker_key_created;
 } cl_dispatcher_t;
 /*
 * FIELDS
 *	lock
-*		Spinlock to guard internal structures.
+*		Passive lock to guard the registrations.  Posting a message
+*		only takes it shared.
 *
 *	reg_vec
 *		Vector of registration info objects.  Indexed by message msg_id.
@@ -232,16 +323,30 @@ typedef struct _cl_dispatcher {
 *	worker_threads
 *		Thread pool of worker threads to dispose of posted messages.
 *
-*	msg_fifo
-*		FIFO of messages being processed by the Dispatcher.  New
-*		messages are posted to the tail of the FIFO.  Worker threads
-*		pull messages from the front.
+*	queues
+*		Array of message queues, one per worker thread.
 *
-*	msg_pool
-*		Pool of message objects to be processed through the FIFO.
+*	num_queues
+*		Number of entries in the queues array.
 *
-*	last_msg_queue_time_us
-*		The time that the last message spent in the Q in usec
+*	next_queue
+*		Round robin counter used to pick the queue of a new message.
+*
+*	next_worker
+*		Counter used to assign each worker thread its own queue.
+*
+*	worker_key
+*		Thread specific data key holding the queue index of a worker
+*		thread.
+*
+*	worker_key_created
+*		Indicates that worker_key is valid.
+*
+* NOTES
+*	A worker thread first drains its own queue and then steals messages
+*	from the other queues, so a message is never left behind while a
+*	worker is idle.  With a single worker thread there is a single queue
+*	and messages are delivered in order.
 *
 * SEE ALSO
 *	Dispatcher
@@ -265,6 +370,7 @@ typedef struct _cl_disp_reg_info {
 	const void *context;
 	atomic32_t ref_cnt;
 	cl_disp_msgid_t msg_id;
+	boolean_t affinity;
 	cl_dispatcher_t *p_disp;
 } cl_disp_reg_info_t;
 /*
@@ -284,6 +390,10 @@ typedef struct _cl_disp_reg_info {
 *	msg_id
 *		Dispatcher message msg_id value for this registration object.
 *
+*	affinity
+*		When TRUE, all messages to msg_id are posted to the same
+*		queue.
+*
 *	p_disp
 *		Pointer to parent Dispatcher.
 *
@@ -310,6 +420,7 @@ typedef struct _cl_disp_msg {
 	cl_pfn_msgdone_cb_t pfn_xmt_callback;
 	uint64_t in_time;
 	const void *context;
+	cl_disp_queue_t *p_queue;
 } cl_disp_msg_t;
 /*
 * FIELDS
@@ -335,6 +446,9 @@ typedef struct _cl_disp_msg {
 *	context
 *		Client's message done callback context.
 *
+*	p_queue
+*		Queue the message was posted to and whose pool owns it.
+*
 * SEE ALSO
 *********/
 
@@ -602,11 +716,11 @@ cl_disp_get_queue_status(IN const cl_disp_reg_handle_t handle,
 *     [in] cl_disp_reg_handle_t value return by cl_disp_register.
 *
 *   p_num_queued_msgs
-*     [out] number of messages in the queue
+*     [out] number of messages in all the queues
 *
 *   p_last_msg_queue_time_ms
 *     [out] pointer to a variable to hold the time the last popped up message
-*           spent in the queue
+*           spent in its queue
 *
 * RETURN VALUE
 *	Thr time the last popped up message stayed in the queue, in msec
@@ -618,5 +732,99 @@ cl_disp_get_queue_status(IN const cl_disp_reg_handle_t handle,
 *	Dispatcher
 *********/
 
+/****f* Component Library: Dispatcher/cl_disp_set_affinity
+* NAME
+*	cl_disp_set_affinity
+*
+* DESCRIPTION
+*	This function makes all messages posted to a registrant go through
+*	the same queue.
+*
+* SYNOPSIS
+*/
+void
+cl_disp_set_affinity(IN const cl_disp_reg_handle_t handle,
+		     IN const boolean_t affinity);
+/*
+* PARAMETERS
+*   handle
+*     [in] cl_disp_reg_handle_t value return by cl_disp_register.
+*
+*   affinity
+*     [in] TRUE to post all messages to the registrant to one queue,
+*          FALSE to spread them over all queues (the default).
+*
+* RETURN VALUE
+*	This function does not return a value.
+*
+* NOTES
+*	Messages to a registrant with affinity are posted to the queue of
+*	a single worker thread, which keeps the registrant's data warm in
+*	that thread's cache.  Idle workers may still steal them, so this
+*	does not guarantee in order delivery.
+*
+* SEE ALSO
+*	Dispatcher, cl_disp_register
+*********/
+
+/****f* Component Library: Dispatcher/cl_disp_get_queue_stats
+* NAME
+*	cl_disp_get_queue_stats
+*
+* DESCRIPTION
+*	This function gets the statistics of one queue of a Dispatcher.
+*
+* SYNOPSIS
+*/
+cl_status_t
+cl_disp_get_queue_stats(IN cl_dispatcher_t * const p_disp,
+			IN const uint32_t queue,
+			OUT cl_disp_queue_stats_t * p_stats);
+/*
+* PARAMETERS
+*   p_disp
+*     [in] Pointer to a Dispatcher.
+*
+*   queue
+*     [in] Index of the queue, less than cl_disp_get_queue_count.
+*
+*   p_stats
+*     [out] Statistics of the queue.
+*
+* RETURN VALUE
+*	CL_SUCCESS if the statistics were returned.
+*
+*	CL_INVALID_PARAMETER if there is no such queue.
+*
+* SEE ALSO
+*	Dispatcher, cl_disp_get_queue_count, cl_disp_get_queue_status
+*********/
+
+/****f* Component Library: Dispatcher/cl_disp_get_queue_count
+* NAME
+*	cl_disp_get_queue_count
+*
+* DESCRIPTION
+*	This function returns the number of queues of a Dispatcher.
+*
+* SYNOPSIS
+*/
+static inline uint32_t
+cl_disp_get_queue_count(IN const cl_dispatcher_t * const p_disp)
+{
+	return p_disp->num_queues;
+}
+/*
+* PARAMETERS
+*   p_disp
+*     [in] Pointer to a Dispatcher.
+*
+* RETURN VALUE
+*	The number of queues, which is the number of worker threads.
+*
+* SEE ALSO
+*	Dispatcher, cl_disp_get_queue_stats
+*********/
+
 END_C_DECLS
 #endif				/* !defined(_CL_DISPATCHER_H_) */
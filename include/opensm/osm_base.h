@@ -194,6 +194,20 @@ BEGIN_C_DECLS
 #define OSM_DEFAULT_CACHE_DIR "/var/cache/opensm"
 #endif
 /***********/
+/****d* OpenSM: OSM_DEFAULT_DB_BACKEND
+* NAME
+*	OSM_DEFAULT_DB_BACKEND
+*
+* DESCRIPTION
+*	Specifies the default format of the db files in the cache directory.
+*	The "binary" backend keeps the guid2lid, guid2mkey and neighbors
+*	domains in memory mapped logs next to the text files.
+*
+* SYNOPSIS
+*/
+#define OSM_DEFAULT_DB_BACKEND "text"
+#define OSM_BINARY_DB_BACKEND "binary"
+/***********/
 /****d* OpenSM: OSM_DEFAULT_LOG_FILE
 * NAME
 *	OSM_DEFAULT_LOG_FILE
@@ -347,6 +361,31 @@ BEGIN_C_DECLS
 */
 #define OSM_DEFAULT_SWEEP_INTERVAL_SECS 10
 /***********/
+
+/****d* OpenSM: OSM_DEFAULT_SWEEP_PROFILE_HISTORY
+* NAME
+*	OSM_DEFAULT_SWEEP_PROFILE_HISTORY
+*
+* DESCRIPTION
+*	Specifies the default number of sweeps whose phase profile is kept.
+*
+* SYNOPSIS
+*/
+#define OSM_DEFAULT_SWEEP_PROFILE_HISTORY 8
+/***********/
+
+/****d* OpenSM: OSM_DEFAULT_LIGHT_SWEEP_SWITCH_PERCENT
+* NAME
+*	OSM_DEFAULT_LIGHT_SWEEP_SWITCH_PERCENT
+*
+* DESCRIPTION
+*	Specifies the default percentage of switches polled for
+*	SwitchInfo by a light sweep.
+*
+* SYNOPSIS
+*/
+#define OSM_DEFAULT_LIGHT_SWEEP_SWITCH_PERCENT 100
+/***********/
 /****d* OpenSM: OSM_DEFAULT_TRANS_TIMEOUT_MILLISEC
 * NAME
 *	OSM_DEFAULT_TRANS_TIMEOUT_MILLISEC
@@ -499,6 +538,30 @@ BEGIN_C_DECLS
 */
 #define OSM_DEFAULT_SMP_MAX_ON_WIRE 4
 /***********/
+/****d* OpenSM: OSM_DEFAULT_MAD_POOL_PREALLOC
+* NAME
+*	OSM_DEFAULT_MAD_POOL_PREALLOC
+*
+* DESCRIPTION
+*	Specifies the default number of MAD wrappers allocated by the
+*	MAD pool at startup.
+*
+* SYNOPSIS
+*/
+#define OSM_DEFAULT_MAD_POOL_PREALLOC 1024
+/***********/
+/****d* OpenSM: OSM_DEFAULT_LFT_WINDOW
+* NAME
+*	OSM_DEFAULT_LFT_WINDOW
+*
+* DESCRIPTION
+*	Specifies the default number of LFT blocks outstanding per switch
+*	while forwarding tables are distributed.
+*
+* SYNOPSIS
+*/
+#define OSM_DEFAULT_LFT_WINDOW 4
+/***********/
 /****d* OpenSM: OSM_SM_DEFAULT_QP0_RCV_SIZE
 * NAME
 *	OSM_SM_DEFAULT_QP0_RCV_SIZE
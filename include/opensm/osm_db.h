@@ -45,6 +45,7 @@
 #include <complib/cl_spinlock.h>
 
 struct osm_log;
+struct osm_db_bin;
 
 #ifdef __cplusplus
 #  define BEGIN_C_DECLS extern "C" {
@@ -67,6 +68,10 @@ BEGIN_C_DECLS
 *  The interface is defined such that it can is not "data dependent":
 *  All keys and data items are texts.
 *
+*  Domains with a fixed record layout may instead be kept in a binary,
+*  memory mapped log (see osm_db_rec_t). Such a domain is imported from
+*  its text file the first time and can be exported back to it.
+*
 *	The DB implementation should be thread safe, thus callers do not need to
 *  provide serialization.
 *
@@ -92,6 +97,7 @@ BEGIN_C_DECLS
 typedef struct osm_db_domain {
 	struct osm_db *p_db;
 	void *p_domain_imp;
+	struct osm_db_bin *p_bin;
 } osm_db_domain_t;
 /*
 * FIELDS
@@ -101,6 +107,10 @@ typedef struct osm_db_domain {
 *	p_domain_imp
 *		Pointer to the db implementation object
 *
+*	p_bin
+*		Pointer to the binary store of the domain or NULL when the
+*		domain is kept in a text file (see osm_db_domain_is_binary).
+*
 * SEE ALSO
 * osm_db_t
 *********/
@@ -121,6 +131,7 @@ typedef struct osm_db {
 	void *p_db_imp;
 	struct osm_log *p_log;
 	cl_list_t domains;
+	boolean_t binary;
 } osm_db_t;
 /*
 * FIELDS
@@ -133,6 +144,10 @@ typedef struct osm_db {
 *  domains
 *     List of initialize domains
 *
+*	binary
+*		When TRUE, domains initialized afterwards that have a known
+*		record layout are kept in the binary store.
+*
 * SEE ALSO
 *********/
 
@@ -426,5 +441,251 @@ int osm_db_delete(IN osm_db_domain_t * p_domain, IN char *p_key);
 *  osm_db_keys, osm_db_lookup, osm_db_update
 *********/
 
+/****s* OpenSM: Database/osm_db_rec_t
+* NAME
+*	osm_db_rec_t
+*
+* DESCRIPTION
+*	A fixed size record of a binary domain. The meaning of the fields
+*	is defined by the domain codec (see osm_db_pack.h).
+*
+* SYNOPSIS
+*/
+typedef struct osm_db_rec {
+	uint64_t key;
+	uint64_t val;
+	uint32_t key_port;
+	uint32_t val2;
+} osm_db_rec_t;
+/*
+* FIELDS
+*	key
+*		The integer key, usually a GUID
+*
+*	val
+*		The main value
+*
+*	key_port
+*		Second part of the key (port number), 0 if not used
+*
+*	val2
+*		Secondary value, 0 if not used
+*
+* SEE ALSO
+*	osm_db_codec_t, osm_db_rec_get, osm_db_rec_set
+*********/
+
+/****s* OpenSM: Database/osm_db_codec_t
+* NAME
+*	osm_db_codec_t
+*
+* DESCRIPTION
+*	Converts the entries of a domain between the text file format
+*	and osm_db_rec_t. Only domains with a codec may use the binary
+*	store; the text form is used to import the existing text files
+*	and to export the binary store back to them.
+*
+* SYNOPSIS
+*/
+typedef struct osm_db_codec {
+	int (*from_text) (const char *p_key, const char *p_val,
+			  osm_db_rec_t * p_rec);
+	void (*to_text) (const osm_db_rec_t * p_rec, char *p_key, char *p_val);
+} osm_db_codec_t;
+/*
+* FIELDS
+*	from_text
+*		Fill the record from a text key and value, returns 0 on success
+*
+*	to_text
+*		Format the record into text key and value buffers of at least
+*		OSM_DB_CODEC_TEXT_LEN bytes
+*
+* SEE ALSO
+*	osm_db_rec_t, osm_db_codec_get
+*********/
+#define OSM_DB_CODEC_TEXT_LEN 32
+
+/****f* OpenSM: Database/osm_db_domain_is_binary
+* NAME
+*	osm_db_domain_is_binary
+*
+* DESCRIPTION
+*	Check whether the domain is kept in the binary store. Binary
+*	domains are accessed through the osm_db_rec_* functions, the text
+*	osm_db_keys/lookup/update/delete functions do not see their entries.
+*
+* SYNOPSIS
+*/
+static inline boolean_t osm_db_domain_is_binary(IN osm_db_domain_t * p_domain)
+{
+	return p_domain->p_bin != NULL;
+}
+/*
+* PARAMETERS
+*
+*  p_domain
+*    [in] Pointer to the database domain object
+*
+* RETURN VALUES
+*  TRUE if the domain uses the binary store
+*
+* SEE ALSO
+*	osm_db_rec_get, osm_db_rec_set, osm_db_rec_delete, osm_db_rec_foreach
+*********/
+
+/****f* OpenSM: Database/osm_db_rec_get
+* NAME
+*	osm_db_rec_get
+*
+* DESCRIPTION
+*	Lookup a record of a binary domain by its key
+*
+* SYNOPSIS
+*/
+int osm_db_rec_get(IN osm_db_domain_t * p_domain, IN uint64_t key,
+		   IN uint32_t key_port, OUT osm_db_rec_t * p_rec);
+/*
+* PARAMETERS
+*
+*  p_domain
+*    [in] Pointer to the binary database domain object
+*
+*	key, key_port
+*		[in] The key to look for
+*
+*	p_rec
+*		[out] The record found
+*
+* RETURN VALUES
+*  0 if found 1 otherwise
+*
+* SEE ALSO
+*	osm_db_rec_set, osm_db_rec_delete, osm_db_rec_foreach
+*********/
+
+/****f* OpenSM: Database/osm_db_rec_set
+* NAME
+*	osm_db_rec_set
+*
+* DESCRIPTION
+*	Add or update a record of a binary domain. The change is appended
+*	to the domain log on the next osm_db_store.
+*
+* SYNOPSIS
+*/
+int osm_db_rec_set(IN osm_db_domain_t * p_domain, IN const osm_db_rec_t * p_rec);
+/*
+* PARAMETERS
+*
+*  p_domain
+*    [in] Pointer to the binary database domain object
+*
+*	p_rec
+*		[in] The record to store
+*
+* RETURN VALUES
+*  0 on success, 1 if the record could not be allocated
+*
+* SEE ALSO
+*	osm_db_rec_get, osm_db_rec_delete, osm_db_rec_foreach
+*********/
+
+/****f* OpenSM: Database/osm_db_rec_delete
+* NAME
+*	osm_db_rec_delete
+*
+* DESCRIPTION
+*	Delete a record of a binary domain by its key
+*
+* SYNOPSIS
+*/
+int osm_db_rec_delete(IN osm_db_domain_t * p_domain, IN uint64_t key,
+		      IN uint32_t key_port);
+/*
+* PARAMETERS
+*
+*  p_domain
+*    [in] Pointer to the binary database domain object
+*
+*	key, key_port
+*		[in] The key to delete
+*
+* RETURN VALUES
+*  0 on success 1 if the key was not found
+*
+* SEE ALSO
+*	osm_db_rec_get, osm_db_rec_set, osm_db_rec_foreach
+*********/
+
+/****f* OpenSM: Database/osm_db_rec_foreach
+* NAME
+*	osm_db_rec_foreach
+*
+* DESCRIPTION
+*	Call a function for every record of a binary domain, in key order.
+*	The domain is locked during the walk so the function must not
+*	call back into the domain.
+*
+* SYNOPSIS
+*/
+void osm_db_rec_foreach(IN osm_db_domain_t * p_domain,
+			IN void (*func) (const osm_db_rec_t * p_rec,
+					 void *context),
+			IN void *context);
+/*
+* PARAMETERS
+*
+*  p_domain
+*    [in] Pointer to the binary database domain object
+*
+*	func
+*		[in] The function to call
+*
+*	context
+*		[in] Passed to func
+*
+* SEE ALSO
+*	osm_db_rec_get, osm_db_rec_set, osm_db_rec_delete
+*********/
+
+/****f* OpenSM: Database/osm_db_export
+* NAME
+*	osm_db_export
+*
+* DESCRIPTION
+*	Write the records of a binary domain to its text file, so the
+*	content stays readable by tools and by an OpenSM using the text
+*	files. Does nothing for text domains.
+*
+* SYNOPSIS
+*/
+int osm_db_export(IN osm_db_domain_t * p_domain,
+		  IN boolean_t fsync_high_avail_files);
+/*
+* PARAMETERS
+*
+*  p_domain
+*    [in] Pointer to the database domain object
+*
+*	fsync_high_avail_files
+*		[in] Sync the text file to the storage
+*
+* RETURN VALUES
+*  0 on success
+*
+* SEE ALSO
+*	osm_db_store, osm_db_domain_is_binary
+*********/
+
+/* binary store internals, used by the db implementation only */
+struct osm_db_bin *osm_db_bin_init(IN struct osm_log *p_log,
+				   IN const char *file_name);
+void osm_db_bin_destroy(IN struct osm_db_bin *p_bin);
+int osm_db_bin_restore(IN struct osm_log *p_log, IN struct osm_db_bin *p_bin);
+int osm_db_bin_store(IN struct osm_log *p_log, IN struct osm_db_bin *p_bin,
+		     IN boolean_t fsync_high_avail_files);
+void osm_db_bin_clear(IN struct osm_db_bin *p_bin);
+
 END_C_DECLS
 #endif				/* _OSM_DB_H_ */
@@ -564,5 +564,27 @@ int osm_db_neighbor_delete(IN osm_db_domain_t * p_neighbor,
 * osm_db_neighbor_get, osm_db_neighbor_set
 *********/
 
+/****f* OpenSM: DB-Pack/osm_db_codec_get
+* NAME
+*	osm_db_codec_get
+*
+* DESCRIPTION
+*	Get the binary record layout of a domain
+*
+* SYNOPSIS
+*/
+const osm_db_codec_t *osm_db_codec_get(IN const char *domain_name);
+/*
+* PARAMETERS
+*	domain_name
+*		[in] The domain name (guid2lid, guid2mkey or neighbors)
+*
+* RETURN VALUES
+*	The codec of the domain or NULL if the domain has no binary layout
+*
+* SEE ALSO
+*	osm_db_codec_t, osm_db_domain_init
+*********/
+
 END_C_DECLS
 #endif				/* _OSM_DB_PACK_H_ */
@@ -116,6 +116,11 @@ typedef uint8_t osm_log_level_t;
 */
 #define OSM_LOG_DEFAULT_LEVEL		OSM_LOG_ERROR | OSM_LOG_INFO
 
+/*
+	Longest time a message waits in an asynchronous log ring
+*/
+#define OSM_LOG_ASYNC_INTERVAL_MS	10
+
 /****s* OpenSM: Log/osm_log_t
 * NAME
 *	osm_log_t
@@ -136,8 +141,14 @@ typedef struct osm_log {
 	char *log_file_name;
 	char *log_prefix;
 	osm_log_level_t per_mod_log_tbl[256];
+	struct osm_log_async *async;
 } osm_log_t;
-/*********/
+/*
+* FIELDS
+*	async
+*		Asynchronous writer state, NULL while messages are written
+*		synchronously by the logging thread.
+*********/
 
 #define OSM_LOG_MOD_NAME_MAX	32
 
@@ -248,6 +259,87 @@ static inline void osm_log_construct(IN osm_log_t * p_log)
 *	osm_log_destroy
 *********/
 
+/****f* OpenSM: Log/osm_log_async_start
+* NAME
+*	osm_log_async_start
+*
+* DESCRIPTION
+*	Switches the log to asynchronous mode.  Every logging thread then
+*	formats its messages into a private lock free ring, and a writer
+*	thread drains all rings into the log file with writev.  Messages
+*	which do not fit into the ring of their thread are dropped and
+*	counted.
+*
+* SYNOPSIS
+*/
+ib_api_status_t osm_log_async_start(IN osm_log_t * p_log,
+				    IN uint32_t ring_size);
+/*
+* PARAMETERS
+*	p_log
+*		[in] Pointer to an initialized log object.
+*
+*	ring_size
+*		[in] Size in bytes of the ring of each logging thread;
+*		rounded up to a power of two.
+*
+* RETURN VALUES
+*	IB_SUCCESS if the writer thread was started, otherwise the log
+*	stays synchronous.
+*
+* NOTES
+*	Error and syslog messages, and every message when the log is
+*	flushed, wake the writer right away; others are written within
+*	OSM_LOG_ASYNC_INTERVAL_MS.  Order is kept per thread only.
+*
+* SEE ALSO
+*	osm_log_async_stop, osm_log_get_dropped
+*********/
+
+/****f* OpenSM: Log/osm_log_async_stop
+* NAME
+*	osm_log_async_stop
+*
+* DESCRIPTION
+*	Writes the queued messages, stops the writer thread and returns
+*	the log to synchronous mode.
+*
+* SYNOPSIS
+*/
+void osm_log_async_stop(IN osm_log_t * p_log);
+/*
+* PARAMETERS
+*	p_log
+*		[in] Pointer to the log object.
+*
+* NOTES
+*	No other thread may log concurrently.  Does nothing if the log
+*	is synchronous.
+*
+* SEE ALSO
+*	osm_log_async_start
+*********/
+
+/****f* OpenSM: Log/osm_log_get_dropped
+* NAME
+*	osm_log_get_dropped
+*
+* DESCRIPTION
+*	Returns the number of messages dropped because the ring of the
+*	logging thread was full.
+*
+* SYNOPSIS
+*/
+uint64_t osm_log_get_dropped(IN osm_log_t * p_log);
+/*
+* PARAMETERS
+*	p_log
+*		[in] Pointer to the log object.
+*
+* SEE ALSO
+*	osm_log_async_start
+*********/
+
 /****f* OpenSM: Log/osm_log_destroy
 * NAME
 *	osm_log_destroy
@@ -260,6 +352,7 @@ static inline void osm_log_construct(IN osm_log_t * p_log)
 */
 static inline void osm_log_destroy(IN osm_log_t * p_log)
 {
+	osm_log_async_stop(p_log);
 	cl_spinlock_destroy(&p_log->lock);
 	if (p_log->out_port != stdout) {
 		fclose(p_log->out_port);
@@ -43,8 +43,11 @@
 #ifndef _OSM_MAD_POOL_H_
 #define _OSM_MAD_POOL_H_
 
+#include <pthread.h>
 #include <iba/ib_types.h>
 #include <complib/cl_atomic.h>
+#include <complib/cl_qlist.h>
+#include <complib/cl_spinlock.h>
 #include <opensm/osm_base.h>
 #include <opensm/osm_madw.h>
 #include <vendor/osm_vendor.h>
@@ -90,16 +93,69 @@ BEGIN_C_DECLS
 */
 typedef struct osm_mad_pool {
 	atomic32_t mads_out;
+	cl_spinlock_t lock;
+	osm_madw_t *p_free;
+	uint32_t free_count;
+	uint32_t total;
+	uint32_t high_water;
+	uint32_t num_slabs;
+	void *p_slabs;
+	cl_qlist_t caches;
+	pthread_key_t cache_key;
+	boolean_t initialized;
 } osm_mad_pool_t;
 /*
 * FIELDS
 *	mads_out
 *		Running total of the number of MADs outstanding.
 *
+*	lock
+*		Protects the shared free list, the slab list and the list
+*		of per thread caches.
+*
+*	p_free
+*		Shared free list of MAD wrappers, chained through their
+*		list_item.
+*
+*	free_count
+*		Number of wrappers on the shared free list.
+*
+*	total
+*		Number of wrappers allocated in all slabs.
+*
+*	high_water
+*		Highest number of MADs outstanding at any time.
+*
+*	num_slabs
+*		Number of slabs allocated.
+*
+*	p_slabs
+*		List of slabs, freed when the pool is destroyed.
+*
+*	caches
+*		List of per thread caches of free wrappers.
+*
+*	cache_key
+*		Thread specific data key of the per thread cache.
+*
+*	initialized
+*		Indicates that osm_mad_pool_init completed successfully.
+*
+* NOTES
+*	Wrappers are allocated OSM_MAD_POOL_SLAB_SIZE at a time and are
+*	never returned to the system before the pool is destroyed.  Each
+*	thread keeps up to OSM_MAD_POOL_CACHE_MAX free wrappers of its own
+*	and exchanges them with the shared free list in batches, so most
+*	gets and puts do not take the lock.
+*
 * SEE ALSO
 *	MAD Pool
 *********/
 
+#define OSM_MAD_POOL_SLAB_SIZE	256
+#define OSM_MAD_POOL_CACHE_MAX	128
+#define OSM_MAD_POOL_CACHE_BATCH	64
+
 /****f* OpenSM: MAD Pool/osm_mad_pool_construct
 * NAME
 *	osm_mad_pool_construct
@@ -166,12 +222,16 @@ void osm_mad_pool_destroy(IN osm_mad_pool_t * p_pool);
 *
 * SYNOPSIS
 */
-ib_api_status_t osm_mad_pool_init(IN osm_mad_pool_t * p_pool);
+ib_api_status_t osm_mad_pool_init(IN osm_mad_pool_t * p_pool,
+				  IN uint32_t prealloc);
 /*
 * PARAMETERS
 *	p_pool
 *		[in] Pointer to an osm_mad_pool_t object to initialize.
 *
+*	prealloc
+*		[in] Number of MAD wrappers to allocate up front.
+*
 * RETURN VALUES
 *	CL_SUCCESS if the MAD Pool was initialized successfully.
 *
@@ -366,5 +426,61 @@ osm_mad_pool_get_outstanding(IN const osm_mad_pool_t * p_pool)
 *	MAD Pool, osm_mad_pool_get
 *********/
 
+/****f* OpenSM: MAD Pool/osm_mad_pool_get_high_water
+* NAME
+*	osm_mad_pool_get_high_water
+*
+* DESCRIPTION
+*	Returns the highest number of MADs outstanding from the pool at
+*	any time.
+*
+* SYNOPSIS
+*/
+static inline uint32_t
+osm_mad_pool_get_high_water(IN const osm_mad_pool_t * p_pool)
+{
+	return p_pool->high_water;
+}
+
+/*
+* PARAMETERS
+*	p_pool
+*		[in] Pointer to an osm_mad_pool_t object.
+*
+* RETURN VALUES
+*	Returns the highest number of MADs outstanding from the pool.
+*
+* SEE ALSO
+*	MAD Pool, osm_mad_pool_get_outstanding
+*********/
+
+/****f* OpenSM: MAD Pool/osm_mad_pool_get_allocated
+* NAME
+*	osm_mad_pool_get_allocated
+*
+* DESCRIPTION
+*	Returns the number of MAD wrappers allocated by the pool, in use
+*	or free.
+*
+* SYNOPSIS
+*/
+static inline uint32_t
+osm_mad_pool_get_allocated(IN const osm_mad_pool_t * p_pool)
+{
+	return p_pool->total;
+}
+
+/*
+* PARAMETERS
+*	p_pool
+*		[in] Pointer to an osm_mad_pool_t object.
+*
+* RETURN VALUES
+*	Returns the number of MAD wrappers allocated by the pool.
+*
+* SEE ALSO
+*	MAD Pool, osm_mad_pool_get_outstanding
+*********/
+
 END_C_DECLS
 #endif				/* _OSM_MAD_POOL_H_ */
@@ -246,6 +246,7 @@ typedef struct osm_si_context {
 typedef struct osm_lft_context {
 	ib_net64_t node_guid;
 	boolean_t set_method;
+	uint32_t sched_gen;
 } osm_lft_context_t;
 /*********/
 
@@ -457,6 +458,8 @@ typedef struct osm_madw {
 	boolean_t resp_expected;
 	uint32_t timeout;
 	const ib_mad_t *p_mad;
+	struct osm_vl15_target *p_vl15_target;
+	uint64_t vl15_send_time;
 } osm_madw_t;
 /*
 * FIELDS
@@ -504,6 +507,13 @@ typedef struct osm_madw {
 *		wrapper, since wire MADs typically reside in special memory
 *		registered with the local HCA.
 *
+*	p_vl15_target
+*		VL15 scheduling target the request MAD was sent to,
+*		NULL when per target scheduling is not used.
+*
+*	vl15_send_time
+*		Time stamp (usec) at which the VL15 interface sent the MAD.
+*
 * SEE ALSO
 *********/
 
@@ -76,6 +76,8 @@ extern "C" {
 #define OSM_PERFMGR_DEFAULT_DUMP_FILE "opensm_port_counters.log"
 #define OSM_PERFMGR_DEFAULT_MAX_OUTSTANDING_QUERIES 500
 #define OSM_PERFMGR_DEFAULT_XMIT_WAIT_THRESHOLD 0x0000FFFF
+#define OSM_PERFMGR_DEFAULT_HISTORY_SIZE 20
+#define OSM_PERFMGR_DEFAULT_HISTORY_MAX_MEM 128
 
 /****s* OpenSM: PerfMgr/osm_perfmgr_state_t */
 typedef enum {
@@ -276,6 +278,8 @@ void osm_perfmgr_dump_counters(osm_perfmgr_t * p_perfmgr,
 			       perfmgr_db_dump_t dump_type);
 void osm_perfmgr_print_counters(osm_perfmgr_t *pm, char *nodename, FILE *fp,
 				char *port, int err_only);
+void osm_perfmgr_print_rates(osm_perfmgr_t *pm, char *nodename, FILE *fp,
+			     char *port);
 void osm_perfmgr_update_nodename(osm_perfmgr_t *pm, uint64_t node_guid,
 				char *nodename);
 
@@ -117,6 +117,46 @@ typedef enum {
 	PERFMGR_EVENT_DB_DUMP_MR	/* Machine readable */
 } perfmgr_db_dump_t;
 
+/** =========================================================================
+ * Counters kept in the per port history
+ */
+typedef enum {
+	PERFMGR_DB_HIST_XMIT_DATA = 0,	/* bytes */
+	PERFMGR_DB_HIST_RCV_DATA,	/* bytes */
+	PERFMGR_DB_HIST_XMIT_PKTS,
+	PERFMGR_DB_HIST_RCV_PKTS,
+	PERFMGR_DB_HIST_ERRORS,		/* sum of all error counters */
+	PERFMGR_DB_HIST_NUM_COUNTERS
+} perfmgr_db_hist_counter_t;
+
+/** =========================================================================
+ * Port counter history.
+ * Ring buffers of the last db->hist_size deltas of a port.  The samples
+ * live in a single allocation laid out as one array per counter followed
+ * by the data and error interval arrays, so that walking one counter is
+ * a sequential scan.  Data and error readings arrive separately and so
+ * have their own ring position.
+ */
+typedef struct db_port_hist {
+	void *buf;
+	uint32_t dc_head;
+	uint32_t dc_count;
+	uint32_t err_head;
+	uint32_t err_count;
+} db_port_hist_t;
+
+/** =========================================================================
+ * Rates computed from the port history
+ */
+typedef struct {
+	uint32_t dc_samples;
+	uint32_t err_samples;
+	time_t dc_span;		/* seconds covered by the data samples */
+	time_t err_span;	/* seconds covered by the error samples */
+	double rate[PERFMGR_DB_HIST_NUM_COUNTERS];	/* per second;
+							   errors per minute */
+} perfmgr_db_rates_t;
+
 /** =========================================================================
  * Port counter object.
  * Store all the port counters for a single port.
@@ -126,6 +166,7 @@ typedef struct db_port {
 	perfmgr_db_err_reading_t err_previous;
 	perfmgr_db_data_cnt_reading_t dc_total;
 	perfmgr_db_data_cnt_reading_t dc_previous;
+	db_port_hist_t hist;
 	time_t last_reset;
 	boolean_t valid;
 } db_port_t;
@@ -151,6 +192,14 @@ typedef struct perfmgr_db {
 	cl_qmap_t pc_data;	/* stores type (db_node_t *) */
 	cl_plock_t lock;
 	struct osm_perfmgr *perfmgr;
+	uint32_t hist_size;	/* samples per port, 0 disables history */
+	size_t hist_mem_used;
+	size_t hist_mem_max;
+	boolean_t hist_mem_warned;
+	char *store_path;	/* persistent store, NULL if none */
+	int store_fd;
+	void *store_map;
+	size_t store_size;
 } perfmgr_db_t;
 
 /**
@@ -200,6 +249,17 @@ void perfmgr_db_print_by_name(perfmgr_db_t * db, char *nodename, FILE *fp,
 			      char *port, int err_only);
 void perfmgr_db_print_by_guid(perfmgr_db_t * db, uint64_t guid, FILE *fp,
 			      char *port, int err_only);
+perfmgr_db_err_t perfmgr_db_get_rates(perfmgr_db_t * db, uint64_t guid,
+				      uint8_t port, perfmgr_db_rates_t * rates);
+perfmgr_db_err_t perfmgr_db_get_rate_percentile(perfmgr_db_t * db,
+						uint64_t guid, uint8_t port,
+						perfmgr_db_hist_counter_t counter,
+						unsigned percentile,
+						double *rate);
+perfmgr_db_err_t perfmgr_db_store_open(perfmgr_db_t * db, const char *file);
+perfmgr_db_err_t perfmgr_db_store_sync(perfmgr_db_t * db);
+void perfmgr_db_print_rates(perfmgr_db_t * db, char *nodename, uint64_t guid,
+			    FILE *fp, char *port);
 
 /** =========================================================================
  * helper functions to fill in the various db objects from wire objects
@@ -49,6 +49,7 @@
 #include <complib/cl_thread.h>
 #include <complib/cl_timer.h>
 #include <complib/cl_dispatcher.h>
+#include <complib/cl_spinlock.h>
 #include <opensm/osm_stats.h>
 #include <opensm/osm_subnet.h>
 #include <vendor/osm_vendor_api.h>
@@ -166,6 +167,60 @@ typedef struct osm_sa_item {
 #define SA_ITEM_RESP_SIZE(_m) offsetof(osm_sa_item_t, resp._m) + \
 			      sizeof(((osm_sa_item_t *)NULL)->resp._m)
 
+/****d* OpenSM: SA/osm_pr_cache_entry_t
+* NAME
+*	osm_pr_cache_entry_t
+*
+* DESCRIPTION
+*	SA PathRecord parameter cache entry.
+*
+* SYNOPSIS
+*/
+typedef struct osm_pr_cache_entry {
+	uint32_t gen;
+	uint16_t src_lid_ho;
+	uint16_t dest_lid_ho;
+	ib_net64_t src_guid;
+	ib_net64_t dest_guid;
+	uint16_t valid_sl_mask;
+	uint8_t mtu;
+	uint8_t rate;
+	boolean_t qos;
+} osm_pr_cache_entry_t;
+/*
+* FIELDS
+*	gen
+*		Cache generation this entry was computed in. The entry is
+*		valid only while it matches the current generation of the
+*		cache.
+*
+*	src_lid_ho, dest_lid_ho
+*		LID pair of the path (host order).
+*
+*	src_guid, dest_guid
+*		Base port GUIDs the LIDs belonged to when the entry was
+*		computed.
+*
+*	valid_sl_mask
+*		SLs that do not lead to VL15 along the path (QoS only).
+*
+*	mtu
+*		Smallest MTU capability along the path.
+*
+*	rate
+*		Smallest rate along the path.
+*
+*	qos
+*		Whether valid_sl_mask was computed with QoS enabled.
+*
+* NOTES
+*	Only the part of the PathRecord parameters that depends on the
+*	subnet (forwarding tables, port capabilities and SL2VL tables) is
+*	cached. Anything that depends on the request itself (PKey, SL,
+*	QoS level, selectors) is still evaluated per query.
+*
+***********/
+
 /****s* OpenSM: SM/osm_sa_t
 * NAME
 *	osm_sa_t
@@ -192,6 +247,14 @@ typedef struct osm_sa {
 	osm_sa_mad_ctrl_t mad_ctrl;
 	cl_timer_t sr_timer;
 	boolean_t dirty;
+	osm_stats_t *p_stats;
+	cl_spinlock_t pr_cache_lock;
+	osm_pr_cache_entry_t *pr_cache;
+	uint32_t pr_cache_mask;
+	atomic32_t pr_cache_gen;
+	uint32_t pr_summary_gen;
+	boolean_t pr_summary_qos;
+	struct osm_pr_pool *pr_pool;
 	cl_disp_reg_handle_t cpi_disp_h;
 	cl_disp_reg_handle_t nr_disp_h;
 	cl_disp_reg_handle_t pir_disp_h;
@@ -256,6 +319,33 @@ typedef struct osm_sa {
 *		A flag that denotes that SA DB is dirty and needs
 *		to be written to the dump file (if dumping is enabled)
 *
+*	p_stats
+*		Pointer to the OpenSM statistics block.
+*
+*	pr_cache_lock
+*		Lock protecting the PathRecord parameter cache entries.
+*
+*	pr_cache
+*		PathRecord parameter cache (direct mapped by LID pair),
+*		NULL when the cache is disabled.
+*
+*	pr_cache_mask
+*		Number of PathRecord cache entries minus one.
+*
+*	pr_cache_gen
+*		Current generation of the PathRecord cache and of the
+*		switch path summaries. Bumping it invalidates both at once.
+*
+*	pr_summary_gen
+*		Generation the switch path summaries were built in.
+*
+*	pr_summary_qos
+*		Whether the switch path summaries include SL2VL masks.
+*
+*	pr_pool
+*		Worker threads evaluating large PathRecord GetTable
+*		queries, NULL when they are evaluated serially.
+*
 * SEE ALSO
 *	SM object
 *********/
@@ -496,6 +586,264 @@ void osm_sa_respond(osm_sa_t *sa, osm_madw_t *madw, size_t attr_size,
 *	SA object
 *********/
 
+/****s* OpenSM: SA/osm_sa_resp_t
+* NAME
+*	osm_sa_resp_t
+*
+* DESCRIPTION
+*	SA response builder. Records are appended directly into the
+*	payload of the response MAD, which is then sent as is.
+*
+* SYNOPSIS
+*/
+typedef struct osm_sa_resp {
+	osm_sa_t *sa;
+	osm_madw_t *p_madw;
+	osm_madw_t *p_resp_madw;
+	size_t attr_size;
+	unsigned num_rec;
+	unsigned max_rec;
+	boolean_t failed;
+} osm_sa_resp_t;
+/*
+* FIELDS
+*	sa
+*		Pointer to the SA object.
+*
+*	p_madw
+*		Request MAD being answered.
+*
+*	p_resp_madw
+*		Response MAD holding the records appended so far.
+*
+*	attr_size
+*		Size of one record.
+*
+*	num_rec
+*		Number of records appended so far.
+*
+*	max_rec
+*		Number of records p_resp_madw has room for.
+*
+*	failed
+*		Set when a record could not be appended; the response is
+*		then replaced by an error.
+*
+* SEE ALSO
+*	osm_sa_resp_init, osm_sa_resp_append, osm_sa_resp_send
+*********/
+
+/****f* OpenSM: SA/osm_sa_resp_init
+* NAME
+*	osm_sa_resp_init
+*
+* DESCRIPTION
+*	Starts building the response to an SA request.
+*
+* SYNOPSIS
+*/
+void osm_sa_resp_init(IN osm_sa_t * sa, OUT osm_sa_resp_t * p_resp,
+		      IN osm_madw_t * p_madw, IN size_t attr_size,
+		      IN unsigned num_rec_hint);
+/*
+* PARAMETERS
+*	sa
+*		[in] Pointer to an osm_sa_t object.
+*
+*	p_resp
+*		[out] Response builder to initialize.
+*
+*	p_madw
+*		[in] Original MAD to which the response must be sent.
+*
+*	attr_size
+*		[in] Size of this SA attribute.
+*
+*	num_rec_hint
+*		[in] Expected number of records. The payload grows past
+*		it as needed.
+*
+* RETURN VALUES
+*	None.
+*
+* NOTES
+*	Every initialized builder must be passed to either
+*	osm_sa_resp_send or osm_sa_resp_destroy.
+*
+* SEE ALSO
+*	osm_sa_resp_append, osm_sa_resp_send, osm_sa_resp_destroy
+*********/
+
+/****f* OpenSM: SA/osm_sa_resp_append
+* NAME
+*	osm_sa_resp_append
+*
+* DESCRIPTION
+*	Reserves room for one more record in the response.
+*
+* SYNOPSIS
+*/
+void *osm_sa_resp_append(IN osm_sa_resp_t * p_resp);
+/*
+* PARAMETERS
+*	p_resp
+*		[in] Pointer to the response builder.
+*
+* RETURN VALUES
+*	Pointer to the zeroed record to fill in, or NULL if the response
+*	could not be grown.
+*
+* NOTES
+*	The pointer is only valid until the next call, since growing the
+*	payload moves it.
+*
+* SEE ALSO
+*	osm_sa_resp_init, osm_sa_resp_send
+*********/
+
+/****f* OpenSM: SA/osm_sa_resp_count
+* NAME
+*	osm_sa_resp_count
+*
+* DESCRIPTION
+*	Returns the number of records appended so far.
+*
+* SYNOPSIS
+*/
+static inline unsigned osm_sa_resp_count(IN const osm_sa_resp_t * p_resp)
+{
+	return p_resp->num_rec;
+}
+/*
+* PARAMETERS
+*	p_resp
+*		[in] Pointer to the response builder.
+*
+* SEE ALSO
+*	osm_sa_resp_append
+*********/
+
+/****f* OpenSM: SA/osm_sa_resp_record
+* NAME
+*	osm_sa_resp_record
+*
+* DESCRIPTION
+*	Returns a record already appended to the response.
+*
+* SYNOPSIS
+*/
+void *osm_sa_resp_record(IN const osm_sa_resp_t * p_resp, IN unsigned index);
+/*
+* PARAMETERS
+*	p_resp
+*		[in] Pointer to the response builder.
+*
+*	index
+*		[in] Index of the record, below osm_sa_resp_count.
+*
+* SEE ALSO
+*	osm_sa_resp_append, osm_sa_resp_count
+*********/
+
+/****f* OpenSM: SA/osm_sa_resp_send
+* NAME
+*	osm_sa_resp_send
+*
+* DESCRIPTION
+*	Completes the response header and sends the response, or the
+*	matching error if the records do not form a valid response.
+*
+* SYNOPSIS
+*/
+void osm_sa_resp_send(IN osm_sa_resp_t * p_resp);
+/*
+* PARAMETERS
+*	p_resp
+*		[in] Pointer to the response builder. It is released.
+*
+* RETURN VALUES
+*	None.
+*
+* SEE ALSO
+*	osm_sa_resp_init, osm_sa_respond
+*********/
+
+/****f* OpenSM: SA/osm_sa_resp_destroy
+* NAME
+*	osm_sa_resp_destroy
+*
+* DESCRIPTION
+*	Releases a response builder without sending anything.
+*
+* SYNOPSIS
+*/
+void osm_sa_resp_destroy(IN osm_sa_resp_t * p_resp);
+/*
+* PARAMETERS
+*	p_resp
+*		[in] Pointer to the response builder.
+*
+* RETURN VALUES
+*	None.
+*
+* SEE ALSO
+*	osm_sa_resp_init, osm_sa_resp_send
+*********/
+
+/****f* OpenSM: SA/osm_sa_pr_cache_invalidate
+* NAME
+*	osm_sa_pr_cache_invalidate
+*
+* DESCRIPTION
+*	Invalidates all entries of the SA PathRecord parameter cache.
+*
+* SYNOPSIS
+*/
+void osm_sa_pr_cache_invalidate(IN osm_sa_t * sa);
+/*
+* PARAMETERS
+*	sa
+*		[in] Pointer to an osm_sa_t object.
+*
+* RETURN VALUES
+*	This function does not return a value.
+*
+* NOTES
+*	Must be called whenever forwarding tables, port capabilities or
+*	SL2VL tables may have changed. The state manager calls it around
+*	every sweep which goes beyond a light sweep.
+*
+* SEE ALSO
+*	SA object
+*********/
+
+/****f* OpenSM: SA/osm_sa_pr_summary_update
+* NAME
+*	osm_sa_pr_summary_update
+*
+* DESCRIPTION
+*	Rebuilds the per switch path summaries used to compute PathRecord
+*	parameters without walking the path.
+*
+* SYNOPSIS
+*/
+void osm_sa_pr_summary_update(IN osm_sa_t * sa);
+/*
+* PARAMETERS
+*	sa
+*		[in] Pointer to an osm_sa_t object.
+*
+* RETURN VALUES
+*	This function does not return a value.
+*
+* NOTES
+*	The caller must hold the OpenSM lock exclusively. Does nothing
+*	but release the summaries when sa_pr_path_summary is disabled.
+*
+* SEE ALSO
+*	SA object, osm_sa_pr_cache_invalidate
+*********/
+
 struct osm_opensm;
 /****f* OpenSM: SA/osm_sa_db_file_dump
 * NAME
@@ -603,7 +951,7 @@ void osm_pr_process_pair(IN osm_sa_t * sa, IN const ib_sa_mad_t * sa_mad,
 				IN const osm_alias_guid_t * p_dest_alias_guid,
 				IN const ib_gid_t * p_sgid,
 				IN const ib_gid_t * p_dgid,
-				IN cl_qlist_t * p_list);
+				IN osm_sa_resp_t * p_resp);
 
 void osm_pr_process_half(IN osm_sa_t * sa, IN const ib_sa_mad_t * sa_mad,
 				IN const osm_port_t * requester_port,
@@ -611,7 +959,11 @@ void osm_pr_process_half(IN osm_sa_t * sa, IN const ib_sa_mad_t * sa_mad,
 				IN const osm_alias_guid_t * p_dest_alias_guid,
 				IN const ib_gid_t * p_sgid,
 				IN const ib_gid_t * p_dgid,
-				IN cl_qlist_t * p_list);
+				IN osm_sa_resp_t * p_resp);
+
+ib_api_status_t osm_pr_pool_init(IN osm_sa_t * sa);
+
+void osm_pr_pool_destroy(IN osm_sa_t * sa);
 
 END_C_DECLS
 #endif				/* _OSM_SA_H_ */
@@ -58,6 +58,7 @@
 #include <opensm/osm_sm_mad_ctrl.h>
 #include <opensm/osm_lid_mgr.h>
 #include <opensm/osm_ucast_mgr.h>
+#include <opensm/osm_sweep_prof.h>
 #include <opensm/osm_port.h>
 #include <opensm/osm_db.h>
 #include <opensm/osm_remote_sm.h>
@@ -131,6 +132,10 @@ typedef struct osm_sm {
 	osm_sm_mad_ctrl_t mad_ctrl;
 	osm_lid_mgr_t lid_mgr;
 	osm_ucast_mgr_t ucast_mgr;
+	osm_sweep_prof_t sweep_prof;
+	uint64_t light_sweep_sw_key;
+	uint64_t light_sweep_nd_key;
+	boolean_t paths_changed;
 	cl_disp_reg_handle_t sweep_fail_disp_h;
 	cl_disp_reg_handle_t ni_disp_h;
 	cl_disp_reg_handle_t pi_disp_h;
@@ -169,6 +174,18 @@ typedef struct osm_sm {
 *	mad_ctrl
 *		MAD Controller.
 *
+*	sweep_prof
+*		Per phase profile of the last sweeps.
+*
+*	light_sweep_sw_key, light_sweep_nd_key
+*		Key of the last switch polled for SwitchInfo and of the last
+*		node whose NodeDescription was re-read by the round robin
+*		light sweep.
+*
+*	paths_changed
+*		Set by a sweep which went beyond the light sweep and hence
+*		may have changed LIDs, topology or routing.
+*
 *	p_disp
 *		Pointer to the Dispatcher.
 *
@@ -88,11 +88,14 @@ typedef struct osm_stats {
 	atomic32_t qp0_mads_sent;
 	atomic32_t qp0_unicasts_sent;
 	atomic32_t qp0_mads_rcvd_unknown;
+	atomic32_t qp0_mads_timeout;
 	atomic32_t sa_mads_outstanding;
 	atomic32_t sa_mads_rcvd;
 	atomic32_t sa_mads_sent;
 	atomic32_t sa_mads_rcvd_unknown;
 	atomic32_t sa_mads_ignored;
+	atomic32_t sa_pr_cache_hits;
+	atomic32_t sa_pr_cache_misses;
 #ifdef HAVE_LIBPTHREAD
 	pthread_mutex_t mutex;
 	pthread_cond_t cond;
@@ -126,6 +129,10 @@ typedef struct osm_stats {
 *		Total number of unknown QP0 MADs received. This includes
 *		unrecognized attribute IDs and methods.
 *
+*	qp0_mads_timeout
+*		Total number of QP0 MADs that completed with a timeout,
+*		i.e. that got no response after all transport retries.
+*
 *	sa_mads_outstanding
 *		Contains the number of SA MADs outstanding on QP1.
 *
@@ -143,6 +150,14 @@ typedef struct osm_stats {
 *		Total number of SA MADs received because SM is not
 *		master or SM is in first time sweep.
 *
+*	sa_pr_cache_hits
+*		Number of PathRecord parameter lookups answered from the
+*		SA PathRecord cache.
+*
+*	sa_pr_cache_misses
+*		Number of PathRecord parameter lookups that had to walk
+*		the path because no valid cache entry was found.
+*
 * SEE ALSO
 ***************/
 
@@ -259,6 +259,10 @@ typedef struct osm_subn_opt {
 	uint32_t max_wire_smps;
 	uint32_t max_wire_smps2;
 	uint32_t max_smps_timeout;
+	uint32_t max_wire_smps_per_target;
+	uint32_t mad_pool_prealloc;
+	uint32_t lft_window;
+	boolean_t lft_lid_routed;
 	uint32_t transaction_timeout;
 	uint32_t transaction_retries;
 	uint32_t long_transaction_timeout;
@@ -292,6 +296,7 @@ typedef struct osm_subn_opt {
 	char *dump_files_dir;
 	char *log_file;
 	uint32_t log_max_size;
+	uint32_t log_async_ring_size;
 	char *partition_config_file;
 	boolean_t no_partition_enforcement;
 	char *part_enforce;
@@ -310,8 +315,12 @@ typedef struct osm_subn_opt {
 	char *port_search_ordering_file;
 	boolean_t port_profile_switch_nodes;
 	boolean_t sweep_on_trap;
+	uint32_t sweep_profile_history;
+	uint32_t light_sweep_switch_percent;
+	uint32_t light_sweep_node_desc_percent;
 	char *routing_engine_names;
 	boolean_t avoid_throttled_links;
+	uint32_t routing_threads;
 	boolean_t use_ucast_cache;
 	boolean_t connect_roots;
 	char *lid_matrix_dump_file;
@@ -327,6 +336,9 @@ typedef struct osm_subn_opt {
 	boolean_t guid_routing_order_no_scatter;
 	char *sa_db_file;
 	boolean_t sa_db_dump;
+	uint32_t sa_pr_cache_size;
+	boolean_t sa_pr_path_summary;
+	uint32_t sa_pr_threads;
 	char *torus_conf_file;
     char *lnmp_conf_file;
 	boolean_t do_mesh_analysis;
@@ -341,6 +353,7 @@ typedef struct osm_subn_opt {
 	boolean_t use_original_extended_sa_rates_only;
 	boolean_t use_optimized_slvl;
 	boolean_t fsync_high_avail_files;
+	char *db_backend;
 	osm_qos_options_t qos_options;
 	osm_qos_options_t qos_ca_options;
 	osm_qos_options_t qos_sw0_options;
@@ -375,6 +388,9 @@ typedef struct osm_subn_opt {
 	boolean_t perfmgr_query_cpi;
 	boolean_t perfmgr_xmit_wait_log;
 	uint32_t perfmgr_xmit_wait_threshold;
+	uint32_t perfmgr_history_size;
+	uint32_t perfmgr_history_max_mem;
+	char *perfmgr_db_file;
 #endif				/* ENABLE_OSM_PERF_MGR */
 	char *event_plugin_name;
 	char *event_plugin_options;
@@ -387,6 +403,7 @@ typedef struct osm_subn_opt {
 	uint8_t sm_sl;			/* which SL to use for SM/SA communication */
 	uint8_t nue_max_num_vls;	/* maximum #VLs to use in nue */
 	boolean_t nue_include_switches;	/* control how nue treats switches */
+	boolean_t nue_incremental_reroute;	/* reroute only affected paths */
 	char *per_module_logging_file;
 	boolean_t quasi_ftree_indexing;
 } osm_subn_opt_t;
@@ -430,6 +447,26 @@ typedef struct osm_subn_opt {
 *		The wait time in usec for timeout based SMPs.  Default is
 *		timeout * retries.
 *
+*	max_wire_smps_per_target
+*		The maximum number of SMPs outstanding to one target (DR path
+*		or LID). When set, response expecting SMPs are sent round robin
+*		across the targets with a window per target adapted to its
+*		response time. Default is 0, which keeps a single FIFO.
+*
+*	mad_pool_prealloc
+*		The number of MAD wrappers the MAD pool allocates at startup.
+*		The pool grows on demand beyond this.  Default is 1024.
+*
+*	lft_window
+*		The maximum number of LFT blocks outstanding per switch while
+*		forwarding tables are distributed.  0 sends all the blocks at
+*		once.  Default is 4.
+*
+*	lft_lid_routed
+*		Send LFT blocks as LID routed SMPs to switches that are
+*		already reachable by LID, before and after the update.
+*		Default is FALSE.
+*
 *	transaction_timeout
 *		The maximum time in milliseconds allowed for a transaction
 *		to complete.  Default is 200.
@@ -522,6 +559,12 @@ typedef struct osm_subn_opt {
 *		specified the log file will be truncated upon reaching
 *		this limit.
 *
+*	log_async_ring_size
+*		Size in KB of the log ring of each thread. When non zero
+*		messages are queued and written by a separate thread,
+*		messages which do not fit are dropped and counted.
+*		0 (default) writes them synchronously.
+*
 *	qos
 *		Boolean that specifies whether the OpenSM QoS functionality
 *		should be off or on.
@@ -544,6 +587,20 @@ typedef struct osm_subn_opt {
 *	sweep_on_trap
 *		Received traps will initiate a new sweep.
 *
+*	sweep_profile_history
+*		Number of sweeps whose per phase profile is kept in memory
+*		for the console "perf sweep" command.  0 disables profiling.
+*
+*	light_sweep_switch_percent
+*		Percentage of the switches polled for SwitchInfo by each
+*		light sweep.  Below 100 the switches are polled round robin
+*		so that all of them are covered every 100 / percent sweeps.
+*
+*	light_sweep_node_desc_percent
+*		Percentage of the nodes whose NodeDescription is re-read,
+*		round robin, by each light sweep.  0 only re-reads unknown
+*		descriptions; changes are otherwise learnt from trap 144.
+*
 *	routing_engine_names
 *		Name of routing engine(s) to use.
 *
@@ -553,6 +610,12 @@ typedef struct osm_subn_opt {
 *		(if they support it), and hence no path is assigned to these
 *		underperforming links and a warning is logged instead.
 *
+*	routing_threads
+*		Number of threads used by routing engines which support
+*		parallel route computation (nue, and the min hop BFS of updn
+*		and dnup). 1 keeps the sequential computation, 0 uses one
+*		thread per processor.
+*
 *	connect_roots
 *		The option which will enforce root to root connectivity with
 *		up/down and fat-tree routing engines (even if this violates
@@ -599,6 +662,23 @@ typedef struct osm_subn_opt {
 *		When TRUE causes OpenSM to dump SA DB at the end of every
 *		light sweep regardless the current verbosity level.
 *
+*	sa_pr_cache_size
+*		Number of entries in the SA PathRecord parameter cache.
+*		The cache holds the result of walking the path between a
+*		pair of LIDs and is invalidated by every sweep which may
+*		change LIDs, topology or routing. 0 disables the cache.
+*
+*	sa_pr_path_summary
+*		When TRUE, OpenSM summarizes the routed path from each
+*		switch to each LID, so that PathRecord parameters are
+*		computed without walking the path. The summary is rebuilt
+*		after every sweep which may have changed the routing.
+*
+*	sa_pr_threads
+*		Number of threads evaluating PathRecord GetTable queries
+*		over the whole or half of the fabric. 0 uses one thread per
+*		CPU, 1 evaluates them serially.
+*
 *	torus_conf_file
 *		Name of the file with extra configuration info for torus-2QoS
 *		routing engine.
@@ -654,6 +734,11 @@ typedef struct osm_subn_opt {
 *		Synchronize high availability in memory files
 *		with storage.
 *
+*	db_backend
+*		Format of the guid2lid, guid2mkey and neighbors files:
+*		"text" or "binary". The binary files are imported from the
+*		text files the first time.
+*
 *	perfmgr
 *		Enable or disable the performance manager
 *
@@ -663,6 +748,18 @@ typedef struct osm_subn_opt {
 *	perfmgr_sweep_time_s
 *		Define the period (in seconds) of PerfMgr sweeps
 *
+*	perfmgr_history_size
+*		Number of sweeps of counter deltas kept per port to derive
+*		rates and percentiles; 0 disables the history
+*
+*	perfmgr_history_max_mem
+*		Memory budget (in MB) for the counter history of all ports;
+*		ports beyond it keep no history
+*
+*	perfmgr_db_file
+*		File the counter totals are kept in across restarts;
+*		NULL disables it
+*
 *       event_db_dump_file
 *               File to dump the event database to
 *
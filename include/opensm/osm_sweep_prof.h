@@ -0,0 +1,482 @@
+/*
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * Abstract:
+ * 	Declaration of osm_sweep_prof_t.
+ *	This object records per phase timing and MAD counts of the
+ *	last sweeps.
+ *	This object is part of the OpenSM family of objects.
+ */
+
+#ifndef _OSM_SWEEP_PROF_H_
+#define _OSM_SWEEP_PROF_H_
+
+#include <stdio.h>
+#include <iba/ib_types.h>
+#include <complib/cl_spinlock.h>
+#include <opensm/osm_stats.h>
+
+#ifdef __cplusplus
+#  define BEGIN_C_DECLS extern "C" {
+#  define END_C_DECLS   }
+#else				/* !__cplusplus */
+#  define BEGIN_C_DECLS
+#  define END_C_DECLS
+#endif				/* __cplusplus */
+
+BEGIN_C_DECLS
+/****h* OpenSM/Sweep Profiler
+* NAME
+*	Sweep Profiler
+*
+* DESCRIPTION
+*	The Sweep Profiler object keeps a history of the last sweeps
+*	run by the state manager.  Each sweep is split into the phases
+*	the state manager marks (discovery, LID assignment, routing,
+*	link setup, ...) and for each phase the profiler records the
+*	wall clock time, the time spent waiting for outstanding MADs,
+*	the CPU time of the sweeping thread and of the whole process,
+*	and the number of QP0 MADs sent, received and timed out.
+*
+*	Phases are only marked from the SM thread.  The history is
+*	read by the console, so records are published under a lock.
+*
+* AUTHOR
+*
+*********/
+/****d* OpenSM: Sweep Profiler/OSM_SWEEP_PROF_MAX_PHASES
+* NAME
+*	OSM_SWEEP_PROF_MAX_PHASES
+*
+* DESCRIPTION
+*	Maximum number of phases recorded for a single sweep.  Phases
+*	marked beyond this are folded into the last one.
+*
+* SYNOPSIS
+*/
+#define OSM_SWEEP_PROF_MAX_PHASES	48
+/***********/
+
+/****s* OpenSM: Sweep Profiler/osm_sweep_phase_t
+* NAME
+*	osm_sweep_phase_t
+*
+* DESCRIPTION
+*	Counters recorded for one phase of a sweep.
+*
+* SYNOPSIS
+*/
+typedef struct osm_sweep_phase {
+	const char *name;
+	uint64_t start;
+	uint64_t wall_us;
+	uint64_t wait_us;
+	uint64_t thread_cpu_us;
+	uint64_t proc_cpu_us;
+	uint32_t mads_sent;
+	uint32_t mads_rcvd;
+	uint32_t mads_timeout;
+} osm_sweep_phase_t;
+/*
+* FIELDS
+*	name
+*		Static name of the phase.
+*
+*	start
+*		Time stamp (in usec) at which the phase began.
+*
+*	wall_us
+*		Wall clock time of the phase, including wait_us.
+*
+*	wait_us
+*		Part of wall_us spent waiting for outstanding MADs.
+*
+*	thread_cpu_us
+*		CPU time consumed by the SM thread during the phase.
+*
+*	proc_cpu_us
+*		CPU time consumed by the whole process during the phase,
+*		including the MAD receive and dispatcher threads.
+*
+*	mads_sent, mads_rcvd
+*		Number of QP0 MADs sent and received during the phase.
+*
+*	mads_timeout
+*		Number of QP0 MADs that completed with a timeout during
+*		the phase, i.e. after all transport retries were used.
+*
+* SEE ALSO
+*	osm_sweep_rec_t
+*********/
+
+/****s* OpenSM: Sweep Profiler/osm_sweep_rec_t
+* NAME
+*	osm_sweep_rec_t
+*
+* DESCRIPTION
+*	Record of one sweep.
+*
+* SYNOPSIS
+*/
+typedef struct osm_sweep_rec {
+	uint32_t seq;
+	const char *type;
+	uint64_t start;
+	uint64_t wall_us;
+	unsigned num_phases;
+	osm_sweep_phase_t phases[OSM_SWEEP_PROF_MAX_PHASES];
+} osm_sweep_rec_t;
+/*
+* FIELDS
+*	seq
+*		Sequence number of the sweep, starting at 1.
+*
+*	type
+*		Kind of sweep: "light", "reroute" or "heavy".
+*
+*	start
+*		Time stamp (in usec) at which the first phase began.
+*
+*	wall_us
+*		Wall clock time from the start of the first phase to the
+*		end of the last one.
+*
+*	num_phases
+*		Number of valid entries in phases.
+*
+*	phases
+*		Phases in the order they ran.  A phase may appear more
+*		than once, e.g. when discovery is repeated.
+*
+* SEE ALSO
+*	osm_sweep_prof_t
+*********/
+
+/****s* OpenSM: Sweep Profiler/osm_sweep_prof_t
+* NAME
+*	osm_sweep_prof_t
+*
+* DESCRIPTION
+*	Sweep Profiler structure.
+*
+*	The osm_sweep_prof_t object should be treated as opaque and
+*	should be manipulated only through the provided functions.
+*
+* SYNOPSIS
+*/
+typedef struct osm_sweep_prof {
+	cl_spinlock_t lock;
+	osm_stats_t *p_stats;
+	unsigned history;
+	unsigned head;
+	unsigned count;
+	uint32_t seq;
+	osm_sweep_rec_t *recs;
+	osm_sweep_rec_t cur;
+	boolean_t active;
+	uint64_t wait_start;
+	uint64_t thread_cpu0;
+	uint64_t proc_cpu0;
+	uint32_t sent0;
+	uint32_t rcvd0;
+	uint32_t timeout0;
+} osm_sweep_prof_t;
+/*
+* FIELDS
+*	lock
+*		Protects the history ring against concurrent readers.
+*
+*	p_stats
+*		Pointer to the OpenSM statistics block the MAD counters
+*		are sampled from.
+*
+*	history
+*		Number of sweeps kept; 0 disables the profiler.
+*
+*	head, count
+*		Ring index of the next record to write and number of
+*		valid records.
+*
+*	seq
+*		Sequence number of the last sweep started.
+*
+*	recs
+*		Ring of history completed sweep records.
+*
+*	cur
+*		Record of the sweep in progress, private to the SM thread.
+*
+*	active
+*		TRUE while a phase of cur is open.
+*
+*	wait_start
+*		Time stamp at which the current MAD wait began, 0 if none.
+*
+*	thread_cpu0, proc_cpu0, sent0, rcvd0, timeout0
+*		Counter samples taken when the open phase began.
+*
+* SEE ALSO
+*********/
+
+/****f* OpenSM: Sweep Profiler/osm_sweep_prof_construct
+* NAME
+*	osm_sweep_prof_construct
+*
+* DESCRIPTION
+*	This function constructs a Sweep Profiler object.
+*
+* SYNOPSIS
+*/
+void osm_sweep_prof_construct(IN osm_sweep_prof_t * p_prof);
+/*
+* PARAMETERS
+*	p_prof
+*		[in] Pointer to a Sweep Profiler object to construct.
+*
+* RETURN VALUE
+*	This function does not return a value.
+*
+* NOTES
+*	Allows calling osm_sweep_prof_destroy.
+*
+* SEE ALSO
+*	osm_sweep_prof_init, osm_sweep_prof_destroy
+*********/
+
+/****f* OpenSM: Sweep Profiler/osm_sweep_prof_init
+* NAME
+*	osm_sweep_prof_init
+*
+* DESCRIPTION
+*	The osm_sweep_prof_init function initializes a Sweep Profiler
+*	object for use.
+*
+* SYNOPSIS
+*/
+ib_api_status_t osm_sweep_prof_init(IN osm_sweep_prof_t * p_prof,
+				    IN osm_stats_t * p_stats,
+				    IN unsigned history);
+/*
+* PARAMETERS
+*	p_prof
+*		[in] Pointer to an osm_sweep_prof_t object to initialize.
+*
+*	p_stats
+*		[in] Pointer to the OpenSM statistics block.
+*
+*	history
+*		[in] Number of sweeps to keep; 0 disables recording.
+*
+* RETURN VALUES
+*	IB_SUCCESS if the Sweep Profiler object was initialized
+*	successfully.
+*
+* SEE ALSO
+*	osm_sweep_prof_construct, osm_sweep_prof_destroy
+*********/
+
+/****f* OpenSM: Sweep Profiler/osm_sweep_prof_destroy
+* NAME
+*	osm_sweep_prof_destroy
+*
+* DESCRIPTION
+*	The osm_sweep_prof_destroy function destroys the object,
+*	releasing all resources.
+*
+* SYNOPSIS
+*/
+void osm_sweep_prof_destroy(IN osm_sweep_prof_t * p_prof);
+/*
+* PARAMETERS
+*	p_prof
+*		[in] Pointer to the object to destroy.
+*
+* RETURN VALUE
+*	This function does not return a value.
+*
+* SEE ALSO
+*	osm_sweep_prof_construct, osm_sweep_prof_init
+*********/
+
+/****f* OpenSM: Sweep Profiler/osm_sweep_prof_phase
+* NAME
+*	osm_sweep_prof_phase
+*
+* DESCRIPTION
+*	Closes the open phase, if any, and opens a new phase of the
+*	current sweep.  The first phase marked starts a new sweep.
+*
+* SYNOPSIS
+*/
+void osm_sweep_prof_phase(IN osm_sweep_prof_t * p_prof,
+			  IN const char *name);
+/*
+* PARAMETERS
+*	p_prof
+*		[in] Pointer to an osm_sweep_prof_t object.
+*
+*	name
+*		[in] Static string naming the phase.
+*
+* RETURN VALUE
+*	This function does not return a value.
+*
+* SEE ALSO
+*	osm_sweep_prof_sweep_done
+*********/
+
+/****f* OpenSM: Sweep Profiler/osm_sweep_prof_set_type
+* NAME
+*	osm_sweep_prof_set_type
+*
+* DESCRIPTION
+*	Sets the kind of the current sweep.
+*
+* SYNOPSIS
+*/
+void osm_sweep_prof_set_type(IN osm_sweep_prof_t * p_prof,
+			     IN const char *type);
+/*
+* PARAMETERS
+*	p_prof
+*		[in] Pointer to an osm_sweep_prof_t object.
+*
+*	type
+*		[in] Static string, e.g. "light", "reroute" or "heavy".
+*
+* RETURN VALUE
+*	This function does not return a value.
+*********/
+
+/****f* OpenSM: Sweep Profiler/osm_sweep_prof_wait_begin
+* NAME
+*	osm_sweep_prof_wait_begin
+*
+* DESCRIPTION
+*	Marks the start of a wait for outstanding MADs within the open
+*	phase.  osm_sweep_prof_wait_end adds the elapsed time to the
+*	phase wait time.
+*
+* SYNOPSIS
+*/
+void osm_sweep_prof_wait_begin(IN osm_sweep_prof_t * p_prof);
+
+void osm_sweep_prof_wait_end(IN osm_sweep_prof_t * p_prof);
+/*
+* PARAMETERS
+*	p_prof
+*		[in] Pointer to an osm_sweep_prof_t object.
+*
+* RETURN VALUE
+*	These functions do not return a value.
+*********/
+
+/****f* OpenSM: Sweep Profiler/osm_sweep_prof_sweep_done
+* NAME
+*	osm_sweep_prof_sweep_done
+*
+* DESCRIPTION
+*	Closes the open phase and publishes the current sweep into the
+*	history.  Sweeps without any phase are not recorded.
+*
+* SYNOPSIS
+*/
+void osm_sweep_prof_sweep_done(IN osm_sweep_prof_t * p_prof);
+/*
+* PARAMETERS
+*	p_prof
+*		[in] Pointer to an osm_sweep_prof_t object.
+*
+* RETURN VALUE
+*	This function does not return a value.
+*
+* NOTES
+*	Safe to call on every exit path of a sweep, including early
+*	returns.
+*
+* SEE ALSO
+*	osm_sweep_prof_phase
+*********/
+
+/****f* OpenSM: Sweep Profiler/osm_sweep_prof_dump
+* NAME
+*	osm_sweep_prof_dump
+*
+* DESCRIPTION
+*	Prints a per phase table of the last recorded sweeps.
+*
+* SYNOPSIS
+*/
+void osm_sweep_prof_dump(IN osm_sweep_prof_t * p_prof, IN unsigned num,
+			 IN FILE * out);
+/*
+* PARAMETERS
+*	p_prof
+*		[in] Pointer to an osm_sweep_prof_t object.
+*
+*	num
+*		[in] Number of most recent sweeps to print; 0 prints all.
+*
+*	out
+*		[in] Output stream.
+*
+* RETURN VALUE
+*	This function does not return a value.
+*********/
+
+/****f* OpenSM: Sweep Profiler/osm_sweep_prof_export
+* NAME
+*	osm_sweep_prof_export
+*
+* DESCRIPTION
+*	Writes the recorded sweeps as a Chrome trace event JSON object
+*	(loadable by chrome://tracing or Perfetto).  Every sweep and
+*	every phase becomes a complete ("X") event; the MAD waits of a
+*	phase are emitted as a nested event at its end.
+*
+* SYNOPSIS
+*/
+int osm_sweep_prof_export(IN osm_sweep_prof_t * p_prof, IN FILE * out);
+/*
+* PARAMETERS
+*	p_prof
+*		[in] Pointer to an osm_sweep_prof_t object.
+*
+*	out
+*		[in] Output stream.
+*
+* RETURN VALUES
+*	Number of sweeps written, or -1 on an output error.
+*********/
+
+END_C_DECLS
+#endif				/* _OSM_SWEEP_PROF_H_ */
@@ -79,6 +79,99 @@ BEGIN_C_DECLS
 *	Steve King, Intel
 *
 *********/
+/****s* OpenSM: Switch/osm_lft_sched_t
+* NAME
+*	osm_lft_sched_t
+*
+* DESCRIPTION
+*	State of the distribution of the LFT blocks of one switch.
+*
+* SYNOPSIS
+*/
+typedef struct osm_lft_sched {
+	uint16_t *blocks;
+	uint16_t num_blocks;
+	uint16_t next;
+	uint16_t outstanding;
+	uint16_t failed;
+	boolean_t lid_routed;
+	uint64_t start_time;
+} osm_lft_sched_t;
+/*
+* FIELDS
+*	blocks
+*		Ids of the LFT blocks that differ from the switch's LFT.
+*
+*	num_blocks
+*		Number of entries in blocks.
+*
+*	next
+*		Index in blocks of the next block to send.
+*
+*	outstanding
+*		Number of blocks sent and not completed yet.
+*
+*	failed
+*		Number of blocks that completed in error.
+*
+*	lid_routed
+*		Blocks are sent as LID routed SMPs.
+*
+*	start_time
+*		Time stamp at which the distribution started.
+*
+* SEE ALSO
+*	Switch object, osm_ucast_mgr_set_fwd_tables
+*********/
+
+/****s* OpenSM: Switch/osm_path_summary_t
+* NAME
+*	osm_path_summary_t
+*
+* DESCRIPTION
+*	Summary of the path from a switch towards one destination LID,
+*	as followed through the forwarding tables.
+*
+* SYNOPSIS
+*/
+typedef struct osm_path_summary {
+	uint16_t valid_sl_mask;
+	uint8_t mtu;
+	uint8_t rate;
+	uint8_t hops;
+	uint8_t state;
+} osm_path_summary_t;
+/*
+* FIELDS
+*	valid_sl_mask
+*		SLs that do not lead to VL15 on the switches after this one.
+*
+*	mtu
+*		Smallest MTU capability on the path after the egress port
+*		of this switch.
+*
+*	rate
+*		Smallest rate on the path after the egress port of this
+*		switch.
+*
+*	hops
+*		Number of switches traversed after this one.
+*
+*	state
+*		OSM_PATH_SUMMARY_VALID when the entry may be used; any
+*		other value means the path has to be walked.
+*
+* NOTES
+*	The egress port of the switch itself and its SL2VL mapping are
+*	not part of the summary since they depend on how the path enters
+*	the switch. The SA combines the summary with those at query time.
+*
+* SEE ALSO
+*	Switch object, osm_sa_pr_summary_update
+*********/
+
+#define OSM_PATH_SUMMARY_VALID		1
+
 /****s* OpenSM: Switch/osm_switch_t
 * NAME
 *	osm_switch_t
@@ -98,12 +191,13 @@ typedef struct osm_switch {
 	uint16_t max_lid_ho;
 	uint8_t num_ports;
 	uint16_t num_hops;
-	uint8_t **hops;
+	uint8_t *hops;
 	osm_port_profile_t *p_prof;
 	uint8_t *search_ordering_ports;
 	uint8_t *lft;
 	uint8_t *new_lft;
 	uint16_t lft_size;
+	osm_lft_sched_t lft_sched;
 	osm_mcast_tbl_t mcast_tbl;
 	int32_t mft_block_num;
 	uint32_t mft_position;
@@ -113,6 +207,8 @@ typedef struct osm_switch {
 	cl_map_item_t mgrp_item;
 	uint32_t num_of_mcm;
 	uint8_t is_mc_member;
+	osm_path_summary_t *path_summary;
+	uint16_t path_summary_size;
 } osm_switch_t;
 /*
 * FIELDS
@@ -132,11 +228,13 @@ typedef struct osm_switch {
 *		Number of ports for this switch.
 *
 *	num_hops
-*		Size of hops table for this switch.
+*		Number of LIDs (rows) in the hops table for this switch.
 *
 *	hops
 *		LID Matrix for this switch containing the hop count
-*		to every LID from every port.
+*		to every LID from every port, stored as one block of
+*		num_hops rows with num_ports entries each (entry 0 of
+*		a row holds the least hop count to that LID).
 *
 *	p_prof
 *		Pointer to array of Port Profile objects for this switch.
@@ -148,6 +246,9 @@ typedef struct osm_switch {
 *		This switch's linear forwarding table, as was
 *		calculated by the last routing engine execution.
 *
+*	lft_sched
+*		State of the distribution of new_lft to the switch.
+*
 *	mcast_tbl
 *		Multicast forwarding table for this switch.
 *
@@ -164,6 +265,13 @@ typedef struct osm_switch {
 *	is_mc_member
 *		whether switch is a mcast member itself
 *
+*	path_summary
+*		Per destination LID summary of the routed paths, used by
+*		the SA to answer PathRecord queries without walking them.
+*
+*	path_summary_size
+*		Number of entries in path_summary.
+*
 * SEE ALSO
 *	Switch object
 *********/
@@ -267,8 +375,8 @@ static inline uint8_t osm_switch_get_hop_count(IN const osm_switch_t * p_sw,
 					       IN uint16_t lid_ho,
 					       IN uint8_t port_num)
 {
-	return (lid_ho > p_sw->max_lid_ho || !p_sw->hops[lid_ho]) ?
-	    OSM_NO_PATH : p_sw->hops[lid_ho][port_num];
+	return (lid_ho > p_sw->max_lid_ho || lid_ho >= p_sw->num_hops) ?
+	    OSM_NO_PATH : p_sw->hops[lid_ho * p_sw->num_ports + port_num];
 }
 /*
 * PARAMETERS
@@ -355,8 +463,8 @@ void osm_switch_clear_hops(IN osm_switch_t * p_sw);
 static inline uint8_t osm_switch_get_least_hops(IN const osm_switch_t * p_sw,
 						IN uint16_t lid_ho)
 {
-	return (lid_ho > p_sw->max_lid_ho || !p_sw->hops[lid_ho]) ?
-	    OSM_NO_PATH : p_sw->hops[lid_ho][0];
+	return (lid_ho > p_sw->max_lid_ho || lid_ho >= p_sw->num_hops) ?
+	    OSM_NO_PATH : p_sw->hops[lid_ho * p_sw->num_ports];
 }
 /*
 * PARAMETERS
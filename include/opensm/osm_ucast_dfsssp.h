@@ -79,10 +79,21 @@ typedef struct vertex {
 	boolean_t dropped;	/* indicate dropped switches (w/ ucast cache) */
 } vertex_t;
 
+/* "no entry" in the row/column index arrays of the VL table */
+#define VLTABLE_NO_INDEX 0xFFFF
+
+/* all sources behind the same switch use the same channels in the cdg
+   for a destination and hence the same virtual lane; so the assignment
+   is stored with one row per switch (for its Hca ports) and one row per
+   SP0, and with 4 bit per virtual lane
+*/
 typedef struct vltable {
-	uint64_t num_lids;	/* size of the lids array */
-	uint16_t *lids;		/* sorted array of all lids in the subnet */
-	uint8_t *vls;		/* matrix form assignment lid X lid -> virtual lane */
+	uint16_t max_lid;	/* highest lid (host order) in the index arrays */
+	uint16_t *row_index;	/* src lid (host order) -> row of the matrix */
+	uint16_t *col_index;	/* dest lid (host order) -> column of the matrix */
+	uint32_t num_rows;	/* number of rows of the matrix */
+	uint32_t num_cols;	/* number of columns (dest lids) of the matrix */
+	uint8_t *vls;		/* packed matrix form assignment row X column -> virtual lane */
 } vltable_t;
 
 typedef struct cdg_link {
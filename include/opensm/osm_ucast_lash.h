@@ -57,10 +57,9 @@ enum {
 typedef struct _cdg_vertex {
 	int from;
 	int to;
-	int seen;
 	int temp;
-	int visiting_number;
-	struct _cdg_vertex *next;
+	int topo_index;
+	unsigned visit;
 	int num_temp_depend;
 	int num_using_vertex;
 	int num_deps;
@@ -70,12 +69,23 @@ typedef struct _cdg_vertex {
 	} deps[0];
 } cdg_vertex_t;
 
+/* topological order of the CDG vertices of one virtual lane, kept up to
+   date on each dependency insertion (Marchetti-Spaccamela, Nanni and
+   Rohnert) so a tentative path only searches the affected region */
+typedef struct _cdg_topo {
+	cdg_vertex_t **order;	/* vertices by position, NULL for holes */
+	int len;
+	int size;
+	int cycle;	/* a tentative dependency closed a cycle */
+} cdg_topo_t;
+
 typedef struct _switch {
 	osm_switch_t *p_sw;
 	int id;
 	int used_channels;
 	int *dij_channels;
 	int q_state;
+	int chan_base;		/* index of the channel of link 0 */
 	mesh_node_t *node;
 	struct routing_table {
 		unsigned out_link;
@@ -89,9 +99,14 @@ typedef struct _lash {
 	uint8_t vl_min;
 	int balance_limit;
 	switch_t **switches;
-	cdg_vertex_t ****cdg_vertex_matrix;
+	unsigned num_channels;
+	cdg_vertex_t ***cdg_vertices;	/* [lane][channel] */
 	int num_mst_in_lane[IB_MAX_NUM_VLS];
-	int ***virtual_location;
+	cdg_topo_t topo[IB_MAX_NUM_VLS];
+	cdg_vertex_t **topo_stack;
+	cdg_vertex_t **topo_buf;
+	int topo_scratch_size;
+	unsigned topo_visit;
 } lash_t;
 
 #endif
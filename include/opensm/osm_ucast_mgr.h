@@ -101,6 +101,10 @@ typedef struct osm_ucast_mgr {
 	boolean_t some_hop_count_set;
 	cl_qmap_t cache_sw_tbl;
 	boolean_t cache_valid;
+	uint32_t lft_gen;
+	uint32_t lft_sw_pending;
+	uint32_t lft_num_blocks;
+	uint64_t lft_start_time;
 } osm_ucast_mgr_t;
 /*
 * FIELDS
@@ -136,6 +140,19 @@ typedef struct osm_ucast_mgr {
 *	cache_valid
 *		TRUE if the unicast cache is valid.
 *
+*	lft_gen
+*		Generation of the current LFT distribution.  Completions of
+*		blocks sent by an earlier distribution are ignored.
+*
+*	lft_sw_pending
+*		Number of switches whose LFT distribution is not complete.
+*
+*	lft_num_blocks
+*		Number of LFT blocks sent by the current distribution.
+*
+*	lft_start_time
+*		Time stamp at which the current distribution started.
+*
 * SEE ALSO
 *	Unicast Manager object
 *********/
@@ -247,8 +264,50 @@ void osm_ucast_mgr_set_fwd_tables(IN osm_ucast_mgr_t * p_mgr);
 *	p_mgr
 *		[in] Pointer to an osm_ucast_mgr_t object.
 *
+* NOTES
+*	Only the LFT blocks that changed are sent.  At most lft_window
+*	blocks per switch are outstanding at any time, the next one is
+*	sent by osm_ucast_mgr_lft_block_done when one completes.  Switches
+*	with the most changed blocks are served first.
+*
 * SEE ALSO
-*	Unicast Manager
+*	Unicast Manager, osm_ucast_mgr_lft_block_done
+*********/
+
+/****f* OpenSM: Unicast Manager/osm_ucast_mgr_lft_block_done
+* NAME
+*	osm_ucast_mgr_lft_block_done
+*
+* DESCRIPTION
+*	Records the completion of an LFT block set sent by
+*	osm_ucast_mgr_set_fwd_tables, and sends the next block of the
+*	switch if any.
+*
+* SYNOPSIS
+*/
+void osm_ucast_mgr_lft_block_done(IN osm_ucast_mgr_t * p_mgr,
+				  IN osm_switch_t * p_sw,
+				  IN uint32_t sched_gen,
+				  IN boolean_t success);
+/*
+* PARAMETERS
+*	p_mgr
+*		[in] Pointer to an osm_ucast_mgr_t object.
+*
+*	p_sw
+*		[in] Pointer to the switch the block was sent to.
+*
+*	sched_gen
+*		[in] Distribution generation from the MAD's LFT context.
+*
+*	success
+*		[in] TRUE if the switch acknowledged the block.
+*
+* NOTES
+*	The plock must be held exclusively.
+*
+* SEE ALSO
+*	Unicast Manager, osm_ucast_mgr_set_fwd_tables
 *********/
 
 /****f* OpenSM: Unicast Manager/osm_ucast_mgr_build_lid_matrices
@@ -48,6 +48,7 @@
 #include <complib/cl_event.h>
 #include <complib/cl_thread.h>
 #include <complib/cl_qlist.h>
+#include <complib/cl_fleximap.h>
 #include <opensm/osm_stats.h>
 #include <opensm/osm_log.h>
 #include <opensm/osm_madw.h>
@@ -102,6 +103,85 @@ typedef enum _osm_vl15_state {
 } osm_vl15_state_t;
 /***********/
 
+/****d* OpenSM: VL15/OSM_VL15_HIST_BUCKETS
+* NAME
+*	OSM_VL15_HIST_BUCKETS
+*
+* DESCRIPTION
+*	Number of buckets of the per target response latency histogram.
+*	Bucket i counts responses received within 2^(i+1) usec, the last
+*	bucket counts all the slower ones.
+*
+* SYNOPSIS
+*/
+#define OSM_VL15_HIST_BUCKETS 16
+/***********/
+
+/****s* OpenSM: VL15/osm_vl15_target_t
+* NAME
+*	osm_vl15_target_t
+*
+* DESCRIPTION
+*	Scheduling state of one destination (directed route path or LID)
+*	of VL15 MADs expecting a response.
+*
+*	Each target has its own queue and a window of outstanding MADs
+*	that adapts like a TCP congestion window: it grows by one per
+*	response up to the slow start threshold and by 1/window beyond it,
+*	is cut by an eighth when the smoothed response time rises well
+*	above the lowest one seen, and drops to one on a timeout.
+*
+* SYNOPSIS
+*/
+typedef struct osm_vl15_target {
+	cl_fmap_item_t map_item;
+	cl_list_item_t ready_item;
+	cl_qlist_t queue;
+	boolean_t ready;
+	ib_net16_t dlid;
+	uint8_t hop_count;
+	uint8_t path[IB_SUBNET_PATH_HOPS_MAX];
+	uint32_t outstanding;
+	uint32_t cwnd;
+	uint32_t ssthresh;
+	uint32_t acks_since_cut;
+	uint64_t srtt;
+	uint64_t min_rtt;
+	uint64_t sent;
+	uint64_t timeouts;
+	uint64_t hist[OSM_VL15_HIST_BUCKETS];
+} osm_vl15_target_t;
+/*
+* FIELDS
+*	map_item
+*		Linkage in the targets map, keyed by the address of the target.
+*
+*	ready_item
+*		Linkage in the round robin list of targets that may send.
+*
+*	queue
+*		MADs waiting for a window slot of this target.
+*
+*	dlid, hop_count, path
+*		Address of the target: the destination LID and, for directed
+*		route SMPs, the hop count and path[1..hop_count].
+*
+*	outstanding
+*		MADs sent to the target and not yet answered or timed out.
+*
+*	cwnd, ssthresh
+*		Window and slow start threshold, in 1/256 MAD units.
+*
+*	srtt, min_rtt
+*		Smoothed and lowest response time in usec.
+*
+*	sent, timeouts, hist
+*		Counters and response latency histogram.
+*
+* SEE ALSO
+*	osm_vl15_t, osm_vl15_dump_targets
+*********/
+
 /****s* OpenSM: VL15/osm_vl15_t
 * NAME
 *	osm_vl15_t
@@ -124,6 +204,10 @@ typedef struct osm_vl15 {
 	cl_thread_t poller;
 	cl_qlist_t rfifo;
 	cl_qlist_t ufifo;
+	uint32_t max_smps_per_target;
+	cl_fmap_t targets;
+	cl_qlist_t ready;
+	uint32_t targets_gc;
 	cl_spinlock_t lock;
 	osm_vendor_t *p_vend;
 	osm_log_t *p_log;
@@ -161,6 +245,20 @@ typedef struct osm_vl15 {
 *		First-in First-out queue for outbound VL15 MADs for which
 *		no response is expected, aka the "unicast fifo".
 *
+*	max_smps_per_target
+*		Upper bound of the window of each target; 0 disables the
+*		per target scheduling and response MADs go through rfifo.
+*
+*	targets
+*		Map of the osm_vl15_target_t objects.
+*
+*	ready
+*		Round robin list of targets with queued MADs and a free
+*		window slot.
+*
+*	targets_gc
+*		Number of targets above which idle ones are freed.
+*
 *	lock
 *		Spinlock guarding the FIFO.
 *
@@ -254,7 +352,8 @@ ib_api_status_t osm_vl15_init(IN osm_vl15_t * p_vl15, IN osm_vendor_t * p_vend,
 			      IN osm_subn_t * p_subn,
 			      IN int32_t max_wire_smps,
 			      IN int32_t max_wire_smps2,
-			      IN uint32_t max_smps_timeout);
+			      IN uint32_t max_smps_timeout,
+			      IN uint32_t max_smps_per_target);
 /*
 * PARAMETERS
 *	p_vl15
@@ -282,6 +381,9 @@ ib_api_status_t osm_vl15_init(IN osm_vl15_t * p_vl15, IN osm_vendor_t * p_vend,
 *	max_smps_timeout
 *		[in] Wait time in usec for timeout based SMPs.
 *
+*	max_smps_per_target
+*		[in] Maximum number of SMPs outstanding to one target,
+*		     0 disables the per target scheduling.
 *
 * RETURN VALUES
 *	IB_SUCCESS if the VL15 object was initialized successfully.
@@ -322,6 +424,62 @@ void osm_vl15_post(IN osm_vl15_t * p_vl15, IN osm_madw_t * p_madw);
 *	VL15 object, osm_vl15_construct, osm_vl15_init
 *********/
 
+/****f* OpenSM: VL15/osm_vl15_complete
+* NAME
+*	osm_vl15_complete
+*
+* DESCRIPTION
+*	Reports the completion of a request MAD to the per target
+*	scheduler: releases its window slot, records the response time
+*	and adapts the window of the target.
+*
+* SYNOPSIS
+*/
+void osm_vl15_complete(IN osm_vl15_t * p_vl15, IN osm_madw_t * p_madw,
+		       IN boolean_t timed_out);
+/*
+* PARAMETERS
+*	p_vl15
+*		[in] Pointer to an osm_vl15_t object.
+*
+*	p_madw
+*		[in] Pointer to the request MAD wrapper.
+*
+*	timed_out
+*		[in] TRUE if no response was received.
+*
+* RETURN VALUES
+*	This function does not return a value.
+*
+* NOTES
+*	Does nothing for MADs that were not sent through a target.
+*
+* SEE ALSO
+*	VL15 object, osm_vl15_poll, osm_vl15_dump_targets
+*********/
+
+/****f* OpenSM: VL15/osm_vl15_dump_targets
+* NAME
+*	osm_vl15_dump_targets
+*
+* DESCRIPTION
+*	Prints the per target window, response times and latency histogram.
+*
+* SYNOPSIS
+*/
+void osm_vl15_dump_targets(IN osm_vl15_t * p_vl15, IN FILE * out);
+/*
+* PARAMETERS
+*	p_vl15
+*		[in] Pointer to an osm_vl15_t object.
+*
+*	out
+*		[in] Stream to print to.
+*
+* SEE ALSO
+*	VL15 object, osm_vl15_complete
+*********/
+
 /****f* OpenSM: VL15/osm_vl15_poll
 * NAME
 *	osm_vl15_poll
@@ -59,8 +59,12 @@ static int log_exit_count = 0;
 
 #ifndef __WIN__
 #include <sys/time.h>
+#include <sys/uio.h>
 #include <unistd.h>
+#include <pthread.h>
 #include <complib/cl_timer.h>
+#include <complib/cl_event.h>
+#include <complib/cl_thread.h>
 
 static const char *month_str[] = {
 	"Jan",
@@ -109,6 +113,357 @@ static void truncate_log_file(osm_log_t * p_log)
 }
 #endif				/* ndef __WIN__ */
 
+#ifndef __WIN__
+
+/**********************************************************************
+ Asynchronous logging
+
+ Each logging thread owns a ring of complete log lines of which it is
+ the only producer; the writer thread is the only consumer.  head and
+ tail run freely and are reduced modulo the power of two ring size.
+ A record is a 32 bit length followed by the line, padded to 4 bytes;
+ a LOG_RING_WRAP length tells the reader to continue at offset 0.
+ Rings are pushed onto the list of the writer without a lock and are
+ only unlinked by the writer once their thread has exited.
+ **********************************************************************/
+#define LOG_RING_WRAP		0xFFFFFFFF
+#define LOG_RING_ALIGN(len)	(((len) + 3) & ~3U)
+#define LOG_WRITER_IOV		64
+
+typedef struct log_ring {
+	struct log_ring *next;
+	struct osm_log_async *async;
+	uint32_t head;
+	uint32_t tail;
+	int orphaned;
+	char data[];
+} log_ring_t;
+
+typedef struct osm_log_async {
+	osm_log_t *p_log;
+	pthread_key_t ring_key;
+	log_ring_t *rings;
+	uint32_t ring_size;
+	uint64_t dropped;
+	uint64_t reported;
+	cl_event_t wakeup;
+	cl_thread_t writer;
+	int stop;
+} osm_log_async_t;
+
+static void ring_release(void *context)
+{
+	log_ring_t *ring = context;
+
+	__atomic_store_n(&ring->orphaned, 1, __ATOMIC_RELEASE);
+}
+
+static log_ring_t *get_ring(osm_log_async_t * async)
+{
+	log_ring_t *ring;
+
+	ring = pthread_getspecific(async->ring_key);
+	if (ring)
+		return ring;
+
+	ring = calloc(1, sizeof(*ring) + async->ring_size);
+	if (!ring)
+		return NULL;
+	ring->async = async;
+	if (pthread_setspecific(async->ring_key, ring)) {
+		free(ring);
+		return NULL;
+	}
+
+	ring->next = __atomic_load_n(&async->rings, __ATOMIC_RELAXED);
+	while (!__atomic_compare_exchange_n(&async->rings, &ring->next, ring,
+					    1, __ATOMIC_RELEASE,
+					    __ATOMIC_RELAXED)) ;
+	return ring;
+}
+
+/* copy a line into the ring of the calling thread; 0 if queued or dropped */
+static int ring_put(osm_log_async_t * async, const char *line, uint32_t len,
+		    boolean_t urgent)
+{
+	log_ring_t *ring = get_ring(async);
+	uint32_t size = async->ring_size;
+	uint32_t need = sizeof(uint32_t) + LOG_RING_ALIGN(len);
+	uint32_t head, tail, pos, room;
+
+	if (!ring)
+		return -1;
+
+	head = ring->head;
+	tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+	pos = head & (size - 1);
+	room = size - pos;
+	if (room < need)
+		need += room;	/* skip to the start of the ring */
+	if (size - (head - tail) < need) {
+		__atomic_add_fetch(&async->dropped, 1, __ATOMIC_RELAXED);
+		cl_event_signal(&async->wakeup);
+		return 0;
+	}
+
+	if (room < sizeof(uint32_t) + LOG_RING_ALIGN(len)) {
+		*(uint32_t *) (ring->data + pos) = LOG_RING_WRAP;
+		head += room;
+		pos = 0;
+	}
+	*(uint32_t *) (ring->data + pos) = len;
+	memcpy(ring->data + pos + sizeof(uint32_t), line, len);
+	head += sizeof(uint32_t) + LOG_RING_ALIGN(len);
+	__atomic_store_n(&ring->head, head, __ATOMIC_RELEASE);
+
+	if (urgent || size - (head - tail) < size / 2)
+		cl_event_signal(&async->wakeup);
+	return 0;
+}
+
+static int log_async_queue(IN osm_log_t * p_log, IN osm_log_level_t verbosity,
+			   IN const char *buffer)
+{
+	char line[LOG_ENTRY_SIZE_MAX + 64];
+	uint64_t time_usecs;
+	struct tm result;
+	time_t tim;
+	int len;
+
+	time_usecs = cl_get_time_stamp();
+	tim = time_usecs / 1000000;
+	localtime_r(&tim, &result);
+	len = snprintf(line, sizeof(line),
+		       "%s %02d %02d:%02d:%02d %06d [%04X] 0x%02x -> %s",
+		       (result.tm_mon < 12 ? month_str[result.tm_mon] : "???"),
+		       result.tm_mday, result.tm_hour, result.tm_min,
+		       result.tm_sec, (uint32_t) (time_usecs % 1000000),
+		       (pid_t) pthread_self(), verbosity, buffer);
+	if (len < 0)
+		return -1;
+	if (len >= (int)sizeof(line))
+		len = sizeof(line) - 1;
+
+	return ring_put(p_log->async, line, len, p_log->flush ||
+			(verbosity & (OSM_LOG_ERROR | OSM_LOG_SYS)));
+}
+
+/* write out iov; p_log->lock must be held */
+static void writer_flush(osm_log_t * p_log, struct iovec *iov, int cnt)
+{
+	ssize_t ret;
+
+	if (!cnt)
+		return;
+
+	if (p_log->max_size && p_log->count > p_log->max_size) {
+		fprintf(stderr,
+			"osm_log: log file exceeds the limit %lu. Truncating.\n",
+			p_log->max_size);
+		truncate_log_file(p_log);
+	}
+
+	/* anything written through stdio has to go first */
+	fflush(p_log->out_port);
+	ret = writev(fileno(p_log->out_port), iov, cnt);
+	if (ret >= 0) {
+		log_exit_count = 0;
+		p_log->count += ret;
+	} else if (log_exit_count < 3) {
+		log_exit_count++;
+		if (errno == ENOSPC && p_log->max_size) {
+			fprintf(stderr,
+				"osm_log: write failed: %s. Truncating log file.\n",
+				strerror(errno));
+			truncate_log_file(p_log);
+		} else
+			fprintf(stderr, "osm_log: write failed: %s\n",
+				strerror(errno));
+	}
+}
+
+/* write out what is queued in a ring; returns TRUE if it was empty */
+static boolean_t writer_drain(osm_log_async_t * async, log_ring_t * ring)
+{
+	osm_log_t *p_log = async->p_log;
+	uint32_t size = async->ring_size;
+	struct iovec iov[LOG_WRITER_IOV];
+	uint32_t head, tail, pos, len;
+	boolean_t empty = TRUE;
+	int cnt;
+
+	head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+	tail = ring->tail;
+	while (tail != head) {
+		empty = FALSE;
+		for (cnt = 0; tail != head && cnt < LOG_WRITER_IOV;) {
+			pos = tail & (size - 1);
+			len = *(uint32_t *) (ring->data + pos);
+			if (len == LOG_RING_WRAP) {
+				tail += size - pos;
+				continue;
+			}
+			iov[cnt].iov_base = ring->data + pos + sizeof(uint32_t);
+			iov[cnt].iov_len = len;
+			cnt++;
+			tail += sizeof(uint32_t) + LOG_RING_ALIGN(len);
+		}
+		cl_spinlock_acquire(&p_log->lock);
+		writer_flush(p_log, iov, cnt);
+		cl_spinlock_release(&p_log->lock);
+		__atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+	}
+	return empty;
+}
+
+static void writer_report_drops(osm_log_async_t * async)
+{
+	uint64_t dropped = __atomic_load_n(&async->dropped, __ATOMIC_RELAXED);
+	struct iovec iov;
+	char line[128];
+
+	if (dropped == async->reported)
+		return;
+
+	iov.iov_base = line;
+	iov.iov_len = snprintf(line, sizeof(line),
+			       "osm_log: %" PRIu64 " messages dropped "
+			       "(%" PRIu64 " total)\n",
+			       dropped - async->reported, dropped);
+	async->reported = dropped;
+	cl_spinlock_acquire(&async->p_log->lock);
+	writer_flush(async->p_log, &iov, 1);
+	cl_spinlock_release(&async->p_log->lock);
+}
+
+static void log_writer(void *context)
+{
+	osm_log_async_t *async = context;
+	log_ring_t **p_ring, *ring;
+	boolean_t idle;
+	int stop;
+
+	do {
+		stop = __atomic_load_n(&async->stop, __ATOMIC_ACQUIRE);
+		p_ring = &async->rings;
+		while ((ring = __atomic_load_n(p_ring, __ATOMIC_ACQUIRE))) {
+			idle = writer_drain(async, ring);
+			/* the ring of an exited thread goes once it is empty;
+			   the list head may be replaced by a new ring
+			   concurrently, so only rings behind it are removed */
+			if (idle && p_ring != &async->rings &&
+			    __atomic_load_n(&ring->orphaned, __ATOMIC_ACQUIRE)
+			    && ring->tail == ring->head) {
+				*p_ring = ring->next;
+				free(ring);
+				continue;
+			}
+			p_ring = &ring->next;
+		}
+		writer_report_drops(async);
+		if (async->p_log->flush) {
+			cl_spinlock_acquire(&async->p_log->lock);
+			fflush(async->p_log->out_port);
+			cl_spinlock_release(&async->p_log->lock);
+		}
+		if (!stop)
+			cl_event_wait_on(&async->wakeup,
+					 OSM_LOG_ASYNC_INTERVAL_MS * 1000,
+					 FALSE);
+	} while (!stop);
+}
+
+ib_api_status_t osm_log_async_start(IN osm_log_t * p_log,
+				    IN uint32_t ring_size)
+{
+	osm_log_async_t *async;
+	uint32_t size = 4096;
+
+	if (p_log->async)
+		return IB_SUCCESS;
+
+	/* a ring holds at least a couple of maximum size messages */
+	if (ring_size < 4 * LOG_ENTRY_SIZE_MAX)
+		ring_size = 4 * LOG_ENTRY_SIZE_MAX;
+	while (size < ring_size && size < 0x80000000)
+		size <<= 1;
+
+	async = calloc(1, sizeof(*async));
+	if (!async)
+		return IB_INSUFFICIENT_MEMORY;
+	async->p_log = p_log;
+	async->ring_size = size;
+	cl_event_construct(&async->wakeup);
+	cl_thread_construct(&async->writer);
+
+	if (pthread_key_create(&async->ring_key, ring_release)) {
+		free(async);
+		return IB_ERROR;
+	}
+	if (cl_event_init(&async->wakeup, FALSE) != CL_SUCCESS)
+		goto Fail;
+	if (cl_thread_init(&async->writer, log_writer, async,
+			   "osm log writer") != CL_SUCCESS)
+		goto Fail;
+
+	p_log->async = async;
+	return IB_SUCCESS;
+
+Fail:
+	cl_event_destroy(&async->wakeup);
+	pthread_key_delete(async->ring_key);
+	free(async);
+	return IB_ERROR;
+}
+
+void osm_log_async_stop(IN osm_log_t * p_log)
+{
+	osm_log_async_t *async = p_log->async;
+	log_ring_t *ring;
+
+	if (!async)
+		return;
+
+	__atomic_store_n(&async->stop, 1, __ATOMIC_RELEASE);
+	cl_event_signal(&async->wakeup);
+	cl_thread_destroy(&async->writer);
+	p_log->async = NULL;
+
+	/* no thread may run ring_release once its ring is freed */
+	pthread_key_delete(async->ring_key);
+	while ((ring = async->rings)) {
+		async->rings = ring->next;
+		free(ring);
+	}
+	cl_event_destroy(&async->wakeup);
+	free(async);
+}
+
+uint64_t osm_log_get_dropped(IN osm_log_t * p_log)
+{
+	if (!p_log->async)
+		return 0;
+	return __atomic_load_n(&p_log->async->dropped, __ATOMIC_RELAXED);
+}
+
+#else				/* Windows */
+
+ib_api_status_t osm_log_async_start(IN osm_log_t * p_log,
+				    IN uint32_t ring_size)
+{
+	return IB_UNSUPPORTED;
+}
+
+void osm_log_async_stop(IN osm_log_t * p_log)
+{
+}
+
+uint64_t osm_log_get_dropped(IN osm_log_t * p_log)
+{
+	return 0;
+}
+#endif				/* ndef __WIN__ */
+
 void osm_log(IN osm_log_t * p_log, IN osm_log_level_t verbosity,
 	     IN const char *p_str, ...)
 {
@@ -163,6 +518,10 @@ void osm_log(IN osm_log_t * p_log, IN osm_log_level_t verbosity,
 	}
 
 	/* regular log to default out_port */
+#ifndef __WIN__
+	if (p_log->async && !log_async_queue(p_log, verbosity, buffer))
+		return;
+#endif
 	cl_spinlock_acquire(&p_log->lock);
 
 	if (p_log->max_size && p_log->count > p_log->max_size) {
@@ -277,6 +636,10 @@ void osm_log_v2(IN osm_log_t * p_log, IN osm_log_level_t verbosity,
 	}
 
 	/* regular log to default out_port */
+#ifndef __WIN__
+	if (p_log->async && !log_async_queue(p_log, verbosity, buffer))
+		return;
+#endif
 	cl_spinlock_acquire(&p_log->lock);
 
 	if (p_log->max_size && p_log->count > p_log->max_size) {
@@ -473,6 +836,7 @@ ib_api_status_t osm_log_init_v2(IN osm_log_t * p_log, IN boolean_t flush,
 	p_log->max_size = max_size << 20; /* convert size in MB to bytes */
 	p_log->accum_log_file = accum_log_file;
 	p_log->log_file_name = (char *)log_file;
+	p_log->async = NULL;
 	memset(p_log->per_mod_log_tbl, 0, sizeof(p_log->per_mod_log_tbl));
 
 	openlog("OpenSM", LOG_CONS | LOG_PID, LOG_USER);
@@ -52,22 +52,256 @@
 #include <opensm/osm_madw.h>
 #include <vendor/osm_vendor_api.h>
 
+typedef struct mad_pool_slab {
+	struct mad_pool_slab *p_next;
+	osm_madw_t madw[OSM_MAD_POOL_SLAB_SIZE];
+} mad_pool_slab_t;
+
+typedef struct mad_pool_cache {
+	cl_list_item_t list_item;
+	osm_mad_pool_t *p_pool;
+	osm_madw_t *p_free;
+	uint32_t count;
+} mad_pool_cache_t;
+
+#define madw_next(p_madw) ((osm_madw_t *)(p_madw)->list_item.p_next)
+
+/**********************************************************************
+ Allocates a new slab and chains its wrappers to the shared free list.
+ The pool lock must be held.
+ **********************************************************************/
+static boolean_t pool_grow(IN osm_mad_pool_t * p_pool)
+{
+	mad_pool_slab_t *p_slab;
+	int i;
+
+	p_slab = malloc(sizeof(*p_slab));
+	if (!p_slab)
+		return FALSE;
+
+	for (i = OSM_MAD_POOL_SLAB_SIZE - 1; i >= 0; i--) {
+		p_slab->madw[i].list_item.p_next =
+		    (cl_list_item_t *) p_pool->p_free;
+		p_pool->p_free = &p_slab->madw[i];
+	}
+	p_slab->p_next = p_pool->p_slabs;
+	p_pool->p_slabs = p_slab;
+	p_pool->free_count += OSM_MAD_POOL_SLAB_SIZE;
+	p_pool->total += OSM_MAD_POOL_SLAB_SIZE;
+	p_pool->num_slabs++;
+	return TRUE;
+}
+
+/**********************************************************************
+ Moves up to count wrappers from the shared free list to the cache,
+ growing the pool if it is empty.  The pool lock must be held.
+ **********************************************************************/
+static void cache_refill(IN osm_mad_pool_t * p_pool,
+			 IN mad_pool_cache_t * p_cache, IN uint32_t count)
+{
+	osm_madw_t *p_madw;
+
+	if (!p_pool->p_free && !pool_grow(p_pool))
+		return;
+
+	while (count-- && p_pool->p_free) {
+		p_madw = p_pool->p_free;
+		p_pool->p_free = madw_next(p_madw);
+		p_pool->free_count--;
+		p_madw->list_item.p_next = (cl_list_item_t *) p_cache->p_free;
+		p_cache->p_free = p_madw;
+		p_cache->count++;
+	}
+}
+
+/**********************************************************************
+ Moves up to count wrappers from the cache back to the shared free
+ list.  The pool lock must be held.
+ **********************************************************************/
+static void cache_flush(IN osm_mad_pool_t * p_pool,
+			IN mad_pool_cache_t * p_cache, IN uint32_t count)
+{
+	osm_madw_t *p_madw;
+
+	while (count-- && p_cache->p_free) {
+		p_madw = p_cache->p_free;
+		p_cache->p_free = madw_next(p_madw);
+		p_cache->count--;
+		p_madw->list_item.p_next = (cl_list_item_t *) p_pool->p_free;
+		p_pool->p_free = p_madw;
+		p_pool->free_count++;
+	}
+}
+
+/**********************************************************************
+ Thread specific data destructor: returns the wrappers cached by an
+ exiting thread to the shared free list.
+ **********************************************************************/
+static void cache_release(void *context)
+{
+	mad_pool_cache_t *p_cache = context;
+	osm_mad_pool_t *p_pool = p_cache->p_pool;
+
+	cl_spinlock_acquire(&p_pool->lock);
+	cache_flush(p_pool, p_cache, p_cache->count);
+	cl_qlist_remove_item(&p_pool->caches, &p_cache->list_item);
+	cl_spinlock_release(&p_pool->lock);
+	free(p_cache);
+}
+
+static mad_pool_cache_t *get_cache(IN osm_mad_pool_t * p_pool)
+{
+	mad_pool_cache_t *p_cache;
+
+	p_cache = pthread_getspecific(p_pool->cache_key);
+	if (p_cache)
+		return p_cache;
+
+	p_cache = calloc(1, sizeof(*p_cache));
+	if (!p_cache)
+		return NULL;
+	p_cache->p_pool = p_pool;
+	if (pthread_setspecific(p_pool->cache_key, p_cache)) {
+		free(p_cache);
+		return NULL;
+	}
+
+	cl_spinlock_acquire(&p_pool->lock);
+	cl_qlist_insert_tail(&p_pool->caches, &p_cache->list_item);
+	cl_spinlock_release(&p_pool->lock);
+	return p_cache;
+}
+
+static osm_madw_t *alloc_madw(IN osm_mad_pool_t * p_pool)
+{
+	mad_pool_cache_t *p_cache;
+	osm_madw_t *p_madw;
+	uint32_t out, high_water;
+
+	p_cache = get_cache(p_pool);
+	if (p_cache) {
+		if (!p_cache->p_free) {
+			cl_spinlock_acquire(&p_pool->lock);
+			cache_refill(p_pool, p_cache,
+				     OSM_MAD_POOL_CACHE_BATCH);
+			cl_spinlock_release(&p_pool->lock);
+		}
+		p_madw = p_cache->p_free;
+		if (!p_madw)
+			return NULL;
+		p_cache->p_free = madw_next(p_madw);
+		p_cache->count--;
+	} else {
+		cl_spinlock_acquire(&p_pool->lock);
+		if (!p_pool->p_free)
+			pool_grow(p_pool);
+		p_madw = p_pool->p_free;
+		if (p_madw) {
+			p_pool->p_free = madw_next(p_madw);
+			p_pool->free_count--;
+		}
+		cl_spinlock_release(&p_pool->lock);
+		if (!p_madw)
+			return NULL;
+	}
+
+	/* atomic max, several threads may get wrappers concurrently */
+	out = cl_atomic_inc(&p_pool->mads_out);
+	high_water = __atomic_load_n(&p_pool->high_water, __ATOMIC_RELAXED);
+	while (out > high_water &&
+	       !__atomic_compare_exchange_n(&p_pool->high_water, &high_water,
+					    out, 1, __ATOMIC_RELAXED,
+					    __ATOMIC_RELAXED)) ;
+	return p_madw;
+}
+
+static void free_madw(IN osm_mad_pool_t * p_pool, IN osm_madw_t * p_madw)
+{
+	mad_pool_cache_t *p_cache;
+
+	cl_atomic_dec(&p_pool->mads_out);
+
+	p_cache = get_cache(p_pool);
+	if (p_cache) {
+		p_madw->list_item.p_next = (cl_list_item_t *) p_cache->p_free;
+		p_cache->p_free = p_madw;
+		if (++p_cache->count > OSM_MAD_POOL_CACHE_MAX) {
+			cl_spinlock_acquire(&p_pool->lock);
+			cache_flush(p_pool, p_cache,
+				    OSM_MAD_POOL_CACHE_BATCH);
+			cl_spinlock_release(&p_pool->lock);
+		}
+		return;
+	}
+
+	cl_spinlock_acquire(&p_pool->lock);
+	p_madw->list_item.p_next = (cl_list_item_t *) p_pool->p_free;
+	p_pool->p_free = p_madw;
+	p_pool->free_count++;
+	cl_spinlock_release(&p_pool->lock);
+}
+
 void osm_mad_pool_construct(IN osm_mad_pool_t * p_pool)
 {
 	CL_ASSERT(p_pool);
 
 	memset(p_pool, 0, sizeof(*p_pool));
+	cl_spinlock_construct(&p_pool->lock);
+	cl_qlist_init(&p_pool->caches);
 }
 
 void osm_mad_pool_destroy(IN osm_mad_pool_t * p_pool)
 {
+	mad_pool_slab_t *p_slab;
+	cl_list_item_t *p_item;
+
 	CL_ASSERT(p_pool);
+
+	if (!p_pool->initialized)
+		return;
+
+	/*
+	   No more destructor calls once the key is deleted, so the caches
+	   of the threads that are still alive are freed here.
+	 */
+	pthread_key_delete(p_pool->cache_key);
+	while ((p_item = cl_qlist_remove_head(&p_pool->caches)) !=
+	       cl_qlist_end(&p_pool->caches))
+		free(p_item);
+
+	while ((p_slab = p_pool->p_slabs)) {
+		p_pool->p_slabs = p_slab->p_next;
+		free(p_slab);
+	}
+	p_pool->p_free = NULL;
+	p_pool->free_count = 0;
+	p_pool->total = 0;
+	p_pool->num_slabs = 0;
+
+	cl_spinlock_destroy(&p_pool->lock);
+	p_pool->initialized = FALSE;
 }
 
-ib_api_status_t osm_mad_pool_init(IN osm_mad_pool_t * p_pool)
+ib_api_status_t osm_mad_pool_init(IN osm_mad_pool_t * p_pool,
+				  IN uint32_t prealloc)
 {
 	p_pool->mads_out = 0;
 
+	if (cl_spinlock_init(&p_pool->lock) != CL_SUCCESS)
+		return IB_ERROR;
+
+	if (pthread_key_create(&p_pool->cache_key, cache_release)) {
+		cl_spinlock_destroy(&p_pool->lock);
+		return IB_INSUFFICIENT_RESOURCES;
+	}
+	p_pool->initialized = TRUE;
+
+	while (p_pool->total < prealloc)
+		if (!pool_grow(p_pool)) {
+			osm_mad_pool_destroy(p_pool);
+			return IB_INSUFFICIENT_MEMORY;
+		}
+
 	return IB_SUCCESS;
 }
 
@@ -85,7 +319,7 @@ osm_madw_t *osm_mad_pool_get(IN osm_mad_pool_t * p_pool,
 	/*
 	   First, acquire a mad wrapper from the mad wrapper pool.
 	 */
-	p_madw = malloc(sizeof(*p_madw));
+	p_madw = alloc_madw(p_pool);
 	if (p_madw == NULL)
 		goto Exit;
 
@@ -97,12 +331,11 @@ osm_madw_t *osm_mad_pool_get(IN osm_mad_pool_t * p_pool,
 	p_mad = osm_vendor_get(h_bind, total_size, &p_madw->vend_wrap);
 	if (p_mad == NULL) {
 		/* Don't leak wrappers! */
-		free(p_madw);
+		free_madw(p_pool, p_madw);
 		p_madw = NULL;
 		goto Exit;
 	}
 
-	cl_atomic_inc(&p_pool->mads_out);
 	/*
 	   Finally, attach the wire MAD to this wrapper.
 	 */
@@ -127,14 +360,13 @@ osm_madw_t *osm_mad_pool_get_wrapper(IN osm_mad_pool_t * p_pool,
 	/*
 	   First, acquire a mad wrapper from the mad wrapper pool.
 	 */
-	p_madw = malloc(sizeof(*p_madw));
+	p_madw = alloc_madw(p_pool);
 	if (p_madw == NULL)
 		goto Exit;
 
 	/*
 	   Finally, initialize the wrapper object.
 	 */
-	cl_atomic_inc(&p_pool->mads_out);
 	osm_madw_init(p_madw, h_bind, total_size, p_mad_addr);
 	osm_madw_set_mad(p_madw, p_mad);
 
@@ -146,13 +378,12 @@ osm_madw_t *osm_mad_pool_get_wrapper_raw(IN osm_mad_pool_t * p_pool)
 {
 	osm_madw_t *p_madw;
 
-	p_madw = malloc(sizeof(*p_madw));
+	p_madw = alloc_madw(p_pool);
 	if (!p_madw)
 		return NULL;
 
 	osm_madw_init(p_madw, NULL, 0, NULL);
 	osm_madw_set_mad(p_madw, NULL);
-	cl_atomic_inc(&p_pool->mads_out);
 
 	return p_madw;
 }
@@ -170,6 +401,5 @@ void osm_mad_pool_put(IN osm_mad_pool_t * p_pool, IN osm_madw_t * p_madw)
 	/*
 	   Return the mad wrapper to the wrapper pool
 	 */
-	free(p_madw);
-	cl_atomic_dec(&p_pool->mads_out);
+	free_madw(p_pool, p_madw);
 }
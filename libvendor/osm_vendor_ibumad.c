@@ -130,30 +130,198 @@ static void log_send_error(osm_vendor_t * const p_vend, osm_madw_t *p_madw)
 	}
 }
 
+/*
+ * Match table helpers, all called with match_tbl_mutex held
+ */
+static inline int mtbl_is_smp(uint8_t mgmt_class)
+{
+	return mgmt_class == IB_MCLASS_SUBN_DIR ||
+	    mgmt_class == IB_MCLASS_SUBN_LID;
+}
+
+static inline vendor_match_lru_t *mtbl_lru(vendor_match_tbl_t * mtbl,
+					   uint8_t mgmt_class)
+{
+	return mtbl_is_smp(mgmt_class) ? &mtbl->lru_smp : &mtbl->lru_gs;
+}
+
+static inline uint32_t mtbl_hash(vendor_match_tbl_t * mtbl, ib_net64_t tid,
+				 uint8_t mgmt_class)
+{
+	uint32_t key = (uint32_t) cl_ntoh64(tid) ^ ((uint32_t) mgmt_class << 24);
+
+	return (key * 2654435761U) & mtbl->hash_mask;
+}
+
+/* return the hash bucket of (tid, mgmt_class) or UMAD_MATCH_NIL */
+static uint32_t mtbl_find(vendor_match_tbl_t * mtbl, ib_net64_t tid,
+			  uint8_t mgmt_class)
+{
+	uint32_t pos = mtbl_hash(mtbl, tid, mgmt_class);
+	umad_match_t *m;
+
+	while (mtbl->hash[pos]) {
+		m = &mtbl->tbl[mtbl->hash[pos] - 1];
+		if (m->tid == tid && m->mgmt_class == mgmt_class)
+			return pos;
+		pos = (pos + 1) & mtbl->hash_mask;
+	}
+	return UMAD_MATCH_NIL;
+}
+
+static void mtbl_hash_insert(vendor_match_tbl_t * mtbl, uint32_t idx)
+{
+	umad_match_t *m = &mtbl->tbl[idx];
+	uint32_t pos = mtbl_hash(mtbl, m->tid, m->mgmt_class);
+
+	while (mtbl->hash[pos])
+		pos = (pos + 1) & mtbl->hash_mask;
+	mtbl->hash[pos] = idx + 1;
+}
+
+/* empty a bucket and move the following entries of its probe sequence
+   back, so lookups don't need tombstones */
+static void mtbl_hash_remove(vendor_match_tbl_t * mtbl, uint32_t pos)
+{
+	uint32_t next = pos, home;
+	umad_match_t *m;
+
+	for (;;) {
+		mtbl->hash[pos] = 0;
+		for (;;) {
+			next = (next + 1) & mtbl->hash_mask;
+			if (!mtbl->hash[next])
+				return;
+			m = &mtbl->tbl[mtbl->hash[next] - 1];
+			home = mtbl_hash(mtbl, m->tid, m->mgmt_class);
+			/* move the entry if its home bucket is not
+			   cyclically in (pos, next] */
+			if (((next - home) & mtbl->hash_mask) >=
+			    ((next - pos) & mtbl->hash_mask))
+				break;
+		}
+		mtbl->hash[pos] = mtbl->hash[next];
+		pos = next;
+	}
+}
+
+static void mtbl_lru_append(vendor_match_tbl_t * mtbl,
+			    vendor_match_lru_t * lru, uint32_t idx)
+{
+	umad_match_t *m = &mtbl->tbl[idx];
+
+	m->prev = lru->tail;
+	m->next = UMAD_MATCH_NIL;
+	if (lru->tail != UMAD_MATCH_NIL)
+		mtbl->tbl[lru->tail].next = idx;
+	else
+		lru->head = idx;
+	lru->tail = idx;
+}
+
+static void mtbl_lru_remove(vendor_match_tbl_t * mtbl,
+			    vendor_match_lru_t * lru, uint32_t idx)
+{
+	umad_match_t *m = &mtbl->tbl[idx];
+
+	if (m->prev != UMAD_MATCH_NIL)
+		mtbl->tbl[m->prev].next = m->next;
+	else
+		lru->head = m->next;
+	if (m->next != UMAD_MATCH_NIL)
+		mtbl->tbl[m->next].prev = m->prev;
+	else
+		lru->tail = m->prev;
+}
+
+/* unlink a used slot from the hash and its LRU list */
+static void mtbl_unlink(vendor_match_tbl_t * mtbl, uint32_t idx)
+{
+	umad_match_t *m = &mtbl->tbl[idx];
+	uint32_t pos = mtbl_hash(mtbl, m->tid, m->mgmt_class);
+
+	/* look for the slot itself, the key may be used twice */
+	while (mtbl->hash[pos] != idx + 1)
+		pos = (pos + 1) & mtbl->hash_mask;
+	mtbl_hash_remove(mtbl, pos);
+	mtbl_lru_remove(mtbl, mtbl_lru(mtbl, m->mgmt_class), idx);
+}
+
+static void mtbl_free_slot(vendor_match_tbl_t * mtbl, uint32_t idx)
+{
+	umad_match_t *m = &mtbl->tbl[idx];
+
+	m->tid = 0;
+	m->mgmt_class = 0;
+	m->v = NULL;
+	m->next = mtbl->free;
+	mtbl->free = idx;
+}
+
+/* the transaction to evict: the LRU GS transaction if one is available
+   and the LRU SMP transaction only if no other choice */
+static uint32_t mtbl_get_victim(vendor_match_tbl_t * mtbl)
+{
+	if (mtbl->lru_gs.head != UMAD_MATCH_NIL)
+		return mtbl->lru_gs.head;
+	return mtbl->lru_smp.head;
+}
+
+static int mtbl_init(vendor_match_tbl_t * mtbl)
+{
+	uint32_t i, hash_size = 1;
+
+	/* keep the load factor of the hash at or below 1/2 */
+	while (hash_size < 2 * (uint32_t) mtbl->max)
+		hash_size <<= 1;
+
+	mtbl->tbl = calloc(mtbl->max, sizeof(*(mtbl->tbl)));
+	mtbl->hash = calloc(hash_size, sizeof(*(mtbl->hash)));
+	if (!mtbl->tbl || !mtbl->hash) {
+		free(mtbl->tbl);
+		free(mtbl->hash);
+		mtbl->tbl = NULL;
+		mtbl->hash = NULL;
+		return -1;
+	}
+	mtbl->hash_mask = hash_size - 1;
+
+	mtbl->free = UMAD_MATCH_NIL;
+	for (i = mtbl->max; i > 0; i--)
+		mtbl_free_slot(mtbl, i - 1);
+	mtbl->lru_smp.head = mtbl->lru_smp.tail = UMAD_MATCH_NIL;
+	mtbl->lru_gs.head = mtbl->lru_gs.tail = UMAD_MATCH_NIL;
+
+	return 0;
+}
+
 static void clear_madw(osm_vendor_t * p_vend)
 {
-	umad_match_t *m, *e, *old_m;
+	vendor_match_tbl_t *mtbl = &p_vend->mtbl;
+	umad_match_t *old_m;
 	ib_net64_t old_tid;
 	uint8_t old_mgmt_class;
+	uint32_t idx;
 
 	OSM_LOG_ENTER(p_vend->p_log);
 	pthread_mutex_lock(&p_vend->match_tbl_mutex);
-	for (m = p_vend->mtbl.tbl, e = m + p_vend->mtbl.max; m < e; m++) {
-		if (m->tid) {
-			old_m = m;
-			old_tid = m->tid;
-			old_mgmt_class = m->mgmt_class;
-			m->tid = 0;
-			osm_mad_pool_put(((osm_umad_bind_info_t
-					   *) ((osm_madw_t *) m->v)->h_bind)->
-					 p_mad_pool, m->v);
-			pthread_mutex_unlock(&p_vend->match_tbl_mutex);
-			OSM_LOG(p_vend->p_log, OSM_LOG_ERROR, "ERR 5401: "
-				"evicting entry %p (tid was 0x%" PRIx64
-				" mgmt class 0x%x)\n",
-				old_m, cl_ntoh64(old_tid), old_mgmt_class);
-			goto Exit;
-		}
+	idx = mtbl->tbl ? mtbl_get_victim(mtbl) : UMAD_MATCH_NIL;
+	if (idx != UMAD_MATCH_NIL) {
+		old_m = &mtbl->tbl[idx];
+		old_tid = old_m->tid;
+		old_mgmt_class = old_m->mgmt_class;
+		mtbl_unlink(mtbl, idx);
+		osm_mad_pool_put(((osm_umad_bind_info_t
+				   *) ((osm_madw_t *) old_m->v)->h_bind)->
+				 p_mad_pool, old_m->v);
+		mtbl_free_slot(mtbl, idx);
+		mtbl->evictions++;
+		pthread_mutex_unlock(&p_vend->match_tbl_mutex);
+		OSM_LOG(p_vend->p_log, OSM_LOG_ERROR, "ERR 5401: "
+			"evicting entry %p (tid was 0x%" PRIx64
+			" mgmt class 0x%x)\n",
+			old_m, cl_ntoh64(old_tid), old_mgmt_class);
+		goto Exit;
 	}
 	pthread_mutex_unlock(&p_vend->match_tbl_mutex);
 
@@ -164,9 +332,10 @@ Exit:
 static osm_madw_t *get_madw(osm_vendor_t * p_vend, ib_net64_t * tid,
 			    uint8_t mgmt_class)
 {
-	umad_match_t *m, *e;
+	vendor_match_tbl_t *mtbl = &p_vend->mtbl;
 	ib_net64_t mtid = (*tid & CL_HTON64(0x00000000ffffffffULL));
 	osm_madw_t *res;
+	uint32_t pos, idx;
 
 	/*
 	 * Since mtid == 0 is the empty key, we should not
@@ -176,17 +345,20 @@ static osm_madw_t *get_madw(osm_vendor_t * p_vend, ib_net64_t * tid,
 		return 0;
 
 	pthread_mutex_lock(&p_vend->match_tbl_mutex);
-	for (m = p_vend->mtbl.tbl, e = m + p_vend->mtbl.max; m < e; m++) {
-		if (m->tid == mtid && m->mgmt_class == mgmt_class) {
-			m->tid = 0;
-			m->mgmt_class = 0;
-			*tid = mtid;
-			res = m->v;
-			pthread_mutex_unlock(&p_vend->match_tbl_mutex);
-			return res;
-		}
+	pos = mtbl_find(mtbl, mtid, mgmt_class);
+	if (pos != UMAD_MATCH_NIL) {
+		idx = mtbl->hash[pos] - 1;
+		mtbl_hash_remove(mtbl, pos);
+		mtbl_lru_remove(mtbl, mtbl_lru(mtbl, mgmt_class), idx);
+		res = mtbl->tbl[idx].v;
+		mtbl_free_slot(mtbl, idx);
+		mtbl->hits++;
+		*tid = mtid;
+		pthread_mutex_unlock(&p_vend->match_tbl_mutex);
+		return res;
 	}
 
+	mtbl->misses++;
 	pthread_mutex_unlock(&p_vend->match_tbl_mutex);
 	return 0;
 }
@@ -201,75 +373,50 @@ static void
 put_madw(osm_vendor_t * p_vend, osm_madw_t * p_madw, ib_net64_t tid,
 	 uint8_t mgmt_class)
 {
-	umad_match_t *m, *e, *old_lru, *lru = 0, *lru_smp = 0;
+	vendor_match_tbl_t *mtbl = &p_vend->mtbl;
+	umad_match_t *m, *old_lru = NULL;
 	osm_madw_t *p_req_madw;
 	osm_umad_bind_info_t *p_bind;
-	ib_net64_t old_tid;
-	uint32_t oldest = ~0, oldest_smp = ~0;
-	uint8_t old_mgmt_class;
+	ib_net64_t old_tid = 0;
+	uint8_t old_mgmt_class = 0;
+	uint32_t idx;
 
 	pthread_mutex_lock(&p_vend->match_tbl_mutex);
-	for (m = p_vend->mtbl.tbl, e = m + p_vend->mtbl.max; m < e; m++) {
-		if (m->tid == 0 && m->mgmt_class == 0) {
-			m->tid = tid;
-			m->mgmt_class = mgmt_class;
-			m->v = p_madw;
-			m->version =
-			    cl_atomic_inc((atomic32_t *) & p_vend->mtbl.
-					  last_version);
-			pthread_mutex_unlock(&p_vend->match_tbl_mutex);
-			return;
-		}
-		if (m->mgmt_class == IB_MCLASS_SUBN_DIR ||
-		    m->mgmt_class == IB_MCLASS_SUBN_LID) {
-			if (oldest_smp >= m->version) {
-				oldest_smp = m->version;
-				lru_smp = m;
-			}
-		} else {
-			if (oldest >= m->version) {
-				oldest = m->version;
-				lru = m;
-			}
-		}
+	idx = mtbl->free;
+	if (idx != UMAD_MATCH_NIL)
+		mtbl->free = mtbl->tbl[idx].next;
+	else {
+		idx = mtbl_get_victim(mtbl);
+		CL_ASSERT(idx != UMAD_MATCH_NIL);
+		old_lru = &mtbl->tbl[idx];
+		old_tid = old_lru->tid;
+		old_mgmt_class = old_lru->mgmt_class;
+		mtbl_unlink(mtbl, idx);
+		mtbl->evictions++;
+
+		p_req_madw = old_lru->v;
+		p_bind = p_req_madw->h_bind;
+		p_req_madw->status = IB_CANCELED;
+		log_send_error(p_vend, p_req_madw);
+		pthread_mutex_lock(&p_vend->cb_mutex);
+		(*p_bind->send_err_callback) (p_bind->client_context,
+					      p_req_madw);
+		pthread_mutex_unlock(&p_vend->cb_mutex);
 	}
 
-	if (oldest != ~0) {
-		old_lru = lru;
-		old_tid = lru->tid;
-		old_mgmt_class = lru->mgmt_class;
-	} else {
-		CL_ASSERT(oldest_smp != ~0);
-		old_lru = lru_smp;
-		old_tid = lru_smp->tid;
-		old_mgmt_class = lru_smp->mgmt_class;
-	}
-	p_req_madw = old_lru->v;
-	p_bind = p_req_madw->h_bind;
-	p_req_madw->status = IB_CANCELED;
-	log_send_error(p_vend, p_req_madw);
-	pthread_mutex_lock(&p_vend->cb_mutex);
-	(*p_bind->send_err_callback) (p_bind->client_context, p_req_madw);
-	pthread_mutex_unlock(&p_vend->cb_mutex);
-	if (mgmt_class == IB_MCLASS_SUBN_DIR ||
-	    mgmt_class == IB_MCLASS_SUBN_LID) {
-		lru_smp->tid = tid;
-		lru_smp->mgmt_class = mgmt_class;
-		lru_smp->v = p_madw;
-		lru_smp->version =
-		    cl_atomic_inc((atomic32_t *) & p_vend->mtbl.last_version);
-	} else {
-		lru->tid = tid;
-		lru->mgmt_class = mgmt_class;
-		lru->v = p_madw;
-		lru->version =
-		    cl_atomic_inc((atomic32_t *) & p_vend->mtbl.last_version);
-	}
+	m = &mtbl->tbl[idx];
+	m->tid = tid;
+	m->mgmt_class = mgmt_class;
+	m->v = p_madw;
+	mtbl_hash_insert(mtbl, idx);
+	mtbl_lru_append(mtbl, mtbl_lru(mtbl, mgmt_class), idx);
 	pthread_mutex_unlock(&p_vend->match_tbl_mutex);
-	OSM_LOG(p_vend->p_log, OSM_LOG_ERROR, "ERR 5402: "
-		"evicting entry %p (tid was 0x%" PRIx64
-		" mgmt class 0x%x)\n", old_lru,
-		cl_ntoh64(old_tid), old_mgmt_class);
+
+	if (old_lru)
+		OSM_LOG(p_vend->p_log, OSM_LOG_ERROR, "ERR 5402: "
+			"evicting entry %p (tid was 0x%" PRIx64
+			" mgmt class 0x%x)\n", old_lru,
+			cl_ntoh64(old_tid), old_mgmt_class);
 }
 
 static void
@@ -586,8 +733,7 @@ osm_vendor_init(IN osm_vendor_t * const p_vend,
 	OSM_LOG(p_vend->p_log, OSM_LOG_INFO, "%d pending umads specified\n",
 		p_vend->mtbl.max);
 
-	p_vend->mtbl.tbl = calloc(p_vend->mtbl.max, sizeof(*(p_vend->mtbl.tbl)));
-	if (!p_vend->mtbl.tbl) {
+	if (mtbl_init(&p_vend->mtbl)) {
 		OSM_LOG(p_vend->p_log, OSM_LOG_ERROR, "Error:"
 			"failed to allocate vendor match table\n");
 		r = IB_INSUFFICIENT_MEMORY;
@@ -639,9 +785,15 @@ void osm_vendor_delete(IN osm_vendor_t ** const pp_vend)
 	/* make sure all ports are closed */
 	umad_done();
 
+	OSM_LOG((*pp_vend)->p_log, OSM_LOG_VERBOSE,
+		"Match table: %" PRIu64 " hits, %" PRIu64 " misses, %"
+		PRIu64 " evictions\n", (*pp_vend)->mtbl.hits,
+		(*pp_vend)->mtbl.misses, (*pp_vend)->mtbl.evictions);
+
 	pthread_mutex_destroy(&(*pp_vend)->cb_mutex);
 	pthread_mutex_destroy(&(*pp_vend)->match_tbl_mutex);
 	free((*pp_vend)->mtbl.tbl);
+	free((*pp_vend)->mtbl.hash);
 	free(*pp_vend);
 	*pp_vend = NULL;
 }
@@ -234,12 +234,43 @@ static void help_update_desc(FILE *out, int detail)
 	}
 }
 
+static void help_vl15(FILE * out, int detail)
+{
+	fprintf(out, "vl15\n");
+	if (detail) {
+		fprintf(out, "print the per target SMP windows, response times\n");
+		fprintf(out, "and latency histograms (max_wire_smps_per_target)\n");
+	}
+}
+
+static void help_perf(FILE * out, int detail)
+{
+	fprintf(out, "perf sweep [<count>|export <file>]\n");
+	if (detail) {
+		fprintf(out, "print the per phase wall clock time, MAD wait time,\n");
+		fprintf(out, "CPU time and QP0 MAD counts of the last sweeps\n");
+		fprintf(out, "   [<count>] -- only print the last <count> sweeps\n");
+		fprintf(out, "   [export <file>] -- write the recorded sweeps to <file>\n");
+		fprintf(out, "      as Chrome trace event JSON (chrome://tracing)\n");
+	}
+}
+
+static void help_db_export(FILE * out, int detail)
+{
+	fprintf(out, "db_export\n");
+	if (detail) {
+		fprintf(out, "write the binary db files back to the text files\n");
+		fprintf(out, "in the cache directory (db_backend binary)\n");
+	}
+}
+
 #ifdef ENABLE_OSM_PERF_MGR
 static void help_perfmgr(FILE * out, int detail)
 {
 	fprintf(out,
 		"perfmgr(pm) [enable|disable\n"
 		"             |clear_counters|dump_counters|print_counters(pc)|print_errors(pe)\n"
+		"             |print_rates(pr)\n"
 		"             |set_rm_nodes|clear_rm_nodes|clear_inactive\n"
 		"             |set_query_cpi|clear_query_cpi\n"
 		"             |dump_redir|clear_redir\n"
@@ -267,6 +298,11 @@ static void help_perfmgr(FILE * out, int detail)
 			"                                           Optionally limit output by name or guid\n");
 		fprintf(out,
 			"   [pe [<nodename|nodeguid>]] -- same as print_errors\n");
+		fprintf(out,
+			"   [print_rates [<nodename|nodeguid>][:<port>]] -- print rates and percentiles\n"
+			"                                                   over the recent counter history\n");
+		fprintf(out,
+			"   [pr [<nodename|nodeguid>][:<port>]] -- same as print_rates\n");
 		fprintf(out,
 			"   [dump_redir [<nodename|nodeguid>]] -- dump the redirection table\n");
 		fprintf(out,
@@ -441,6 +477,26 @@ static void dump_sms(osm_opensm_t * p_osm, FILE * out)
 	CL_PLOCK_RELEASE(p_osm->sm.p_lock);
 }
 
+static void print_disp_queues(osm_opensm_t * p_osm, FILE * out)
+{
+	cl_disp_queue_stats_t stats;
+	uint32_t i;
+
+	fprintf(out, "\n   Dispatcher queues\n"
+		"   -----------------\n");
+	for (i = 0; i < cl_disp_get_queue_count(&p_osm->disp); i++) {
+		if (cl_disp_get_queue_stats(&p_osm->disp, i, &stats) !=
+		    CL_SUCCESS)
+			break;
+		fprintf(out, "   Queue %-2u depth %u (max %u), posted %"
+			PRIu64 ", stolen %" PRIu64 ", wait %" PRIu64
+			" usec (max %" PRIu64 ")\n", i, stats.depth,
+			stats.max_depth, stats.msgs_posted, stats.msgs_stolen,
+			stats.last_msg_queue_time_us,
+			stats.max_msg_queue_time_us);
+	}
+}
+
 static void print_status(osm_opensm_t * p_osm, FILE * out)
 {
 	cl_list_item_t *item;
@@ -487,22 +543,42 @@ static void print_status(osm_opensm_t * p_osm, FILE * out)
 			"   QP0 MADs sent                  : %u\n"
 			"   QP0 unicasts sent              : %u\n"
 			"   QP0 unknown MADs rcvd          : %u\n"
+			"   QP0 MADs timed out             : %u\n"
 			"   SA MADs outstanding            : %u\n"
 			"   SA MADs rcvd                   : %u\n"
 			"   SA MADs sent                   : %u\n"
 			"   SA unknown MADs rcvd           : %u\n"
-			"   SA MADs ignored                : %u\n",
+			"   SA MADs ignored                : %u\n"
+			"   SA PR cache hits               : %u\n"
+			"   SA PR cache misses             : %u\n",
 			(uint32_t)p_osm->stats.qp0_mads_outstanding,
 			(uint32_t)p_osm->stats.qp0_mads_outstanding_on_wire,
 			(uint32_t)p_osm->stats.qp0_mads_rcvd,
 			(uint32_t)p_osm->stats.qp0_mads_sent,
 			(uint32_t)p_osm->stats.qp0_unicasts_sent,
 			(uint32_t)p_osm->stats.qp0_mads_rcvd_unknown,
+			(uint32_t)p_osm->stats.qp0_mads_timeout,
 			(uint32_t)p_osm->stats.sa_mads_outstanding,
 			(uint32_t)p_osm->stats.sa_mads_rcvd,
 			(uint32_t)p_osm->stats.sa_mads_sent,
 			(uint32_t)p_osm->stats.sa_mads_rcvd_unknown,
-			(uint32_t)p_osm->stats.sa_mads_ignored);
+			(uint32_t)p_osm->stats.sa_mads_ignored,
+			(uint32_t)p_osm->stats.sa_pr_cache_hits,
+			(uint32_t)p_osm->stats.sa_pr_cache_misses);
+		fprintf(out, "\n   MAD pool\n"
+			"   --------\n"
+			"   MADs outstanding               : %u\n"
+			"   MADs outstanding (high water)  : %u\n"
+			"   MAD wrappers allocated         : %u\n",
+			osm_mad_pool_get_outstanding(&p_osm->mad_pool),
+			osm_mad_pool_get_high_water(&p_osm->mad_pool),
+			osm_mad_pool_get_allocated(&p_osm->mad_pool));
+		if (p_osm->log.async)
+			fprintf(out, "\n   Log\n"
+				"   ---\n"
+				"   Async log lines dropped        : %" PRIu64 "\n",
+				osm_log_get_dropped(&p_osm->log));
+		print_disp_queues(p_osm, out);
 		fprintf(out, "\n   Subnet flags\n"
 			"   ------------\n"
 			"   Sweeping enabled               : %d\n"
@@ -1392,6 +1468,81 @@ static void update_desc_parse(char **p_last, osm_opensm_t * p_osm, FILE * out)
 	osm_update_node_desc(p_osm);
 }
 
+static void vl15_parse(char **p_last, osm_opensm_t * p_osm, FILE * out)
+{
+	osm_vl15_dump_targets(&p_osm->vl15, out);
+}
+
+static void perf_parse(char **p_last, osm_opensm_t * p_osm, FILE * out)
+{
+	char *p_cmd;
+	FILE *fp;
+	int num;
+
+	p_cmd = next_token(p_last);
+	if (!p_cmd || strcmp(p_cmd, "sweep")) {
+		help_perf(out, 1);
+		return;
+	}
+
+	p_cmd = next_token(p_last);
+	if (!p_cmd) {
+		osm_sweep_prof_dump(&p_osm->sm.sweep_prof, 0, out);
+		return;
+	}
+
+	if (strcmp(p_cmd, "export")) {
+		osm_sweep_prof_dump(&p_osm->sm.sweep_prof,
+				    strtoul(p_cmd, NULL, 0), out);
+		return;
+	}
+
+	p_cmd = next_token(p_last);
+	if (!p_cmd) {
+		fprintf(out, "No file name passed\n");
+		return;
+	}
+
+	fp = fopen(p_cmd, "w");
+	if (!fp) {
+		fprintf(out, "Could not open file %s: %s\n", p_cmd,
+			strerror(errno));
+		return;
+	}
+	num = osm_sweep_prof_export(&p_osm->sm.sweep_prof, fp);
+	if (fclose(fp) || num < 0)
+		fprintf(out, "Failed to write %s\n", p_cmd);
+	else
+		fprintf(out, "Exported %d sweeps to %s\n", num, p_cmd);
+}
+
+static void db_export_parse(char **p_last, osm_opensm_t * p_osm, FILE * out)
+{
+	cl_list_iterator_t iter;
+	osm_db_domain_t *p_domain;
+	unsigned exported = 0, failed = 0;
+
+	for (iter = cl_list_head(&p_osm->db.domains);
+	     iter != cl_list_end(&p_osm->db.domains);
+	     iter = cl_list_next(iter)) {
+		p_domain = (osm_db_domain_t *) cl_list_obj(iter);
+		if (!osm_db_domain_is_binary(p_domain))
+			continue;
+		if (osm_db_export(p_domain,
+				  p_osm->subn.opt.fsync_high_avail_files))
+			failed++;
+		else
+			exported++;
+	}
+
+	if (!exported && !failed)
+		fprintf(out, "No binary db domains (db_backend is %s)\n",
+			p_osm->subn.opt.db_backend);
+	else
+		fprintf(out, "Exported %u db domains to text, %u failed\n",
+			exported, failed);
+}
+
 #ifdef ENABLE_OSM_PERF_MGR
 static monitored_node_t *find_node_by_name(osm_opensm_t * p_osm,
 					   char *nodename)
@@ -1591,6 +1742,19 @@ static void perfmgr_parse(char **p_last, osm_opensm_t * p_osm, FILE * out)
 			p_cmd = name_token(p_last);
 			osm_perfmgr_print_counters(&p_osm->perfmgr, p_cmd,
 						   out, NULL, 1);
+		} else if (strcmp(p_cmd, "print_rates") == 0 ||
+			   strcmp(p_cmd, "pr") == 0) {
+			char *port = NULL;
+			p_cmd = name_token(p_last);
+			if (p_cmd) {
+				port = strchr(p_cmd, ':');
+				if (port) {
+					*port = '\0';
+					port++;
+				}
+			}
+			osm_perfmgr_print_rates(&p_osm->perfmgr, p_cmd, out,
+						port);
 		} else if (strcmp(p_cmd, "dump_redir") == 0) {
 			p_cmd = name_token(p_last);
 			dump_redir(p_osm, p_cmd, out);
@@ -1783,6 +1947,9 @@ static const struct command console_cmds[] = {
 	{"dump_conf", &help_dump_conf, &dump_conf_parse},
 	{"update_desc", &help_update_desc, &update_desc_parse},
 	{"version", &help_version, &version_parse},
+	{"db_export", &help_db_export, &db_export_parse},
+	{"vl15", &help_vl15, &vl15_parse},
+	{"perf", &help_perf, &perf_parse},
 #ifdef ENABLE_OSM_PERF_MGR
 	{"perfmgr", &help_perfmgr, &perfmgr_parse},
 	{"pm", &help_pm, &perfmgr_parse},
@@ -0,0 +1,657 @@
+/*
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * Abstract:
+ * Binary store of the osm_db domains: an append only log of fixed size
+ * records, replayed from a memory mapping on restore and compacted
+ * when it grows much larger than the live set.
+ */
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif				/* HAVE_CONFIG_H */
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <complib/cl_fleximap.h>
+#include <opensm/osm_file_ids.h>
+#define FILE_ID OSM_FILE_DB_BIN_C
+#include <opensm/osm_db.h>
+#include <opensm/osm_log.h>
+
+#define OSM_DB_BIN_MAGIC	"OSMDBBIN"
+#define OSM_DB_BIN_VERSION	1
+#define OSM_DB_BIN_ENDIAN	0x01020304
+#define OSM_DB_BIN_OP_SET	1
+#define OSM_DB_BIN_OP_DELETE	2
+
+/****d* Database/OSM_DB_BIN_MIN_COMPACT
+ * NAME
+ * OSM_DB_BIN_MIN_COMPACT
+ *
+ * DESCRIPTION
+ * The log is rewritten on store when it holds more than twice the live
+ * records plus this number of records
+ *
+ * SYNOPSIS
+ */
+#define OSM_DB_BIN_MIN_COMPACT 1024
+/**********/
+
+/* The file starts with this header followed by the log records. Records
+   are kept in host byte order, the endian field rejects foreign files. */
+typedef struct db_bin_hdr {
+	char magic[8];
+	uint32_t version;
+	uint32_t endian;
+	uint32_t rec_size;
+	uint32_t reserved[11];
+} db_bin_hdr_t;
+
+typedef struct db_bin_log_rec {
+	osm_db_rec_t rec;
+	uint32_t op;
+	uint32_t check;
+} db_bin_log_rec_t;
+
+typedef struct db_bin_entry {
+	cl_fmap_item_t map_item;
+	osm_db_rec_t rec;
+} db_bin_entry_t;
+
+/****s* OpenSM: Database/osm_db_bin
+ * NAME
+ * osm_db_bin
+ *
+ * DESCRIPTION
+ * The binary store of one domain.
+ *
+ * SYNOPSIS
+ */
+typedef struct osm_db_bin {
+	char *file_name;
+	cl_fmap_t map;
+	cl_spinlock_t lock;
+	db_bin_log_rec_t *pending;
+	unsigned num_pending;
+	unsigned max_pending;
+	uint64_t file_recs;
+	boolean_t dirty;
+	boolean_t rewrite;
+} osm_db_bin_t;
+/*
+ * FIELDS
+ *
+ * file_name
+ *   The log file (the text file name with a .bin suffix)
+ *
+ * map
+ *   The live records, keyed by key and key_port
+ *
+ * pending
+ *   Log records not yet appended to the file
+ *
+ * file_recs
+ *   Number of valid records in the file
+ *
+ * dirty
+ *   The map changed since the last store
+ *
+ * rewrite
+ *   The file no longer matches the map plus the pending records and
+ *   must be compacted on the next store
+ *
+ * SEE ALSO
+ * osm_db_domain_t
+ *********/
+
+static int compare_recs(IN const void *p_key1, IN const void *p_key2)
+{
+	const osm_db_rec_t *p_rec1 = p_key1, *p_rec2 = p_key2;
+
+	if (p_rec1->key != p_rec2->key)
+		return p_rec1->key < p_rec2->key ? -1 : 1;
+	if (p_rec1->key_port != p_rec2->key_port)
+		return p_rec1->key_port < p_rec2->key_port ? -1 : 1;
+	return 0;
+}
+
+static uint32_t log_rec_check(IN const db_bin_log_rec_t * p_log_rec)
+{
+	const osm_db_rec_t *p_rec = &p_log_rec->rec;
+	uint32_t check = 0x5a5aa5a5;
+
+	check = (check << 5 | check >> 27) ^ (uint32_t) p_rec->key;
+	check = (check << 5 | check >> 27) ^ (uint32_t) (p_rec->key >> 32);
+	check = (check << 5 | check >> 27) ^ (uint32_t) p_rec->val;
+	check = (check << 5 | check >> 27) ^ (uint32_t) (p_rec->val >> 32);
+	check = (check << 5 | check >> 27) ^ p_rec->key_port;
+	check = (check << 5 | check >> 27) ^ p_rec->val2;
+	check = (check << 5 | check >> 27) ^ p_log_rec->op;
+	return check;
+}
+
+static db_bin_entry_t *map_get(IN osm_db_bin_t * p_bin, IN uint64_t key,
+			       IN uint32_t key_port)
+{
+	osm_db_rec_t rec;
+	cl_fmap_item_t *p_item;
+
+	memset(&rec, 0, sizeof(rec));
+	rec.key = key;
+	rec.key_port = key_port;
+	p_item = cl_fmap_get(&p_bin->map, &rec);
+	if (p_item == cl_fmap_end(&p_bin->map))
+		return NULL;
+	return (db_bin_entry_t *) p_item;
+}
+
+/* returns 0 if the map changed, 1 if it did not and -1 on failure */
+static int map_set(IN osm_db_bin_t * p_bin, IN const osm_db_rec_t * p_rec)
+{
+	db_bin_entry_t *p_entry;
+
+	p_entry = map_get(p_bin, p_rec->key, p_rec->key_port);
+	if (p_entry) {
+		if (p_entry->rec.val == p_rec->val &&
+		    p_entry->rec.val2 == p_rec->val2)
+			return 1;
+		p_entry->rec = *p_rec;
+		return 0;
+	}
+
+	p_entry = malloc(sizeof(*p_entry));
+	if (!p_entry)
+		return -1;
+	p_entry->rec = *p_rec;
+	cl_fmap_insert(&p_bin->map, &p_entry->rec, &p_entry->map_item);
+	return 0;
+}
+
+/* returns 0 if the key was found */
+static int map_delete(IN osm_db_bin_t * p_bin, IN uint64_t key,
+		      IN uint32_t key_port)
+{
+	db_bin_entry_t *p_entry;
+
+	p_entry = map_get(p_bin, key, key_port);
+	if (!p_entry)
+		return 1;
+	cl_fmap_remove_item(&p_bin->map, &p_entry->map_item);
+	free(p_entry);
+	return 0;
+}
+
+static void map_clear(IN osm_db_bin_t * p_bin)
+{
+	cl_fmap_item_t *p_item;
+
+	while ((p_item = cl_fmap_head(&p_bin->map)) != cl_fmap_end(&p_bin->map)) {
+		cl_fmap_remove_item(&p_bin->map, p_item);
+		free(p_item);
+	}
+}
+
+/* queue a change for the next store; if the queue can not grow the
+   next store rewrites the whole file instead */
+static void log_change(IN osm_db_bin_t * p_bin, IN uint32_t op,
+		       IN const osm_db_rec_t * p_rec)
+{
+	db_bin_log_rec_t *p_log_rec;
+	unsigned max;
+
+	p_bin->dirty = TRUE;
+	if (p_bin->rewrite)
+		return;
+
+	if (p_bin->num_pending == p_bin->max_pending) {
+		max = p_bin->max_pending ? 2 * p_bin->max_pending : 64;
+		p_log_rec = realloc(p_bin->pending, max * sizeof(*p_log_rec));
+		if (!p_log_rec) {
+			p_bin->rewrite = TRUE;
+			p_bin->num_pending = 0;
+			return;
+		}
+		p_bin->pending = p_log_rec;
+		p_bin->max_pending = max;
+	}
+
+	p_log_rec = &p_bin->pending[p_bin->num_pending++];
+	p_log_rec->rec = *p_rec;
+	p_log_rec->op = op;
+	p_log_rec->check = log_rec_check(p_log_rec);
+}
+
+static int write_all(IN int fd, IN const void *buf, IN size_t len)
+{
+	const char *p = buf;
+	ssize_t ret;
+
+	while (len) {
+		ret = write(fd, p, len);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		p += ret;
+		len -= ret;
+	}
+	return 0;
+}
+
+static void db_bin_sync(IN osm_log_t * p_log, IN int fd,
+			IN const char *file_name)
+{
+	if (fsync(fd) == -1)
+		OSM_LOG(p_log, OSM_LOG_ERROR,
+			"ERR 6120: fsync() failed (%s) for %s\n",
+			strerror(errno), file_name);
+}
+
+/* write the live records to a new file and replace the log with it */
+static int db_bin_compact(IN osm_log_t * p_log, IN osm_db_bin_t * p_bin,
+			  IN boolean_t fsync_high_avail_files)
+{
+	db_bin_log_rec_t buf[256];
+	db_bin_hdr_t hdr;
+	cl_fmap_item_t *p_item;
+	char tmp_name[1024];
+	unsigned n = 0;
+	uint64_t count = 0;
+	int fd;
+
+	snprintf(tmp_name, sizeof(tmp_name), "%s.tmp", p_bin->file_name);
+	fd = open(tmp_name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		OSM_LOG(p_log, OSM_LOG_ERROR, "ERR 6121: "
+			"Failed to open the db file:%s for writing: err:%s\n",
+			tmp_name, strerror(errno));
+		return 1;
+	}
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, OSM_DB_BIN_MAGIC, sizeof(hdr.magic));
+	hdr.version = OSM_DB_BIN_VERSION;
+	hdr.endian = OSM_DB_BIN_ENDIAN;
+	hdr.rec_size = sizeof(db_bin_log_rec_t);
+	if (write_all(fd, &hdr, sizeof(hdr)))
+		goto Error;
+
+	for (p_item = cl_fmap_head(&p_bin->map);
+	     p_item != cl_fmap_end(&p_bin->map);
+	     p_item = cl_fmap_next(p_item)) {
+		buf[n].rec = ((db_bin_entry_t *) p_item)->rec;
+		buf[n].op = OSM_DB_BIN_OP_SET;
+		buf[n].check = log_rec_check(&buf[n]);
+		count++;
+		if (++n == sizeof(buf) / sizeof(buf[0])) {
+			if (write_all(fd, buf, n * sizeof(buf[0])))
+				goto Error;
+			n = 0;
+		}
+	}
+	if (n && write_all(fd, buf, n * sizeof(buf[0])))
+		goto Error;
+
+	if (fsync_high_avail_files)
+		db_bin_sync(p_log, fd, tmp_name);
+	close(fd);
+
+	if (rename(tmp_name, p_bin->file_name)) {
+		OSM_LOG(p_log, OSM_LOG_ERROR, "ERR 6122: "
+			"Failed to rename the db file to:%s (err:%s)\n",
+			p_bin->file_name, strerror(errno));
+		unlink(tmp_name);
+		return 1;
+	}
+
+	OSM_LOG(p_log, OSM_LOG_DEBUG, "Compacted %s to %" PRIu64 " records\n",
+		p_bin->file_name, count);
+	p_bin->file_recs = count;
+	return 0;
+
+Error:
+	OSM_LOG(p_log, OSM_LOG_ERROR, "ERR 6123: "
+		"Failed to write the db file:%s (err:%s)\n",
+		tmp_name, strerror(errno));
+	close(fd);
+	unlink(tmp_name);
+	return 1;
+}
+
+/* append the pending records to the log */
+static int db_bin_append(IN osm_log_t * p_log, IN osm_db_bin_t * p_bin,
+			 IN boolean_t fsync_high_avail_files)
+{
+	int fd;
+
+	if (!p_bin->num_pending)
+		return 0;
+
+	fd = open(p_bin->file_name, O_WRONLY | O_APPEND);
+	if (fd < 0) {
+		if (errno == ENOENT)
+			return db_bin_compact(p_log, p_bin,
+					      fsync_high_avail_files);
+		OSM_LOG(p_log, OSM_LOG_ERROR, "ERR 6124: "
+			"Failed to open the db file:%s for writing: err:%s\n",
+			p_bin->file_name, strerror(errno));
+		return 1;
+	}
+
+	if (write_all(fd, p_bin->pending,
+		      p_bin->num_pending * sizeof(*p_bin->pending))) {
+		OSM_LOG(p_log, OSM_LOG_ERROR, "ERR 6125: "
+			"Failed to append to the db file:%s (err:%s)\n",
+			p_bin->file_name, strerror(errno));
+		close(fd);
+		/* a partial tail would hide later appends, so rewrite */
+		p_bin->rewrite = TRUE;
+		return 1;
+	}
+
+	if (fsync_high_avail_files)
+		db_bin_sync(p_log, fd, p_bin->file_name);
+	close(fd);
+
+	p_bin->file_recs += p_bin->num_pending;
+	return 0;
+}
+
+osm_db_bin_t *osm_db_bin_init(IN osm_log_t * p_log, IN const char *file_name)
+{
+	osm_db_bin_t *p_bin;
+	size_t len = strlen(file_name) + 5;
+
+	p_bin = calloc(1, sizeof(*p_bin));
+	if (!p_bin)
+		goto Error;
+
+	p_bin->file_name = malloc(len);
+	if (!p_bin->file_name) {
+		free(p_bin);
+		goto Error;
+	}
+	snprintf(p_bin->file_name, len, "%s.bin", file_name);
+
+	cl_fmap_init(&p_bin->map, compare_recs);
+	cl_spinlock_construct(&p_bin->lock);
+	cl_spinlock_init(&p_bin->lock);
+	return p_bin;
+
+Error:
+	OSM_LOG(p_log, OSM_LOG_ERROR, "ERR 6126: "
+		"Failed to allocate the binary store of %s\n", file_name);
+	return NULL;
+}
+
+void osm_db_bin_destroy(IN osm_db_bin_t * p_bin)
+{
+	map_clear(p_bin);
+	cl_spinlock_destroy(&p_bin->lock);
+	free(p_bin->pending);
+	free(p_bin->file_name);
+	free(p_bin);
+}
+
+int osm_db_bin_restore(IN osm_log_t * p_log, IN osm_db_bin_t * p_bin)
+{
+	const db_bin_hdr_t *p_hdr;
+	const db_bin_log_rec_t *p_log_rec;
+	struct stat st;
+	void *map = MAP_FAILED;
+	uint64_t num_recs, i;
+	int fd, status = 0;
+
+	OSM_LOG_ENTER(p_log);
+
+	cl_spinlock_acquire(&p_bin->lock);
+
+	map_clear(p_bin);
+	p_bin->num_pending = 0;
+	p_bin->file_recs = 0;
+	p_bin->dirty = FALSE;
+	p_bin->rewrite = FALSE;
+
+	fd = open(p_bin->file_name, O_RDONLY);
+	if (fd < 0) {
+		if (errno != ENOENT) {
+			OSM_LOG(p_log, OSM_LOG_ERROR, "ERR 6127: "
+				"Failed to open the db file:%s (%s)\n",
+				p_bin->file_name, strerror(errno));
+			status = 1;
+		} else
+			status = -1;
+		goto Exit;
+	}
+
+	if (fstat(fd, &st) || st.st_size < sizeof(*p_hdr)) {
+		OSM_LOG(p_log, OSM_LOG_ERROR, "ERR 6128: "
+			"db file:%s is truncated, ignoring it\n",
+			p_bin->file_name);
+		status = -1;
+		goto Exit;
+	}
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		OSM_LOG(p_log, OSM_LOG_ERROR, "ERR 6129: "
+			"Failed to map the db file:%s (%s)\n",
+			p_bin->file_name, strerror(errno));
+		status = 1;
+		goto Exit;
+	}
+
+	p_hdr = map;
+	if (memcmp(p_hdr->magic, OSM_DB_BIN_MAGIC, sizeof(p_hdr->magic)) ||
+	    p_hdr->version != OSM_DB_BIN_VERSION ||
+	    p_hdr->endian != OSM_DB_BIN_ENDIAN ||
+	    p_hdr->rec_size != sizeof(*p_log_rec)) {
+		OSM_LOG(p_log, OSM_LOG_ERROR, "ERR 612A: "
+			"db file:%s has an unknown format, ignoring it\n",
+			p_bin->file_name);
+		status = -1;
+		goto Exit;
+	}
+
+	num_recs = (st.st_size - sizeof(*p_hdr)) / sizeof(*p_log_rec);
+	p_log_rec = (const db_bin_log_rec_t *) (p_hdr + 1);
+	for (i = 0; i < num_recs; i++, p_log_rec++) {
+		if (p_log_rec->check != log_rec_check(p_log_rec))
+			break;
+		if (p_log_rec->op == OSM_DB_BIN_OP_SET) {
+			if (map_set(p_bin, &p_log_rec->rec) < 0) {
+				OSM_LOG(p_log, OSM_LOG_ERROR, "ERR 612C: "
+					"Failed to allocate a record while "
+					"restoring db file:%s\n",
+					p_bin->file_name);
+				map_clear(p_bin);
+				status = 1;
+				goto Exit;
+			}
+		} else if (p_log_rec->op == OSM_DB_BIN_OP_DELETE)
+			map_delete(p_bin, p_log_rec->rec.key,
+				   p_log_rec->rec.key_port);
+		else
+			break;
+	}
+	p_bin->file_recs = i;
+
+	if (i != num_recs ||
+	    sizeof(*p_hdr) + num_recs * sizeof(*p_log_rec) != st.st_size) {
+		/* a torn tail from an interrupted append: drop it */
+		OSM_LOG(p_log, OSM_LOG_INFO, "WRN 612B: "
+			"db file:%s has %" PRIu64 " bad trailing bytes,"
+			" they will be dropped\n", p_bin->file_name,
+			(uint64_t) st.st_size - sizeof(*p_hdr) -
+			i * sizeof(*p_log_rec));
+		p_bin->dirty = TRUE;
+		p_bin->rewrite = TRUE;
+	}
+
+	OSM_LOG(p_log, OSM_LOG_DEBUG,
+		"Restored %zu records from %" PRIu64 " log records of %s\n",
+		cl_fmap_count(&p_bin->map), p_bin->file_recs,
+		p_bin->file_name);
+
+Exit:
+	if (map != MAP_FAILED)
+		munmap(map, st.st_size);
+	if (fd >= 0)
+		close(fd);
+	if (status < 0) {
+		/* the file is missing or unusable: the next store creates it */
+		p_bin->dirty = TRUE;
+		p_bin->rewrite = TRUE;
+	}
+	cl_spinlock_release(&p_bin->lock);
+	OSM_LOG_EXIT(p_log);
+	return status;
+}
+
+int osm_db_bin_store(IN osm_log_t * p_log, IN osm_db_bin_t * p_bin,
+		     IN boolean_t fsync_high_avail_files)
+{
+	uint64_t live;
+	int status = 0;
+
+	OSM_LOG_ENTER(p_log);
+
+	cl_spinlock_acquire(&p_bin->lock);
+
+	if (!p_bin->dirty)
+		goto Exit;
+
+	live = cl_fmap_count(&p_bin->map);
+	if (p_bin->rewrite ||
+	    p_bin->file_recs + p_bin->num_pending >
+	    2 * live + OSM_DB_BIN_MIN_COMPACT)
+		status = db_bin_compact(p_log, p_bin, fsync_high_avail_files);
+	else
+		status = db_bin_append(p_log, p_bin, fsync_high_avail_files);
+
+	if (!status) {
+		p_bin->num_pending = 0;
+		p_bin->dirty = FALSE;
+		p_bin->rewrite = FALSE;
+	}
+
+Exit:
+	cl_spinlock_release(&p_bin->lock);
+	OSM_LOG_EXIT(p_log);
+	return status;
+}
+
+void osm_db_bin_clear(IN osm_db_bin_t * p_bin)
+{
+	cl_spinlock_acquire(&p_bin->lock);
+	map_clear(p_bin);
+	p_bin->num_pending = 0;
+	p_bin->rewrite = TRUE;
+	cl_spinlock_release(&p_bin->lock);
+}
+
+int osm_db_rec_get(IN osm_db_domain_t * p_domain, IN uint64_t key,
+		   IN uint32_t key_port, OUT osm_db_rec_t * p_rec)
+{
+	osm_db_bin_t *p_bin = p_domain->p_bin;
+	db_bin_entry_t *p_entry;
+
+	cl_spinlock_acquire(&p_bin->lock);
+	p_entry = map_get(p_bin, key, key_port);
+	if (p_entry && p_rec)
+		*p_rec = p_entry->rec;
+	cl_spinlock_release(&p_bin->lock);
+
+	return p_entry ? 0 : 1;
+}
+
+int osm_db_rec_set(IN osm_db_domain_t * p_domain, IN const osm_db_rec_t * p_rec)
+{
+	osm_db_bin_t *p_bin = p_domain->p_bin;
+	int res;
+
+	cl_spinlock_acquire(&p_bin->lock);
+	res = map_set(p_bin, p_rec);
+	if (!res)
+		log_change(p_bin, OSM_DB_BIN_OP_SET, p_rec);
+	cl_spinlock_release(&p_bin->lock);
+
+	return res < 0 ? 1 : 0;
+}
+
+int osm_db_rec_delete(IN osm_db_domain_t * p_domain, IN uint64_t key,
+		      IN uint32_t key_port)
+{
+	osm_db_bin_t *p_bin = p_domain->p_bin;
+	osm_db_rec_t rec;
+	int res;
+
+	memset(&rec, 0, sizeof(rec));
+	rec.key = key;
+	rec.key_port = key_port;
+
+	cl_spinlock_acquire(&p_bin->lock);
+	res = map_delete(p_bin, key, key_port);
+	if (!res)
+		log_change(p_bin, OSM_DB_BIN_OP_DELETE, &rec);
+	cl_spinlock_release(&p_bin->lock);
+
+	if (res)
+		OSM_LOG(p_domain->p_db->p_log, OSM_LOG_DEBUG,
+			"fail to find key:0x%016" PRIx64 ":%u. delete failed\n",
+			key, key_port);
+	return res;
+}
+
+void osm_db_rec_foreach(IN osm_db_domain_t * p_domain,
+			IN void (*func) (const osm_db_rec_t * p_rec,
+					 void *context),
+			IN void *context)
+{
+	osm_db_bin_t *p_bin = p_domain->p_bin;
+	cl_fmap_item_t *p_item;
+
+	cl_spinlock_acquire(&p_bin->lock);
+	for (p_item = cl_fmap_head(&p_bin->map);
+	     p_item != cl_fmap_end(&p_bin->map);
+	     p_item = cl_fmap_next(p_item))
+		func(&((db_bin_entry_t *) p_item)->rec, context);
+	cl_spinlock_release(&p_bin->lock);
+}
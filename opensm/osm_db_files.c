@@ -36,7 +36,8 @@
 
 /*
  * Abstract:
- * Implementation of the osm_db interface using simple text files
+ * Implementation of the osm_db interface using simple text files.
+ * Domains kept in the binary store are handed to osm_db_bin.c.
  */
 
 #if HAVE_CONFIG_H
@@ -53,6 +54,7 @@
 #define FILE_ID OSM_FILE_DB_FILES_C
 #include <opensm/st.h>
 #include <opensm/osm_db.h>
+#include <opensm/osm_db_pack.h>
 #include <opensm/osm_log.h>
 
 /****d* Database/OSM_DB_MAX_LINE_LEN
@@ -82,10 +84,15 @@ typedef struct osm_db_domain_imp {
 	st_table *p_hash;
 	cl_spinlock_t lock;
 	boolean_t dirty;
+	const osm_db_codec_t *p_codec;
 } osm_db_domain_imp_t;
 /*
  * FIELDS
  *
+ * p_codec
+ *   Record layout of the domain when it is kept in the binary store,
+ *   used to import and export the text file
+ *
  * SEE ALSO
  * osm_db_domain_t
  *********/
@@ -124,6 +131,8 @@ void osm_db_domain_destroy(IN osm_db_domain_t * p_db_domain)
 	p_domain_imp = (osm_db_domain_imp_t *) p_db_domain->p_domain_imp;
 
 	osm_db_clear(p_db_domain);
+	if (p_db_domain->p_bin)
+		osm_db_bin_destroy(p_db_domain->p_bin);
 
 	cl_spinlock_destroy(&p_domain_imp->lock);
 
@@ -260,6 +269,22 @@ osm_db_domain_t *osm_db_domain_init(IN osm_db_t * p_db, IN const char *domain_na
 	CL_ASSERT(p_domain_imp->p_hash != NULL);
 	p_domain_imp->dirty = FALSE;
 
+	/* the binary store is only possible for known record layouts */
+	p_domain->p_bin = NULL;
+	p_domain_imp->p_codec = NULL;
+	if (p_db->binary) {
+		p_domain_imp->p_codec = osm_db_codec_get(domain_name);
+		if (p_domain_imp->p_codec)
+			p_domain->p_bin = osm_db_bin_init(p_log,
+							  p_domain_imp->file_name);
+		if (!p_domain->p_bin) {
+			p_domain_imp->p_codec = NULL;
+			OSM_LOG(p_log, OSM_LOG_VERBOSE,
+				"Domain %s is kept in a text file\n",
+				domain_name);
+		}
+	}
+
 	p_domain->p_db = p_db;
 	cl_list_insert_tail(&p_db->domains, p_domain);
 	p_domain->p_domain_imp = p_domain_imp;
@@ -271,7 +296,7 @@ Exit:
 	return p_domain;
 }
 
-int osm_db_restore(IN osm_db_domain_t * p_domain)
+static int db_text_restore(IN osm_db_domain_t * p_domain)
 {
 
 	osm_log_t *p_log = p_domain->p_db->p_log;
@@ -431,6 +456,54 @@ Exit:
 	return status;
 }
 
+/* move a text entry into the binary store */
+static int import_tbl_entry(st_data_t key, st_data_t val, st_data_t arg)
+{
+	osm_db_domain_t *p_domain = (osm_db_domain_t *) arg;
+	osm_db_domain_imp_t *p_domain_imp =
+	    (osm_db_domain_imp_t *) p_domain->p_domain_imp;
+	osm_db_rec_t rec;
+
+	memset(&rec, 0, sizeof(rec));
+	if (p_domain_imp->p_codec->from_text((char *)key, (char *)val, &rec) ||
+	    osm_db_rec_set(p_domain, &rec))
+		OSM_LOG(p_domain->p_db->p_log, OSM_LOG_ERROR, "ERR 6114: "
+			"Failed to import key:%s value:%s from:%s\n",
+			(char *)key, (char *)val, p_domain_imp->file_name);
+
+	free((char *)key);
+	free((char *)val);
+	return ST_DELETE;
+}
+
+int osm_db_restore(IN osm_db_domain_t * p_domain)
+{
+	osm_log_t *p_log = p_domain->p_db->p_log;
+	osm_db_domain_imp_t *p_domain_imp =
+	    (osm_db_domain_imp_t *) p_domain->p_domain_imp;
+	int status;
+
+	if (!p_domain->p_bin)
+		return db_text_restore(p_domain);
+
+	status = osm_db_bin_restore(p_log, p_domain->p_bin);
+	if (status >= 0)
+		return status;
+
+	/* no usable binary file yet: import the text file */
+	OSM_LOG(p_log, OSM_LOG_VERBOSE,
+		"Importing %s into the binary store\n",
+		p_domain_imp->file_name);
+	status = db_text_restore(p_domain);
+
+	cl_spinlock_acquire(&p_domain_imp->lock);
+	st_foreach(p_domain_imp->p_hash, import_tbl_entry,
+		   (st_data_t) p_domain);
+	cl_spinlock_release(&p_domain_imp->lock);
+
+	return status;
+}
+
 static int dump_tbl_entry(st_data_t key, st_data_t val, st_data_t arg)
 {
 	FILE *p_file = (FILE *) arg;
@@ -441,8 +514,8 @@ static int dump_tbl_entry(st_data_t key, st_data_t val, st_data_t arg)
 	return ST_CONTINUE;
 }
 
-int osm_db_store(IN osm_db_domain_t * p_domain,
-		 IN boolean_t fsync_high_avail_files)
+static int db_text_store(IN osm_db_domain_t * p_domain,
+			 IN boolean_t fsync_high_avail_files)
 {
 	osm_log_t *p_log = p_domain->p_db->p_log;
 	osm_db_domain_imp_t *p_domain_imp;
@@ -518,6 +591,15 @@ Exit2:
 	return status;
 }
 
+int osm_db_store(IN osm_db_domain_t * p_domain,
+		 IN boolean_t fsync_high_avail_files)
+{
+	if (p_domain->p_bin)
+		return osm_db_bin_store(p_domain->p_db->p_log, p_domain->p_bin,
+					fsync_high_avail_files);
+	return db_text_store(p_domain, fsync_high_avail_files);
+}
+
 /* simply de-allocate the key and the value and return the code
    that makes the st_foreach delete the entry */
 static int clear_tbl_entry(st_data_t key, st_data_t val, st_data_t arg)
@@ -536,9 +618,51 @@ int osm_db_clear(IN osm_db_domain_t * p_domain)
 	st_foreach(p_domain_imp->p_hash, clear_tbl_entry, (st_data_t) NULL);
 	cl_spinlock_release(&p_domain_imp->lock);
 
+	if (p_domain->p_bin)
+		osm_db_bin_clear(p_domain->p_bin);
+
 	return 0;
 }
 
+static void export_rec(const osm_db_rec_t * p_rec, void *context)
+{
+	osm_db_domain_imp_t *p_domain_imp = (osm_db_domain_imp_t *) context;
+	char key[OSM_DB_CODEC_TEXT_LEN];
+	char val[OSM_DB_CODEC_TEXT_LEN];
+
+	p_domain_imp->p_codec->to_text(p_rec, key, val);
+	st_insert(p_domain_imp->p_hash, (st_data_t) strdup(key),
+		  (st_data_t) strdup(val));
+}
+
+int osm_db_export(IN osm_db_domain_t * p_domain,
+		  IN boolean_t fsync_high_avail_files)
+{
+	osm_db_domain_imp_t *p_domain_imp =
+	    (osm_db_domain_imp_t *) p_domain->p_domain_imp;
+	int status;
+
+	if (!p_domain->p_bin)
+		return 0;
+
+	/* the text table of a binary domain is only used as a staging
+	   area for the import and export */
+	cl_spinlock_acquire(&p_domain_imp->lock);
+	st_foreach(p_domain_imp->p_hash, clear_tbl_entry, (st_data_t) NULL);
+	osm_db_rec_foreach(p_domain, export_rec, p_domain_imp);
+	p_domain_imp->dirty = TRUE;
+	cl_spinlock_release(&p_domain_imp->lock);
+
+	status = db_text_store(p_domain, fsync_high_avail_files);
+
+	cl_spinlock_acquire(&p_domain_imp->lock);
+	st_foreach(p_domain_imp->p_hash, clear_tbl_entry, (st_data_t) NULL);
+	p_domain_imp->dirty = FALSE;
+	cl_spinlock_release(&p_domain_imp->lock);
+
+	return status;
+}
+
 static int get_key_of_tbl_entry(st_data_t key, st_data_t val, st_data_t arg)
 {
 	cl_list_t *p_list = (cl_list_t *) arg;
@@ -38,6 +38,7 @@
 #endif				/* HAVE_CONFIG_H */
 
 #include <stdlib.h>
+#include <string.h>
 #include <complib/cl_debug.h>
 #include <opensm/osm_file_ids.h>
 #define FILE_ID OSM_FILE_DB_PACK_C
@@ -131,6 +132,106 @@ static inline int unpack_neighbor(char *p_str, uint64_t *guid,
 	return 0;
 }
 
+static int guid2lid_from_text(const char *p_key, const char *p_val,
+			      osm_db_rec_t * p_rec)
+{
+	uint16_t min_lid, max_lid;
+
+	if (unpack_lids((char *)p_val, &min_lid, &max_lid))
+		return 1;
+	p_rec->key = unpack_guid((char *)p_key);
+	p_rec->val = min_lid;
+	p_rec->val2 = max_lid;
+	return 0;
+}
+
+static void guid2lid_to_text(const osm_db_rec_t * p_rec, char *p_key,
+			     char *p_val)
+{
+	pack_guid(p_rec->key, p_key);
+	pack_lids((uint16_t) p_rec->val, (uint16_t) p_rec->val2, p_val);
+}
+
+static int guid2mkey_from_text(const char *p_key, const char *p_val,
+			       osm_db_rec_t * p_rec)
+{
+	p_rec->key = unpack_guid((char *)p_key);
+	p_rec->val = unpack_mkey((char *)p_val);
+	return 0;
+}
+
+static void guid2mkey_to_text(const osm_db_rec_t * p_rec, char *p_key,
+			      char *p_val)
+{
+	pack_guid(p_rec->key, p_key);
+	pack_mkey(p_rec->val, p_val);
+}
+
+static int neighbor_from_text(const char *p_key, const char *p_val,
+			      osm_db_rec_t * p_rec)
+{
+	uint8_t portnum1, portnum2;
+
+	if (unpack_neighbor((char *)p_key, &p_rec->key, &portnum1) ||
+	    unpack_neighbor((char *)p_val, &p_rec->val, &portnum2))
+		return 1;
+	p_rec->key_port = portnum1;
+	p_rec->val2 = portnum2;
+	return 0;
+}
+
+static void neighbor_to_text(const osm_db_rec_t * p_rec, char *p_key,
+			     char *p_val)
+{
+	pack_neighbor(p_rec->key, (uint8_t) p_rec->key_port, p_key);
+	pack_neighbor(p_rec->val, (uint8_t) p_rec->val2, p_val);
+}
+
+static const struct {
+	const char *domain_name;
+	osm_db_codec_t codec;
+} db_codecs[] = {
+	{"guid2lid", {guid2lid_from_text, guid2lid_to_text}},
+	{"guid2mkey", {guid2mkey_from_text, guid2mkey_to_text}},
+	{"neighbors", {neighbor_from_text, neighbor_to_text}},
+};
+
+const osm_db_codec_t *osm_db_codec_get(IN const char *domain_name)
+{
+	int i;
+
+	for (i = 0; i < sizeof(db_codecs) / sizeof(db_codecs[0]); i++)
+		if (!strcmp(db_codecs[i].domain_name, domain_name))
+			return &db_codecs[i].codec;
+	return NULL;
+}
+
+static void add_guid_elem(const osm_db_rec_t * p_rec, void *context)
+{
+	cl_qlist_t *p_guid_list = (cl_qlist_t *) context;
+	osm_db_guid_elem_t *p_guid_elem;
+
+	p_guid_elem = (osm_db_guid_elem_t *) malloc(sizeof(osm_db_guid_elem_t));
+	CL_ASSERT(p_guid_elem != NULL);
+
+	p_guid_elem->guid = p_rec->key;
+	cl_qlist_insert_head(p_guid_list, &p_guid_elem->item);
+}
+
+static void add_neighbor_elem(const osm_db_rec_t * p_rec, void *context)
+{
+	cl_qlist_t *p_neighbor_list = (cl_qlist_t *) context;
+	osm_db_neighbor_elem_t *p_neighbor_elem;
+
+	p_neighbor_elem =
+	    (osm_db_neighbor_elem_t *) malloc(sizeof(osm_db_neighbor_elem_t));
+	CL_ASSERT(p_neighbor_elem != NULL);
+
+	p_neighbor_elem->guid = p_rec->key;
+	p_neighbor_elem->portnum = (uint8_t) p_rec->key_port;
+	cl_qlist_insert_head(p_neighbor_list, &p_neighbor_elem->item);
+}
+
 int osm_db_guid2lid_guids(IN osm_db_domain_t * p_g2l,
 			  OUT cl_qlist_t * p_guid_list)
 {
@@ -138,6 +239,11 @@ int osm_db_guid2lid_guids(IN osm_db_domain_t * p_g2l,
 	cl_list_t keys;
 	osm_db_guid_elem_t *p_guid_elem;
 
+	if (osm_db_domain_is_binary(p_g2l)) {
+		osm_db_rec_foreach(p_g2l, add_guid_elem, p_guid_list);
+		return 0;
+	}
+
 	cl_list_construct(&keys);
 	cl_list_init(&keys, 10);
 
@@ -163,6 +269,15 @@ int osm_db_guid2lid_get(IN osm_db_domain_t * p_g2l, IN uint64_t guid,
 	char guid_str[20];
 	char *p_lid_str;
 	uint16_t min_lid, max_lid;
+	osm_db_rec_t rec;
+
+	if (osm_db_domain_is_binary(p_g2l)) {
+		if (osm_db_rec_get(p_g2l, guid, 0, &rec))
+			return 1;
+		min_lid = (uint16_t) rec.val;
+		max_lid = (uint16_t) rec.val2;
+		goto Found;
+	}
 
 	pack_guid(guid, guid_str);
 	p_lid_str = osm_db_lookup(p_g2l, guid_str);
@@ -171,6 +286,7 @@ int osm_db_guid2lid_get(IN osm_db_domain_t * p_g2l, IN uint64_t guid,
 	if (unpack_lids(p_lid_str, &min_lid, &max_lid))
 		return 1;
 
+Found:
 	if (p_min_lid)
 		*p_min_lid = min_lid;
 	if (p_max_lid)
@@ -184,6 +300,15 @@ int osm_db_guid2lid_set(IN osm_db_domain_t * p_g2l, IN uint64_t guid,
 {
 	char guid_str[20];
 	char lid_str[16];
+	osm_db_rec_t rec;
+
+	if (osm_db_domain_is_binary(p_g2l)) {
+		memset(&rec, 0, sizeof(rec));
+		rec.key = guid;
+		rec.val = min_lid;
+		rec.val2 = max_lid;
+		return osm_db_rec_set(p_g2l, &rec);
+	}
 
 	pack_guid(guid, guid_str);
 	pack_lids(min_lid, max_lid, lid_str);
@@ -194,6 +319,9 @@ int osm_db_guid2lid_set(IN osm_db_domain_t * p_g2l, IN uint64_t guid,
 int osm_db_guid2lid_delete(IN osm_db_domain_t * p_g2l, IN uint64_t guid)
 {
 	char guid_str[20];
+
+	if (osm_db_domain_is_binary(p_g2l))
+		return osm_db_rec_delete(p_g2l, guid, 0);
 	pack_guid(guid, guid_str);
 	return osm_db_delete(p_g2l, guid_str);
 }
@@ -205,6 +333,11 @@ int osm_db_guid2mkey_guids(IN osm_db_domain_t * p_g2m,
 	cl_list_t keys;
 	osm_db_guid_elem_t *p_guid_elem;
 
+	if (osm_db_domain_is_binary(p_g2m)) {
+		osm_db_rec_foreach(p_g2m, add_guid_elem, p_guid_list);
+		return 0;
+	}
+
 	cl_list_construct(&keys);
 	cl_list_init(&keys, 10);
 
@@ -229,6 +362,15 @@ int osm_db_guid2mkey_get(IN osm_db_domain_t * p_g2m, IN uint64_t guid,
 {
 	char guid_str[20];
 	char *p_mkey_str;
+	osm_db_rec_t rec;
+
+	if (osm_db_domain_is_binary(p_g2m)) {
+		if (osm_db_rec_get(p_g2m, guid, 0, &rec))
+			return 1;
+		if (p_mkey)
+			*p_mkey = rec.val;
+		return 0;
+	}
 
 	pack_guid(guid, guid_str);
 	p_mkey_str = osm_db_lookup(p_g2m, guid_str);
@@ -246,6 +388,14 @@ int osm_db_guid2mkey_set(IN osm_db_domain_t * p_g2m, IN uint64_t guid,
 {
 	char guid_str[20];
 	char mkey_str[20];
+	osm_db_rec_t rec;
+
+	if (osm_db_domain_is_binary(p_g2m)) {
+		memset(&rec, 0, sizeof(rec));
+		rec.key = guid;
+		rec.val = mkey;
+		return osm_db_rec_set(p_g2m, &rec);
+	}
 
 	pack_guid(guid, guid_str);
 	pack_mkey(mkey, mkey_str);
@@ -256,6 +406,9 @@ int osm_db_guid2mkey_set(IN osm_db_domain_t * p_g2m, IN uint64_t guid,
 int osm_db_guid2mkey_delete(IN osm_db_domain_t * p_g2m, IN uint64_t guid)
 {
 	char guid_str[20];
+
+	if (osm_db_domain_is_binary(p_g2m))
+		return osm_db_rec_delete(p_g2m, guid, 0);
 	pack_guid(guid, guid_str);
 	return osm_db_delete(p_g2m, guid_str);
 }
@@ -267,6 +420,12 @@ int osm_db_neighbor_guids(IN osm_db_domain_t * p_neighbor,
 	cl_list_t keys;
 	osm_db_neighbor_elem_t *p_neighbor_elem;
 
+	if (osm_db_domain_is_binary(p_neighbor)) {
+		osm_db_rec_foreach(p_neighbor, add_neighbor_elem,
+				   p_neighbor_list);
+		return 0;
+	}
+
 	cl_list_construct(&keys);
 	cl_list_init(&keys, 10);
 
@@ -295,6 +454,15 @@ int osm_db_neighbor_get(IN osm_db_domain_t * p_neighbor, IN uint64_t guid1,
 	char *p_other_str;
 	uint64_t temp_guid;
 	uint8_t temp_portnum;
+	osm_db_rec_t rec;
+
+	if (osm_db_domain_is_binary(p_neighbor)) {
+		if (osm_db_rec_get(p_neighbor, guid1, portnum1, &rec))
+			return 1;
+		temp_guid = rec.val;
+		temp_portnum = (uint8_t) rec.val2;
+		goto Found;
+	}
 
 	pack_neighbor(guid1, portnum1, neighbor_str);
 	p_other_str = osm_db_lookup(p_neighbor, neighbor_str);
@@ -303,6 +471,7 @@ int osm_db_neighbor_get(IN osm_db_domain_t * p_neighbor, IN uint64_t guid1,
 	if (unpack_neighbor(p_other_str, &temp_guid, &temp_portnum))
 		return 1;
 
+Found:
 	if (p_guid2)
 		*p_guid2 = temp_guid;
 	if (p_portnum2)
@@ -316,6 +485,16 @@ int osm_db_neighbor_set(IN osm_db_domain_t * p_neighbor, IN uint64_t guid1,
 			IN uint8_t portnum2)
 {
 	char n1_str[24], n2_str[24];
+	osm_db_rec_t rec;
+
+	if (osm_db_domain_is_binary(p_neighbor)) {
+		memset(&rec, 0, sizeof(rec));
+		rec.key = guid1;
+		rec.key_port = portnum1;
+		rec.val = guid2;
+		rec.val2 = portnum2;
+		return osm_db_rec_set(p_neighbor, &rec);
+	}
 
 	pack_neighbor(guid1, portnum1, n1_str);
 	pack_neighbor(guid2, portnum2, n2_str);
@@ -328,6 +507,9 @@ int osm_db_neighbor_delete(IN osm_db_domain_t * p_neighbor, IN uint64_t guid,
 {
 	char n_str[24];
 
+	if (osm_db_domain_is_binary(p_neighbor))
+		return osm_db_rec_delete(p_neighbor, guid, portnum);
+
 	pack_neighbor(guid, portnum, n_str);
 	return osm_db_delete(p_neighbor, n_str);
 }
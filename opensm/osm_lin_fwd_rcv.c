@@ -67,6 +67,7 @@ void osm_lft_rcv_process(IN void *context, IN void *data)
 	ib_net64_t node_guid;
 	osm_epi_lft_change_event_t lft_change;
 	ib_api_status_t status;
+	boolean_t success;
 
 	CL_ASSERT(sm);
 
@@ -84,12 +85,19 @@ void osm_lft_rcv_process(IN void *context, IN void *data)
 	p_lft_context = osm_madw_get_lft_context_ptr(p_madw);
 	node_guid = p_lft_context->node_guid;
 
-	if (ib_smp_get_status(p_smp)) {
+	/*
+	   Set requests that completed in error are dispatched here too,
+	   so the LFT distribution can move on to the next block.
+	 */
+	success = p_madw->status == IB_SUCCESS;
+	if (success && ib_smp_get_status(p_smp)) {
 		OSM_LOG(sm->p_log, OSM_LOG_DEBUG,
 			"MAD status 0x%x received\n",
 			cl_ntoh16(ib_smp_get_status(p_smp)));
-		goto Exit;
+		success = FALSE;
 	}
+	if (!success && !p_lft_context->set_method)
+		goto Exit;
 
 	CL_PLOCK_EXCL_ACQUIRE(sm->p_lock);
 	p_sw = osm_get_switch_by_guid(sm->p_subn, node_guid);
@@ -98,6 +106,9 @@ void osm_lft_rcv_process(IN void *context, IN void *data)
 		OSM_LOG(sm->p_log, OSM_LOG_ERROR, "ERR 0401: "
 			"LFT received for nonexistent node "
 			"0x%" PRIx64 "\n", cl_ntoh64(node_guid));
+	} else if (!success) {
+		osm_ucast_mgr_lft_block_done(&sm->ucast_mgr, p_sw,
+					     p_lft_context->sched_gen, FALSE);
 	} else {
 		status = osm_switch_set_lft_block(p_sw, p_block, block_num);
 		if (status == IB_SUCCESS) {
@@ -117,6 +128,10 @@ void osm_lft_rcv_process(IN void *context, IN void *data)
 				ib_get_err_str(status), cl_ntoh64(node_guid),
 				p_sw->p_node->print_desc);
 		}
+		if (p_lft_context->set_method)
+			osm_ucast_mgr_lft_block_done(&sm->ucast_mgr, p_sw,
+						     p_lft_context->sched_gen,
+						     status == IB_SUCCESS);
 	}
 
 	CL_PLOCK_RELEASE(sm->p_lock);
@@ -685,11 +685,12 @@ void osm_opensm_destroy_finish(IN osm_opensm_t * p_osm)
 	osm_db_destroy(&p_osm->db);
 	if (p_osm->vl15_constructed && p_osm->mad_pool_constructed)
 		osm_vl15_destroy(&p_osm->vl15, &p_osm->mad_pool);
+	p_osm->vl15_constructed = FALSE;
+	/* the vendor layer returns its pending MADs to the pool */
+	osm_vendor_delete(&p_osm->p_vendor);
 	if (p_osm->mad_pool_constructed)
 		osm_mad_pool_destroy(&p_osm->mad_pool);
-	p_osm->vl15_constructed = FALSE;
 	p_osm->mad_pool_constructed = FALSE;
-	osm_vendor_delete(&p_osm->p_vendor);
 	osm_subn_destroy(&p_osm->subn);
 	cl_disp_destroy(&p_osm->disp);
 	if (p_osm->sa_set_disp_initialized)
@@ -744,6 +745,12 @@ ib_api_status_t osm_opensm_init(IN osm_opensm_t * p_osm,
 	if (status != IB_SUCCESS)
 		return status;
 	p_osm->log.log_prefix = p_opt->log_prefix;
+	if (p_opt->log_async_ring_size &&
+	    osm_log_async_start(&p_osm->log,
+				p_opt->log_async_ring_size << 10) != IB_SUCCESS)
+		osm_log_v2(&p_osm->log, OSM_LOG_ERROR, FILE_ID,
+			   "ERR 1001: cannot start the log writer; "
+			   "logging synchronously\n");
 
 	/* If there is a log level defined - add the OSM_VERSION to it */
 	osm_log_v2(&p_osm->log,
@@ -796,6 +803,7 @@ ib_api_status_t osm_opensm_init(IN osm_opensm_t * p_osm,
 	status = osm_db_init(&p_osm->db, &p_osm->log);
 	if (status != IB_SUCCESS)
 		goto Exit;
+	p_osm->db.binary = !strcmp(p_opt->db_backend, OSM_BINARY_DB_BACKEND);
 
 	status = osm_subn_init(&p_osm->subn, p_osm, p_opt);
 	if (status != IB_SUCCESS)
@@ -820,14 +828,15 @@ ib_api_status_t osm_opensm_init_finish(IN osm_opensm_t * p_osm,
 
 	p_osm->subn.sm_port_guid = p_opt->guid;
 
-	status = osm_mad_pool_init(&p_osm->mad_pool);
+	status = osm_mad_pool_init(&p_osm->mad_pool, p_opt->mad_pool_prealloc);
 	if (status != IB_SUCCESS)
 		goto Exit;
 
 	status = osm_vl15_init(&p_osm->vl15, p_osm->p_vendor,
 			       &p_osm->log, &p_osm->stats, &p_osm->subn,
 			       p_opt->max_wire_smps, p_opt->max_wire_smps2,
-			       p_opt->max_smps_timeout);
+			       p_opt->max_smps_timeout,
+			       p_opt->max_wire_smps_per_target);
 	if (status != IB_SUCCESS)
 		goto Exit;
 
@@ -1092,6 +1092,9 @@ void osm_perfmgr_process(osm_perfmgr_t * pm)
 		CL_PLOCK_RELEASE(pm->sm->p_lock);
 	}
 
+	/* the replies to the previous sweep are in; persist them */
+	perfmgr_db_store_sync(pm->db);
+
 #ifdef ENABLE_OSM_PERF_MGR_PROFILE
 	gettimeofday(&before, NULL);
 #endif
@@ -1152,6 +1155,8 @@ void osm_perfmgr_shutdown(osm_perfmgr_t * pm)
 void osm_perfmgr_destroy(osm_perfmgr_t * pm)
 {
 	OSM_LOG_ENTER(pm->log);
+	if (pm->db)
+		perfmgr_db_store_sync(pm->db);
 	perfmgr_db_destroy(pm->db);
 	cl_timer_destroy(&pm->sweep_timer);
 	OSM_LOG_EXIT(pm->log);
@@ -1951,6 +1956,8 @@ ib_api_status_t osm_perfmgr_init(osm_perfmgr_t * pm, osm_opensm_t * osm,
 		pm->state = PERFMGR_STATE_NO_DB;
 		goto Exit;
 	}
+	if (p_opt->perfmgr_db_file)
+		perfmgr_db_store_open(pm->db, p_opt->perfmgr_db_file);
 
 	pm->pc_disp_h = cl_disp_register(&osm->disp, OSM_MSG_MAD_PORT_COUNTERS,
 					 pc_recv_process, pm);
@@ -2025,6 +2032,23 @@ void osm_perfmgr_print_counters(osm_perfmgr_t * pm, char *nodename, FILE * fp,
 		perfmgr_db_print_all(pm->db, fp, err_only);
 }
 
+/*******************************************************************
+ * Print the rates from the counter history to the fp specified
+ *******************************************************************/
+void osm_perfmgr_print_rates(osm_perfmgr_t * pm, char *nodename, FILE * fp,
+			     char *port)
+{
+	if (nodename) {
+		char *end = NULL;
+		uint64_t guid = strtoull(nodename, &end, 0);
+		if (nodename + strlen(nodename) != end)
+			perfmgr_db_print_rates(pm->db, nodename, 0, fp, port);
+		else
+			perfmgr_db_print_rates(pm->db, NULL, guid, fp, port);
+	} else
+		perfmgr_db_print_rates(pm->db, NULL, 0, fp, NULL);
+}
+
 void osm_perfmgr_update_nodename(osm_perfmgr_t *pm, uint64_t node_guid,
 				char *nodename)
 {
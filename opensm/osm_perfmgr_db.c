@@ -43,7 +43,10 @@
 #include <errno.h>
 #include <limits.h>
 #include <dlfcn.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 
 #include <opensm/osm_file_ids.h>
 #define FILE_ID OSM_FILE_PERFMGR_DB_C
@@ -51,7 +54,8 @@
 #include <opensm/osm_perfmgr.h>
 #include <opensm/osm_opensm.h>
 
-static void free_node(db_node_t * node);
+static void free_node(perfmgr_db_t * db, db_node_t * node);
+static void store_close(perfmgr_db_t * db);
 
 /** =========================================================================
  */
@@ -65,6 +69,15 @@ perfmgr_db_t *perfmgr_db_construct(osm_perfmgr_t *perfmgr)
 	cl_plock_construct(&db->lock);
 	cl_plock_init(&db->lock);
 	db->perfmgr = perfmgr;
+	db->hist_size = perfmgr->subn->opt.perfmgr_history_size;
+	db->hist_mem_max =
+	    (size_t) perfmgr->subn->opt.perfmgr_history_max_mem << 20;
+	db->hist_mem_used = 0;
+	db->hist_mem_warned = FALSE;
+	db->store_path = NULL;
+	db->store_fd = -1;
+	db->store_map = NULL;
+	db->store_size = 0;
 	return db;
 }
 
@@ -78,9 +91,11 @@ void perfmgr_db_destroy(perfmgr_db_t * db)
 		item = cl_qmap_head(&db->pc_data);
 		while (item != cl_qmap_end(&db->pc_data)) {
 			next_item = cl_qmap_next(item);
-			free_node((db_node_t *)item);
+			free_node(db, (db_node_t *)item);
 			item = next_item;
 		}
+		store_close(db);
+		free(db->store_path);
 		cl_plock_destroy(&db->lock);
 		free(db);
 	}
@@ -114,6 +129,126 @@ static inline void mark_port_valid(db_node_t * node, uint8_t port)
 	node->ports[port].valid = TRUE;
 }
 
+/**********************************************************************
+ * Port history helpers; db->lock should be held when calling
+ **********************************************************************/
+#define HIST_DC_INTERVAL 0
+#define HIST_ERR_INTERVAL 1
+
+static inline size_t hist_buf_size(perfmgr_db_t * db)
+{
+	return (size_t) db->hist_size *
+	    (PERFMGR_DB_HIST_NUM_COUNTERS * sizeof(uint64_t) +
+	     2 * sizeof(uint32_t));
+}
+
+static inline uint64_t *hist_counter(perfmgr_db_t * db, db_port_hist_t * hist,
+				     perfmgr_db_hist_counter_t counter)
+{
+	return (uint64_t *) hist->buf + (size_t) counter * db->hist_size;
+}
+
+static inline uint32_t *hist_interval(perfmgr_db_t * db, db_port_hist_t * hist,
+				      int which)
+{
+	return (uint32_t *) hist_counter(db, hist,
+					 PERFMGR_DB_HIST_NUM_COUNTERS) +
+	    (size_t) which * db->hist_size;
+}
+
+/* allocate the history of a port on first use within the memory budget */
+static db_port_hist_t *get_hist(perfmgr_db_t * db, db_node_t * node,
+				uint8_t port)
+{
+	db_port_hist_t *hist = &node->ports[port].hist;
+	size_t size;
+
+	if (hist->buf)
+		return hist;
+	if (!db->hist_size)
+		return NULL;
+
+	size = hist_buf_size(db);
+	if (db->hist_mem_used + size > db->hist_mem_max) {
+		if (!db->hist_mem_warned) {
+			OSM_LOG(db->perfmgr->log, OSM_LOG_INFO,
+				"WRN 5488: perfmgr_history_max_mem reached; "
+				"no counter history kept for further ports "
+				"(first one is 0x%" PRIx64 " port %u)\n",
+				node->node_guid, port);
+			db->hist_mem_warned = TRUE;
+		}
+		return NULL;
+	}
+
+	hist->buf = malloc(size);
+	if (!hist->buf)
+		return NULL;
+	hist->dc_head = hist->dc_count = 0;
+	hist->err_head = hist->err_count = 0;
+	db->hist_mem_used += size;
+	return hist;
+}
+
+static void free_hist(perfmgr_db_t * db, db_port_hist_t * hist)
+{
+	if (!hist->buf)
+		return;
+	free(hist->buf);
+	hist->buf = NULL;
+	db->hist_mem_used -= hist_buf_size(db);
+}
+
+static void hist_add_err(perfmgr_db_t * db, db_node_t * node, uint8_t port,
+			 osm_epi_pe_event_t * pe)
+{
+	db_port_hist_t *hist = get_hist(db, node, port);
+	uint32_t i;
+
+	if (!hist)
+		return;
+
+	/* xmit_wait is congestion, not an error; leave it out of the sum */
+	i = hist->err_head;
+	hist_counter(db, hist, PERFMGR_DB_HIST_ERRORS)[i] =
+	    pe->symbol_err_cnt + pe->link_err_recover + pe->link_downed +
+	    pe->rcv_err + pe->rcv_rem_phys_err + pe->rcv_switch_relay_err +
+	    pe->xmit_discards + pe->xmit_constraint_err +
+	    pe->rcv_constraint_err + pe->link_integrity +
+	    pe->buffer_overrun + pe->vl15_dropped;
+	hist_interval(db, hist, HIST_ERR_INTERVAL)[i] =
+	    pe->time_diff_s > 0 ? pe->time_diff_s : 0;
+
+	hist->err_head = (i + 1) % db->hist_size;
+	if (hist->err_count < db->hist_size)
+		hist->err_count++;
+}
+
+static void hist_add_dc(perfmgr_db_t * db, db_node_t * node, uint8_t port,
+			osm_epi_dc_event_t * dc)
+{
+	db_port_hist_t *hist = get_hist(db, node, port);
+	uint32_t i;
+
+	if (!hist)
+		return;
+
+	/* data counters count 4 byte words; keep bytes */
+	i = hist->dc_head;
+	hist_counter(db, hist, PERFMGR_DB_HIST_XMIT_DATA)[i] =
+	    dc->xmit_data * 4;
+	hist_counter(db, hist, PERFMGR_DB_HIST_RCV_DATA)[i] =
+	    dc->rcv_data * 4;
+	hist_counter(db, hist, PERFMGR_DB_HIST_XMIT_PKTS)[i] = dc->xmit_pkts;
+	hist_counter(db, hist, PERFMGR_DB_HIST_RCV_PKTS)[i] = dc->rcv_pkts;
+	hist_interval(db, hist, HIST_DC_INTERVAL)[i] =
+	    dc->time_diff_s > 0 ? dc->time_diff_s : 0;
+
+	hist->dc_head = (i + 1) % db->hist_size;
+	if (hist->dc_count < db->hist_size)
+		hist->dc_count++;
+}
+
 /** =========================================================================
  */
 static db_node_t *malloc_node(uint64_t guid, boolean_t esp0,
@@ -151,12 +286,17 @@ free_rc:
 
 /** =========================================================================
  */
-static void free_node(db_node_t * node)
+static void free_node(perfmgr_db_t * db, db_node_t * node)
 {
+	int i;
+
 	if (!node)
 		return;
-	if (node->ports)
+	if (node->ports) {
+		for (i = 0; i < node->num_ports; i++)
+			free_hist(db, &node->ports[i].hist);
 		free(node->ports);
+	}
 	free(node);
 }
 
@@ -186,7 +326,7 @@ perfmgr_db_create_entry(perfmgr_db_t * db, uint64_t guid, boolean_t esp0,
 			goto Exit;
 		}
 		if (insert(db, pc_node)) {
-			free_node(pc_node);
+			free_node(db, pc_node);
 			rc = PERFMGR_EVENT_DB_FAIL;
 			goto Exit;
 		}
@@ -218,7 +358,7 @@ perfmgr_db_delete_entry(perfmgr_db_t * db, uint64_t guid)
 		return(PERFMGR_EVENT_DB_GUIDNOTFOUND);
 
 	db_node_t *pc_node = (db_node_t *)rc;
-	free_node(pc_node);
+	free_node(db, pc_node);
 	return(PERFMGR_EVENT_DB_SUCCESS);
 }
 
@@ -418,6 +558,10 @@ perfmgr_db_add_err_reading(perfmgr_db_t * db, uint64_t guid, uint8_t port,
 	    (reading->xmit_wait - previous->xmit_wait);
 	p_port->err_total.xmit_wait += epi_pe_data.xmit_wait;
 
+	/* the first reading of a port is relative to boot; not a sample */
+	if (p_port->err_total.time)
+		hist_add_err(db, node, port, &epi_pe_data);
+
 	p_port->err_previous = *reading;
 
 	/* mark the time this total was updated */
@@ -553,6 +697,10 @@ perfmgr_db_add_dc_reading(perfmgr_db_t * db, uint64_t guid, uint8_t port,
 		p_port->dc_total.multicast_rcv_pkts += epi_dc_data.multicast_rcv_pkts;
 	}
 
+	/* the first reading of a port is relative to boot; not a sample */
+	if (p_port->dc_total.time)
+		hist_add_dc(db, node, port, &epi_dc_data);
+
 	p_port->dc_previous = *reading;
 
 	/* mark the time this total was updated */
@@ -641,6 +789,9 @@ static void clear_counters(cl_map_item_t * const p_map_item, void *context)
 		node->ports[i].dc_total.time = ts;
 
 		node->ports[i].last_reset = ts;
+
+		node->ports[i].hist.dc_head = node->ports[i].hist.dc_count = 0;
+		node->ports[i].hist.err_head = node->ports[i].hist.err_count = 0;
 	}
 }
 
@@ -1011,6 +1162,624 @@ perfmgr_db_print_by_guid(perfmgr_db_t * db, uint64_t nodeguid, FILE *fp,
 	cl_plock_release(&db->lock);
 }
 
+/**********************************************************************
+ * Rates from the port history; db->lock should be held when calling
+ **********************************************************************/
+static inline boolean_t hist_is_err(perfmgr_db_hist_counter_t counter)
+{
+	return counter == PERFMGR_DB_HIST_ERRORS;
+}
+
+static void hist_rates(perfmgr_db_t * db, db_port_hist_t * hist,
+		       perfmgr_db_rates_t * rates)
+{
+	uint64_t sum[PERFMGR_DB_HIST_NUM_COUNTERS];
+	uint64_t dc_span = 0, err_span = 0;
+	uint32_t *interval;
+	uint64_t *counter;
+	uint32_t i;
+	int c;
+
+	memset(rates, 0, sizeof(*rates));
+	memset(sum, 0, sizeof(sum));
+	if (!hist->buf)
+		return;
+
+	/* order does not matter for the sums; scan from the start */
+	for (c = 0; c < PERFMGR_DB_HIST_NUM_COUNTERS; c++) {
+		uint32_t n = hist_is_err(c) ? hist->err_count : hist->dc_count;
+		counter = hist_counter(db, hist, c);
+		for (i = 0; i < n; i++)
+			sum[c] += counter[i];
+	}
+	interval = hist_interval(db, hist, HIST_DC_INTERVAL);
+	for (i = 0; i < hist->dc_count; i++)
+		dc_span += interval[i];
+	interval = hist_interval(db, hist, HIST_ERR_INTERVAL);
+	for (i = 0; i < hist->err_count; i++)
+		err_span += interval[i];
+
+	rates->dc_samples = hist->dc_count;
+	rates->err_samples = hist->err_count;
+	rates->dc_span = dc_span;
+	rates->err_span = err_span;
+	for (c = 0; c < PERFMGR_DB_HIST_NUM_COUNTERS; c++) {
+		if (hist_is_err(c)) {
+			if (err_span)
+				rates->rate[c] = (double)sum[c] * 60 / err_span;
+		} else if (dc_span)
+			rates->rate[c] = (double)sum[c] / dc_span;
+	}
+}
+
+static int compare_rates(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+/* nearest rank percentile of the per sample rates; scratch holds
+ * db->hist_size entries */
+static boolean_t hist_percentile(perfmgr_db_t * db, db_port_hist_t * hist,
+				 perfmgr_db_hist_counter_t counter,
+				 unsigned percentile, double *scratch,
+				 double *rate)
+{
+	uint32_t count, i, n = 0;
+	uint32_t *interval;
+	uint64_t *samples;
+	size_t rank;
+
+	if (!hist->buf)
+		return FALSE;
+
+	if (hist_is_err(counter)) {
+		count = hist->err_count;
+		interval = hist_interval(db, hist, HIST_ERR_INTERVAL);
+	} else {
+		count = hist->dc_count;
+		interval = hist_interval(db, hist, HIST_DC_INTERVAL);
+	}
+	samples = hist_counter(db, hist, counter);
+	for (i = 0; i < count; i++) {
+		if (!interval[i])
+			continue;
+		scratch[n] = (double)samples[i] / interval[i];
+		if (hist_is_err(counter))
+			scratch[n] *= 60;
+		n++;
+	}
+	if (!n)
+		return FALSE;
+
+	qsort(scratch, n, sizeof(*scratch), compare_rates);
+	rank = ((size_t) percentile * n + 99) / 100;
+	*rate = scratch[rank ? rank - 1 : 0];
+	return TRUE;
+}
+
+/**********************************************************************
+ * Average rates over the history kept for a port
+ **********************************************************************/
+perfmgr_db_err_t
+perfmgr_db_get_rates(perfmgr_db_t * db, uint64_t guid, uint8_t port,
+		     perfmgr_db_rates_t * rates)
+{
+	db_node_t *node = NULL;
+	perfmgr_db_err_t rc = PERFMGR_EVENT_DB_SUCCESS;
+
+	if (!db->hist_size)
+		return PERFMGR_EVENT_DB_NOT_IMPL;
+
+	cl_plock_acquire(&db->lock);
+	node = get(db, guid);
+	if ((rc = bad_node_port(node, port)) != PERFMGR_EVENT_DB_SUCCESS)
+		goto Exit;
+
+	hist_rates(db, &node->ports[port].hist, rates);
+
+Exit:
+	cl_plock_release(&db->lock);
+	return rc;
+}
+
+/**********************************************************************
+ * Percentile (0-100) of the per sample rates of one counter of a port
+ **********************************************************************/
+perfmgr_db_err_t
+perfmgr_db_get_rate_percentile(perfmgr_db_t * db, uint64_t guid, uint8_t port,
+			       perfmgr_db_hist_counter_t counter,
+			       unsigned percentile, double *rate)
+{
+	db_node_t *node = NULL;
+	double *scratch = NULL;
+	perfmgr_db_err_t rc = PERFMGR_EVENT_DB_SUCCESS;
+
+	if (!db->hist_size)
+		return PERFMGR_EVENT_DB_NOT_IMPL;
+	if (counter >= PERFMGR_DB_HIST_NUM_COUNTERS || percentile > 100)
+		return PERFMGR_EVENT_DB_FAIL;
+
+	scratch = malloc(db->hist_size * sizeof(*scratch));
+	if (!scratch)
+		return PERFMGR_EVENT_DB_NOMEM;
+
+	cl_plock_acquire(&db->lock);
+	node = get(db, guid);
+	if ((rc = bad_node_port(node, port)) != PERFMGR_EVENT_DB_SUCCESS)
+		goto Exit;
+
+	if (!hist_percentile(db, &node->ports[port].hist, counter, percentile,
+			     scratch, rate))
+		*rate = 0;
+
+Exit:
+	cl_plock_release(&db->lock);
+	free(scratch);
+	return rc;
+}
+
+static void dump_hr_rate(FILE * fp, double val, const char *suffix)
+{
+	static const char units[] = " KMGTPE";
+	int ui = 0;
+
+	while (val >= 1024 && ui < (int)sizeof(units) - 2) {
+		val /= 1024;
+		ui++;
+	}
+	if (ui)
+		fprintf(fp, "%.3f%c%s", val, units[ui], suffix);
+	else
+		fprintf(fp, "%.3f%s", val, suffix);
+}
+
+static void dump_node_rates(perfmgr_db_t * db, db_node_t * node, FILE * fp,
+			    char *port, double *scratch)
+{
+	static const struct {
+		const char *name;
+		const char *unit;
+	} counters[PERFMGR_DB_HIST_NUM_COUNTERS] = {
+		{ "xmit_data", "B/s" },
+		{ "rcv_data", "B/s" },
+		{ "xmit_pkts", "/s" },
+		{ "rcv_pkts", "/s" },
+		{ "errors", "/min" },
+	};
+	static const unsigned pcts[] = { 50, 95, 99 };
+	int i = (node->esp0) ? 0 : 1;
+	int num_ports = node->num_ports;
+	perfmgr_db_rates_t rates;
+	unsigned j;
+	double val;
+	int c;
+
+	if (port) {
+		char *end = NULL;
+		int p = strtoul(port, &end, 0);
+		if (port + strlen(port) == end && p >= i && p < num_ports) {
+			i = p;
+			num_ports = p+1;
+		} else {
+			fprintf(fp, "Warning: \"%s\" is not a valid port\n", port);
+		}
+	}
+	for (/* set above */; i < num_ports; i++) {
+		db_port_hist_t *hist = &node->ports[i].hist;
+
+		if (!node->ports[i].valid)
+			continue;
+
+		fprintf(fp, "\"%s\" 0x%" PRIx64 " active %s port %d\n",
+			node->node_name, node->node_guid,
+			node->active ? "TRUE":"FALSE", i);
+		if (!hist->buf) {
+			fprintf(fp, "     no history%s\n",
+				db->hist_mem_warned ?
+				" (perfmgr_history_max_mem reached)" : "");
+			continue;
+		}
+
+		hist_rates(db, hist, &rates);
+		fprintf(fp, "     Data Samples         : %u over %" PRIu64 "s\n"
+			    "     Error Samples        : %u over %" PRIu64 "s\n",
+			rates.dc_samples, (uint64_t) rates.dc_span,
+			rates.err_samples, (uint64_t) rates.err_span);
+		for (c = 0; c < PERFMGR_DB_HIST_NUM_COUNTERS; c++) {
+			fprintf(fp, "     %-20s : ", counters[c].name);
+			dump_hr_rate(fp, rates.rate[c], counters[c].unit);
+			for (j = 0; j < sizeof(pcts) / sizeof(pcts[0]); j++) {
+				if (!hist_percentile(db, hist, c, pcts[j],
+						     scratch, &val))
+					break;
+				fprintf(fp, "%sp%u ", j ? ", " : " (", pcts[j]);
+				dump_hr_rate(fp, val, "");
+			}
+			fprintf(fp, "%s\n", j ? ")" : "");
+		}
+	}
+}
+
+/**********************************************************************
+ * print the rates of a node, or of all nodes, to fp
+ * nodename takes precedence over guid; neither selects all nodes
+ **********************************************************************/
+void
+perfmgr_db_print_rates(perfmgr_db_t * db, char *nodename, uint64_t guid,
+		       FILE *fp, char *port)
+{
+	cl_map_item_t *item;
+	double *scratch;
+
+	if (!db->hist_size) {
+		fprintf(fp, "Counter history is disabled "
+			"(perfmgr_history_size 0)\n");
+		return;
+	}
+
+	scratch = malloc(db->hist_size * sizeof(*scratch));
+	if (!scratch) {
+		fprintf(fp, "Failed to allocate memory\n");
+		return;
+	}
+
+	cl_plock_acquire(&db->lock);
+	if (nodename) {
+		for (item = cl_qmap_head(&db->pc_data);
+		     item != cl_qmap_end(&db->pc_data);
+		     item = cl_qmap_next(item))
+			if (strcmp(((db_node_t *)item)->node_name,
+				   nodename) == 0)
+				break;
+		if (item != cl_qmap_end(&db->pc_data))
+			dump_node_rates(db, (db_node_t *)item, fp, port,
+					scratch);
+		else
+			fprintf(fp, "Node %s not found...\n", nodename);
+	} else if (guid) {
+		item = cl_qmap_get(&db->pc_data, guid);
+		if (item != cl_qmap_end(&db->pc_data))
+			dump_node_rates(db, (db_node_t *)item, fp, port,
+					scratch);
+		else
+			fprintf(fp, "Node 0x%" PRIx64 " not found...\n", guid);
+	} else {
+		for (item = cl_qmap_head(&db->pc_data);
+		     item != cl_qmap_end(&db->pc_data);
+		     item = cl_qmap_next(item))
+			dump_node_rates(db, (db_node_t *)item, fp, NULL,
+					scratch);
+	}
+	cl_plock_release(&db->lock);
+	free(scratch);
+}
+
+/**********************************************************************
+ * Persistent store
+ *
+ * The file holds a header page followed by two copies of a table of
+ * fixed size port records sorted by node GUID and port number.  A sync
+ * writes the copy which is not current, flushes it and only then flips
+ * "current" in the header, so after a crash the file holds the last
+ * complete sync.  Growing the table rebuilds the file under a temporary
+ * name and renames it over the old one.  The layout is host endian and
+ * guarded by the version and record size in the header.
+ **********************************************************************/
+#define PERFMGR_STORE_MAGIC "OSMPMDB"
+#define PERFMGR_STORE_VERSION 1
+#define PERFMGR_STORE_HDR_SIZE 4096
+#define PERFMGR_STORE_MIN_RECORDS 1024
+
+typedef struct perfmgr_store_hdr {
+	char magic[8];
+	uint32_t version;
+	uint32_t record_size;
+	uint32_t capacity;	/* records in each copy */
+	uint32_t current;	/* copy holding the last complete sync */
+	uint32_t num_records[2];
+	uint64_t generation;
+	int64_t sync_time;
+} perfmgr_store_hdr_t;
+
+typedef struct perfmgr_store_rec {
+	uint64_t node_guid;
+	char node_name[NODE_NAME_SIZE];
+	uint8_t num_ports;
+	uint8_t esp0;
+	uint8_t port;
+	uint8_t valid;
+	int64_t last_reset;
+	perfmgr_db_err_reading_t err_total;
+	perfmgr_db_err_reading_t err_previous;
+	perfmgr_db_data_cnt_reading_t dc_total;
+	perfmgr_db_data_cnt_reading_t dc_previous;
+} perfmgr_store_rec_t;
+
+static inline size_t store_file_size(uint32_t capacity)
+{
+	return PERFMGR_STORE_HDR_SIZE +
+	    2 * (size_t) capacity * sizeof(perfmgr_store_rec_t);
+}
+
+static inline perfmgr_store_rec_t *store_table(void *map, uint32_t copy)
+{
+	perfmgr_store_hdr_t *hdr = map;
+
+	return (perfmgr_store_rec_t *) ((char *)map + PERFMGR_STORE_HDR_SIZE) +
+	    (size_t) copy * hdr->capacity;
+}
+
+static void store_close(perfmgr_db_t * db)
+{
+	if (db->store_map)
+		munmap(db->store_map, db->store_size);
+	if (db->store_fd >= 0)
+		close(db->store_fd);
+	db->store_map = NULL;
+	db->store_fd = -1;
+	db->store_size = 0;
+}
+
+/* create an empty store of the given capacity; returns the mapping */
+static void *store_create(perfmgr_db_t * db, const char *file,
+			  uint32_t capacity, int *fd, size_t * size)
+{
+	perfmgr_store_hdr_t *hdr;
+	void *map;
+
+	*size = store_file_size(capacity);
+	*fd = open(file, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (*fd < 0) {
+		OSM_LOG(db->perfmgr->log, OSM_LOG_ERROR, "ERR 5489: "
+			"cannot create %s: %s\n", file, strerror(errno));
+		return NULL;
+	}
+	if (ftruncate(*fd, *size) < 0) {
+		OSM_LOG(db->perfmgr->log, OSM_LOG_ERROR, "ERR 548A: "
+			"cannot size %s: %s\n", file, strerror(errno));
+		goto Fail;
+	}
+	map = mmap(NULL, *size, PROT_READ | PROT_WRITE, MAP_SHARED, *fd, 0);
+	if (map == MAP_FAILED) {
+		OSM_LOG(db->perfmgr->log, OSM_LOG_ERROR, "ERR 548B: "
+			"cannot map %s: %s\n", file, strerror(errno));
+		goto Fail;
+	}
+
+	hdr = map;
+	memcpy(hdr->magic, PERFMGR_STORE_MAGIC, sizeof(hdr->magic));
+	hdr->version = PERFMGR_STORE_VERSION;
+	hdr->record_size = sizeof(perfmgr_store_rec_t);
+	hdr->capacity = capacity;
+	/* the first sync goes to copy 0 */
+	hdr->current = 1;
+	return map;
+
+Fail:
+	close(*fd);
+	unlink(file);
+	*fd = -1;
+	return NULL;
+}
+
+/* write the db into the spare copy of map and make it current */
+static int store_write(perfmgr_db_t * db, void *map, size_t size)
+{
+	perfmgr_store_hdr_t *hdr = map;
+	uint32_t target = !hdr->current;
+	perfmgr_store_rec_t *rec = store_table(map, target);
+	uint32_t n = 0;
+	cl_map_item_t *item;
+	db_node_t *node;
+	int i;
+
+	for (item = cl_qmap_head(&db->pc_data);
+	     item != cl_qmap_end(&db->pc_data); item = cl_qmap_next(item)) {
+		node = (db_node_t *) item;
+		for (i = 0; i < node->num_ports; i++, n++, rec++) {
+			memset(rec, 0, sizeof(*rec));
+			rec->node_guid = node->node_guid;
+			memcpy(rec->node_name, node->node_name,
+			       sizeof(rec->node_name));
+			rec->num_ports = node->num_ports;
+			rec->esp0 = node->esp0;
+			rec->port = i;
+			rec->valid = node->ports[i].valid;
+			rec->last_reset = node->ports[i].last_reset;
+			rec->err_total = node->ports[i].err_total;
+			rec->err_previous = node->ports[i].err_previous;
+			rec->dc_total = node->ports[i].dc_total;
+			rec->dc_previous = node->ports[i].dc_previous;
+		}
+	}
+
+	if (msync(map, size, MS_SYNC) < 0)
+		return -1;
+
+	hdr->num_records[target] = n;
+	hdr->generation++;
+	hdr->sync_time = time(NULL);
+	hdr->current = target;
+	return msync(map, PERFMGR_STORE_HDR_SIZE, MS_SYNC);
+}
+
+static uint32_t count_ports(perfmgr_db_t * db)
+{
+	cl_map_item_t *item;
+	uint32_t n = 0;
+
+	for (item = cl_qmap_head(&db->pc_data);
+	     item != cl_qmap_end(&db->pc_data); item = cl_qmap_next(item))
+		n += ((db_node_t *) item)->num_ports;
+	return n;
+}
+
+/* load the current copy of a mapped store; db->lock held exclusive */
+static void store_load(perfmgr_db_t * db, void *map)
+{
+	perfmgr_store_hdr_t *hdr = map;
+	perfmgr_store_rec_t *rec = store_table(map, hdr->current);
+	uint32_t n = hdr->num_records[hdr->current];
+	db_node_t *node = NULL;
+	unsigned loaded = 0;
+	uint32_t i;
+
+	for (i = 0; i < n; i++, rec++) {
+		if (!node || node->node_guid != rec->node_guid) {
+			rec->node_name[NODE_NAME_SIZE - 1] = '\0';
+			node = get(db, rec->node_guid);
+			if (!node) {
+				node = malloc_node(rec->node_guid, rec->esp0,
+						   rec->num_ports,
+						   rec->node_name);
+				if (!node)
+					break;
+				if (insert(db, node)) {
+					free_node(db, node);
+					node = NULL;
+					continue;
+				}
+				loaded++;
+			}
+		}
+		if (rec->port >= node->num_ports)
+			continue;
+		node->ports[rec->port].valid = rec->valid;
+		node->ports[rec->port].last_reset = rec->last_reset;
+		node->ports[rec->port].err_total = rec->err_total;
+		node->ports[rec->port].err_previous = rec->err_previous;
+		node->ports[rec->port].dc_total = rec->dc_total;
+		node->ports[rec->port].dc_previous = rec->dc_previous;
+	}
+
+	OSM_LOG(db->perfmgr->log, OSM_LOG_INFO,
+		"Restored %u nodes from counter store generation %" PRIu64
+		"\n", loaded, hdr->generation);
+}
+
+/**********************************************************************
+ * Open the persistent store "file", creating it if needed, and load
+ * the counters of the last complete sync into the db
+ **********************************************************************/
+perfmgr_db_err_t perfmgr_db_store_open(perfmgr_db_t * db, const char *file)
+{
+	perfmgr_store_hdr_t *hdr;
+	struct stat st;
+	void *map;
+	int fd;
+
+	db->store_path = strdup(file);
+	if (!db->store_path)
+		return PERFMGR_EVENT_DB_NOMEM;
+
+	fd = open(file, O_RDWR);
+	if (fd < 0) {
+		if (errno == ENOENT)
+			return PERFMGR_EVENT_DB_SUCCESS;
+		OSM_LOG(db->perfmgr->log, OSM_LOG_ERROR, "ERR 548C: "
+			"cannot open %s: %s\n", file, strerror(errno));
+		return PERFMGR_EVENT_DB_FAIL;
+	}
+	if (fstat(fd, &st) < 0 ||
+	    (size_t) st.st_size < PERFMGR_STORE_HDR_SIZE)
+		goto Invalid;
+	map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+		   fd, 0);
+	if (map == MAP_FAILED)
+		goto Invalid;
+
+	hdr = map;
+	if (memcmp(hdr->magic, PERFMGR_STORE_MAGIC, sizeof(hdr->magic)) ||
+	    hdr->version != PERFMGR_STORE_VERSION ||
+	    hdr->record_size != sizeof(perfmgr_store_rec_t) ||
+	    hdr->current > 1 ||
+	    (size_t) st.st_size != store_file_size(hdr->capacity) ||
+	    hdr->num_records[hdr->current] > hdr->capacity) {
+		munmap(map, st.st_size);
+		goto Invalid;
+	}
+
+	cl_plock_excl_acquire(&db->lock);
+	store_load(db, map);
+	db->store_fd = fd;
+	db->store_map = map;
+	db->store_size = st.st_size;
+	cl_plock_release(&db->lock);
+	return PERFMGR_EVENT_DB_SUCCESS;
+
+Invalid:
+	/* a fresh store replaces it on the next sync */
+	OSM_LOG(db->perfmgr->log, OSM_LOG_ERROR, "ERR 548D: "
+		"%s is not a valid counter store; ignoring it\n", file);
+	close(fd);
+	return PERFMGR_EVENT_DB_FAIL;
+}
+
+/**********************************************************************
+ * Write the db to the persistent store
+ **********************************************************************/
+perfmgr_db_err_t perfmgr_db_store_sync(perfmgr_db_t * db)
+{
+	perfmgr_db_err_t rc = PERFMGR_EVENT_DB_SUCCESS;
+	perfmgr_store_hdr_t *hdr;
+	char tmp_path[1024];
+	uint32_t need, capacity;
+	size_t size;
+	void *map;
+	int fd;
+
+	if (!db->store_path)
+		return PERFMGR_EVENT_DB_SUCCESS;
+
+	/* the spare copy, the header and the store_* fields change here */
+	cl_plock_excl_acquire(&db->lock);
+
+	hdr = db->store_map;
+	need = count_ports(db);
+	if (hdr && need <= hdr->capacity) {
+		if (store_write(db, db->store_map, db->store_size) < 0) {
+			OSM_LOG(db->perfmgr->log, OSM_LOG_ERROR, "ERR 548E: "
+				"sync of %s failed: %s\n", db->store_path,
+				strerror(errno));
+			rc = PERFMGR_EVENT_DB_FAIL;
+		}
+		goto Exit;
+	}
+
+	/* (re)build the store with room to grow */
+	capacity = need + need / 2;
+	if (capacity < PERFMGR_STORE_MIN_RECORDS)
+		capacity = PERFMGR_STORE_MIN_RECORDS;
+	snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", db->store_path);
+	map = store_create(db, tmp_path, capacity, &fd, &size);
+	if (!map) {
+		rc = PERFMGR_EVENT_DB_FAIL;
+		goto Exit;
+	}
+	if (store_write(db, map, size) < 0 ||
+	    rename(tmp_path, db->store_path) < 0) {
+		OSM_LOG(db->perfmgr->log, OSM_LOG_ERROR, "ERR 548E: "
+			"sync of %s failed: %s\n", db->store_path,
+			strerror(errno));
+		munmap(map, size);
+		close(fd);
+		unlink(tmp_path);
+		rc = PERFMGR_EVENT_DB_FAIL;
+		goto Exit;
+	}
+
+	store_close(db);
+	db->store_fd = fd;
+	db->store_map = map;
+	db->store_size = size;
+
+Exit:
+	cl_plock_release(&db->lock);
+	return rc;
+}
+
 /**********************************************************************
  * dump the data to the file "file"
  **********************************************************************/
@@ -101,6 +101,7 @@ void osm_sa_construct(IN osm_sa_t * p_sa)
 	p_sa->sa_trans_id = OSM_SA_INITIAL_TID_VALUE;
 
 	cl_timer_construct(&p_sa->sr_timer);
+	cl_spinlock_construct(&p_sa->pr_cache_lock);
 }
 
 void osm_sa_shutdown(IN osm_sa_t * p_sa)
@@ -153,9 +154,51 @@ void osm_sa_destroy(IN osm_sa_t * p_sa)
 
 	cl_timer_destroy(&p_sa->sr_timer);
 
+	osm_pr_pool_destroy(p_sa);
+
+	free(p_sa->pr_cache);
+	p_sa->pr_cache = NULL;
+	cl_spinlock_destroy(&p_sa->pr_cache_lock);
+
 	OSM_LOG_EXIT(p_sa->p_log);
 }
 
+void osm_sa_pr_cache_invalidate(IN osm_sa_t * sa)
+{
+	cl_atomic_inc(&sa->pr_cache_gen);
+}
+
+static ib_api_status_t sa_pr_cache_init(IN osm_sa_t * p_sa)
+{
+	uint32_t size = p_sa->p_subn->opt.sa_pr_cache_size;
+	uint32_t num_entries = 1;
+
+	/* zeroed entries have generation 0 and are never valid */
+	p_sa->pr_cache_gen = 1;
+
+	if (!size)
+		return IB_SUCCESS;
+
+	if (cl_spinlock_init(&p_sa->pr_cache_lock) != CL_SUCCESS)
+		return IB_ERROR;
+
+	while (num_entries < size && num_entries < (1U << 31))
+		num_entries <<= 1;
+
+	p_sa->pr_cache = calloc(num_entries, sizeof(*p_sa->pr_cache));
+	if (!p_sa->pr_cache) {
+		OSM_LOG(p_sa->p_log, OSM_LOG_ERROR, "ERR 4C0D: "
+			"Cannot allocate %u PathRecord cache entries\n",
+			num_entries);
+		return IB_INSUFFICIENT_MEMORY;
+	}
+	p_sa->pr_cache_mask = num_entries - 1;
+
+	OSM_LOG(p_sa->p_log, OSM_LOG_VERBOSE,
+		"PathRecord cache enabled with %u entries\n", num_entries);
+	return IB_SUCCESS;
+}
+
 ib_api_status_t osm_sa_init(IN osm_sm_t * p_sm, IN osm_sa_t * p_sa,
 			    IN osm_subn_t * p_subn, IN osm_vendor_t * p_vendor,
 			    IN osm_mad_pool_t * p_mad_pool,
@@ -176,9 +219,18 @@ ib_api_status_t osm_sa_init(IN osm_sm_t * p_sm, IN osm_sa_t * p_sa,
 	p_sa->p_disp = p_disp;
 	p_sa->p_set_disp = p_set_disp;
 	p_sa->p_lock = p_lock;
+	p_sa->p_stats = p_stats;
 
 	p_sa->state = OSM_SA_STATE_READY;
 
+	status = sa_pr_cache_init(p_sa);
+	if (status != IB_SUCCESS)
+		goto Exit;
+
+	status = osm_pr_pool_init(p_sa);
+	if (status != IB_SUCCESS)
+		goto Exit;
+
 	status = osm_sa_mad_ctrl_init(&p_sa->mad_ctrl, p_sa, p_sa->p_mad_pool,
 				      p_sa->p_vendor, p_subn, p_log, p_stats,
 				      p_disp, p_set_disp);
@@ -419,20 +471,113 @@ Exit:
 	OSM_LOG_EXIT(sa->p_log);
 }
 
-void osm_sa_respond(osm_sa_t *sa, osm_madw_t *madw, size_t attr_size,
-		    cl_qlist_t *list)
+static osm_madw_t *sa_resp_get_madw(IN osm_sa_resp_t * p_resp,
+				    IN unsigned max_rec)
 {
-	cl_list_item_t *item;
+	return osm_mad_pool_get(p_resp->sa->p_mad_pool, p_resp->p_madw->h_bind,
+				max_rec * p_resp->attr_size +
+				IB_SA_MAD_HDR_SIZE,
+				&p_resp->p_madw->mad_addr);
+}
+
+void osm_sa_resp_init(IN osm_sa_t * sa, OUT osm_sa_resp_t * p_resp,
+		      IN osm_madw_t * p_madw, IN size_t attr_size,
+		      IN unsigned num_rec_hint)
+{
+#ifndef VENDOR_RMPP_SUPPORT
+	unsigned trim_num_rec;
+
+	/* records past a single MAD are trimmed anyway */
+	trim_num_rec = (MAD_BLOCK_SIZE - IB_SA_MAD_HDR_SIZE) / attr_size;
+	if (num_rec_hint > trim_num_rec)
+		num_rec_hint = trim_num_rec;
+#endif
+
+	memset(p_resp, 0, sizeof(*p_resp));
+	p_resp->sa = sa;
+	p_resp->p_madw = p_madw;
+	p_resp->attr_size = attr_size;
+
+	/*
+	 * Get a MAD to reply. Address of Mad is in the received mad_wrapper
+	 */
+	p_resp->p_resp_madw = sa_resp_get_madw(p_resp, num_rec_hint);
+	if (!p_resp->p_resp_madw) {
+		OSM_LOG(sa->p_log, OSM_LOG_ERROR, "ERR 4C06: "
+			"osm_mad_pool_get failed\n");
+		p_resp->failed = TRUE;
+		return;
+	}
+	p_resp->max_rec = num_rec_hint;
+}
+
+void *osm_sa_resp_append(IN osm_sa_resp_t * p_resp)
+{
+	osm_madw_t *p_new_madw;
+	unsigned max_rec;
+	uint8_t *p;
+
+	if (p_resp->failed)
+		return NULL;
+
+	if (p_resp->num_rec == p_resp->max_rec) {
+		max_rec = p_resp->max_rec ? 2 * p_resp->max_rec : 1;
+		p_new_madw = sa_resp_get_madw(p_resp, max_rec);
+		if (!p_new_madw) {
+			OSM_LOG(p_resp->sa->p_log, OSM_LOG_ERROR, "ERR 4C0E: "
+				"failed to grow response to %u records\n",
+				max_rec);
+			p_resp->failed = TRUE;
+			return NULL;
+		}
+		memcpy(osm_madw_get_sa_mad_ptr(p_new_madw),
+		       osm_madw_get_sa_mad_ptr(p_resp->p_resp_madw),
+		       p_resp->num_rec * p_resp->attr_size +
+		       IB_SA_MAD_HDR_SIZE);
+		osm_mad_pool_put(p_resp->sa->p_mad_pool, p_resp->p_resp_madw);
+		p_resp->p_resp_madw = p_new_madw;
+		p_resp->max_rec = max_rec;
+	}
+
+	p = osm_sa_resp_record(p_resp, p_resp->num_rec++);
+	memset(p, 0, p_resp->attr_size);
+	return p;
+}
+
+void *osm_sa_resp_record(IN const osm_sa_resp_t * p_resp, IN unsigned index)
+{
+	CL_ASSERT(index < p_resp->max_rec);
+	return ib_sa_mad_get_payload_ptr(osm_madw_get_sa_mad_ptr
+					 (p_resp->p_resp_madw)) +
+	    index * p_resp->attr_size;
+}
+
+void osm_sa_resp_destroy(IN osm_sa_resp_t * p_resp)
+{
+	if (p_resp->p_resp_madw) {
+		osm_mad_pool_put(p_resp->sa->p_mad_pool, p_resp->p_resp_madw);
+		p_resp->p_resp_madw = NULL;
+	}
+}
+
+void osm_sa_resp_send(IN osm_sa_resp_t * p_resp)
+{
+	osm_sa_t *sa = p_resp->sa;
+	osm_madw_t *madw = p_resp->p_madw;
 	osm_madw_t *resp_madw;
 	ib_sa_mad_t *sa_mad, *resp_sa_mad;
-	unsigned num_rec, i;
+	unsigned num_rec;
 #ifndef VENDOR_RMPP_SUPPORT
 	unsigned trim_num_rec;
 #endif
-	unsigned char *p;
 
 	sa_mad = osm_madw_get_sa_mad_ptr(madw);
-	num_rec = cl_qlist_count(list);
+	num_rec = p_resp->num_rec;
+
+	if (p_resp->failed) {
+		osm_sa_send_error(sa, madw, IB_SA_MAD_STATUS_NO_RESOURCES);
+		goto Exit;
+	}
 
 	/*
 	 * C15-0.1.30:
@@ -450,7 +595,7 @@ void osm_sa_respond(osm_sa_t *sa, osm_madw_t *madw, size_t attr_size,
 	}
 
 #ifndef VENDOR_RMPP_SUPPORT
-	trim_num_rec = (MAD_BLOCK_SIZE - IB_SA_MAD_HDR_SIZE) / attr_size;
+	trim_num_rec = (MAD_BLOCK_SIZE - IB_SA_MAD_HDR_SIZE) / p_resp->attr_size;
 	if (trim_num_rec < num_rec) {
 		OSM_LOG(sa->p_log, OSM_LOG_VERBOSE,
 			"Number of records:%u trimmed to:%u to fit in one MAD\n",
@@ -466,25 +611,13 @@ void osm_sa_respond(osm_sa_t *sa, osm_madw_t *madw, size_t attr_size,
 		goto Exit;
 	}
 
-	/*
-	 * Get a MAD to reply. Address of Mad is in the received mad_wrapper
-	 */
-	resp_madw = osm_mad_pool_get(sa->p_mad_pool, madw->h_bind,
-				     num_rec * attr_size + IB_SA_MAD_HDR_SIZE,
-				     &madw->mad_addr);
-	if (!resp_madw) {
-		OSM_LOG(sa->p_log, OSM_LOG_ERROR, "ERR 4C06: "
-			"osm_mad_pool_get failed\n");
-		osm_sa_send_error(sa, madw, IB_SA_MAD_STATUS_NO_RESOURCES);
-		goto Exit;
-	}
-
+	resp_madw = p_resp->p_resp_madw;
 	resp_sa_mad = osm_madw_get_sa_mad_ptr(resp_madw);
 
 	/*
 	   Copy the MAD header back into the response mad.
-	   Set the 'R' bit and the payload length,
-	   Then copy all records from the list into the response payload.
+	   Set the 'R' bit and the payload length.
+	   The records are already in place in the response payload.
 	 */
 
 	memcpy(resp_sa_mad, sa_mad, IB_SA_MAD_HDR_SIZE);
@@ -495,9 +628,11 @@ void osm_sa_respond(osm_sa_t *sa, osm_madw_t *madw, size_t attr_size,
 	resp_sa_mad->sm_key = 0;
 
 	/* Fill in the offset (paylen will be done by the rmpp SAR) */
-	resp_sa_mad->attr_offset = num_rec ? ib_get_attr_offset(attr_size) : 0;
+	resp_sa_mad->attr_offset =
+	    num_rec ? ib_get_attr_offset(p_resp->attr_size) : 0;
 
-	p = ib_sa_mad_get_payload_ptr(resp_sa_mad);
+	/* the payload may have been allocated for more records */
+	resp_madw->mad_size = num_rec * p_resp->attr_size + IB_SA_MAD_HDR_SIZE;
 
 #ifndef VENDOR_RMPP_SUPPORT
 	/* we support only one packet RMPP - so we will set the first and
@@ -514,23 +649,37 @@ void osm_sa_respond(osm_sa_t *sa, osm_madw_t *madw, size_t attr_size,
 		resp_sa_mad->rmpp_flags = IB_RMPP_FLAG_ACTIVE;
 #endif
 
-	for (i = 0; i < num_rec; i++) {
-		item = cl_qlist_remove_head(list);
-		memcpy(p, ((osm_sa_item_t *)item)->resp.data, attr_size);
-		p += attr_size;
-		free(item);
-	}
-
 	osm_dump_sa_mad_v2(sa->p_log, resp_sa_mad, FILE_ID, OSM_LOG_FRAMES);
+
+	/* the send consumes the response MAD */
+	p_resp->p_resp_madw = NULL;
 	osm_sa_send(sa, resp_madw, FALSE);
 
 Exit:
+	osm_sa_resp_destroy(p_resp);
+}
+
+void osm_sa_respond(osm_sa_t *sa, osm_madw_t *madw, size_t attr_size,
+		    cl_qlist_t *list)
+{
+	cl_list_item_t *item;
+	osm_sa_resp_t resp;
+	void *p;
+
+	osm_sa_resp_init(sa, &resp, madw, attr_size, cl_qlist_count(list));
+
 	/* need to set the mem free ... */
 	item = cl_qlist_remove_head(list);
 	while (item != cl_qlist_end(list)) {
+		p = osm_sa_resp_append(&resp);
+		if (p)
+			memcpy(p, ((osm_sa_item_t *)item)->resp.data,
+			       attr_size);
 		free(item);
 		item = cl_qlist_remove_head(list);
 	}
+
+	osm_sa_resp_send(&resp);
 }
 
 /*
@@ -50,12 +50,15 @@
 #endif				/* HAVE_CONFIG_H */
 
 #include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
 #include <arpa/inet.h>
 #include <iba/ib_types.h>
 #include <complib/cl_qmap.h>
 #include <complib/cl_passivelock.h>
 #include <complib/cl_debug.h>
 #include <complib/cl_qlist.h>
+#include <complib/cl_thread.h>
 #include <opensm/osm_file_ids.h>
 #define FILE_ID OSM_FILE_SA_PATH_RECORD_C
 #include <vendor/osm_vendor_api.h>
@@ -74,7 +77,6 @@
 #include <opensm/osm_prefix_route.h>
 #include <opensm/osm_ucast_lash.h>
 
-#define SA_PR_RESP_SIZE SA_ITEM_RESP_SIZE(path_rec)
 
 #define MAX_HOPS 64
 
@@ -142,37 +144,26 @@ sa_path_rec_apply_tavor_mtu_limit(IN const ib_path_rec_t * p_pr,
 	return TRUE;
 }
 
-static ib_api_status_t pr_rcv_get_path_parms(IN osm_sa_t * sa,
-					     IN const ib_path_rec_t * p_pr,
-					     IN const osm_alias_guid_t * p_src_alias_guid,
-					     IN const uint16_t src_lid_ho,
-					     IN const osm_alias_guid_t * p_dest_alias_guid,
-					     IN const uint16_t dest_lid_ho,
-					     IN const ib_net64_t comp_mask,
-					     OUT osm_path_parms_t * p_parms)
+static ib_api_status_t pr_rcv_walk_path(IN osm_sa_t * sa,
+					IN const osm_alias_guid_t * p_src_alias_guid,
+					IN const uint16_t src_lid_ho,
+					IN const osm_alias_guid_t * p_dest_alias_guid,
+					IN const uint16_t dest_lid_ho,
+					OUT osm_pr_cache_entry_t * p_walk,
+					OUT const osm_physp_t ** pp_dest_physp)
 {
 	const osm_node_t *p_node;
 	const osm_physp_t *p_physp, *p_physp0;
 	const osm_physp_t *p_src_physp;
 	const osm_physp_t *p_dest_physp;
-	const osm_prtn_t *p_prtn = NULL;
-	osm_opensm_t *p_osm;
-	struct osm_routing_engine *p_re;
 	const ib_port_info_t *p_pi, *p_pi0;
 	ib_api_status_t status = IB_SUCCESS;
-	ib_net16_t pkey;
 	uint8_t mtu;
 	uint8_t rate, p0_extended_rate, dest_rate;
-	uint8_t pkt_life;
-	uint8_t required_mtu;
-	uint8_t required_rate;
-	uint8_t required_pkt_life;
-	uint8_t sl;
 	uint8_t in_port_num;
 	ib_net16_t dest_lid;
 	uint8_t i;
 	ib_slvl_table_t *p_slvl_tbl = NULL;
-	osm_qos_level_t *p_qos_level = NULL;
 	uint16_t valid_sl_mask = 0xffff;
 	int hops = 0;
 	int extended, p0_extended;
@@ -185,30 +176,11 @@ static ib_api_status_t pr_rcv_get_path_parms(IN osm_sa_t * sa,
 	p_physp = p_src_alias_guid->p_base_port->p_physp;
 	p_src_physp = p_physp;
 	p_pi = &p_physp->port_info;
-	p_osm = sa->p_subn->p_osm;
-	p_re = p_osm->routing_engine_used;
 
 	mtu = ib_port_info_get_mtu_cap(p_pi);
 	extended = p_pi->capability_mask & IB_PORT_CAP_HAS_EXT_SPEEDS;
 	rate = ib_port_info_compute_rate(p_pi, extended);
 
-	/*
-	   Mellanox Tavor device performance is better using 1K MTU.
-	   If required MTU and MTU selector are such that 1K is OK
-	   and at least one end of the path is Tavor we override the
-	   port MTU with 1K.
-	 */
-	if (sa->p_subn->opt.enable_quirks &&
-	    sa_path_rec_apply_tavor_mtu_limit(p_pr,
-					      p_src_alias_guid->p_base_port,
-					      p_dest_alias_guid->p_base_port,
-					      comp_mask))
-		if (mtu > IB_MTU_LEN_1024) {
-			mtu = IB_MTU_LEN_1024;
-			OSM_LOG(sa->p_log, OSM_LOG_DEBUG,
-				"Optimized Path MTU to 1K for Mellanox Tavor device\n");
-		}
-
 	/*
 	   Walk the subnet object from source to destination,
 	   tracking the most restrictive rate and mtu values along the way...
@@ -431,6 +403,504 @@ static ib_api_status_t pr_rcv_get_path_parms(IN osm_sa_t * sa,
 	if (ib_path_compare_rates(rate, dest_rate) > 0)
 		rate = dest_rate;
 
+	p_walk->mtu = mtu;
+	p_walk->rate = rate;
+	p_walk->valid_sl_mask = valid_sl_mask;
+	p_walk->qos = sa->p_subn->opt.qos;
+	*pp_dest_physp = p_dest_physp;
+Exit:
+	OSM_LOG_EXIT(sa->p_log);
+	return status;
+}
+
+#define PR_SUMMARY_BUSY		2
+#define PR_SUMMARY_INVALID	3
+
+static inline int pr_summary_p0_extended(IN const osm_node_t * p_node)
+{
+	const osm_physp_t *p_physp0 = osm_node_get_physp_ptr((osm_node_t *) p_node, 0);
+
+	return p_physp0->port_info.capability_mask & IB_PORT_CAP_HAS_EXT_SPEEDS;
+}
+
+static void pr_summary_init(OUT osm_path_summary_t * p_sum,
+			    IN const osm_physp_t * p_physp, IN int extended)
+{
+	p_sum->valid_sl_mask = 0xffff;
+	p_sum->mtu = ib_port_info_get_mtu_cap(&p_physp->port_info);
+	p_sum->rate = ib_port_info_compute_rate(&p_physp->port_info, extended);
+	p_sum->hops = 0;
+}
+
+static void pr_summary_add_port(IN OUT osm_path_summary_t * p_sum,
+				IN const osm_physp_t * p_physp,
+				IN int extended)
+{
+	uint8_t rate;
+
+	if (p_sum->mtu > ib_port_info_get_mtu_cap(&p_physp->port_info))
+		p_sum->mtu = ib_port_info_get_mtu_cap(&p_physp->port_info);
+	rate = ib_port_info_compute_rate(&p_physp->port_info, extended);
+	if (ib_path_compare_rates(p_sum->rate, rate) > 0)
+		p_sum->rate = rate;
+}
+
+static void pr_summary_add_slvl(IN OUT osm_path_summary_t * p_sum,
+				IN const osm_physp_t * p_physp,
+				IN uint8_t in_port_num)
+{
+	ib_slvl_table_t *p_slvl_tbl;
+	uint8_t i;
+
+	p_slvl_tbl = osm_physp_get_slvl_tbl(p_physp, in_port_num);
+	for (i = 0; i < IB_MAX_NUM_VLS; i++)
+		if (p_sum->valid_sl_mask & (1 << i) &&
+		    ib_slvl_table_get(p_slvl_tbl, i) == IB_DROP_VL)
+			p_sum->valid_sl_mask &= ~(1 << i);
+}
+
+static void pr_summary_add(IN OUT osm_path_summary_t * p_sum,
+			   IN const osm_path_summary_t * p_next)
+{
+	if (p_sum->mtu > p_next->mtu)
+		p_sum->mtu = p_next->mtu;
+	if (ib_path_compare_rates(p_sum->rate, p_next->rate) > 0)
+		p_sum->rate = p_next->rate;
+	p_sum->valid_sl_mask &= p_next->valid_sl_mask;
+}
+
+/*
+ * Summarize the path from p_sw to lid_ho. The forwarding tables are
+ * followed until the destination or an already summarized switch is
+ * reached, and the entries are then filled in backwards. Anything the
+ * path walk would report as an error (missing route, loop, too many
+ * hops) leaves the entries invalid so that queries fall back to the walk.
+ */
+static void pr_summary_resolve(IN osm_sa_t * sa, IN osm_switch_t * p_sw,
+			       IN uint16_t lid_ho,
+			       IN const osm_physp_t * p_dest_physp,
+			       IN osm_switch_t ** stack)
+{
+	ib_net16_t lid = cl_hton16(lid_ho);
+	const osm_physp_t *p_out, *p_rem = NULL;
+	osm_path_summary_t *p_sum, *p_next_sum;
+	osm_switch_t *p_next;
+	uint8_t state = OSM_PATH_SUMMARY_VALID;
+	unsigned n = 0;
+	int p0_extended;
+
+	for (;;) {
+		p_sw->path_summary[lid_ho].state = PR_SUMMARY_BUSY;
+		stack[n++] = p_sw;
+
+		p_out = osm_switch_get_route_by_lid(p_sw, lid);
+		if (!p_out) {
+			state = PR_SUMMARY_INVALID;
+			break;
+		}
+		if (p_out == p_dest_physp)
+			break;
+		p_rem = osm_physp_get_remote(p_out);
+		if (!p_rem) {
+			state = PR_SUMMARY_INVALID;
+			break;
+		}
+		if (p_rem == p_dest_physp)
+			break;
+		p_next = p_rem->p_node->sw;
+		if (!p_next || !osm_switch_get_route_by_lid(p_next, lid)) {
+			state = PR_SUMMARY_INVALID;
+			break;
+		}
+		p_next_sum = &p_next->path_summary[lid_ho];
+		if (!p_next_sum->state) {
+			p_sw = p_next;
+			continue;
+		}
+		/* a busy entry means the forwarding tables loop */
+		if (p_next_sum->state != OSM_PATH_SUMMARY_VALID)
+			state = PR_SUMMARY_INVALID;
+		break;
+	}
+
+	while (n--) {
+		p_sw = stack[n];
+		p_sum = &p_sw->path_summary[lid_ho];
+		if (state != OSM_PATH_SUMMARY_VALID) {
+			p_sum->state = PR_SUMMARY_INVALID;
+			continue;
+		}
+
+		p_out = osm_switch_get_route_by_lid(p_sw, lid);
+		if (p_out == p_dest_physp) {
+			/* destination is this switch */
+			pr_summary_init(p_sum, p_out,
+					p_out->port_info.capability_mask &
+					IB_PORT_CAP_HAS_EXT_SPEEDS);
+			p_sum->state = OSM_PATH_SUMMARY_VALID;
+			continue;
+		}
+		p_rem = osm_physp_get_remote(p_out);
+		if (p_rem == p_dest_physp) {
+			pr_summary_init(p_sum, p_rem,
+					p_rem->port_info.capability_mask &
+					IB_PORT_CAP_HAS_EXT_SPEEDS);
+			p_sum->state = OSM_PATH_SUMMARY_VALID;
+			continue;
+		}
+
+		/* ingress and egress ports of the next switch, then the rest */
+		p_next = p_rem->p_node->sw;
+		p_next_sum = &p_next->path_summary[lid_ho];
+		if (p_next_sum->hops >= MAX_HOPS) {
+			p_sum->state = state = PR_SUMMARY_INVALID;
+			continue;
+		}
+		p0_extended = pr_summary_p0_extended(p_next->p_node);
+		pr_summary_init(p_sum, p_rem, p0_extended);
+		p_out = osm_switch_get_route_by_lid(p_next, lid);
+		pr_summary_add_port(p_sum, p_out, p0_extended);
+		if (sa->p_subn->opt.qos)
+			pr_summary_add_slvl(p_sum, p_out,
+					    osm_physp_get_port_num(p_rem));
+		pr_summary_add(p_sum, p_next_sum);
+		p_sum->hops = p_next_sum->hops + 1;
+		p_sum->state = OSM_PATH_SUMMARY_VALID;
+	}
+}
+
+void osm_sa_pr_summary_update(IN osm_sa_t * sa)
+{
+	osm_subn_t *p_subn = sa->p_subn;
+	cl_qmap_t *p_sw_tbl = &p_subn->sw_guid_tbl;
+	osm_switch_t **stack = NULL;
+	const osm_physp_t *p_dest_physp;
+	osm_switch_t *p_sw;
+	osm_port_t *p_port;
+	uint16_t size = p_subn->max_ucast_lid_ho + 1;
+	uint16_t lid_ho;
+
+	OSM_LOG_ENTER(sa->p_log);
+
+	if (!p_subn->opt.sa_pr_path_summary) {
+		for (p_sw = (osm_switch_t *) cl_qmap_head(p_sw_tbl);
+		     p_sw != (osm_switch_t *) cl_qmap_end(p_sw_tbl);
+		     p_sw = (osm_switch_t *) cl_qmap_next(&p_sw->map_item)) {
+			free(p_sw->path_summary);
+			p_sw->path_summary = NULL;
+			p_sw->path_summary_size = 0;
+		}
+		goto Exit;
+	}
+
+	stack = malloc((cl_qmap_count(p_sw_tbl) + 1) * sizeof(*stack));
+	if (!stack) {
+		OSM_LOG(sa->p_log, OSM_LOG_ERROR, "ERR 1F2B: "
+			"Cannot allocate path summary stack\n");
+		goto Exit;
+	}
+
+	for (p_sw = (osm_switch_t *) cl_qmap_head(p_sw_tbl);
+	     p_sw != (osm_switch_t *) cl_qmap_end(p_sw_tbl);
+	     p_sw = (osm_switch_t *) cl_qmap_next(&p_sw->map_item)) {
+		if (p_sw->path_summary_size != size) {
+			free(p_sw->path_summary);
+			p_sw->path_summary_size = 0;
+			p_sw->path_summary = malloc(size *
+						    sizeof(*p_sw->path_summary));
+			if (!p_sw->path_summary) {
+				OSM_LOG(sa->p_log, OSM_LOG_ERROR, "ERR 1F2C: "
+					"Cannot allocate path summary for "
+					"switch 0x%016" PRIx64 "\n",
+					cl_ntoh64(osm_node_get_node_guid
+						  (p_sw->p_node)));
+				goto Exit;
+			}
+			p_sw->path_summary_size = size;
+		}
+		memset(p_sw->path_summary, 0,
+		       size * sizeof(*p_sw->path_summary));
+	}
+
+	for (lid_ho = 1; lid_ho < size; lid_ho++) {
+		p_port = osm_get_port_by_lid_ho(p_subn, lid_ho);
+		if (!p_port)
+			continue;
+		p_dest_physp = p_port->p_physp;
+		if (p_port->p_node->sw) {
+			p_dest_physp =
+			    osm_switch_get_route_by_lid(p_port->p_node->sw,
+							cl_hton16(lid_ho));
+			if (!p_dest_physp)
+				continue;
+		}
+		for (p_sw = (osm_switch_t *) cl_qmap_head(p_sw_tbl);
+		     p_sw != (osm_switch_t *) cl_qmap_end(p_sw_tbl);
+		     p_sw = (osm_switch_t *) cl_qmap_next(&p_sw->map_item))
+			if (!p_sw->path_summary[lid_ho].state)
+				pr_summary_resolve(sa, p_sw, lid_ho,
+						   p_dest_physp, stack);
+	}
+
+	sa->pr_summary_qos = p_subn->opt.qos;
+	sa->pr_summary_gen = sa->pr_cache_gen;
+
+	OSM_LOG(sa->p_log, OSM_LOG_VERBOSE,
+		"Path summaries built for %u switches and %u LIDs\n",
+		cl_qmap_count(p_sw_tbl), size - 1);
+Exit:
+	free(stack);
+	OSM_LOG_EXIT(sa->p_log);
+}
+
+/*
+ * Compute the walk result from the switch path summaries. Returns FALSE
+ * whenever the path walk has to be done instead, either because the
+ * summaries do not cover this path or because the walk would fail and
+ * report the reason.
+ */
+static boolean_t pr_rcv_walk_summary(IN osm_sa_t * sa,
+				     IN const osm_alias_guid_t * p_src_alias_guid,
+				     IN const uint16_t dest_lid_ho,
+				     IN const osm_alias_guid_t * p_dest_alias_guid,
+				     OUT osm_pr_cache_entry_t * p_walk,
+				     OUT const osm_physp_t ** pp_dest_physp)
+{
+	ib_net16_t dest_lid = cl_hton16(dest_lid_ho);
+	const osm_physp_t *p_src_physp, *p_dest_physp, *p_out, *p_rem;
+	const osm_path_summary_t *p_next_sum;
+	osm_path_summary_t sum;
+	osm_switch_t *p_sw;
+	unsigned hops;
+	int p0_extended;
+
+	if (sa->pr_summary_gen != (uint32_t) sa->pr_cache_gen ||
+	    sa->pr_summary_qos != sa->p_subn->opt.qos ||
+	    osm_get_port_by_lid_ho(sa->p_subn, dest_lid_ho) !=
+	    p_dest_alias_guid->p_base_port)
+		return FALSE;
+
+	p_dest_physp = p_dest_alias_guid->p_base_port->p_physp;
+	if (p_dest_physp->p_node->sw) {
+		p_dest_physp = osm_switch_get_route_by_lid(p_dest_physp->p_node->sw,
+							   dest_lid);
+		if (!p_dest_physp)
+			return FALSE;
+	}
+
+	p_src_physp = p_src_alias_guid->p_base_port->p_physp;
+	pr_summary_init(&sum, p_src_physp,
+			p_src_physp->port_info.capability_mask &
+			IB_PORT_CAP_HAS_EXT_SPEEDS);
+
+	p_sw = p_src_physp->p_node->sw;
+	if (p_sw) {
+		/* source is a switch: its summary covers the whole path */
+		p_out = osm_switch_get_route_by_lid(p_sw, dest_lid);
+		if (!p_out || dest_lid_ho >= p_sw->path_summary_size)
+			return FALSE;
+		if (sa->p_subn->opt.qos)
+			pr_summary_add_slvl(&sum, p_out, 0);
+		p_next_sum = &p_sw->path_summary[dest_lid_ho];
+		if (p_next_sum->state != OSM_PATH_SUMMARY_VALID)
+			return FALSE;
+		pr_summary_add(&sum, p_next_sum);
+		hops = p_next_sum->hops;
+	} else {
+		if (sa->p_subn->opt.qos)
+			pr_summary_add_slvl(&sum, p_src_physp, 0);
+		if (p_src_physp == p_dest_physp)
+			p_rem = p_dest_physp;
+		else {
+			p_rem = osm_physp_get_remote(p_src_physp);
+			if (!p_rem)
+				return FALSE;
+		}
+		if (p_rem == p_dest_physp) {
+			pr_summary_add_port(&sum, p_rem,
+					    p_rem->port_info.capability_mask &
+					    IB_PORT_CAP_HAS_EXT_SPEEDS);
+			hops = 0;
+		} else {
+			p_sw = p_rem->p_node->sw;
+			if (!p_sw || dest_lid_ho >= p_sw->path_summary_size)
+				return FALSE;
+			p_out = osm_switch_get_route_by_lid(p_sw, dest_lid);
+			if (!p_out)
+				return FALSE;
+			p_next_sum = &p_sw->path_summary[dest_lid_ho];
+			if (p_next_sum->state != OSM_PATH_SUMMARY_VALID)
+				return FALSE;
+			p0_extended = pr_summary_p0_extended(p_sw->p_node);
+			pr_summary_add_port(&sum, p_rem, p0_extended);
+			pr_summary_add_port(&sum, p_out, p0_extended);
+			if (sa->p_subn->opt.qos)
+				pr_summary_add_slvl(&sum, p_out,
+						    osm_physp_get_port_num(p_rem));
+			pr_summary_add(&sum, p_next_sum);
+			hops = p_next_sum->hops + 1;
+		}
+	}
+
+	if (hops > MAX_HOPS || !sum.valid_sl_mask)
+		return FALSE;
+
+	p_walk->mtu = sum.mtu;
+	p_walk->rate = sum.rate;
+	p_walk->valid_sl_mask = sum.valid_sl_mask;
+	p_walk->qos = sa->p_subn->opt.qos;
+	*pp_dest_physp = p_dest_physp;
+	return TRUE;
+}
+
+/*
+ * Look up the walk result for a LID pair in the PathRecord cache and walk
+ * the path on a miss. Entries are only stored when computed entirely
+ * within the current cache generation.
+ */
+static ib_api_status_t pr_rcv_get_path_walk(IN osm_sa_t * sa,
+					    IN const osm_alias_guid_t * p_src_alias_guid,
+					    IN const uint16_t src_lid_ho,
+					    IN const osm_alias_guid_t * p_dest_alias_guid,
+					    IN const uint16_t dest_lid_ho,
+					    OUT osm_pr_cache_entry_t * p_walk,
+					    OUT const osm_physp_t ** pp_dest_physp)
+{
+	osm_pr_cache_entry_t *p_entry;
+	const osm_physp_t *p_dest_physp;
+	const osm_node_t *p_node;
+	ib_net64_t src_guid, dest_guid;
+	ib_api_status_t status;
+	uint32_t gen;
+	boolean_t hit;
+
+	if (pr_rcv_walk_summary(sa, p_src_alias_guid, dest_lid_ho,
+				p_dest_alias_guid, p_walk, pp_dest_physp))
+		return IB_SUCCESS;
+
+	if (!sa->pr_cache)
+		return pr_rcv_walk_path(sa, p_src_alias_guid, src_lid_ho,
+					p_dest_alias_guid, dest_lid_ho,
+					p_walk, pp_dest_physp);
+
+	p_dest_physp = p_dest_alias_guid->p_base_port->p_physp;
+	p_node = osm_physp_get_node_ptr(p_dest_physp);
+	if (p_node->sw) {
+		p_dest_physp = osm_switch_get_route_by_lid(p_node->sw,
+							   cl_hton16(dest_lid_ho));
+		/* let the walk report the missing route */
+		if (!p_dest_physp)
+			return pr_rcv_walk_path(sa, p_src_alias_guid,
+						src_lid_ho, p_dest_alias_guid,
+						dest_lid_ho, p_walk,
+						pp_dest_physp);
+	}
+
+	src_guid = osm_port_get_guid(p_src_alias_guid->p_base_port);
+	dest_guid = osm_port_get_guid(p_dest_alias_guid->p_base_port);
+	p_entry = &sa->pr_cache[((uint32_t) src_lid_ho * 0x9e3779b1 ^
+				 dest_lid_ho) & sa->pr_cache_mask];
+
+	cl_spinlock_acquire(&sa->pr_cache_lock);
+	gen = sa->pr_cache_gen;
+	hit = p_entry->gen == gen &&
+	    p_entry->src_lid_ho == src_lid_ho &&
+	    p_entry->dest_lid_ho == dest_lid_ho &&
+	    p_entry->src_guid == src_guid &&
+	    p_entry->dest_guid == dest_guid &&
+	    p_entry->qos == sa->p_subn->opt.qos;
+	if (hit)
+		*p_walk = *p_entry;
+	cl_spinlock_release(&sa->pr_cache_lock);
+
+	if (hit) {
+		cl_atomic_inc(&sa->p_stats->sa_pr_cache_hits);
+		*pp_dest_physp = p_dest_physp;
+		return IB_SUCCESS;
+	}
+
+	cl_atomic_inc(&sa->p_stats->sa_pr_cache_misses);
+	status = pr_rcv_walk_path(sa, p_src_alias_guid, src_lid_ho,
+				  p_dest_alias_guid, dest_lid_ho,
+				  p_walk, pp_dest_physp);
+	if (status != IB_SUCCESS)
+		return status;
+
+	p_walk->gen = gen;
+	p_walk->src_lid_ho = src_lid_ho;
+	p_walk->dest_lid_ho = dest_lid_ho;
+	p_walk->src_guid = src_guid;
+	p_walk->dest_guid = dest_guid;
+
+	cl_spinlock_acquire(&sa->pr_cache_lock);
+	*p_entry = *p_walk;
+	cl_spinlock_release(&sa->pr_cache_lock);
+
+	return IB_SUCCESS;
+}
+
+static ib_api_status_t pr_rcv_get_path_parms(IN osm_sa_t * sa,
+					     IN const ib_path_rec_t * p_pr,
+					     IN const osm_alias_guid_t * p_src_alias_guid,
+					     IN const uint16_t src_lid_ho,
+					     IN const osm_alias_guid_t * p_dest_alias_guid,
+					     IN const uint16_t dest_lid_ho,
+					     IN const ib_net64_t comp_mask,
+					     OUT osm_path_parms_t * p_parms)
+{
+	const osm_physp_t *p_src_physp;
+	const osm_physp_t *p_dest_physp;
+	const osm_prtn_t *p_prtn = NULL;
+	osm_opensm_t *p_osm;
+	struct osm_routing_engine *p_re;
+	osm_pr_cache_entry_t walk;
+	ib_api_status_t status = IB_SUCCESS;
+	ib_net16_t pkey;
+	uint8_t mtu;
+	uint8_t rate;
+	uint8_t pkt_life;
+	uint8_t required_mtu;
+	uint8_t required_rate;
+	uint8_t required_pkt_life;
+	uint8_t sl;
+	uint8_t i;
+	osm_qos_level_t *p_qos_level = NULL;
+	uint16_t valid_sl_mask;
+
+	OSM_LOG_ENTER(sa->p_log);
+
+	p_src_physp = p_src_alias_guid->p_base_port->p_physp;
+	p_osm = sa->p_subn->p_osm;
+	p_re = p_osm->routing_engine_used;
+
+	/* most restrictive rate and mtu values along the path */
+	status = pr_rcv_get_path_walk(sa, p_src_alias_guid, src_lid_ho,
+				      p_dest_alias_guid, dest_lid_ho,
+				      &walk, &p_dest_physp);
+	if (status != IB_SUCCESS)
+		goto Exit;
+
+	mtu = walk.mtu;
+	rate = walk.rate;
+	valid_sl_mask = walk.valid_sl_mask;
+
+	/*
+	   Mellanox Tavor device performance is better using 1K MTU.
+	   If required MTU and MTU selector are such that 1K is OK
+	   and at least one end of the path is Tavor we override the
+	   port MTU with 1K.
+	 */
+	if (sa->p_subn->opt.enable_quirks &&
+	    sa_path_rec_apply_tavor_mtu_limit(p_pr,
+					      p_src_alias_guid->p_base_port,
+					      p_dest_alias_guid->p_base_port,
+					      comp_mask))
+		if (mtu > IB_MTU_LEN_1024) {
+			mtu = IB_MTU_LEN_1024;
+			OSM_LOG(sa->p_log, OSM_LOG_DEBUG,
+				"Optimized Path MTU to 1K for Mellanox Tavor device\n");
+		}
+
 	OSM_LOG(sa->p_log, OSM_LOG_DEBUG,
 		"Path min MTU = %u, min rate = %u\n", mtu, rate);
 
@@ -971,7 +1441,7 @@ static void pr_rcv_build_pr(IN osm_sa_t * sa,
 	OSM_LOG_EXIT(sa->p_log);
 }
 
-static osm_sa_item_t *pr_rcv_get_lid_pair_path(IN osm_sa_t * sa,
+static ib_path_rec_t *pr_rcv_get_lid_pair_path(IN osm_sa_t * sa,
 					       IN const ib_path_rec_t * p_pr,
 					       IN const osm_alias_guid_t * p_src_alias_guid,
 					       IN const osm_alias_guid_t * p_dest_alias_guid,
@@ -980,11 +1450,12 @@ static osm_sa_item_t *pr_rcv_get_lid_pair_path(IN osm_sa_t * sa,
 					       IN const uint16_t src_lid_ho,
 					       IN const uint16_t dest_lid_ho,
 					       IN const ib_net64_t comp_mask,
-					       IN const uint8_t preference)
+					       IN const uint8_t preference,
+					       IN osm_sa_resp_t * p_resp)
 {
 	osm_path_parms_t path_parms;
 	osm_path_parms_t rev_path_parms;
-	osm_sa_item_t *p_pr_item;
+	ib_path_rec_t *p_path_rec = NULL;
 	ib_api_status_t status, rev_path_status;
 
 	OSM_LOG_ENTER(sa->p_log);
@@ -992,23 +1463,12 @@ static osm_sa_item_t *pr_rcv_get_lid_pair_path(IN osm_sa_t * sa,
 	OSM_LOG(sa->p_log, OSM_LOG_DEBUG, "Src LID %u, Dest LID %u\n",
 		src_lid_ho, dest_lid_ho);
 
-	p_pr_item = malloc(SA_PR_RESP_SIZE);
-	if (p_pr_item == NULL) {
-		OSM_LOG(sa->p_log, OSM_LOG_ERROR, "ERR 1F01: "
-			"Unable to allocate path record\n");
-		goto Exit;
-	}
-	memset(p_pr_item, 0, SA_PR_RESP_SIZE);
-
 	status = pr_rcv_get_path_parms(sa, p_pr, p_src_alias_guid, src_lid_ho,
 				       p_dest_alias_guid, dest_lid_ho,
 				       comp_mask, &path_parms);
 
-	if (status != IB_SUCCESS) {
-		free(p_pr_item);
-		p_pr_item = NULL;
+	if (status != IB_SUCCESS)
 		goto Exit;
-	}
 
 	/* now try the reversible path */
 	rev_path_status = pr_rcv_get_path_parms(sa, p_pr, p_dest_alias_guid,
@@ -1028,18 +1488,23 @@ static osm_sa_item_t *pr_rcv_get_lid_pair_path(IN osm_sa_t * sa,
 	    !path_parms.reversible && (p_pr->num_path & 0x80)) {
 		OSM_LOG(sa->p_log, OSM_LOG_DEBUG,
 			"Requested reversible path but failed to get one\n");
-		free(p_pr_item);
-		p_pr_item = NULL;
+		goto Exit;
+	}
+
+	p_path_rec = osm_sa_resp_append(p_resp);
+	if (p_path_rec == NULL) {
+		OSM_LOG(sa->p_log, OSM_LOG_ERROR, "ERR 1F01: "
+			"Unable to allocate path record\n");
 		goto Exit;
 	}
 
 	pr_rcv_build_pr(sa, p_src_alias_guid, p_dest_alias_guid, p_sgid, p_dgid,
 			src_lid_ho, dest_lid_ho, preference, &path_parms,
-			&p_pr_item->resp.path_rec);
+			p_path_rec);
 
 Exit:
 	OSM_LOG_EXIT(sa->p_log);
-	return p_pr_item;
+	return p_path_rec;
 }
 
 static void pr_rcv_get_port_pair_paths(IN osm_sa_t * sa,
@@ -1049,11 +1514,10 @@ static void pr_rcv_get_port_pair_paths(IN osm_sa_t * sa,
 				       IN const osm_alias_guid_t * p_dest_alias_guid,
 				       IN const ib_gid_t * p_sgid,
 				       IN const ib_gid_t * p_dgid,
-				       IN cl_qlist_t * p_list)
+				       IN osm_sa_resp_t * p_resp)
 {
 	const ib_path_rec_t *p_pr = ib_sa_mad_get_payload_ptr(sa_mad);
 	ib_net64_t comp_mask = sa_mad->comp_mask;
-	osm_sa_item_t *p_pr_item;
 	uint16_t src_lid_min_ho;
 	uint16_t src_lid_max_ho;
 	uint16_t dest_lid_min_ho;
@@ -1190,16 +1654,12 @@ static void pr_rcv_get_port_pair_paths(IN osm_sa_t * sa,
 		   These paths are "fully redundant"
 		 */
 
-		p_pr_item = pr_rcv_get_lid_pair_path(sa, p_pr, p_src_alias_guid,
-						     p_dest_alias_guid,
-						     p_sgid, p_dgid,
-						     src_lid_ho, dest_lid_ho,
-						     comp_mask, preference);
-
-		if (p_pr_item) {
-			cl_qlist_insert_tail(p_list, &p_pr_item->list_item);
+		if (pr_rcv_get_lid_pair_path(sa, p_pr, p_src_alias_guid,
+					     p_dest_alias_guid,
+					     p_sgid, p_dgid,
+					     src_lid_ho, dest_lid_ho,
+					     comp_mask, preference, p_resp))
 			++path_num;
-		}
 
 		if (++src_lid_ho > src_lid_max_ho)
 			break;
@@ -1254,16 +1714,12 @@ static void pr_rcv_get_port_pair_paths(IN osm_sa_t * sa,
 		if (src_offset == dest_offset)
 			continue;	/* already reported */
 
-		p_pr_item = pr_rcv_get_lid_pair_path(sa, p_pr, p_src_alias_guid,
-						     p_dest_alias_guid, p_sgid,
-						     p_dgid, src_lid_ho,
-						     dest_lid_ho, comp_mask,
-						     preference);
-
-		if (p_pr_item) {
-			cl_qlist_insert_tail(p_list, &p_pr_item->list_item);
+		if (pr_rcv_get_lid_pair_path(sa, p_pr, p_src_alias_guid,
+					     p_dest_alias_guid, p_sgid,
+					     p_dgid, src_lid_ho,
+					     dest_lid_ho, comp_mask,
+					     preference, p_resp))
 			++path_num;
-		}
 	}
 
 Exit:
@@ -1441,11 +1897,332 @@ Exit:
 	return sa_status;
 }
 
+/*
+ * GetTable queries over the whole or half of the fabric are split into
+ * chunks of a snapshot array of the alias GUIDs. The chunks are evaluated
+ * by the threads of the pool, the requesting thread included, each into
+ * its own response. They are then copied into the response in chunk
+ * order, so the records come out in the order of the serial evaluation.
+ */
+#define PR_CHUNK_PAIRS 256
+
+typedef struct osm_pr_chunk {
+	unsigned worker;
+	unsigned first_rec;
+	unsigned num_rec;
+} osm_pr_chunk_t;
+
+typedef struct osm_pr_job {
+	const ib_sa_mad_t *sa_mad;
+	const osm_port_t *requester_port;
+	const osm_alias_guid_t *p_src_alias_guid;
+	const osm_alias_guid_t *p_dest_alias_guid;
+	const ib_gid_t *p_sgid;
+	const ib_gid_t *p_dgid;
+	const osm_alias_guid_t **aliases;
+	unsigned num_aliases;
+	unsigned chunk_size;
+	unsigned num_chunks;
+	osm_pr_chunk_t *chunks;
+	atomic32_t next_chunk;
+} osm_pr_job_t;
+
+typedef struct osm_pr_worker {
+	struct osm_pr_pool *pool;
+	cl_thread_t thread;
+	osm_sa_resp_t resp;
+} osm_pr_worker_t;
+
+typedef struct osm_pr_pool {
+	osm_sa_t *sa;
+	osm_pr_worker_t *workers;
+	unsigned num_workers;	/* incl. the requesting thread (workers[0]) */
+	unsigned num_threads;	/* number of started helper threads */
+	pthread_mutex_t busy;	/* held by the request using the pool */
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	osm_pr_job_t *job;
+	unsigned round;
+	unsigned pending;	/* helper threads still busy in this round */
+	boolean_t stop;
+} osm_pr_pool_t;
+
+static void pr_pool_worker_run(IN osm_pr_worker_t * worker)
+{
+	osm_pr_pool_t *pool = worker->pool;
+	osm_pr_job_t *job = pool->job;
+	osm_pr_chunk_t *chunk;
+	unsigned c, i, j, end;
+
+	while ((c = (unsigned)cl_atomic_inc(&job->next_chunk) - 1) <
+	       job->num_chunks) {
+		chunk = &job->chunks[c];
+		chunk->worker = worker - pool->workers;
+		chunk->first_rec = osm_sa_resp_count(&worker->resp);
+
+		end = (c + 1) * job->chunk_size;
+		if (end > job->num_aliases)
+			end = job->num_aliases;
+		for (i = c * job->chunk_size; i < end; i++) {
+			if (job->p_src_alias_guid)
+				pr_rcv_get_port_pair_paths(pool->sa,
+							   job->sa_mad,
+							   job->requester_port,
+							   job->p_src_alias_guid,
+							   job->aliases[i],
+							   job->p_sgid,
+							   job->p_dgid,
+							   &worker->resp);
+			else if (job->p_dest_alias_guid)
+				pr_rcv_get_port_pair_paths(pool->sa,
+							   job->sa_mad,
+							   job->requester_port,
+							   job->aliases[i],
+							   job->p_dest_alias_guid,
+							   job->p_sgid,
+							   job->p_dgid,
+							   &worker->resp);
+			else
+				for (j = 0; j < job->num_aliases; j++)
+					pr_rcv_get_port_pair_paths(pool->sa,
+								   job->sa_mad,
+								   job->requester_port,
+								   job->aliases[j],
+								   job->aliases[i],
+								   job->p_sgid,
+								   job->p_dgid,
+								   &worker->resp);
+		}
+
+		chunk->num_rec =
+		    osm_sa_resp_count(&worker->resp) - chunk->first_rec;
+	}
+}
+
+static void pr_pool_thread(IN void *context)
+{
+	osm_pr_worker_t *worker = context;
+	osm_pr_pool_t *pool = worker->pool;
+	unsigned round = 0;
+
+	pthread_mutex_lock(&pool->mutex);
+	for (;;) {
+		while (pool->round == round && !pool->stop)
+			pthread_cond_wait(&pool->cond, &pool->mutex);
+		if (pool->stop)
+			break;
+		round = pool->round;
+		pthread_mutex_unlock(&pool->mutex);
+
+		pr_pool_worker_run(worker);
+
+		pthread_mutex_lock(&pool->mutex);
+		if (--pool->pending == 0)
+			pthread_cond_broadcast(&pool->cond);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+static void pr_pool_run(IN osm_pr_pool_t * pool, IN osm_pr_job_t * job)
+{
+	pthread_mutex_lock(&pool->mutex);
+	pool->job = job;
+	pool->round++;
+	pool->pending = pool->num_threads;
+	pthread_cond_broadcast(&pool->cond);
+	pthread_mutex_unlock(&pool->mutex);
+
+	pr_pool_worker_run(&pool->workers[0]);
+
+	pthread_mutex_lock(&pool->mutex);
+	while (pool->pending)
+		pthread_cond_wait(&pool->cond, &pool->mutex);
+	pool->job = NULL;
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+void osm_pr_pool_destroy(IN osm_sa_t * sa)
+{
+	osm_pr_pool_t *pool = sa->pr_pool;
+	unsigned i;
+
+	if (!pool)
+		return;
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->stop = TRUE;
+	pthread_cond_broadcast(&pool->cond);
+	pthread_mutex_unlock(&pool->mutex);
+
+	for (i = 1; i <= pool->num_threads; i++)
+		cl_thread_destroy(&pool->workers[i].thread);
+
+	free(pool->workers);
+	pthread_cond_destroy(&pool->cond);
+	pthread_mutex_destroy(&pool->mutex);
+	pthread_mutex_destroy(&pool->busy);
+	free(pool);
+	sa->pr_pool = NULL;
+}
+
+ib_api_status_t osm_pr_pool_init(IN osm_sa_t * sa)
+{
+	osm_pr_pool_t *pool;
+	unsigned num_workers, i;
+
+	num_workers = sa->p_subn->opt.sa_pr_threads;
+	if (!num_workers)
+		num_workers = cl_proc_count();
+	if (num_workers <= 1)
+		return IB_SUCCESS;
+
+	pool = calloc(1, sizeof(*pool));
+	if (!pool)
+		goto ErrorAlloc;
+	pool->sa = sa;
+	pthread_mutex_init(&pool->busy, NULL);
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_cond_init(&pool->cond, NULL);
+	sa->pr_pool = pool;
+
+	pool->workers = calloc(num_workers, sizeof(*pool->workers));
+	if (!pool->workers)
+		goto ErrorAlloc;
+	pool->num_workers = num_workers;
+
+	for (i = 0; i < num_workers; i++) {
+		pool->workers[i].pool = pool;
+		cl_thread_construct(&pool->workers[i].thread);
+	}
+
+	for (i = 1; i < num_workers; i++) {
+		if (cl_thread_init(&pool->workers[i].thread, pr_pool_thread,
+				   &pool->workers[i], "opensm pr") !=
+		    CL_SUCCESS) {
+			OSM_LOG(sa->p_log, OSM_LOG_ERROR, "ERR 1F2E: "
+				"Cannot start PathRecord worker thread\n");
+			osm_pr_pool_destroy(sa);
+			return IB_ERROR;
+		}
+		pool->num_threads++;
+	}
+
+	OSM_LOG(sa->p_log, OSM_LOG_VERBOSE,
+		"Using %u threads for PathRecord queries\n", num_workers);
+	return IB_SUCCESS;
+
+ErrorAlloc:
+	OSM_LOG(sa->p_log, OSM_LOG_ERROR, "ERR 1F2D: "
+		"Cannot allocate PathRecord worker pool\n");
+	osm_pr_pool_destroy(sa);
+	return IB_INSUFFICIENT_MEMORY;
+}
+
+/*
+ * Evaluates a GetTable query over the whole fabric (no fixed alias) or
+ * half of it (one fixed alias) on the worker pool. Returns FALSE, without
+ * adding any record, if the query is left to the serial evaluation.
+ */
+static boolean_t pr_rcv_process_parallel(IN osm_sa_t * sa,
+					 IN const ib_sa_mad_t * sa_mad,
+					 IN const osm_port_t * requester_port,
+					 IN const osm_alias_guid_t * p_src_alias_guid,
+					 IN const osm_alias_guid_t * p_dest_alias_guid,
+					 IN const ib_gid_t * p_sgid,
+					 IN const ib_gid_t * p_dgid,
+					 IN osm_sa_resp_t * p_resp)
+{
+	osm_pr_pool_t *pool = sa->pr_pool;
+	const cl_qmap_t *p_tbl = &sa->p_subn->alias_port_guid_tbl;
+	const cl_map_item_t *p_item;
+	osm_sa_resp_t *p_worker_resp;
+	osm_pr_chunk_t *chunk;
+	osm_pr_job_t job;
+	uint64_t num_pairs;
+	unsigned i, c;
+	ib_path_rec_t *p_pr;
+	boolean_t done = FALSE;
+
+	if (!pool || sa_mad->method != IB_MAD_METHOD_GETTABLE)
+		return FALSE;
+
+	memset(&job, 0, sizeof(job));
+	job.num_aliases = cl_qmap_count(p_tbl);
+	num_pairs = job.num_aliases;
+	if (!p_src_alias_guid && !p_dest_alias_guid)
+		num_pairs *= job.num_aliases;
+	if (num_pairs < 2 * PR_CHUNK_PAIRS)
+		return FALSE;
+
+	/* another request is using the pool */
+	if (pthread_mutex_trylock(&pool->busy))
+		return FALSE;
+
+	job.sa_mad = sa_mad;
+	job.requester_port = requester_port;
+	job.p_src_alias_guid = p_src_alias_guid;
+	job.p_dest_alias_guid = p_dest_alias_guid;
+	job.p_sgid = p_sgid;
+	job.p_dgid = p_dgid;
+	job.chunk_size = PR_CHUNK_PAIRS / (num_pairs / job.num_aliases);
+	if (!job.chunk_size)
+		job.chunk_size = 1;
+	job.num_chunks = (job.num_aliases + job.chunk_size - 1) /
+	    job.chunk_size;
+
+	job.aliases = malloc(job.num_aliases * sizeof(*job.aliases));
+	job.chunks = malloc(job.num_chunks * sizeof(*job.chunks));
+	if (!job.aliases || !job.chunks) {
+		OSM_LOG(sa->p_log, OSM_LOG_ERROR, "ERR 1F2F: "
+			"Cannot allocate PathRecord work list, "
+			"evaluating serially\n");
+		goto Exit;
+	}
+
+	for (i = 0, p_item = cl_qmap_head(p_tbl);
+	     p_item != cl_qmap_end(p_tbl); i++, p_item = cl_qmap_next(p_item))
+		job.aliases[i] = (const osm_alias_guid_t *) p_item;
+
+	for (i = 0; i < pool->num_workers; i++)
+		osm_sa_resp_init(sa, &pool->workers[i].resp, p_resp->p_madw,
+				 sizeof(ib_path_rec_t), 0);
+
+	pr_pool_run(pool, &job);
+
+	for (i = 0; i < pool->num_workers; i++)
+		if (pool->workers[i].resp.failed)
+			p_resp->failed = TRUE;
+
+	for (c = 0; c < job.num_chunks; c++) {
+		chunk = &job.chunks[c];
+		p_worker_resp = &pool->workers[chunk->worker].resp;
+		for (i = 0; i < chunk->num_rec; i++) {
+			p_pr = osm_sa_resp_append(p_resp);
+			if (!p_pr)
+				break;
+			memcpy(p_pr, osm_sa_resp_record(p_worker_resp,
+							chunk->first_rec + i),
+			       sizeof(*p_pr));
+		}
+	}
+
+	for (i = 0; i < pool->num_workers; i++)
+		osm_sa_resp_destroy(&pool->workers[i].resp);
+
+	done = TRUE;
+
+Exit:
+	free(job.chunks);
+	free(job.aliases);
+	pthread_mutex_unlock(&pool->busy);
+	return done;
+}
+
 static void pr_rcv_process_world(IN osm_sa_t * sa, IN const ib_sa_mad_t * sa_mad,
 				 IN const osm_port_t * requester_port,
 				 IN const ib_gid_t * p_sgid,
 				 IN const ib_gid_t * p_dgid,
-				 IN cl_qlist_t * p_list)
+				 IN osm_sa_resp_t * p_resp)
 {
 	const cl_qmap_t *p_tbl;
 	const osm_alias_guid_t *p_dest_alias_guid, *p_src_alias_guid;
@@ -1460,6 +2237,10 @@ static void pr_rcv_process_world(IN osm_sa_t * sa, IN const ib_sa_mad_t * sa_mad
 	   We compute both A -> B and B -> A, since we don't have
 	   any check to determine the reversability of the paths.
 	 */
+	if (pr_rcv_process_parallel(sa, sa_mad, requester_port, NULL, NULL,
+				    p_sgid, p_dgid, p_resp))
+		goto Exit;
+
 	p_tbl = &sa->p_subn->alias_port_guid_tbl;
 
 	p_dest_alias_guid = (osm_alias_guid_t *) cl_qmap_head(p_tbl);
@@ -1469,9 +2250,9 @@ static void pr_rcv_process_world(IN osm_sa_t * sa, IN const ib_sa_mad_t * sa_mad
 			pr_rcv_get_port_pair_paths(sa, sa_mad, requester_port,
 						   p_src_alias_guid,
 						   p_dest_alias_guid,
-						   p_sgid, p_dgid, p_list);
+						   p_sgid, p_dgid, p_resp);
 			if (sa_mad->method == IB_MAD_METHOD_GET &&
-			    cl_qlist_count(p_list) > 0)
+			    osm_sa_resp_count(p_resp) > 0)
 				goto Exit;
 
 			p_src_alias_guid =
@@ -1492,7 +2273,7 @@ void osm_pr_process_half(IN osm_sa_t * sa, IN const ib_sa_mad_t * sa_mad,
 				IN const osm_alias_guid_t * p_dest_alias_guid,
 				IN const ib_gid_t * p_sgid,
 				IN const ib_gid_t * p_dgid,
-				IN cl_qlist_t * p_list)
+				IN osm_sa_resp_t * p_resp)
 {
 	const cl_qmap_t *p_tbl;
 	const osm_alias_guid_t *p_alias_guid;
@@ -1504,6 +2285,11 @@ void osm_pr_process_half(IN osm_sa_t * sa, IN const ib_sa_mad_t * sa_mad,
 	   A path record from a port to itself is legit, so no
 	   need to special case that one.
 	 */
+	if (pr_rcv_process_parallel(sa, sa_mad, requester_port,
+				    p_src_alias_guid, p_dest_alias_guid,
+				    p_sgid, p_dgid, p_resp))
+		goto Exit;
+
 	p_tbl = &sa->p_subn->alias_port_guid_tbl;
 
 	if (p_src_alias_guid) {
@@ -1515,9 +2301,9 @@ void osm_pr_process_half(IN osm_sa_t * sa, IN const ib_sa_mad_t * sa_mad,
 			pr_rcv_get_port_pair_paths(sa, sa_mad, requester_port,
 						   p_src_alias_guid,
 						   p_alias_guid,
-						   p_sgid, p_dgid, p_list);
+						   p_sgid, p_dgid, p_resp);
 			if (sa_mad->method == IB_MAD_METHOD_GET &&
-			    cl_qlist_count(p_list) > 0)
+			    osm_sa_resp_count(p_resp) > 0)
 				break;
 			p_alias_guid = (osm_alias_guid_t *) cl_qmap_next(&p_alias_guid->map_item);
 		}
@@ -1530,14 +2316,15 @@ void osm_pr_process_half(IN osm_sa_t * sa, IN const ib_sa_mad_t * sa_mad,
 			pr_rcv_get_port_pair_paths(sa, sa_mad, requester_port,
 						   p_alias_guid,
 						   p_dest_alias_guid, p_sgid,
-						   p_dgid, p_list);
+						   p_dgid, p_resp);
 			if (sa_mad->method == IB_MAD_METHOD_GET &&
-			    cl_qlist_count(p_list) > 0)
+			    osm_sa_resp_count(p_resp) > 0)
 				break;
 			p_alias_guid = (osm_alias_guid_t *) cl_qmap_next(&p_alias_guid->map_item);
 		}
 	}
 
+Exit:
 	OSM_LOG_EXIT(sa->p_log);
 }
 
@@ -1547,12 +2334,12 @@ void osm_pr_process_pair(IN osm_sa_t * sa, IN const ib_sa_mad_t * sa_mad,
 				IN const osm_alias_guid_t * p_dest_alias_guid,
 				IN const ib_gid_t * p_sgid,
 				IN const ib_gid_t * p_dgid,
-				IN cl_qlist_t * p_list)
+				IN osm_sa_resp_t * p_resp)
 {
 	OSM_LOG_ENTER(sa->p_log);
 
 	pr_rcv_get_port_pair_paths(sa, sa_mad, requester_port, p_src_alias_guid,
-				   p_dest_alias_guid, p_sgid, p_dgid, p_list);
+				   p_dest_alias_guid, p_sgid, p_dgid, p_resp);
 
 	OSM_LOG_EXIT(sa->p_log);
 }
@@ -1665,12 +2452,12 @@ Exit:
 }
 
 static void pr_process_multicast(osm_sa_t * sa, const ib_sa_mad_t *sa_mad,
-				 cl_qlist_t *list)
+				 osm_sa_resp_t *resp)
 {
 	ib_path_rec_t *pr = ib_sa_mad_get_payload_ptr(sa_mad);
 	osm_mgrp_t *mgrp;
 	ib_api_status_t status;
-	osm_sa_item_t *pr_item;
+	ib_path_rec_t *resp_pr;
 	uint32_t flow_label;
 	uint8_t sl, hop_limit;
 
@@ -1694,34 +2481,33 @@ static void pr_process_multicast(osm_sa_t * sa, const ib_sa_mad_t *sa_mad,
 		return;
 	}
 
-	pr_item = malloc(SA_PR_RESP_SIZE);
-	if (pr_item == NULL) {
+	resp_pr = osm_sa_resp_append(resp);
+	if (resp_pr == NULL) {
 		OSM_LOG(sa->p_log, OSM_LOG_ERROR, "ERR 1F18: "
 			"Unable to allocate path record for MC group\n");
 		return;
 	}
-	memset(pr_item, 0, sizeof(cl_list_item_t));
 
 	/* Copy PathRecord request into response */
-	pr_item->resp.path_rec = *pr;
+	*resp_pr = *pr;
 
 	/* Now, use the MC info to cruft up the PathRecord response */
-	pr_item->resp.path_rec.dgid = mgrp->mcmember_rec.mgid;
-	pr_item->resp.path_rec.dlid = mgrp->mcmember_rec.mlid;
-	pr_item->resp.path_rec.tclass = mgrp->mcmember_rec.tclass;
-	pr_item->resp.path_rec.num_path = 1;
-	pr_item->resp.path_rec.pkey = mgrp->mcmember_rec.pkey;
+	resp_pr->dgid = mgrp->mcmember_rec.mgid;
+	resp_pr->dlid = mgrp->mcmember_rec.mlid;
+	resp_pr->tclass = mgrp->mcmember_rec.tclass;
+	resp_pr->num_path = 1;
+	resp_pr->pkey = mgrp->mcmember_rec.pkey;
 
 	/* MTU, rate, and packet lifetime should be exactly */
-	pr_item->resp.path_rec.mtu = (IB_PATH_SELECTOR_EXACTLY << 6) | mgrp->mcmember_rec.mtu;
-	pr_item->resp.path_rec.rate = (IB_PATH_SELECTOR_EXACTLY << 6) | mgrp->mcmember_rec.rate;
-	pr_item->resp.path_rec.pkt_life = (IB_PATH_SELECTOR_EXACTLY << 6) | mgrp->mcmember_rec.pkt_life;
+	resp_pr->mtu = (IB_PATH_SELECTOR_EXACTLY << 6) | mgrp->mcmember_rec.mtu;
+	resp_pr->rate = (IB_PATH_SELECTOR_EXACTLY << 6) | mgrp->mcmember_rec.rate;
+	resp_pr->pkt_life = (IB_PATH_SELECTOR_EXACTLY << 6) | mgrp->mcmember_rec.pkt_life;
 
 	/* SL, Hop Limit, and Flow Label */
 	ib_member_get_sl_flow_hop(mgrp->mcmember_rec.sl_flow_hop,
 				  &sl, &flow_label, &hop_limit);
-	ib_path_rec_set_sl(&pr_item->resp.path_rec, sl);
-	ib_path_rec_set_qos_class(&pr_item->resp.path_rec, 0);
+	ib_path_rec_set_sl(resp_pr, sl);
+	ib_path_rec_set_qos_class(resp_pr, 0);
 
 	/* HopLimit is not yet set in non link local MC groups */
 	/* If it were, this would not be needed */
@@ -1729,10 +2515,8 @@ static void pr_process_multicast(osm_sa_t * sa, const ib_sa_mad_t *sa_mad,
 	    IB_MC_SCOPE_LINK_LOCAL)
 		hop_limit = IB_HOPLIMIT_MAX;
 
-	pr_item->resp.path_rec.hop_flow_raw =
+	resp_pr->hop_flow_raw =
 	    cl_hton32(hop_limit) | (flow_label << 8);
-
-	cl_qlist_insert_tail(list, &pr_item->list_item);
 }
 
 void osm_pr_rcv_process(IN void *context, IN void *data)
@@ -1741,7 +2525,7 @@ void osm_pr_rcv_process(IN void *context, IN void *data)
 	osm_madw_t *p_madw = data;
 	const ib_sa_mad_t *p_sa_mad = osm_madw_get_sa_mad_ptr(p_madw);
 	ib_path_rec_t *p_pr = ib_sa_mad_get_payload_ptr(p_sa_mad);
-	cl_qlist_t pr_list;
+	osm_sa_resp_t resp;
 	const ib_gid_t *p_sgid = NULL, *p_dgid = NULL;
 	const osm_alias_guid_t *p_src_alias_guid, *p_dest_alias_guid;
 	const osm_port_t *p_src_port, *p_dest_port;
@@ -1793,8 +2577,6 @@ void osm_pr_rcv_process(IN void *context, IN void *data)
 		goto Exit;
 	}
 
-	cl_qlist_init(&pr_list);
-
 	/*
 	   Most SA functions (including this one) are read-only on the
 	   subnet object, so we grab the lock non-exclusively.
@@ -1819,10 +2601,15 @@ void osm_pr_rcv_process(IN void *context, IN void *data)
 		osm_dump_path_record_v2(sa->p_log, p_pr, FILE_ID, OSM_LOG_DEBUG);
 	}
 
+	/* a GetTable response grows past the hint as paths are found */
+	osm_sa_resp_init(sa, &resp, p_madw, sizeof(ib_path_rec_t),
+			 p_sa_mad->method == IB_MAD_METHOD_GET ?
+			 1 : 1 << sa->p_subn->opt.lmc);
+
 	/* Handle multicast destinations separately */
 	if ((p_sa_mad->comp_mask & IB_PR_COMPMASK_DGID) &&
 	    ib_gid_is_multicast(&p_pr->dgid)) {
-		pr_process_multicast(sa, p_sa_mad, &pr_list);
+		pr_process_multicast(sa, p_sa_mad, &resp);
 		goto Unlock;
 	}
 
@@ -1843,6 +2630,7 @@ void osm_pr_rcv_process(IN void *context, IN void *data)
 			cl_ntoh64(osm_port_get_guid(requester_port)),
 			cl_ntoh64(p_pr->sgid.unicast.interface_id),
 			cl_ntoh16(p_pr->slid));
+		osm_sa_resp_destroy(&resp);
 		osm_sa_send_error(sa, p_madw, IB_SA_MAD_STATUS_REQ_INVALID);
 		goto Exit;
 	}
@@ -1856,6 +2644,7 @@ void osm_pr_rcv_process(IN void *context, IN void *data)
 			cl_ntoh64(osm_port_get_guid(requester_port)),
 			cl_ntoh64(p_pr->dgid.unicast.interface_id),
 			cl_ntoh16(p_pr->dlid));
+		osm_sa_resp_destroy(&resp);
 		osm_sa_send_error(sa, p_madw, IB_SA_MAD_STATUS_REQ_INVALID);
 		goto Exit;
 	}
@@ -1868,11 +2657,11 @@ void osm_pr_rcv_process(IN void *context, IN void *data)
 		if (p_dest_alias_guid)
 			osm_pr_process_pair(sa, p_sa_mad, requester_port,
 					    p_src_alias_guid, p_dest_alias_guid,
-					    p_sgid, p_dgid, &pr_list);
+					    p_sgid, p_dgid, &resp);
 		else if (!p_dest_port)
 			osm_pr_process_half(sa, p_sa_mad, requester_port,
 					    p_src_alias_guid, NULL, p_sgid,
-					    p_dgid, &pr_list);
+					    p_dgid, &resp);
 		else {
 			/* Get all alias GUIDs for the dest port */
 			p_dest_alias_guid = (osm_alias_guid_t *) cl_qmap_head(&sa->p_subn->alias_port_guid_tbl);
@@ -1885,9 +2674,9 @@ void osm_pr_rcv_process(IN void *context, IN void *data)
 							    p_src_alias_guid,
 							    p_dest_alias_guid,
 							    p_sgid, p_dgid,
-							    &pr_list);
+							    &resp);
 				if (p_sa_mad->method == IB_MAD_METHOD_GET &&
-				    cl_qlist_count(&pr_list) > 0)
+				    osm_sa_resp_count(&resp) > 0)
 					break;
 
 				p_dest_alias_guid = (osm_alias_guid_t *) cl_qmap_next(&p_dest_alias_guid->map_item);
@@ -1897,13 +2686,13 @@ void osm_pr_rcv_process(IN void *context, IN void *data)
 		if (p_dest_alias_guid && !p_src_port)
 			osm_pr_process_half(sa, p_sa_mad, requester_port,
 					    NULL, p_dest_alias_guid, p_sgid,
-					    p_dgid, &pr_list);
+					    p_dgid, &resp);
 		else if (!p_src_port && !p_dest_port)
 			/*
 			   Katie, bar the door!
 			 */
 			pr_rcv_process_world(sa, p_sa_mad, requester_port,
-					     p_sgid, p_dgid, &pr_list);
+					     p_sgid, p_dgid, &resp);
 		else if (p_dest_alias_guid && p_src_port) {
 			/* Get all alias GUIDs for the src port */
 			p_src_alias_guid = (osm_alias_guid_t *) cl_qmap_head(&sa->p_subn->alias_port_guid_tbl);
@@ -1917,9 +2706,9 @@ void osm_pr_rcv_process(IN void *context, IN void *data)
 							    p_src_alias_guid,
 							    p_dest_alias_guid,
 							    p_sgid, p_dgid,
-							    &pr_list);
+							    &resp);
 				if (p_sa_mad->method == IB_MAD_METHOD_GET &&
-				    cl_qlist_count(&pr_list) > 0)
+				    osm_sa_resp_count(&resp) > 0)
 					break;
 				p_src_alias_guid = (osm_alias_guid_t *) cl_qmap_next(&p_src_alias_guid->map_item);
 			}
@@ -1935,7 +2724,7 @@ void osm_pr_rcv_process(IN void *context, IN void *data)
 							    requester_port,
 							    p_src_alias_guid,
 							    NULL, p_sgid,
-							    p_dgid, &pr_list);
+							    p_dgid, &resp);
 				p_src_alias_guid = (osm_alias_guid_t *) cl_qmap_next(&p_src_alias_guid->map_item);
 			}
 		} else if (p_dest_port && !p_src_port) {
@@ -1951,7 +2740,7 @@ void osm_pr_rcv_process(IN void *context, IN void *data)
 							    NULL,
 							    p_dest_alias_guid,
 							    p_sgid, p_dgid,
-							    &pr_list);
+							    &resp);
 				p_dest_alias_guid = (osm_alias_guid_t *) cl_qmap_next(&p_dest_alias_guid->map_item);
 			}
 		} else {
@@ -1976,15 +2765,15 @@ void osm_pr_rcv_process(IN void *context, IN void *data)
 								    p_dest_alias_guid,
 								    p_sgid,
 								    p_dgid,
-								    &pr_list);
+								    &resp);
 						if (p_sa_mad->method == IB_MAD_METHOD_GET &&
-						    cl_qlist_count(&pr_list) > 0)
+						    osm_sa_resp_count(&resp) > 0)
 							break;
 						p_dest_alias_guid = (osm_alias_guid_t *) cl_qmap_next(&p_dest_alias_guid->map_item);
 					}
 				}
 				if (p_sa_mad->method == IB_MAD_METHOD_GET &&
-				    cl_qlist_count(&pr_list) > 0)
+				    osm_sa_resp_count(&resp) > 0)
 					break;
 				p_src_alias_guid = (osm_alias_guid_t *) cl_qmap_next(&p_src_alias_guid->map_item);
 			}
@@ -1995,7 +2784,7 @@ Unlock:
 	cl_plock_release(sa->p_lock);
 
 	/* Now, (finally) respond to the PathRecord request */
-	osm_sa_respond(sa, p_madw, sizeof(ib_path_rec_t), &pr_list);
+	osm_sa_resp_send(&resp);
 
 Exit:
 	OSM_LOG_EXIT(sa->p_log);
@@ -144,11 +144,14 @@ static void sm_mad_ctrl_disp_done_callback(IN void *context, IN void *p_data)
  * sm_mad_ctrl_update_wire_stats
  *
  * DESCRIPTION
- * Updates wire stats for outstanding MADs and calls the VL15 poller.
+ * Updates wire stats for outstanding MADs, reports the completion of
+ * the request MAD to the VL15 scheduler and calls the VL15 poller.
  *
  * SYNOPSIS
  */
-static void sm_mad_ctrl_update_wire_stats(IN osm_sm_mad_ctrl_t * p_ctrl)
+static void sm_mad_ctrl_update_wire_stats(IN osm_sm_mad_ctrl_t * p_ctrl,
+					  IN osm_madw_t * p_req_madw,
+					  IN boolean_t timed_out)
 {
 	uint32_t mads_on_wire;
 
@@ -161,6 +164,9 @@ static void sm_mad_ctrl_update_wire_stats(IN osm_sm_mad_ctrl_t * p_ctrl)
 		"%u SMPs on the wire, %u outstanding\n", mads_on_wire,
 		p_ctrl->p_stats->qp0_mads_outstanding);
 
+	if (p_req_madw)
+		osm_vl15_complete(p_ctrl->p_vl15, p_req_madw, timed_out);
+
 	/*
 	   We can signal the VL15 controller to send another MAD
 	   if any are waiting for transmission.
@@ -203,7 +209,7 @@ static void sm_mad_ctrl_process_get_resp(IN osm_sm_mad_ctrl_t * p_ctrl,
 
 	p_old_madw = transaction_context;
 
-	sm_mad_ctrl_update_wire_stats(p_ctrl);
+	sm_mad_ctrl_update_wire_stats(p_ctrl, p_old_madw, FALSE);
 
 	/*
 	   Copy the MAD Wrapper context from the requesting MAD
@@ -523,7 +529,8 @@ Exit:
  * SYNOPSIS
  */
 static void sm_mad_ctrl_process_trap_repress(IN osm_sm_mad_ctrl_t * p_ctrl,
-					     IN osm_madw_t * p_madw)
+					     IN osm_madw_t * p_madw,
+					     IN osm_madw_t * p_req_madw)
 {
 	ib_smp_t *p_smp;
 
@@ -537,7 +544,7 @@ static void sm_mad_ctrl_process_trap_repress(IN osm_sm_mad_ctrl_t * p_ctrl,
 	 */
 	switch (p_smp->attr_id) {
 	case IB_MAD_ATTR_NOTICE:
-		sm_mad_ctrl_update_wire_stats(p_ctrl);
+		sm_mad_ctrl_update_wire_stats(p_ctrl, p_req_madw, FALSE);
 		sm_mad_ctrl_retire_trans_mad(p_ctrl, p_madw);
 		break;
 	default:
@@ -674,7 +681,7 @@ static void sm_mad_ctrl_rcv_callback(IN osm_madw_t * p_madw,
 		break;
 	case IB_MAD_METHOD_TRAP_REPRESS:
 		CL_ASSERT(p_req_madw != NULL);
-		sm_mad_ctrl_process_trap_repress(p_ctrl, p_madw);
+		sm_mad_ctrl_process_trap_repress(p_ctrl, p_madw, p_req_madw);
 		break;
 	case IB_MAD_METHOD_SEND:
 	case IB_MAD_METHOD_REPORT:
@@ -731,6 +738,9 @@ static void sm_mad_ctrl_send_err_cb(IN void *context, IN osm_madw_t * p_madw)
 		ib_get_sm_attr_str(p_smp->attr_id), cl_ntoh32(p_smp->attr_mod),
 		cl_ntoh64(p_smp->trans_id));
 
+	if (p_madw->status == IB_TIMEOUT)
+		cl_atomic_inc(&p_ctrl->p_stats->qp0_mads_timeout);
+
 	/*
 	   If this was a SubnSet MAD, then this error might indicate a problem
 	   in configuring the subnet. In this case - need to mark that there was
@@ -790,7 +800,7 @@ static void sm_mad_ctrl_send_err_cb(IN void *context, IN osm_madw_t * p_madw)
 	   An error occurred.  No response was received to a request MAD.
 	   Retire the original request MAD.
 	 */
-	sm_mad_ctrl_update_wire_stats(p_ctrl);
+	sm_mad_ctrl_update_wire_stats(p_ctrl, p_madw, TRUE);
 
 	if (osm_madw_get_err_msg(p_madw) != CL_DISP_MSGID_NONE) {
 		OSM_LOG(p_ctrl->p_log, OSM_LOG_DEBUG,
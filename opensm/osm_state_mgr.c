@@ -783,6 +783,55 @@ exit:
 	OSM_LOG_EXIT(sm->p_log);
 }
 
+/**********************************************************************
+ During a light sweep, re-read the node description of a node whose
+ description is known, so that changes are noticed on nodes that do not
+ send trap 144.  Unknown descriptions are reissued by
+ state_mgr_get_node_desc already.
+**********************************************************************/
+static void state_mgr_refresh_node_desc(IN cl_map_item_t * obj,
+					IN void *context)
+{
+	osm_node_t *p_node = (osm_node_t *) obj;
+
+	if (p_node->print_desc
+	    && strcmp(p_node->print_desc, OSM_NODE_DESC_UNKNOWN))
+		state_mgr_update_node_desc(obj, context);
+}
+
+/**********************************************************************
+ Apply func to percent percent of the items of p_map, starting after
+ the item keyed *p_key and wrapping around, so that successive calls
+ cover the whole map.  *p_key is updated to the last item visited.
+**********************************************************************/
+static void state_mgr_apply_rolling(IN osm_sm_t * sm, IN cl_qmap_t * p_map,
+				    IN void (*func) (cl_map_item_t *, void *),
+				    IN uint32_t percent, IN OUT uint64_t * p_key)
+{
+	cl_map_item_t *p_item;
+	unsigned count = cl_qmap_count(p_map);
+	unsigned batch;
+
+	if (percent >= 100) {
+		cl_qmap_apply_func(p_map, func, sm);
+		return;
+	}
+
+	batch = (count * percent + 99) / 100;
+	OSM_LOG(sm->p_log, OSM_LOG_DEBUG,
+		"Light sweep visiting %u of %u items after key 0x%016"
+		PRIx64 "\n", batch, count, cl_ntoh64(*p_key));
+
+	p_item = cl_qmap_get_next(p_map, *p_key);
+	while (batch--) {
+		if (p_item == cl_qmap_end(p_map))
+			p_item = cl_qmap_head(p_map);
+		*p_key = cl_qmap_key(p_item);
+		func(p_item, sm);
+		p_item = cl_qmap_next(p_item);
+	}
+}
+
 /**********************************************************************
  Initiates a lightweight sweep of the subnet.
  Used during normal sweeps after the subnet is up.
@@ -799,6 +848,9 @@ static ib_api_status_t state_mgr_light_sweep_start(IN osm_sm_t * sm)
 
 	OSM_LOG_ENTER(sm->p_log);
 
+	osm_sweep_prof_set_type(&sm->sweep_prof, "light");
+	osm_sweep_prof_phase(&sm->sweep_prof, "light_sweep");
+
 	p_sw_tbl = &sm->p_subn->sw_guid_tbl;
 
 	/*
@@ -814,12 +866,19 @@ static ib_api_status_t state_mgr_light_sweep_start(IN osm_sm_t * sm)
 
 	OSM_LOG_MSG_BOX(sm->p_log, OSM_LOG_VERBOSE, "INITIATING LIGHT SWEEP");
 	CL_PLOCK_ACQUIRE(sm->p_lock);
-	cl_qmap_apply_func(p_sw_tbl, state_mgr_get_sw_info, sm);
+	state_mgr_apply_rolling(sm, p_sw_tbl, state_mgr_get_sw_info,
+				sm->p_subn->opt.light_sweep_switch_percent,
+				&sm->light_sweep_sw_key);
 	CL_PLOCK_RELEASE(sm->p_lock);
 
 	CL_PLOCK_ACQUIRE(sm->p_lock);
 	cl_qmap_apply_func(&sm->p_subn->node_guid_tbl, state_mgr_get_node_desc,
 			   sm);
+	if (sm->p_subn->opt.light_sweep_node_desc_percent)
+		state_mgr_apply_rolling(sm, &sm->p_subn->node_guid_tbl,
+					state_mgr_refresh_node_desc,
+					sm->p_subn->opt.light_sweep_node_desc_percent,
+					&sm->light_sweep_nd_key);
 	CL_PLOCK_RELEASE(sm->p_lock);
 
 	/* now scan the list of physical ports that were not down but have no remote port */
@@ -1258,6 +1317,30 @@ int wait_for_pending_transactions(osm_stats_t * stats)
 	return osm_exit_flag;
 }
 
+/*
+ * Waits for outstanding MADs, accounting the time to the current sweep
+ * phase.
+ */
+static int sweep_wait(osm_sm_t * sm)
+{
+	int ret;
+
+	osm_sweep_prof_wait_begin(&sm->sweep_prof);
+	ret = wait_for_pending_transactions(&sm->p_subn->p_osm->stats);
+	osm_sweep_prof_wait_end(&sm->sweep_prof);
+	return ret;
+}
+
+static int sweep_wait_cc(osm_sm_t * sm)
+{
+	int ret;
+
+	osm_sweep_prof_wait_begin(&sm->sweep_prof);
+	ret = osm_congestion_control_wait_pending_transactions(sm->p_subn->p_osm);
+	osm_sweep_prof_wait_end(&sm->sweep_prof);
+	return ret;
+}
+
 static void do_sweep(osm_sm_t * sm)
 {
 	ib_api_status_t status;
@@ -1288,6 +1371,7 @@ static void do_sweep(osm_sm_t * sm)
 		return;
 
 	if (sm->p_subn->coming_out_of_standby) {
+		osm_sweep_prof_phase(&sm->sweep_prof, "standby_cleanup");
 		/*
 		 * Need to force re-write of sm_base_lid to all ports
 		 * to do that we want all the ports to be considered
@@ -1328,7 +1412,7 @@ static void do_sweep(osm_sm_t * sm)
 	    && sm->p_subn->force_reroute == FALSE
 	    && sm->p_subn->subnet_initialization_error == FALSE
 	    && (state_mgr_light_sweep_start(sm) == IB_SUCCESS)) {
-		if (wait_for_pending_transactions(&sm->p_subn->p_osm->stats))
+		if (sweep_wait(sm))
 			return;
 		if (!sm->p_subn->force_heavy_sweep) {
 			if (sm->p_subn->opt.sa_db_dump &&
@@ -1342,6 +1426,14 @@ static void do_sweep(osm_sm_t * sm)
 		}
 	}
 
+	/*
+	 * From here on LIDs, topology or routing may change, so drop the
+	 * cached PathRecord parameters now and again after the sweep,
+	 * including entries computed meanwhile.
+	 */
+	sm->paths_changed = TRUE;
+	osm_sa_pr_cache_invalidate(&sm->p_subn->p_osm->sa);
+
 	/*
 	 * Unicast cache should be invalidated when subnet re-route is
 	 * requested, and when OpenSM comes out of standby state.
@@ -1366,22 +1458,26 @@ static void do_sweep(osm_sm_t * sm)
 		/* Re-program the switches fully */
 		sm->p_subn->ignore_existing_lfts = TRUE;
 
+		osm_sweep_prof_set_type(&sm->sweep_prof, "reroute");
+		osm_sweep_prof_phase(&sm->sweep_prof, "ucast_mgr");
 		if (osm_ucast_mgr_process(&sm->ucast_mgr)) {
 			OSM_LOG_MSG_BOX(sm->p_log, OSM_LOG_VERBOSE,
 					"REROUTE FAILED");
 			return;
 		}
+		osm_sweep_prof_phase(&sm->sweep_prof, "qos_setup");
 		osm_qos_setup(sm->p_subn->p_osm);
 
 		/* Reset flag */
 		sm->p_subn->ignore_existing_lfts = FALSE;
 
-		if (wait_for_pending_transactions(&sm->p_subn->p_osm->stats))
+		if (sweep_wait(sm))
 			return;
 
+		osm_sweep_prof_phase(&sm->sweep_prof, "congestion_control");
 		osm_congestion_control_setup(sm->p_subn->p_osm);
 
-		if (osm_congestion_control_wait_pending_transactions(sm->p_subn->p_osm))
+		if (sweep_wait_cc(sm))
 			return;
 
 		if (!sm->p_subn->subnet_initialization_error) {
@@ -1399,6 +1495,8 @@ static void do_sweep(osm_sm_t * sm)
 
 	/* go to heavy sweep */
 repeat_discovery:
+	osm_sweep_prof_set_type(&sm->sweep_prof, "heavy");
+	osm_sweep_prof_phase(&sm->sweep_prof, "conf_rescan");
 
 	/* First of all - unset all flags */
 	sm->p_subn->force_heavy_sweep = FALSE;
@@ -1420,9 +1518,9 @@ repeat_discovery:
 	if (sm->p_subn->sm_state != IB_SMINFO_STATE_MASTER)
 		sm->p_subn->need_update = 1;
 
+	osm_sweep_prof_phase(&sm->sweep_prof, "discovery_hop0");
 	status = state_mgr_sweep_hop_0(sm);
-	if (status != IB_SUCCESS ||
-	    wait_for_pending_transactions(&sm->p_subn->p_osm->stats))
+	if (status != IB_SUCCESS || sweep_wait(sm))
 		return;
 
 	if (state_mgr_is_sm_port_down(sm) == TRUE) {
@@ -1454,9 +1552,9 @@ repeat_discovery:
 		}
 	}
 
+	osm_sweep_prof_phase(&sm->sweep_prof, "discovery");
 	status = state_mgr_sweep_hop_1(sm);
-	if (status != IB_SUCCESS ||
-	    wait_for_pending_transactions(&sm->p_subn->p_osm->stats))
+	if (status != IB_SUCCESS || sweep_wait(sm))
 		return;
 
 	/* discovery completed - check other sm presence */
@@ -1487,6 +1585,7 @@ repeat_discovery:
 
 	OSM_LOG_MSG_BOX(sm->p_log, OSM_LOG_VERBOSE, "HEAVY SWEEP COMPLETE");
 
+	osm_sweep_prof_phase(&sm->sweep_prof, "drop_mgr");
 	osm_drop_mgr_process(sm);
 
 	/* If we are MASTER - get the highest remote_sm, and
@@ -1536,10 +1635,12 @@ repeat_discovery:
 	if (sm->p_subn->sm_state == IB_SMINFO_STATE_DISCOVERING)
 		osm_sm_state_mgr_process(sm, OSM_SM_SIGNAL_DISCOVERY_COMPLETED);
 
+	osm_sweep_prof_phase(&sm->sweep_prof, "sw_state_change");
 	osm_reset_switch_state_change_bit(sm->p_subn->p_osm);
-	if (wait_for_pending_transactions(&sm->p_subn->p_osm->stats))
+	if (sweep_wait(sm))
 		return;
 
+	osm_sweep_prof_phase(&sm->sweep_prof, "pkey_mgr");
 	osm_pkey_mgr_process(sm->p_subn->p_osm);
 
 	/* try to restore SA DB (this should be before lid_mgr
@@ -1547,22 +1648,24 @@ repeat_discovery:
 	   when SA DB is restored) */
 	osm_sa_db_file_load(sm->p_subn->p_osm);
 
-	if (wait_for_pending_transactions(&sm->p_subn->p_osm->stats))
+	if (sweep_wait(sm))
 		return;
 
 	OSM_LOG_MSG_BOX(sm->p_log, OSM_LOG_VERBOSE,
 			"PKEY setup completed - STARTING SM LID CONFIG");
 
+	osm_sweep_prof_phase(&sm->sweep_prof, "lid_mgr_sm");
 	osm_lid_mgr_process_sm(&sm->lid_mgr);
-	if (wait_for_pending_transactions(&sm->p_subn->p_osm->stats))
+	if (sweep_wait(sm))
 		return;
 
 	OSM_LOG_MSG_BOX(sm->p_log, OSM_LOG_VERBOSE,
 			"SM LID ASSIGNMENT COMPLETE - STARTING SUBNET LID CONFIG");
+	osm_sweep_prof_phase(&sm->sweep_prof, "lid_mgr_subnet");
 	state_mgr_notify_lid_change(sm);
 
 	osm_lid_mgr_process_subnet(&sm->lid_mgr);
-	if (wait_for_pending_transactions(&sm->p_subn->p_osm->stats))
+	if (sweep_wait(sm))
 		return;
 
 	/* At this point we need to check the consistency of
@@ -1579,6 +1682,7 @@ repeat_discovery:
 	 * return early to wait for a trap or the next sweep interval.
 	 */
 
+	osm_sweep_prof_phase(&sm->sweep_prof, "ucast_mgr");
 	if (!sm->ucast_mgr.cache_valid ||
 	    osm_ucast_cache_process(&sm->ucast_mgr)) {
 		if (osm_ucast_mgr_process(&sm->ucast_mgr)) {
@@ -1587,9 +1691,10 @@ repeat_discovery:
 		}
 	}
 
+	osm_sweep_prof_phase(&sm->sweep_prof, "qos_setup");
 	osm_qos_setup(sm->p_subn->p_osm);
 
-	if (wait_for_pending_transactions(&sm->p_subn->p_osm->stats))
+	if (sweep_wait(sm))
 		return;
 
 	/* We are done setting all LFTs so clear the ignore existing.
@@ -1604,15 +1709,17 @@ repeat_discovery:
 				(void *) UCAST_ROUTING_HEAVY_SWEEP);
 
 	if (!sm->p_subn->opt.disable_multicast) {
+		osm_sweep_prof_phase(&sm->sweep_prof, "mcast_mgr");
 		osm_mcast_mgr_process(sm, TRUE);
-		if (wait_for_pending_transactions(&sm->p_subn->p_osm->stats))
+		if (sweep_wait(sm))
 			return;
 		OSM_LOG_MSG_BOX(sm->p_log, OSM_LOG_VERBOSE,
 				"SWITCHES CONFIGURED FOR MULTICAST");
 	}
 
+	osm_sweep_prof_phase(&sm->sweep_prof, "guid_mgr");
 	osm_guid_mgr_process(sm);
-	if (wait_for_pending_transactions(&sm->p_subn->p_osm->stats))
+	if (sweep_wait(sm))
 		return;
 	OSM_LOG_MSG_BOX(sm->p_log, OSM_LOG_VERBOSE, "ALIAS GUIDS CONFIGURED");
 
@@ -1624,22 +1731,25 @@ repeat_discovery:
 	 * other parameters provided by the Set(PortInfo) Packet.
 	 */
 
+	osm_sweep_prof_phase(&sm->sweep_prof, "link_mgr_init");
 	osm_link_mgr_process(sm, IB_LINK_NO_CHANGE);
-	if (wait_for_pending_transactions(&sm->p_subn->p_osm->stats))
+	if (sweep_wait(sm))
 		return;
 
 	OSM_LOG_MSG_BOX(sm->p_log, OSM_LOG_VERBOSE,
 			"LINKS PORTS CONFIGURED - SET LINKS TO ARMED STATE");
 
+	osm_sweep_prof_phase(&sm->sweep_prof, "link_mgr_armed");
 	osm_link_mgr_process(sm, IB_LINK_ARMED);
-	if (wait_for_pending_transactions(&sm->p_subn->p_osm->stats))
+	if (sweep_wait(sm))
 		return;
 
 	OSM_LOG_MSG_BOX(sm->p_log, OSM_LOG_VERBOSE,
 			"LINKS ARMED - SET LINKS TO ACTIVE STATE");
 
+	osm_sweep_prof_phase(&sm->sweep_prof, "link_mgr_active");
 	osm_link_mgr_process(sm, IB_LINK_ACTIVE);
-	if (wait_for_pending_transactions(&sm->p_subn->p_osm->stats))
+	if (sweep_wait(sm))
 		return;
 
 	/*
@@ -1648,11 +1758,14 @@ repeat_discovery:
 
 	/* Now do GSI configuration */
 
+	osm_sweep_prof_phase(&sm->sweep_prof, "congestion_control");
 	osm_congestion_control_setup(sm->p_subn->p_osm);
 
-	if (osm_congestion_control_wait_pending_transactions(sm->p_subn->p_osm))
+	if (sweep_wait_cc(sm))
 		return;
 
+	osm_sweep_prof_phase(&sm->sweep_prof, "finalize");
+
 	/*
 	 * Send trap 64 on newly discovered endports
 	 */
@@ -1737,8 +1850,17 @@ void osm_state_mgr_process(IN osm_sm_t * sm, IN osm_signal_t signal)
 				"ignoring signal %s in state %s\n",
 				osm_get_sm_signal_str(signal),
 				osm_get_sm_mgr_state_str(sm->p_subn->sm_state));
-		} else
+		} else {
 			do_sweep(sm);
+			osm_sweep_prof_sweep_done(&sm->sweep_prof);
+			if (sm->paths_changed) {
+				sm->paths_changed = FALSE;
+				osm_sa_pr_cache_invalidate(&sm->p_subn->p_osm->sa);
+				CL_PLOCK_EXCL_ACQUIRE(sm->p_lock);
+				osm_sa_pr_summary_update(&sm->p_subn->p_osm->sa);
+				CL_PLOCK_RELEASE(sm->p_lock);
+			}
+		}
 		break;
 	case OSM_SIGNAL_IDLE_TIME_PROCESS_REQUEST:
 		do_process_mgrp_queue(sm);
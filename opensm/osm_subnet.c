@@ -189,9 +189,11 @@ static const char *module_name_str[] = {
 	"osm_congestion_control.c",
 	"osm_ucast_nue.c",
     "osm_ucast_lnmp.c",
+	"osm_db_bin.c",
+	"osm_sweep_prof.c",
 	/* Add new module names here ... */
 	/* FILE_ID define in those modules must be identical to index here */
-	/* last FILE_ID is currently 91 */
+	/* last FILE_ID is currently 93 */
 };
 
 #define MOD_NAME_STR_UNKNOWN_VAL (ARR_SIZE(module_name_str))
@@ -773,6 +775,10 @@ static const opt_rec_t opt_tbl[] = {
 	{ "max_wire_smps", OPT_OFFSET(max_wire_smps), opts_parse_uint32, NULL, 1 },
 	{ "max_wire_smps2", OPT_OFFSET(max_wire_smps2), opts_parse_uint32, NULL, 1 },
 	{ "max_smps_timeout", OPT_OFFSET(max_smps_timeout), opts_parse_uint32, NULL, 1 },
+	{ "max_wire_smps_per_target", OPT_OFFSET(max_wire_smps_per_target), opts_parse_uint32, NULL, 0 },
+	{ "mad_pool_prealloc", OPT_OFFSET(mad_pool_prealloc), opts_parse_uint32, NULL, 0 },
+	{ "lft_window", OPT_OFFSET(lft_window), opts_parse_uint32, NULL, 1 },
+	{ "lft_lid_routed", OPT_OFFSET(lft_lid_routed), opts_parse_boolean, NULL, 1 },
 	{ "console", OPT_OFFSET(console), opts_parse_charp, NULL, 0 },
 	{ "console_port", OPT_OFFSET(console_port), opts_parse_uint16, NULL, 0 },
 	{ "transaction_timeout", OPT_OFFSET(transaction_timeout), opts_parse_uint32, NULL, 0 },
@@ -809,12 +815,17 @@ static const opt_rec_t opt_tbl[] = {
 	{ "port_search_ordering_file", OPT_OFFSET(port_search_ordering_file), opts_parse_charp, NULL, 0 },
 	{ "port_profile_switch_nodes", OPT_OFFSET(port_profile_switch_nodes), opts_parse_boolean, NULL, 1 },
 	{ "sweep_on_trap", OPT_OFFSET(sweep_on_trap), opts_parse_boolean, NULL, 1 },
+	{ "sweep_profile_history", OPT_OFFSET(sweep_profile_history), opts_parse_uint32, NULL, 0 },
+	{ "light_sweep_switch_percent", OPT_OFFSET(light_sweep_switch_percent), opts_parse_uint32, NULL, 1 },
+	{ "light_sweep_node_desc_percent", OPT_OFFSET(light_sweep_node_desc_percent), opts_parse_uint32, NULL, 1 },
 	{ "routing_engine", OPT_OFFSET(routing_engine_names), opts_parse_charp, NULL, 0 },
 	{ "avoid_throttled_links", OPT_OFFSET(avoid_throttled_links), opts_parse_boolean, NULL, 0 },
+	{ "routing_threads", OPT_OFFSET(routing_threads), opts_parse_uint32, NULL, 1 },
 	{ "connect_roots", OPT_OFFSET(connect_roots), opts_parse_boolean, NULL, 1 },
 	{ "use_ucast_cache", OPT_OFFSET(use_ucast_cache), opts_parse_boolean, NULL, 0 },
 	{ "log_file", OPT_OFFSET(log_file), opts_parse_charp, NULL, 0 },
 	{ "log_max_size", OPT_OFFSET(log_max_size), opts_parse_uint32, opts_setup_log_max_size, 1 },
+	{ "log_async_ring_size", OPT_OFFSET(log_async_ring_size), opts_parse_uint32, NULL, 0 },
 	{ "log_flags", OPT_OFFSET(log_flags), opts_parse_uint8, opts_setup_log_flags, 1 },
 	{ "force_log_flush", OPT_OFFSET(force_log_flush), opts_parse_boolean, opts_setup_force_log_flush, 1 },
 	{ "accum_log_file", OPT_OFFSET(accum_log_file), opts_parse_boolean, opts_setup_accum_log_file, 1 },
@@ -841,6 +852,9 @@ static const opt_rec_t opt_tbl[] = {
 	{ "guid_routing_order_no_scatter", OPT_OFFSET(guid_routing_order_no_scatter), opts_parse_boolean, NULL, 0 },
 	{ "sa_db_file", OPT_OFFSET(sa_db_file), opts_parse_charp, NULL, 0 },
 	{ "sa_db_dump", OPT_OFFSET(sa_db_dump), opts_parse_boolean, NULL, 1 },
+	{ "sa_pr_cache_size", OPT_OFFSET(sa_pr_cache_size), opts_parse_uint32, NULL, 0 },
+	{ "sa_pr_path_summary", OPT_OFFSET(sa_pr_path_summary), opts_parse_boolean, NULL, 1 },
+	{ "sa_pr_threads", OPT_OFFSET(sa_pr_threads), opts_parse_uint32, NULL, 0 },
 	{ "torus_config", OPT_OFFSET(torus_conf_file), opts_parse_charp, NULL, 1 },
 	{ "lnmp_config", OPT_OFFSET(lnmp_conf_file), opts_parse_charp, NULL, 1 },
 	{ "do_mesh_analysis", OPT_OFFSET(do_mesh_analysis), opts_parse_boolean, NULL, 1 },
@@ -855,6 +869,7 @@ static const opt_rec_t opt_tbl[] = {
 	{ "use_original_extended_sa_rates_only", OPT_OFFSET(use_original_extended_sa_rates_only), opts_parse_boolean, NULL, 1 },
 	{ "use_optimized_slvl", OPT_OFFSET(use_optimized_slvl), opts_parse_boolean, NULL, 1 },
 	{ "fsync_high_avail_files", OPT_OFFSET(fsync_high_avail_files), opts_parse_boolean, NULL, 1 },
+	{ "db_backend", OPT_OFFSET(db_backend), opts_parse_charp, NULL, 0 },
 #ifdef ENABLE_OSM_PERF_MGR
 	{ "perfmgr", OPT_OFFSET(perfmgr), opts_parse_boolean, NULL, 0 },
 	{ "perfmgr_redir", OPT_OFFSET(perfmgr_redir), opts_parse_boolean, NULL, 0 },
@@ -867,6 +882,9 @@ static const opt_rec_t opt_tbl[] = {
 	{ "perfmgr_query_cpi", OPT_OFFSET(perfmgr_query_cpi), opts_parse_boolean, NULL, 0 },
 	{ "perfmgr_xmit_wait_log", OPT_OFFSET(perfmgr_xmit_wait_log), opts_parse_boolean, NULL, 0 },
 	{ "perfmgr_xmit_wait_threshold", OPT_OFFSET(perfmgr_xmit_wait_threshold), opts_parse_uint32, NULL, 0 },
+	{ "perfmgr_history_size", OPT_OFFSET(perfmgr_history_size), opts_parse_uint32, NULL, 0 },
+	{ "perfmgr_history_max_mem", OPT_OFFSET(perfmgr_history_max_mem), opts_parse_uint32, NULL, 0 },
+	{ "perfmgr_db_file", OPT_OFFSET(perfmgr_db_file), opts_parse_charp, NULL, 0 },
 #endif				/* ENABLE_OSM_PERF_MGR */
 	{ "event_plugin_name", OPT_OFFSET(event_plugin_name), opts_parse_charp, NULL, 0 },
 	{ "event_plugin_options", OPT_OFFSET(event_plugin_options), opts_parse_charp, NULL, 0 },
@@ -922,6 +940,7 @@ static const opt_rec_t opt_tbl[] = {
 	{ "sm_sl", OPT_OFFSET(sm_sl), opts_parse_uint8, NULL, 1 },
 	{ "nue_max_num_vls", OPT_OFFSET(nue_max_num_vls), opts_parse_uint8, NULL, 1 },
 	{ "nue_include_switches", OPT_OFFSET(nue_include_switches), opts_parse_boolean, NULL, 0 },
+	{ "nue_incremental_reroute", OPT_OFFSET(nue_incremental_reroute), opts_parse_boolean, NULL, 1 },
 	{ "log_prefix", OPT_OFFSET(log_prefix), opts_parse_charp, NULL, 1 },
 	{ "per_module_logging_file", OPT_OFFSET(per_module_logging_file), opts_parse_charp, NULL, 0 },
 	{ "quasi_ftree_indexing", OPT_OFFSET(quasi_ftree_indexing), opts_parse_boolean, NULL, 1 },
@@ -1094,6 +1113,7 @@ static void subn_destroy_qos_options(osm_qos_options_t *opt)
 static void subn_opt_destroy(IN osm_subn_opt_t * p_opt)
 {
 	free(p_opt->console);
+	free(p_opt->db_backend);
 	free(p_opt->port_prof_ignore_file);
 	free(p_opt->hop_weights_file);
 	free(p_opt->port_search_ordering_file);
@@ -1115,6 +1135,7 @@ static void subn_opt_destroy(IN osm_subn_opt_t * p_opt)
     free(p_opt->lnmp_conf_file);
 #ifdef ENABLE_OSM_PERF_MGR
 	free(p_opt->event_db_dump_file);
+	free(p_opt->perfmgr_db_file);
 #endif /* ENABLE_OSM_PERF_MGR */
 	free(p_opt->event_plugin_name);
 	free(p_opt->event_plugin_options);
@@ -1567,6 +1588,10 @@ void osm_subn_set_default_opt(IN osm_subn_opt_t * p_opt)
 	p_opt->long_transaction_timeout = OSM_DEFAULT_LONG_TRANS_TIMEOUT_MILLISEC;
 	p_opt->max_smps_timeout = 1000 * p_opt->transaction_timeout *
 				  p_opt->transaction_retries;
+	p_opt->max_wire_smps_per_target = 0;
+	p_opt->mad_pool_prealloc = OSM_DEFAULT_MAD_POOL_PREALLOC;
+	p_opt->lft_window = OSM_DEFAULT_LFT_WINDOW;
+	p_opt->lft_lid_routed = FALSE;
 	/* by default we will consider waiting for 50x transaction timeout normal */
 	p_opt->max_msg_fifo_timeout = 50 * OSM_DEFAULT_TRANS_TIMEOUT_MILLISEC;
 	p_opt->sm_priority = OSM_DEFAULT_SM_PRIORITY;
@@ -1607,6 +1632,7 @@ void osm_subn_set_default_opt(IN osm_subn_opt_t * p_opt)
 	p_opt->use_original_extended_sa_rates_only = FALSE;
 	p_opt->use_optimized_slvl = FALSE;
 	p_opt->fsync_high_avail_files = TRUE;
+	p_opt->db_backend = strdup(OSM_DEFAULT_DB_BACKEND);
 #ifdef ENABLE_OSM_PERF_MGR
 	p_opt->perfmgr = FALSE;
 	p_opt->perfmgr_redir = TRUE;
@@ -1620,6 +1646,9 @@ void osm_subn_set_default_opt(IN osm_subn_opt_t * p_opt)
 	p_opt->perfmgr_query_cpi = TRUE;
 	p_opt->perfmgr_xmit_wait_log = FALSE;
 	p_opt->perfmgr_xmit_wait_threshold = OSM_PERFMGR_DEFAULT_XMIT_WAIT_THRESHOLD;
+	p_opt->perfmgr_history_size = OSM_PERFMGR_DEFAULT_HISTORY_SIZE;
+	p_opt->perfmgr_history_max_mem = OSM_PERFMGR_DEFAULT_HISTORY_MAX_MEM;
+	p_opt->perfmgr_db_file = NULL;
 #endif				/* ENABLE_OSM_PERF_MGR */
 
 	p_opt->event_plugin_name = NULL;
@@ -1633,6 +1662,7 @@ void osm_subn_set_default_opt(IN osm_subn_opt_t * p_opt)
 		p_opt->dump_files_dir = strdup(p_opt->dump_files_dir);
 	p_opt->log_file = strdup(OSM_DEFAULT_LOG_FILE);
 	p_opt->log_max_size = 0;
+	p_opt->log_async_ring_size = 0;
 	p_opt->partition_config_file = strdup(OSM_DEFAULT_PARTITION_CONFIG_FILE);
 	p_opt->no_partition_enforcement = FALSE;
 	p_opt->part_enforce = strdup(OSM_PARTITION_ENFORCE_BOTH);
@@ -1648,9 +1678,14 @@ void osm_subn_set_default_opt(IN osm_subn_opt_t * p_opt)
 	p_opt->port_search_ordering_file = NULL;
 	p_opt->port_profile_switch_nodes = FALSE;
 	p_opt->sweep_on_trap = TRUE;
+	p_opt->sweep_profile_history = OSM_DEFAULT_SWEEP_PROFILE_HISTORY;
+	p_opt->light_sweep_switch_percent =
+	    OSM_DEFAULT_LIGHT_SWEEP_SWITCH_PERCENT;
+	p_opt->light_sweep_node_desc_percent = 0;
 	p_opt->use_ucast_cache = FALSE;
 	p_opt->routing_engine_names = NULL;
 	p_opt->avoid_throttled_links = FALSE;
+	p_opt->routing_threads = 1;
 	p_opt->connect_roots = FALSE;
 	p_opt->lid_matrix_dump_file = NULL;
 	p_opt->lfts_file = NULL;
@@ -1665,6 +1700,9 @@ void osm_subn_set_default_opt(IN osm_subn_opt_t * p_opt)
 	p_opt->guid_routing_order_no_scatter = FALSE;
 	p_opt->sa_db_file = NULL;
 	p_opt->sa_db_dump = FALSE;
+	p_opt->sa_pr_cache_size = 0;
+	p_opt->sa_pr_path_summary = FALSE;
+	p_opt->sa_pr_threads = 1;
 	p_opt->torus_conf_file = strdup(OSM_DEFAULT_TORUS_CONF_FILE);
 	p_opt->lnmp_conf_file = strdup(OSM_DEFAULT_LNMP_CONF_FILE);
 	p_opt->do_mesh_analysis = FALSE;
@@ -1680,6 +1718,7 @@ void osm_subn_set_default_opt(IN osm_subn_opt_t * p_opt)
 	p_opt->sm_sl = OSM_DEFAULT_SL;
 	p_opt->nue_max_num_vls = 1;
 	p_opt->nue_include_switches = FALSE;
+	p_opt->nue_incremental_reroute = FALSE;
 	p_opt->log_prefix = NULL;
 	p_opt->per_module_logging_file = strdup(OSM_DEFAULT_PER_MOD_LOGGING_CONF_FILE);
 	subn_init_qos_options(&p_opt->qos_options, NULL);
@@ -2130,6 +2169,17 @@ int osm_subn_verify_config(IN osm_subn_opt_t * p_opts)
 		p_opts->console = strdup(OSM_DEFAULT_CONSOLE);
 	}
 
+	if (!p_opts->db_backend ||
+	    (strcmp(p_opts->db_backend, OSM_DEFAULT_DB_BACKEND)
+	     && strcmp(p_opts->db_backend, OSM_BINARY_DB_BACKEND))) {
+		log_report(" Invalid Cached Option Value:db_backend = %s"
+			   ", Using Default:%s\n",
+			   p_opts->db_backend ? p_opts->db_backend : null_str,
+			   OSM_DEFAULT_DB_BACKEND);
+		free(p_opts->db_backend);
+		p_opts->db_backend = strdup(OSM_DEFAULT_DB_BACKEND);
+	}
+
 	if (p_opts->no_partition_enforcement == TRUE) {
 		strcpy(p_opts->part_enforce, OSM_PARTITION_ENFORCE_OFF);
 		p_opts->part_enforce_enum = OSM_PARTITION_ENFORCE_TYPE_OFF;
@@ -2178,6 +2228,23 @@ int osm_subn_verify_config(IN osm_subn_opt_t * p_opts)
 	}
 #endif
 
+	if (!p_opts->light_sweep_switch_percent ||
+	    p_opts->light_sweep_switch_percent > 100) {
+		log_report(" Invalid Cached Option Value:"
+			   "light_sweep_switch_percent = %u Using Default:%u\n",
+			   p_opts->light_sweep_switch_percent,
+			   OSM_DEFAULT_LIGHT_SWEEP_SWITCH_PERCENT);
+		p_opts->light_sweep_switch_percent =
+		    OSM_DEFAULT_LIGHT_SWEEP_SWITCH_PERCENT;
+	}
+	if (p_opts->light_sweep_node_desc_percent > 100) {
+		log_report(" Invalid Cached Option Value:"
+			   "light_sweep_node_desc_percent = %u Setting to %u "
+			   "instead\n", p_opts->light_sweep_node_desc_percent,
+			   100);
+		p_opts->light_sweep_node_desc_percent = 100;
+	}
+
 	if (p_opts->m_key_protect_bits > 3) {
 		log_report(" Invalid Cached Option Value:"
 			   "m_key_protection_level = %u Setting to %u "
@@ -2555,11 +2622,23 @@ void osm_subn_output_conf(FILE *out, IN osm_subn_opt_t * p_opts)
 		"force_heavy_sweep %s\n\n"
 		"# If TRUE every trap 128 and 144 will cause a heavy sweep.\n"
 		"# NOTE: successive identical traps (>10) are suppressed\n"
-		"sweep_on_trap %s\n\n",
+		"sweep_on_trap %s\n\n"
+		"# Number of sweeps whose per phase profile is kept for the\n"
+		"# console \"perf sweep\" command (0 disables it)\n"
+		"sweep_profile_history %u\n\n"
+		"# Percentage of the switches polled for SwitchInfo by each\n"
+		"# light sweep, round robin (100 polls all of them)\n"
+		"light_sweep_switch_percent %u\n\n"
+		"# Percentage of the nodes whose NodeDescription is re-read by\n"
+		"# each light sweep, round robin (0 only re-reads unknown ones)\n"
+		"light_sweep_node_desc_percent %u\n\n",
 		p_opts->sweep_interval,
 		p_opts->reassign_lids ? "TRUE" : "FALSE",
 		p_opts->force_heavy_sweep ? "TRUE" : "FALSE",
-		p_opts->sweep_on_trap ? "TRUE" : "FALSE");
+		p_opts->sweep_on_trap ? "TRUE" : "FALSE",
+		p_opts->sweep_profile_history,
+		p_opts->light_sweep_switch_percent,
+		p_opts->light_sweep_node_desc_percent);
 
 	fprintf(out,
 		"#\n# ROUTING OPTIONS\n#\n"
@@ -2599,6 +2678,13 @@ void osm_subn_output_conf(FILE *out, IN osm_subn_opt_t * p_opts)
 		"avoid_throttled_links %s\n\n",
 		p_opts->avoid_throttled_links ? "TRUE" : "FALSE");
 
+	fprintf(out,
+		"# Number of threads for the route computation\n"
+		"# (supported by: nue, updn, dnup; 1 computes the routes sequentially,\n"
+		"# 0 uses one thread per processor)\n"
+		"routing_threads %u\n\n",
+		p_opts->routing_threads);
+
 	fprintf(out,
 		"# Connect roots (use FALSE if unsure)\n"
 		"connect_roots %s\n\n",
@@ -2686,6 +2772,14 @@ void osm_subn_output_conf(FILE *out, IN osm_subn_opt_t * p_opts)
 		"nue_include_switches %s\n\n",
 		p_opts->nue_include_switches ? "TRUE" : "FALSE");
 
+	fprintf(out,
+		"# If TRUE, then Nue keeps the paths of the last run and only\n"
+		"# reroutes destinations whose paths used a vanished link or\n"
+		"# switch (falls back to a full run if the fabric grew or\n"
+		"# deadlock-freedom cannot be guaranteed otherwise)\n"
+		"nue_incremental_reroute %s\n\n",
+		p_opts->nue_incremental_reroute ? "TRUE" : "FALSE");
+
 	fprintf(out,
 		"# Port Shifting (use FALSE if unsure)\n"
 		"port_shifting %s\n\n",
@@ -2713,6 +2807,24 @@ void osm_subn_output_conf(FILE *out, IN osm_subn_opt_t * p_opts)
 		"sa_db_dump %s\n\n",
 		p_opts->sa_db_dump ? "TRUE" : "FALSE");
 
+	fprintf(out,
+		"# Number of entries in the SA PathRecord parameter cache\n"
+		"# (0 disables the cache)\n"
+		"sa_pr_cache_size %u\n\n",
+		p_opts->sa_pr_cache_size);
+
+	fprintf(out,
+		"# If TRUE, summarize the routed paths between switches after\n"
+		"# each rerouting to answer PathRecord queries without walking them\n"
+		"sa_pr_path_summary %s\n\n",
+		p_opts->sa_pr_path_summary ? "TRUE" : "FALSE");
+
+	fprintf(out,
+		"# Number of threads evaluating PathRecord queries over the\n"
+		"# whole or half of the fabric (0 is one per CPU, 1 is serial)\n"
+		"sa_pr_threads %u\n\n",
+		p_opts->sa_pr_threads);
+
 	fprintf(out,
 		"# Torus-2QoS configuration file name\ntorus_config %s\n\n",
 		p_opts->torus_conf_file ? p_opts->torus_conf_file : null_str);
@@ -2751,6 +2863,17 @@ void osm_subn_output_conf(FILE *out, IN osm_subn_opt_t * p_opts)
 		"# The timeout in [usec] used for sending SMPs above max_wire_smps limit\n"
 		"# and below max_wire_smps2 limit\n"
 		"max_smps_timeout %u\n\n"
+		"# Maximum number of SMPs outstanding to one target (DR path or LID)\n"
+		"# SMPs are sent round robin across the targets and each target's\n"
+		"# window adapts to its response time (0 keeps a single FIFO)\n"
+		"max_wire_smps_per_target %u\n\n"
+		"# Number of MAD wrappers allocated by the MAD pool at startup\n"
+		"mad_pool_prealloc %u\n\n"
+		"# Maximum number of LFT blocks outstanding per switch\n"
+		"# (0 sends all the blocks at once)\n"
+		"lft_window %u\n\n"
+		"# Send LFT blocks LID routed to switches already reachable by LID\n"
+		"lft_lid_routed %s\n\n"
 		"# The maximum time in [msec] allowed for a transaction to complete\n"
 		"transaction_timeout %u\n\n"
 		"# The maximum number of retries allowed for a transaction to complete\n"
@@ -2768,6 +2891,10 @@ void osm_subn_output_conf(FILE *out, IN osm_subn_opt_t * p_opts)
 		p_opts->max_wire_smps,
 		p_opts->max_wire_smps2,
 		p_opts->max_smps_timeout,
+		p_opts->max_wire_smps_per_target,
+		p_opts->mad_pool_prealloc,
+		p_opts->lft_window,
+		p_opts->lft_lid_routed ? "TRUE" : "FALSE",
 		p_opts->transaction_timeout,
 		p_opts->transaction_retries,
 		p_opts->long_transaction_timeout,
@@ -2799,7 +2926,11 @@ void osm_subn_output_conf(FILE *out, IN osm_subn_opt_t * p_opts)
 		"# Use Optimized SLtoVLMapping programming if supported by device\n"
 		"use_optimized_slvl %s\n\n"
 		"# Sync in memory files used for high availability with storage\n"
-		"fsync_high_avail_files %s\n\n",
+		"fsync_high_avail_files %s\n\n"
+		"# Format of the guid2lid, guid2mkey and neighbors files [text|binary]\n"
+		"# The binary files are imported from the text files the first\n"
+		"# time; the console db_export command writes them back to text\n"
+		"db_backend %s\n\n",
 		p_opts->daemon ? "TRUE" : "FALSE",
 		p_opts->sm_inactive ? "TRUE" : "FALSE",
 		p_opts->babbling_port_policy ? "TRUE" : "FALSE",
@@ -2808,7 +2939,8 @@ void osm_subn_output_conf(FILE *out, IN osm_subn_opt_t * p_opts)
 		p_opts->mcgroup_join_validation ? "TRUE" : "FALSE",
 		p_opts->use_original_extended_sa_rates_only ? "TRUE" : "FALSE",
 		p_opts->use_optimized_slvl ? "TRUE" : "FALSE",
-		p_opts->fsync_high_avail_files ? "TRUE" : "FALSE");
+		p_opts->fsync_high_avail_files ? "TRUE" : "FALSE",
+		p_opts->db_backend);
 
 #ifdef ENABLE_OSM_PERF_MGR
 	fprintf(out,
@@ -2837,6 +2969,14 @@ void osm_subn_output_conf(FILE *out, IN osm_subn_opt_t * p_opts)
 		"perfmgr_xmit_wait_log %s\n\n"
 		"# If logging xmit_wait's; set threshold (default %u)\n"
 		"perfmgr_xmit_wait_threshold %u\n\n"
+		"# Number of sweeps of counter deltas kept per port for\n"
+		"# rates and percentiles; 0 disables (default %u)\n"
+		"perfmgr_history_size %u\n\n"
+		"# Memory budget in MB for the counter history (default %u)\n"
+		"perfmgr_history_max_mem %u\n\n"
+		"# File keeping the counter totals across restarts\n"
+		"# (default (null), not kept)\n"
+		"perfmgr_db_file %s\n\n"
 		,
 		p_opts->perfmgr ? "TRUE" : "FALSE",
 		p_opts->perfmgr_redir ? "TRUE" : "FALSE",
@@ -2850,7 +2990,12 @@ void osm_subn_output_conf(FILE *out, IN osm_subn_opt_t * p_opts)
 		p_opts->perfmgr_query_cpi ? "TRUE" : "FALSE",
 		p_opts->perfmgr_xmit_wait_log ? "TRUE" : "FALSE",
 		OSM_PERFMGR_DEFAULT_XMIT_WAIT_THRESHOLD,
-		p_opts->perfmgr_xmit_wait_threshold);
+		p_opts->perfmgr_xmit_wait_threshold,
+		OSM_PERFMGR_DEFAULT_HISTORY_SIZE,
+		p_opts->perfmgr_history_size,
+		OSM_PERFMGR_DEFAULT_HISTORY_MAX_MEM,
+		p_opts->perfmgr_history_max_mem,
+		p_opts->perfmgr_db_file ? p_opts->perfmgr_db_file : null_str);
 
 	fprintf(out,
 		"#\n# Event DB Options\n#\n"
@@ -2886,6 +3031,9 @@ void osm_subn_output_conf(FILE *out, IN osm_subn_opt_t * p_opts)
 		"log_file %s\n\n"
 		"# Limit the size of the log file in MB. If overrun, log is restarted\n"
 		"log_max_size %u\n\n"
+		"# Size in KB of the per thread ring of the asynchronous log\n"
+		"# writer; messages not fitting are dropped (0 = synchronous)\n"
+		"log_async_ring_size %u\n\n"
 		"# If TRUE will accumulate the log over multiple OpenSM sessions\n"
 		"accum_log_file %s\n\n"
 		"# Per module logging configuration file\n"
@@ -2920,6 +3068,7 @@ void osm_subn_output_conf(FILE *out, IN osm_subn_opt_t * p_opts)
 		p_opts->force_log_flush ? "TRUE" : "FALSE",
 		p_opts->log_file,
 		p_opts->log_max_size,
+		p_opts->log_async_ring_size,
 		p_opts->accum_log_file ? "TRUE" : "FALSE",
 		p_opts->per_module_logging_file ?
 			p_opts->per_module_logging_file : null_str,
@@ -0,0 +1,359 @@
+/*
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * Abstract:
+ *    Implementation of osm_sweep_prof_t.
+ * This object records the phases of the last sweeps.
+ * This object is part of the opensm family of objects.
+ */
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif				/* HAVE_CONFIG_H */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <complib/cl_timer.h>
+#include <opensm/osm_file_ids.h>
+#define FILE_ID OSM_FILE_SWEEP_PROF_C
+#include <opensm/osm_sweep_prof.h>
+
+static uint64_t cpu_time_us(IN clockid_t clock)
+{
+	struct timespec ts;
+
+	if (clock_gettime(clock, &ts))
+		return 0;
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void prof_sample(IN osm_sweep_prof_t * p_prof)
+{
+	p_prof->thread_cpu0 = cpu_time_us(CLOCK_THREAD_CPUTIME_ID);
+	p_prof->proc_cpu0 = cpu_time_us(CLOCK_PROCESS_CPUTIME_ID);
+	p_prof->sent0 = p_prof->p_stats->qp0_mads_sent;
+	p_prof->rcvd0 = p_prof->p_stats->qp0_mads_rcvd;
+	p_prof->timeout0 = p_prof->p_stats->qp0_mads_timeout;
+}
+
+static void prof_close_phase(IN osm_sweep_prof_t * p_prof,
+			     IN uint64_t now)
+{
+	osm_sweep_rec_t *p_rec = &p_prof->cur;
+	osm_sweep_phase_t *p_phase;
+
+	if (!p_prof->active)
+		return;
+
+	if (p_prof->wait_start)
+		osm_sweep_prof_wait_end(p_prof);
+
+	/* an overflowing phase keeps accumulating into the last slot */
+	p_phase = &p_rec->phases[p_rec->num_phases - 1];
+	p_phase->wall_us = now - p_phase->start;
+	p_phase->thread_cpu_us +=
+	    cpu_time_us(CLOCK_THREAD_CPUTIME_ID) - p_prof->thread_cpu0;
+	p_phase->proc_cpu_us +=
+	    cpu_time_us(CLOCK_PROCESS_CPUTIME_ID) - p_prof->proc_cpu0;
+	p_phase->mads_sent += p_prof->p_stats->qp0_mads_sent - p_prof->sent0;
+	p_phase->mads_rcvd += p_prof->p_stats->qp0_mads_rcvd - p_prof->rcvd0;
+	p_phase->mads_timeout +=
+	    p_prof->p_stats->qp0_mads_timeout - p_prof->timeout0;
+
+	p_rec->wall_us = now - p_rec->start;
+	p_prof->active = FALSE;
+}
+
+void osm_sweep_prof_construct(IN osm_sweep_prof_t * p_prof)
+{
+	memset(p_prof, 0, sizeof(*p_prof));
+	cl_spinlock_construct(&p_prof->lock);
+}
+
+ib_api_status_t osm_sweep_prof_init(IN osm_sweep_prof_t * p_prof,
+				    IN osm_stats_t * p_stats,
+				    IN unsigned history)
+{
+	p_prof->p_stats = p_stats;
+	p_prof->history = history;
+
+	if (cl_spinlock_init(&p_prof->lock) != CL_SUCCESS)
+		return IB_ERROR;
+
+	if (history) {
+		p_prof->recs = calloc(history, sizeof(*p_prof->recs));
+		if (!p_prof->recs)
+			return IB_INSUFFICIENT_MEMORY;
+	}
+
+	return IB_SUCCESS;
+}
+
+void osm_sweep_prof_destroy(IN osm_sweep_prof_t * p_prof)
+{
+	free(p_prof->recs);
+	p_prof->recs = NULL;
+	p_prof->history = 0;
+	cl_spinlock_destroy(&p_prof->lock);
+}
+
+void osm_sweep_prof_phase(IN osm_sweep_prof_t * p_prof, IN const char *name)
+{
+	osm_sweep_rec_t *p_rec = &p_prof->cur;
+	osm_sweep_phase_t *p_phase;
+	uint64_t now;
+
+	if (!p_prof->history)
+		return;
+
+	now = cl_get_time_stamp();
+	prof_close_phase(p_prof, now);
+
+	if (!p_rec->num_phases) {
+		p_rec->seq = ++p_prof->seq;
+		p_rec->start = now;
+		if (!p_rec->type)
+			p_rec->type = "heavy";
+	}
+
+	if (p_rec->num_phases < OSM_SWEEP_PROF_MAX_PHASES) {
+		p_phase = &p_rec->phases[p_rec->num_phases++];
+		memset(p_phase, 0, sizeof(*p_phase));
+		p_phase->name = name;
+		p_phase->start = now;
+	} else
+		p_rec->phases[p_rec->num_phases - 1].name = "(more)";
+
+	prof_sample(p_prof);
+	p_prof->active = TRUE;
+}
+
+void osm_sweep_prof_set_type(IN osm_sweep_prof_t * p_prof,
+			     IN const char *type)
+{
+	p_prof->cur.type = type;
+}
+
+void osm_sweep_prof_wait_begin(IN osm_sweep_prof_t * p_prof)
+{
+	if (p_prof->active)
+		p_prof->wait_start = cl_get_time_stamp();
+}
+
+void osm_sweep_prof_wait_end(IN osm_sweep_prof_t * p_prof)
+{
+	osm_sweep_rec_t *p_rec = &p_prof->cur;
+
+	if (!p_prof->active || !p_prof->wait_start)
+		return;
+
+	p_rec->phases[p_rec->num_phases - 1].wait_us +=
+	    cl_get_time_stamp() - p_prof->wait_start;
+	p_prof->wait_start = 0;
+}
+
+void osm_sweep_prof_sweep_done(IN osm_sweep_prof_t * p_prof)
+{
+	osm_sweep_rec_t *p_rec = &p_prof->cur;
+
+	if (!p_prof->history)
+		return;
+
+	prof_close_phase(p_prof, cl_get_time_stamp());
+
+	if (p_rec->num_phases) {
+		cl_spinlock_acquire(&p_prof->lock);
+		memcpy(&p_prof->recs[p_prof->head], p_rec, sizeof(*p_rec));
+		p_prof->head = (p_prof->head + 1) % p_prof->history;
+		if (p_prof->count < p_prof->history)
+			p_prof->count++;
+		cl_spinlock_release(&p_prof->lock);
+	}
+
+	p_rec->num_phases = 0;
+	p_rec->type = NULL;
+}
+
+/*
+ * Copy out the last num records, oldest first, so that they can be
+ * formatted without holding the lock.
+ */
+static unsigned prof_snapshot(IN osm_sweep_prof_t * p_prof, IN unsigned num,
+			      OUT osm_sweep_rec_t ** p_recs)
+{
+	osm_sweep_rec_t *recs;
+	unsigned i, first;
+
+	*p_recs = NULL;
+	if (!p_prof->history)
+		return 0;
+
+	recs = malloc(p_prof->history * sizeof(*recs));
+	if (!recs)
+		return 0;
+
+	cl_spinlock_acquire(&p_prof->lock);
+	if (!num || num > p_prof->count)
+		num = p_prof->count;
+	first = (p_prof->head + p_prof->history - num) % p_prof->history;
+	for (i = 0; i < num; i++)
+		memcpy(&recs[i], &p_prof->recs[(first + i) % p_prof->history],
+		       sizeof(*recs));
+	cl_spinlock_release(&p_prof->lock);
+
+	*p_recs = recs;
+	return num;
+}
+
+#define US_TO_MS(x) ((double)(x) / 1000.0)
+
+void osm_sweep_prof_dump(IN osm_sweep_prof_t * p_prof, IN unsigned num,
+			 IN FILE * out)
+{
+	osm_sweep_rec_t *recs;
+	osm_sweep_phase_t *p_phase, total;
+	unsigned i, j;
+	char tbuf[32];
+	struct tm tm;
+	time_t t;
+
+	if (!p_prof->history) {
+		fprintf(out, "Sweep profiling is disabled "
+			"(sweep_profile_history is 0)\n");
+		return;
+	}
+
+	num = prof_snapshot(p_prof, num, &recs);
+	if (!num) {
+		fprintf(out, "No sweeps recorded\n");
+		free(recs);
+		return;
+	}
+
+	for (i = 0; i < num; i++) {
+		t = (time_t) (recs[i].start / 1000000);
+		localtime_r(&t, &tm);
+		strftime(tbuf, sizeof(tbuf), "%Y-%m-%d %H:%M:%S", &tm);
+		fprintf(out, "\nSweep %u (%s) started %s, %.3f ms\n",
+			recs[i].seq, recs[i].type, tbuf,
+			US_TO_MS(recs[i].wall_us));
+		fprintf(out, "   %-22s %11s %11s %11s %11s %8s %8s %6s\n",
+			"Phase", "Wall(ms)", "Wait(ms)", "ThrCPU(ms)",
+			"ProcCPU(ms)", "Sent", "Rcvd", "Tmout");
+
+		memset(&total, 0, sizeof(total));
+		for (j = 0; j < recs[i].num_phases; j++) {
+			p_phase = &recs[i].phases[j];
+			fprintf(out, "   %-22s %11.3f %11.3f %11.3f %11.3f "
+				"%8u %8u %6u\n", p_phase->name,
+				US_TO_MS(p_phase->wall_us),
+				US_TO_MS(p_phase->wait_us),
+				US_TO_MS(p_phase->thread_cpu_us),
+				US_TO_MS(p_phase->proc_cpu_us),
+				p_phase->mads_sent, p_phase->mads_rcvd,
+				p_phase->mads_timeout);
+			total.wall_us += p_phase->wall_us;
+			total.wait_us += p_phase->wait_us;
+			total.thread_cpu_us += p_phase->thread_cpu_us;
+			total.proc_cpu_us += p_phase->proc_cpu_us;
+			total.mads_sent += p_phase->mads_sent;
+			total.mads_rcvd += p_phase->mads_rcvd;
+			total.mads_timeout += p_phase->mads_timeout;
+		}
+		fprintf(out, "   %-22s %11.3f %11.3f %11.3f %11.3f "
+			"%8u %8u %6u\n", "total",
+			US_TO_MS(total.wall_us), US_TO_MS(total.wait_us),
+			US_TO_MS(total.thread_cpu_us),
+			US_TO_MS(total.proc_cpu_us), total.mads_sent,
+			total.mads_rcvd, total.mads_timeout);
+	}
+
+	free(recs);
+}
+
+int osm_sweep_prof_export(IN osm_sweep_prof_t * p_prof, IN FILE * out)
+{
+	osm_sweep_rec_t *recs;
+	osm_sweep_phase_t *p_phase;
+	unsigned i, j, num;
+	int pid = (int)getpid();
+
+	num = prof_snapshot(p_prof, 0, &recs);
+
+	fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	fprintf(out, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,"
+		"\"tid\":1,\"args\":{\"name\":\"opensm\"}},\n", pid);
+	fprintf(out, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,"
+		"\"tid\":1,\"args\":{\"name\":\"sweep\"}}", pid);
+
+	for (i = 0; i < num; i++) {
+		fprintf(out, ",\n{\"name\":\"%s sweep %u\",\"cat\":\"sweep\","
+			"\"ph\":\"X\",\"ts\":%" PRIu64 ",\"dur\":%" PRIu64
+			",\"pid\":%d,\"tid\":1,\"args\":{\"seq\":%u,"
+			"\"phases\":%u}}", recs[i].type, recs[i].seq,
+			recs[i].start, recs[i].wall_us, pid, recs[i].seq,
+			recs[i].num_phases);
+
+		for (j = 0; j < recs[i].num_phases; j++) {
+			p_phase = &recs[i].phases[j];
+			fprintf(out, ",\n{\"name\":\"%s\",\"cat\":\"phase\","
+				"\"ph\":\"X\",\"ts\":%" PRIu64 ",\"dur\":%"
+				PRIu64 ",\"pid\":%d,\"tid\":1,\"args\":{"
+				"\"wait_us\":%" PRIu64 ",\"thread_cpu_us\":%"
+				PRIu64 ",\"proc_cpu_us\":%" PRIu64
+				",\"mads_sent\":%u,\"mads_rcvd\":%u,"
+				"\"mads_timeout\":%u}}", p_phase->name,
+				p_phase->start, p_phase->wall_us, pid,
+				p_phase->wait_us, p_phase->thread_cpu_us,
+				p_phase->proc_cpu_us, p_phase->mads_sent,
+				p_phase->mads_rcvd, p_phase->mads_timeout);
+
+			/* waits close the phases that issue MADs */
+			if (p_phase->wait_us && p_phase->wait_us <=
+			    p_phase->wall_us)
+				fprintf(out, ",\n{\"name\":\"wait\","
+					"\"cat\":\"wait\",\"ph\":\"X\","
+					"\"ts\":%" PRIu64 ",\"dur\":%" PRIu64
+					",\"pid\":%d,\"tid\":1}",
+					p_phase->start + p_phase->wall_us -
+					p_phase->wait_us, p_phase->wait_us,
+					pid);
+		}
+	}
+
+	fprintf(out, "\n]}\n");
+	free(recs);
+
+	return ferror(out) ? -1 : (int)num;
+}
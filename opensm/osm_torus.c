@@ -215,6 +215,13 @@ struct t_switch {
 	 */
 	struct osm_switch *osm_switch;
 
+	/*
+	 * Copy of the LFT last computed for this switch, so that a later
+	 * routing pass over an unchanged torus can reuse it.
+	 */
+	uint8_t *lft;
+	unsigned lft_size;
+
 	struct port_grp ptgrp[SWITCH_MAX_PORTGRPS];
 	struct endpoint **port;
 };
@@ -281,6 +288,19 @@ struct coord_dirs {
 	int x_dateline, y_dateline, z_dateline;
 };
 
+/*
+ * A destination LID range, in the order torus_lft() spreads destinations
+ * over the parallel links of a port group.  port is the switch port the
+ * destination is attached to.
+ */
+struct t_dest {
+	struct t_switch *sw;
+	uint16_t dlid_base;
+	uint8_t dlid_lmc;
+	uint8_t port;
+	bool ca;
+};
+
 struct torus {
 	osm_opensm_t *osm;
 	unsigned ca_cnt;
@@ -304,6 +324,9 @@ struct torus {
 	struct t_switch ****sw;
 	struct t_switch *master_stree_root;
 
+	struct t_dest *dest;
+	unsigned dest_cnt;
+
 	unsigned flags;
 	unsigned max_changes;
 	int debug;
@@ -391,6 +414,7 @@ void teardown_torus(struct torus *t)
 				if (port && !port->link)
 					free(port);	/* management port */
 			}
+			free(sw->lft);
 			free(sw);
 		}
 		free(t->sw_pool);
@@ -398,6 +422,9 @@ void teardown_torus(struct torus *t)
 	if (t->link_pool)
 		free(t->link_pool);
 
+	if (t->dest)
+		free(t->dest);
+
 	if (t->sw)
 		free(t->sw);
 
@@ -8612,28 +8639,29 @@ bool get_lid(struct port_grp *pg, unsigned p,
 	return true;
 }
 
+/*
+ * Collect the LID ranges every switch LFT has to route, in switch pool
+ * order and, within a switch, in port_order order.
+ */
 static
-bool torus_lft(struct torus *t, struct t_switch *sw)
+bool build_dest_list(struct torus *t)
 {
-	bool success = true;
-	int dp;
-	unsigned p, s;
-	uint16_t l, dlid_base;
-	uint8_t dlid_lmc;
-	bool ca;
+	unsigned p, s, cnt = 0;
 	struct port_grp *pgrp;
 	struct t_switch *dsw;
-	osm_switch_t *osm_sw;
+	struct t_dest *dest;
 	uint8_t order[IB_NODE_NUM_PORTS_MAX+1];
 
-	if (!(sw->osm_switch && sw->osm_switch->priv == sw)) {
+	for (s = 0; s < t->switch_cnt; s++)
+		cnt += t->sw_pool[s]->ptgrp[2 * TORUS_MAX_DIM].port_cnt;
+
+	t->dest = calloc(cnt + 1, sizeof(*t->dest));
+	if (!t->dest) {
 		OSM_LOG(&t->osm->log, OSM_LOG_ERROR,
-			"ERR 4E3D: sw->osm_switch->priv != sw "
-			"for sw 0x%04"PRIx64"\n", cl_ntoh64(sw->n_id));
+			"ERR 4E49: calloc: %s\n", strerror(errno));
 		return false;
 	}
-	osm_sw = sw->osm_switch;
-	memset(osm_sw->new_lft, OSM_NO_PATH, osm_sw->lft_size);
+	t->dest_cnt = 0;
 
 	for (s = 0; s < t->switch_cnt; s++) {
 
@@ -8644,35 +8672,109 @@ bool torus_lft(struct torus *t, struct t_switch *sw)
 		for (p = 0; p < pgrp->port_cnt; p++)
 			order[pgrp->port[p]->port] = p;
 
-		for (p = 0; p < ARRAY_SIZE(order); p++) {
+		for (p = 0; p < ARRAY_SIZE(order) && t->dest_cnt < cnt; p++) {
 
 			uint8_t px = order[t->port_order[p]];
 
 			if (px == IB_INVALID_PORT_NUM)
 				continue;
 
-			if (!get_lid(pgrp, px, &dlid_base, &dlid_lmc, &ca))
+			dest = &t->dest[t->dest_cnt];
+			if (!get_lid(pgrp, px, &dest->dlid_base,
+				     &dest->dlid_lmc, &dest->ca))
 				return false;
 
-			if (sw->n_id == dsw->n_id)
-				dp = pgrp->port[px]->port;
-			else
-				dp = lft_port(t, sw, dsw, true, ca);
-			/*
-			 * LMC > 0 doesn't really make sense for torus-2QoS.
-			 * So, just make sure traffic gets delivered if
-			 * non-zero LMC is used.
-			 */
-			if (dp >= 0)
-				for (l = 0; l < (1U << dlid_lmc); l++)
-					osm_sw->new_lft[dlid_base + l] = dp;
-			else
-				success = false;
+			dest->sw = dsw;
+			dest->port = pgrp->port[px]->port;
+			t->dest_cnt++;
 		}
 	}
+	return true;
+}
+
+static
+bool torus_lft(struct torus *t, struct t_switch *sw)
+{
+	bool success = true;
+	int dp;
+	unsigned d;
+	uint16_t l;
+	struct t_dest *dest;
+	osm_switch_t *osm_sw;
+	uint8_t *lft;
+
+	if (!(sw->osm_switch && sw->osm_switch->priv == sw)) {
+		OSM_LOG(&t->osm->log, OSM_LOG_ERROR,
+			"ERR 4E3D: sw->osm_switch->priv != sw "
+			"for sw 0x%04"PRIx64"\n", cl_ntoh64(sw->n_id));
+		return false;
+	}
+	osm_sw = sw->osm_switch;
+	memset(osm_sw->new_lft, OSM_NO_PATH, osm_sw->lft_size);
+
+	for (d = 0; d < t->dest_cnt; d++) {
+
+		dest = &t->dest[d];
+
+		if (sw->n_id == dest->sw->n_id)
+			dp = dest->port;
+		else
+			dp = lft_port(t, sw, dest->sw, true, dest->ca);
+		/*
+		 * LMC > 0 doesn't really make sense for torus-2QoS.
+		 * So, just make sure traffic gets delivered if
+		 * non-zero LMC is used.
+		 */
+		if (dp >= 0)
+			for (l = 0; l < (1U << dest->dlid_lmc); l++)
+				osm_sw->new_lft[dest->dlid_base + l] = dp;
+		else
+			success = false;
+	}
+
+	/*
+	 * Keep a copy for the next routing pass; if that fails the switch
+	 * simply gets recomputed next time.
+	 */
+	if (sw->lft_size != osm_sw->lft_size) {
+		lft = realloc(sw->lft, osm_sw->lft_size);
+		if (!lft) {
+			free(sw->lft);
+			sw->lft = NULL;
+			sw->lft_size = 0;
+			return success;
+		}
+		sw->lft = lft;
+		sw->lft_size = osm_sw->lft_size;
+	}
+	memcpy(sw->lft, osm_sw->new_lft, sw->lft_size);
+
 	return success;
 }
 
+/*
+ * Install the LFT computed for osw in the previous torus as the LFT of
+ * sw, which sits at the same place in an unchanged torus.
+ */
+static
+bool torus_lft_reuse(struct t_switch *sw, struct t_switch *osw)
+{
+	osm_switch_t *osm_sw = sw->osm_switch;
+
+	if (!(osm_sw && osm_sw->priv == sw) ||
+	    !osw->lft || osw->lft_size > osm_sw->lft_size)
+		return false;
+
+	memset(osm_sw->new_lft, OSM_NO_PATH, osm_sw->lft_size);
+	memcpy(osm_sw->new_lft, osw->lft, osw->lft_size);
+
+	sw->lft = osw->lft;
+	sw->lft_size = osw->lft_size;
+	osw->lft = NULL;
+	osw->lft_size = 0;
+	return true;
+}
+
 static
 osm_mtree_node_t *mcast_stree_branch(struct t_switch *sw, osm_switch_t *osm_sw,
 				     osm_mgrp_box_t *mgb, unsigned depth,
@@ -9160,13 +9262,164 @@ out:
 	return success;
 }
 
-int route_torus(struct torus *t)
+/*
+ * Returns true if the LFTs computed for ot can be reused for t, i.e. the
+ * switches sit at the same coordinates in the same pool order, and the
+ * destinations are the same.  Interswitch links may still differ.
+ */
+static
+bool torus_routes_reusable(struct torus *t, struct torus *ot)
+{
+	unsigned d, s;
+	struct t_switch *sw, *osw;
+	struct t_dest *dest, *odest;
+	unsigned mesh = X_MESH | Y_MESH | Z_MESH;
+
+	if (!ot)
+		return false;
+
+	if (t->x_sz != ot->x_sz || t->y_sz != ot->y_sz ||
+	    t->z_sz != ot->z_sz || (t->flags & mesh) != (ot->flags & mesh) ||
+	    t->switch_cnt != ot->switch_cnt || t->dest_cnt != ot->dest_cnt ||
+	    memcmp(t->port_order, ot->port_order, sizeof(t->port_order)))
+		return false;
+
+	for (s = 0; s < t->switch_cnt; s++) {
+		sw = t->sw_pool[s];
+		osw = ot->sw_pool[s];
+		if (sw->n_id != osw->n_id || sw->i != osw->i ||
+		    sw->j != osw->j || sw->k != osw->k)
+			return false;
+	}
+	for (d = 0; d < t->dest_cnt; d++) {
+		dest = &t->dest[d];
+		odest = &ot->dest[d];
+		if (dest->sw->n_id != odest->sw->n_id ||
+		    dest->dlid_base != odest->dlid_base ||
+		    dest->dlid_lmc != odest->dlid_lmc ||
+		    dest->port != odest->port || dest->ca != odest->ca)
+			return false;
+	}
+	return true;
+}
+
+static
+struct endpoint *far_endpoint(struct endpoint *ep)
+{
+	if (!ep->link)
+		return NULL;
+	return &ep->link->end[0] == ep ? &ep->link->end[1] : &ep->link->end[0];
+}
+
+/*
+ * Returns true if the links of an interswitch port group differ between
+ * two switches at the same place in the old and new torus.
+ */
+static
+bool ptgrp_changed(struct port_grp *pg, struct port_grp *opg)
+{
+	unsigned p;
+	struct endpoint *rep, *orep;
+
+	if (pg->port_cnt != opg->port_cnt)
+		return true;
+
+	for (p = 0; p < pg->port_cnt; p++) {
+		if (pg->port[p]->port != opg->port[p]->port)
+			return true;
+
+		rep = far_endpoint(pg->port[p]);
+		orep = far_endpoint(opg->port[p]);
+		if (!rep || !orep) {
+			if (rep != orep)
+				return true;
+			continue;
+		}
+		if (rep->n_id != orep->n_id || rep->port != orep->port)
+			return true;
+	}
+	return false;
+}
+
+#define TSW_IDX(t, i, j, k) \
+	(((k) * (t)->y_sz + (j)) * (t)->x_sz + (i))
+
+/*
+ * Flag all switches on the ring through sw along coordinate direction cdir.
+ */
+static
+void mark_ring(struct torus *t, bool *dirty, struct t_switch *sw,
+	       unsigned cdir)
+{
+	int n;
+
+	switch (cdir) {
+	case 0:
+		for (n = 0; n < (int)t->x_sz; n++)
+			dirty[TSW_IDX(t, n, sw->j, sw->k)] = true;
+		break;
+	case 1:
+		for (n = 0; n < (int)t->y_sz; n++)
+			dirty[TSW_IDX(t, sw->i, n, sw->k)] = true;
+		break;
+	case 2:
+		for (n = 0; n < (int)t->z_sz; n++)
+			dirty[TSW_IDX(t, sw->i, sw->j, n)] = true;
+		break;
+	default:
+		break;
+	}
+}
+
+/*
+ * The LFT of a switch only depends on the destination list, its own port
+ * groups, and the links of the switches on its three rings: lft_port()
+ * follows a ring from the switch to the turning switch, and the parallel
+ * link used is picked round robin per port group.  So when the torus is
+ * otherwise unchanged, only switches sharing a ring with a switch whose
+ * interswitch links changed need their LFT recomputed; the others reuse
+ * the LFT computed for the previous torus ot.
+ */
+int route_torus(struct torus *t, struct torus *ot)
 {
 	int s;
+	unsigned g, reused = 0;
 	bool success = true;
+	bool *dirty = NULL;
+	struct t_switch *sw, *osw;
+
+	if (!build_dest_list(t))
+		return -1;
+
+	if (torus_routes_reusable(t, ot))
+		dirty = calloc(t->x_sz * t->y_sz * t->z_sz, sizeof(*dirty));
 
-	for (s = 0; s < (int)t->switch_cnt; s++)
-		success = torus_lft(t, t->sw_pool[s]) && success;
+	if (dirty)
+		for (s = 0; s < (int)t->switch_cnt; s++) {
+			sw = t->sw_pool[s];
+			osw = ot->sw_pool[s];
+			for (g = 0; g < 2 * TORUS_MAX_DIM; g++)
+				if (ptgrp_changed(&sw->ptgrp[g],
+						  &osw->ptgrp[g]))
+					mark_ring(t, dirty, sw, g / 2);
+		}
+
+	for (s = 0; s < (int)t->switch_cnt; s++) {
+		sw = t->sw_pool[s];
+		if (dirty && !dirty[TSW_IDX(t, sw->i, sw->j, sw->k)] &&
+		    torus_lft_reuse(sw, ot->sw_pool[s])) {
+			reused++;
+			continue;
+		}
+		success = torus_lft(t, sw) && success;
+	}
+
+	if (dirty) {
+		OSM_LOG(&t->osm->log, OSM_LOG_INFO,
+			"Torus geometry unchanged, reused the LFTs of "
+			"%u of %u switches\n", reused, t->switch_cnt);
+		free(dirty);
+	}
 
 	success = success && torus_master_stree(t);
 
@@ -9515,7 +9768,7 @@ int torus_build_lfts(void *context)
 		report_torus_changes(torus, ctx->torus);
 
 	if (routable_torus(torus, fabric))
-		status = route_torus(torus);
+		status = route_torus(torus, ctx->torus);
 
 out:
 	if (status) {		/* bad torus!! */
@@ -72,7 +72,7 @@ typedef struct cache_switch {
 	boolean_t dropped;
 	uint16_t max_lid_ho;
 	uint16_t num_hops;
-	uint8_t **hops;
+	uint8_t *hops;
 	uint8_t *lft;
 	uint8_t num_ports;
 	cache_port_t ports[0];
@@ -114,19 +114,13 @@ static cache_switch_t *cache_sw_new(uint16_t lid_ho, unsigned num_ports)
 
 static void cache_sw_destroy(cache_switch_t * p_sw)
 {
-	unsigned i;
-
 	if (!p_sw)
 		return;
 
 	if (p_sw->lft)
 		free(p_sw->lft);
-	if (p_sw->hops) {
-		for (i = 0; i < p_sw->num_hops; i++)
-			if (p_sw->hops[i])
-				free(p_sw->hops[i]);
+	if (p_sw->hops)
 		free(p_sw->hops);
-	}
 	free(p_sw);
 }
 
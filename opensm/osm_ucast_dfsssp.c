@@ -60,39 +60,38 @@
 
 /************ helper functions to save src/dest X vl combination ******
  **********************************************************************/
-/* compare function of two lids for stdlib qsort */
-static int cmp_lids(const void *l1, const void *l2)
+/* get the index of a src/dest lid (network order) combination in the
+   matrix; return -1 for invalid lids
+*/
+static inline int64_t vltable_get_index(vltable_t * vltable, ib_net16_t slid,
+					ib_net16_t dlid)
 {
-	ib_net16_t lid1 = *((ib_net16_t *) l1), lid2 = *((ib_net16_t *) l2);
+	uint16_t slid_ho = cl_ntoh16(slid), dlid_ho = cl_ntoh16(dlid);
+	uint16_t row = 0, col = 0;
 
-	if (lid1 < lid2)
+	if (slid_ho > vltable->max_lid || dlid_ho > vltable->max_lid)
 		return -1;
-	else if (lid1 > lid2)
-		return 1;
-	else
-		return 0;
+
+	row = vltable->row_index[slid_ho];
+	col = vltable->col_index[dlid_ho];
+	if (row == VLTABLE_NO_INDEX || col == VLTABLE_NO_INDEX)
+		return -1;
+
+	return (int64_t) row * vltable->num_cols + col;
 }
 
-/* use stdlib to sort the lid array */
-static inline void vltable_sort_lids(vltable_t * vltable)
+static inline uint8_t vltable_get_entry(vltable_t * vltable, uint64_t ind)
 {
-	qsort(vltable->lids, vltable->num_lids, sizeof(ib_net16_t), cmp_lids);
+	return (vltable->vls[ind >> 1] >> ((ind & 1) << 2)) & 0x0F;
 }
 
-/* use stdlib to get index of key in lid array;
-   return -1 if lid isn't found in lids array
-*/
-static inline int64_t vltable_get_lidindex(ib_net16_t * key, vltable_t * vltable)
+static inline void vltable_set_entry(vltable_t * vltable, uint64_t ind,
+				     uint8_t vl)
 {
-	ib_net16_t *found_lid = NULL;
+	uint8_t shift = (ind & 1) << 2;
 
-	found_lid =
-	    (ib_net16_t *) bsearch(key, vltable->lids, vltable->num_lids,
-				   sizeof(ib_net16_t), cmp_lids);
-	if (found_lid)
-		return found_lid - vltable->lids;
-	else
-		return -1;
+	vltable->vls[ind >> 1] =
+	    (vltable->vls[ind >> 1] & ~(0x0F << shift)) | ((vl & 0x0F) << shift);
 }
 
 /* get virtual lane from src lid X dest lid combination;
@@ -100,12 +99,10 @@ static inline int64_t vltable_get_lidindex(ib_net16_t * key, vltable_t * vltable
 */
 int32_t vltable_get_vl(vltable_t * vltable, ib_net16_t slid, ib_net16_t dlid)
 {
-	int64_t ind1 = vltable_get_lidindex(&slid, vltable);
-	int64_t ind2 = vltable_get_lidindex(&dlid, vltable);
+	int64_t ind = vltable_get_index(vltable, slid, dlid);
 
-	if (ind1 > -1 && ind2 > -1)
-		return (int32_t) (vltable->
-				  vls[ind1 + ind2 * vltable->num_lids]);
+	if (ind > -1)
+		return (int32_t) vltable_get_entry(vltable, ind);
 	else
 		return -1;
 }
@@ -114,57 +111,40 @@ int32_t vltable_get_vl(vltable_t * vltable, ib_net16_t slid, ib_net16_t dlid)
 static inline void vltable_insert(vltable_t * vltable, ib_net16_t slid,
 				  ib_net16_t dlid, uint8_t vl)
 {
-	int64_t ind1 = vltable_get_lidindex(&slid, vltable);
-	int64_t ind2 = vltable_get_lidindex(&dlid, vltable);
+	int64_t ind = vltable_get_index(vltable, slid, dlid);
 
-	if (ind1 > -1 && ind2 > -1)
-		vltable->vls[ind1 + ind2 * vltable->num_lids] = vl;
+	if (ind > -1)
+		vltable_set_entry(vltable, ind, vl);
 }
 
-/* change a number of lanes from lane xy to lane yz */
-static void vltable_change_vl(vltable_t * vltable, uint8_t from, uint8_t to,
-			      uint64_t count)
+/* change all lanes from lane xy to lane yz */
+static void vltable_change_vl(vltable_t * vltable, uint8_t from, uint8_t to)
 {
-	uint64_t set = 0, stop = 0;
-	uint64_t ind1 = 0, ind2 = 0;
+	uint64_t ind = 0, size = (uint64_t) vltable->num_rows * vltable->num_cols;
 
-	for (ind1 = 0; ind1 < vltable->num_lids; ind1++) {
-		for (ind2 = 0; ind2 < vltable->num_lids; ind2++) {
-			if (set == count) {
-				stop = 1;
-				break;
-			}
-			if (ind1 != ind2) {
-				if (vltable->
-				    vls[ind1 + ind2 * vltable->num_lids] ==
-				    from) {
-					vltable->vls[ind1 +
-						     ind2 * vltable->num_lids] =
-					    to;
-					set++;
-				}
-			}
-		}
-		if (stop)
-			break;
-	}
+	for (ind = 0; ind < size; ind++)
+		if (vltable_get_entry(vltable, ind) == from)
+			vltable_set_entry(vltable, ind, to);
 }
 
 static void vltable_print(osm_ucast_mgr_t * p_mgr, vltable_t * vltable)
 {
-	uint64_t ind1 = 0, ind2 = 0;
+	uint32_t slid = 0, dlid = 0;
+	int32_t vl = 0;
 
-	for (ind1 = 0; ind1 < vltable->num_lids; ind1++) {
-		for (ind2 = 0; ind2 < vltable->num_lids; ind2++) {
-			if (ind1 != ind2) {
+	for (slid = 1; slid <= vltable->max_lid; slid++) {
+		if (vltable->row_index[slid] == VLTABLE_NO_INDEX)
+			continue;
+		for (dlid = 1; dlid <= vltable->max_lid; dlid++) {
+			if (slid == dlid)
+				continue;
+			vl = vltable_get_vl(vltable, cl_hton16(slid),
+					    cl_hton16(dlid));
+			if (vl > -1)
 				OSM_LOG(p_mgr->p_log, OSM_LOG_DEBUG,
-					"   route from src_lid=%" PRIu16
-					" to dest_lid=%" PRIu16 " on vl=%" PRIu8
-					"\n", cl_ntoh16(vltable->lids[ind1]),
-					cl_ntoh16(vltable->lids[ind2]),
-					vltable->vls[ind1 +
-						     ind2 * vltable->num_lids]);
-			}
+					"   route from src_lid=%" PRIu32
+					" to dest_lid=%" PRIu32 " on vl=%" PRId32
+					"\n", slid, dlid, vl);
 		}
 	}
 }
@@ -172,8 +152,10 @@ static void vltable_print(osm_ucast_mgr_t * p_mgr, vltable_t * vltable)
 void vltable_dealloc(vltable_t ** vltable)
 {
 	if (*vltable) {
-		if ((*vltable)->lids)
-			free((*vltable)->lids);
+		if ((*vltable)->row_index)
+			free((*vltable)->row_index);
+		if ((*vltable)->col_index)
+			free((*vltable)->col_index);
 		if ((*vltable)->vls)
 			free((*vltable)->vls);
 		free(*vltable);
@@ -181,24 +163,93 @@ void vltable_dealloc(vltable_t ** vltable)
 	}
 }
 
-static int vltable_alloc(vltable_t ** vltable, uint64_t size)
+/* allocate the VL table for all ports (also multiple LIDs) of type CA or
+   SP0 of the port_order_list
+*/
+static int vltable_alloc(vltable_t ** vltable, osm_ucast_mgr_t * p_mgr)
 {
-	/* allocate VL table and indexing array */
-	*vltable = (vltable_t *) malloc(sizeof(vltable_t));
+	cl_qlist_t *port_tbl = &p_mgr->port_order_list;
+	cl_list_item_t *item = NULL;
+	osm_port_t *port = NULL;
+	osm_node_t *remote_node = NULL;
+	uint16_t *sw_row = NULL;
+	uint16_t max_lid = p_mgr->p_subn->max_ucast_lid_ho;
+	uint16_t lid = 0, min_lid_ho = 0, max_lid_ho = 0, sw_lid = 0, row = 0;
+	uint8_t ntype = 0, remote_port = 0;
+	uint64_t size = 0;
+
+	/* allocate VL table and indexing arrays */
+	*vltable = (vltable_t *) calloc(1, sizeof(vltable_t));
 	if (!(*vltable))
 		goto ERROR;
-	(*vltable)->num_lids = size;
-	(*vltable)->lids = (ib_net16_t *) malloc(size * sizeof(ib_net16_t));
-	if (!((*vltable)->lids))
+	(*vltable)->max_lid = max_lid;
+	(*vltable)->row_index =
+	    (uint16_t *) malloc((max_lid + 1) * sizeof(uint16_t));
+	(*vltable)->col_index =
+	    (uint16_t *) malloc((max_lid + 1) * sizeof(uint16_t));
+	/* temporary switch lid -> row of its Hca ports */
+	sw_row = (uint16_t *) malloc((max_lid + 1) * sizeof(uint16_t));
+	if (!((*vltable)->row_index) || !((*vltable)->col_index) || !sw_row)
 		goto ERROR;
-	(*vltable)->vls = (uint8_t *) malloc(size * size * sizeof(uint8_t));
+	memset((*vltable)->row_index, 0xFF, (max_lid + 1) * sizeof(uint16_t));
+	memset((*vltable)->col_index, 0xFF, (max_lid + 1) * sizeof(uint16_t));
+	memset(sw_row, 0xFF, (max_lid + 1) * sizeof(uint16_t));
+
+	/* fill lids into indexing arrays */
+	for (item = cl_qlist_head(port_tbl); item != cl_qlist_end(port_tbl);
+	     item = cl_qlist_next(item)) {
+		port = (osm_port_t *)cl_item_obj(item, port, list_item);
+		ntype = osm_node_get_type(port->p_node);
+		if (ntype != IB_NODE_TYPE_CA && ntype != IB_NODE_TYPE_SWITCH)
+			continue;
+		/* only SP0 with SLtoVLMapping support will be processed */
+		if (ntype == IB_NODE_TYPE_SWITCH
+		    && !(port->p_physp->port_info.capability_mask
+		    & IB_PORT_CAP_HAS_SL_MAP))
+			continue;
+
+		/* Hca ports share the row of the switch they are connected
+		   to, each SP0 gets its own row
+		 */
+		row = (*vltable)->num_rows;
+		if (ntype == IB_NODE_TYPE_CA) {
+			remote_node =
+			    osm_node_get_remote_node(port->p_node,
+						     port->p_physp->port_num,
+						     &remote_port);
+			if (remote_node && remote_node->sw) {
+				sw_lid = cl_ntoh16(osm_node_get_base_lid
+						   (remote_node, 0));
+				if (sw_lid <= max_lid) {
+					if (sw_row[sw_lid] == VLTABLE_NO_INDEX)
+						sw_row[sw_lid] = row;
+					row = sw_row[sw_lid];
+				}
+			}
+		}
+		if (row == (*vltable)->num_rows)
+			(*vltable)->num_rows++;
+
+		osm_port_get_lid_range_ho(port, &min_lid_ho, &max_lid_ho);
+		for (lid = min_lid_ho; lid <= max_lid_ho && lid <= max_lid;
+		     lid++) {
+			(*vltable)->row_index[lid] = row;
+			(*vltable)->col_index[lid] = (*vltable)->num_cols++;
+		}
+	}
+
+	size = ((uint64_t) (*vltable)->num_rows * (*vltable)->num_cols + 1) / 2;
+	(*vltable)->vls = (uint8_t *) malloc(size * sizeof(uint8_t));
 	if (!((*vltable)->vls))
 		goto ERROR;
-	memset((*vltable)->vls, OSM_DEFAULT_SL, size * size);
+	memset((*vltable)->vls, (OSM_DEFAULT_SL << 4) | OSM_DEFAULT_SL, size);
 
+	free(sw_row);
 	return 0;
 
 ERROR:
+	if (sw_row)
+		free(sw_row);
 	vltable_dealloc(vltable);
 
 	return 1;
@@ -1663,7 +1714,6 @@ int dfsssp_remove_deadlocks(dfsssp_context_t * dfsssp_ctx)
 	uint32_t srcdest = 0;
 
 	vltable_t *srcdest2vl_table = NULL;
-	uint8_t lmc = 0;
 	uint16_t slid = 0, dlid = 0, min_lid_ho = 0, max_lid_ho =
 	    0, min_lid_ho2 = 0, max_lid_ho2 = 0;;
 	uint64_t *paths_per_vl = NULL;
@@ -1697,54 +1747,16 @@ int dfsssp_remove_deadlocks(dfsssp_context_t * dfsssp_ctx)
 	for (i = 0; i < vl_avail; i++)
 		cdg[i] = NULL;
 
-	count = 0;
-	/* count all ports (also multiple LIDs) of type CA or SP0 for size of VL table */
-	for (item1 = cl_qlist_head(port_tbl); item1 != cl_qlist_end(port_tbl);
-	     item1 = cl_qlist_next(item1)) {
-		dest_port = (osm_port_t *)cl_item_obj(item1, dest_port,
-						      list_item);
-		ntype = osm_node_get_type(dest_port->p_node);
-		if (ntype == IB_NODE_TYPE_CA || ntype == IB_NODE_TYPE_SWITCH) {
-			/* only SP0 with SLtoVLMapping support will be processed */
-			if (ntype == IB_NODE_TYPE_SWITCH
-			    && !(dest_port->p_physp->port_info.capability_mask
-			    & IB_PORT_CAP_HAS_SL_MAP))
-				continue;
-
-			lmc = osm_port_get_lmc(dest_port);
-			count += (1 << lmc);
-		}
-	}
-	/* allocate VL table and indexing array */
-	err = vltable_alloc(&srcdest2vl_table, count);
+	/* allocate VL table and indexing arrays */
+	err = vltable_alloc(&srcdest2vl_table, p_mgr);
 	if (err) {
 		OSM_LOG(p_mgr->p_log, OSM_LOG_ERROR,
 			"ERR AD26: cannot allocate memory for srcdest2vl_table\n");
 		goto ERROR;
 	}
-
-	i = 0;
-	/* fill lids into indexing array */
-	for (item1 = cl_qlist_head(port_tbl); item1 != cl_qlist_end(port_tbl);
-	     item1 = cl_qlist_next(item1)) {
-		dest_port = (osm_port_t *)cl_item_obj(item1, dest_port,
-						      list_item);
-		ntype = osm_node_get_type(dest_port->p_node);
-		if (ntype == IB_NODE_TYPE_CA || ntype == IB_NODE_TYPE_SWITCH) {
-			/* only SP0 with SLtoVLMapping support will be processed */
-			if (ntype == IB_NODE_TYPE_SWITCH
-			    && !(dest_port->p_physp->port_info.capability_mask
-			    & IB_PORT_CAP_HAS_SL_MAP))
-				continue;
-
-			osm_port_get_lid_range_ho(dest_port, &min_lid_ho,
-						  &max_lid_ho);
-			for (dlid = min_lid_ho; dlid <= max_lid_ho; dlid++, i++)
-				srcdest2vl_table->lids[i] = cl_hton16(dlid);
-		}
-	}
-	/* sort lids */
-	vltable_sort_lids(srcdest2vl_table);
+	OSM_LOG(p_mgr->p_log, OSM_LOG_VERBOSE,
+		"VL table with %" PRIu32 " rows and %" PRIu32 " columns\n",
+		srcdest2vl_table->num_rows, srcdest2vl_table->num_cols);
 
 	test_vl = 0;
 	/* fill cdg[0] with routes from each src/dest port combination for all Hca/SP0 in the subnet */
@@ -1900,10 +1912,28 @@ int dfsssp_remove_deadlocks(dfsssp_context_t * dfsssp_ctx)
 							"ERR AD14: cannot allocate memory for cdg node or link in update_channel_dep_graph(...)\n");
 						goto ERROR;
 					}
-					vltable_insert(srcdest2vl_table,
-						       cl_hton16(slid),
-						       cl_hton16(dlid),
-						       test_vl + 1);
+				}
+
+				/* update the VL table after all paths are moved,
+				   because paths from sources behind the same
+				   switch share one entry of the table
+				 */
+				for (i = 0; i < weakest_link->num_pairs; i++) {
+					srcdest =
+					    get_next_srcdest_pair(weakest_link,
+								  i);
+					slid = (uint16_t) (srcdest >> 16);
+					dlid =
+					    (uint16_t) ((srcdest << 16) >> 16);
+					if (test_vl ==
+					    (uint8_t)
+					    vltable_get_vl(srcdest2vl_table,
+							   cl_hton16(slid),
+							   cl_hton16(dlid)))
+						vltable_insert(srcdest2vl_table,
+							       cl_hton16(slid),
+							       cl_hton16(dlid),
+							       test_vl + 1);
 				}
 
 				if (weakest_link->num_pairs)
@@ -1986,7 +2016,7 @@ int dfsssp_remove_deadlocks(dfsssp_context_t * dfsssp_ctx)
 			for (i = 0; i < from; i++)
 				to += split_count[i];
 			count = paths_per_vl[from];
-			vltable_change_vl(srcdest2vl_table, from, to, count);
+			vltable_change_vl(srcdest2vl_table, from, to);
 			/* change also the information within the split_count
 			   array; this is important for fast calculation later
 			 */
@@ -49,6 +49,8 @@
 #include <ctype.h>
 #include <complib/cl_debug.h>
 #include <complib/cl_qmap.h>
+#include <complib/cl_atomic.h>
+#include <complib/cl_thread.h>
 #include <opensm/osm_file_ids.h>
 #define FILE_ID OSM_FILE_UCAST_DNUP_C
 #include <opensm/osm_switch.h>
@@ -74,11 +76,31 @@ typedef struct dnup {
 struct dnup_node {
 	cl_list_item_t list;
 	osm_switch_t *sw;
-	dnup_switch_dir_t dir;
 	unsigned rank;
-	unsigned visited;
+	unsigned index;
 };
 
+/* the min hop BFS runs, one per switch, only write the hop row of the
+   starting switch lid, so they are run concurrently; each worker keeps
+   its own BFS queue and direction marks indexed by dnup_node.index
+*/
+typedef struct dnup_bfs_pool {
+	osm_log_t *p_log;
+	osm_switch_t **sws;
+	unsigned num_sws;
+	uint8_t prune_weight;
+	atomic32_t next;
+} dnup_bfs_pool_t;
+
+typedef struct dnup_bfs_worker {
+	cl_thread_t thread;
+	dnup_bfs_pool_t *pool;
+	unsigned *queue;	/* ring of num_sws + 1 switch indexes */
+	uint8_t *dir;
+	uint8_t *queued;
+	uint8_t max_hops;
+} dnup_bfs_worker_t;
+
 /* This function returns direction based on rank and guid info of current &
    remote ports */
 static dnup_switch_dir_t dnup_get_dir(unsigned cur_rank, unsigned rem_rank)
@@ -102,12 +124,13 @@ static dnup_switch_dir_t dnup_get_dir(unsigned cur_rank, unsigned rem_rank)
  * This function does the bfs of min hop table calculation by guid index
  * as a starting point.
  **********************************************************************/
-static int dnup_bfs_by_node(IN osm_log_t * p_log, IN osm_subn_t * p_subn,
-			    IN osm_switch_t * p_sw, IN uint8_t prune_weight,
-			    OUT uint8_t * max_hops)
+static int dnup_bfs_by_node(IN dnup_bfs_worker_t * w, IN osm_switch_t * p_sw)
 {
+	osm_log_t *p_log = w->pool->p_log;
+	unsigned ring_size = w->pool->num_sws + 1;
+	uint8_t prune_weight = w->pool->prune_weight;
+	unsigned head = 0, tail = 0;
 	uint8_t pn, pn_rem;
-	cl_qlist_t list;
 	uint16_t lid;
 	struct dnup_node *u;
 	dnup_switch_dir_t next_dir, current_dir;
@@ -123,17 +146,20 @@ static int dnup_bfs_by_node(IN osm_log_t * p_log, IN osm_subn_t * p_subn,
 		cl_ntoh64(p_sw->p_node->node_info.port_guid), lid);
 
 	u = p_sw->priv;
-	u->dir = DOWN;
+	w->dir[u->index] = DOWN;
 
 	/* Update list with the new element */
-	cl_qlist_init(&list);
-	cl_qlist_insert_tail(&list, &u->list);
-
-	/* BFS the list till no next element */
-	while (!cl_is_qlist_empty(&list)) {
-		u = (struct dnup_node *)cl_qlist_remove_head(&list);
-		u->visited = 0;	/* cleanup */
-		current_dir = u->dir;
+	w->queue[tail++] = u->index;
+
+	/* BFS the list till no next element; a switch is queued at most
+	   once at a time, so with a spare slot the ring never looks empty
+	   when it is full */
+	while (head != tail) {
+		u = w->pool->sws[w->queue[head]]->priv;
+		if (++head == ring_size)
+			head = 0;
+		w->queued[u->index] = 0;	/* cleanup */
+		current_dir = w->dir[u->index];
 		/* Go over all ports of the switch and find unvisited remote nodes */
 		for (pn = 1; pn < u->sw->num_ports; pn++) {
 			osm_node_t *p_remote_node;
@@ -191,21 +217,22 @@ static int dnup_bfs_by_node(IN osm_log_t * p_log, IN osm_subn_t * p_subn,
 				    osm_switch_set_hops(p_remote_sw, lid,
 							pn_rem,
 							current_min_hop + 1);
-				if(max_hops && current_min_hop + 1 > *max_hops) {
-					*max_hops = current_min_hop + 1;
-				}
+				if (!prune_weight &&
+				    current_min_hop + 1 > w->max_hops)
+					w->max_hops = current_min_hop + 1;
 				if (set_hop_return_value) {
 					OSM_LOG(p_log, OSM_LOG_ERROR, "ERR AE01: "
 						"Invalid value returned from set min hop is: %d\n",
 						set_hop_return_value);
 				}
 				/* Check if remote port has already been visited */
-				if (!rem_u->visited) {
+				if (!w->queued[rem_u->index]) {
 					/* Insert dnup_switch item into the list */
-					rem_u->dir = next_dir;
-					rem_u->visited = 1;
-					cl_qlist_insert_tail(&list,
-							     &rem_u->list);
+					w->dir[rem_u->index] = next_dir;
+					w->queued[rem_u->index] = 1;
+					w->queue[tail] = rem_u->index;
+					if (++tail == ring_size)
+						tail = 0;
 				}
 			}
 		}
@@ -215,6 +242,92 @@ static int dnup_bfs_by_node(IN osm_log_t * p_log, IN osm_subn_t * p_subn,
 	return 0;
 }
 
+static void dnup_bfs_worker_run(void *context)
+{
+	dnup_bfs_worker_t *w = context;
+	dnup_bfs_pool_t *pool = w->pool;
+	unsigned i;
+
+	while ((i = (unsigned)cl_atomic_inc(&pool->next) - 1) < pool->num_sws)
+		dnup_bfs_by_node(w, pool->sws[i]);
+}
+
+/* run dnup_bfs_by_node for all switches on num_workers threads (the
+   calling thread included); without prune_weight the largest hop count
+   found is returned in max_hops
+*/
+static int dnup_bfs_all(IN osm_log_t * p_log, IN osm_switch_t ** sws,
+			IN unsigned num_sws, IN unsigned num_workers,
+			IN uint8_t prune_weight, OUT uint8_t * max_hops)
+{
+	dnup_bfs_pool_t pool;
+	dnup_bfs_worker_t *workers, *w;
+	unsigned i, started = 0;
+	int ret = 0;
+
+	if (num_workers > num_sws)
+		num_workers = num_sws;
+	if (!num_workers)
+		return 0;
+
+	pool.p_log = p_log;
+	pool.sws = sws;
+	pool.num_sws = num_sws;
+	pool.prune_weight = prune_weight;
+	pool.next = 0;
+
+	workers = calloc(num_workers, sizeof(*workers));
+	if (!workers)
+		goto ErrorMem;
+	for (i = 0, w = workers; i < num_workers; i++, w++) {
+		w->pool = &pool;
+		cl_thread_construct(&w->thread);
+		w->queue = malloc((num_sws + 1) * sizeof(*w->queue));
+		w->dir = malloc(num_sws);
+		w->queued = calloc(num_sws, 1);
+		if (!w->queue || !w->dir || !w->queued)
+			goto ErrorMem;
+	}
+
+	if (num_workers > 1)
+		OSM_LOG(p_log, OSM_LOG_VERBOSE,
+			"Using %u threads for the min hop BFS\n", num_workers);
+
+	for (i = 1, w = workers + 1; i < num_workers; i++, w++) {
+		if (cl_thread_init(&w->thread, dnup_bfs_worker_run, w,
+				   "dnup bfs") != CL_SUCCESS) {
+			OSM_LOG(p_log, OSM_LOG_ERROR, "ERR AE03: "
+				"cannot start dnup BFS thread, "
+				"continuing with %u threads\n", started + 1);
+			break;
+		}
+		started++;
+	}
+	dnup_bfs_worker_run(workers);
+	for (i = 1; i <= started; i++)
+		cl_thread_destroy(&workers[i].thread);
+
+	if (max_hops)
+		for (i = 0; i < num_workers; i++)
+			if (workers[i].max_hops > *max_hops)
+				*max_hops = workers[i].max_hops;
+	goto Exit;
+
+ErrorMem:
+	OSM_LOG(p_log, OSM_LOG_ERROR, "ERR AE04: "
+		"cannot allocate memory for the min hop BFS\n");
+	ret = -1;
+Exit:
+	if (workers)
+		for (i = 0; i < num_workers; i++) {
+			free(workers[i].queue);
+			free(workers[i].dir);
+			free(workers[i].queued);
+		}
+	free(workers);
+	return ret;
+}
+
 /* NOTE : PLS check if we need to decide that the first */
 /*        rank is a SWITCH for BFS purpose */
 static int dnup_subn_rank(IN dnup_t * p_dnup)
@@ -296,13 +409,22 @@ static int dnup_set_min_hop_table(IN dnup_t * p_dnup)
 {
 	osm_subn_t *p_subn = &p_dnup->p_osm->subn;
 	osm_log_t *p_log = &p_dnup->p_osm->log;
-	osm_switch_t *p_sw;
-	struct dnup_node *u;
+	osm_switch_t *p_sw, **sws;
 	cl_map_item_t *item;
 	uint8_t max_hops = 0;
+	unsigned num_sws = 0, num_threads, i;
+	int ret;
 
 	OSM_LOG_ENTER(p_log);
 
+	sws = malloc(cl_qmap_count(&p_subn->sw_guid_tbl) * sizeof(*sws));
+	if (!sws) {
+		OSM_LOG(p_log, OSM_LOG_ERROR, "ERR AE05: "
+			"cannot allocate memory for the min hop BFS\n");
+		ret = -1;
+		goto Exit;
+	}
+
 	/* Go over all the switches in the subnet - for each init their Min Hop
 	   Table */
 	OSM_LOG(p_log, OSM_LOG_VERBOSE,
@@ -314,6 +436,8 @@ static int dnup_set_min_hop_table(IN dnup_t * p_dnup)
 		p_sw = (osm_switch_t *)item;
 		/* Clear Min Hop Table */
 		osm_switch_clear_hops(p_sw);
+		((struct dnup_node *)p_sw->priv)->index = num_sws;
+		sws[num_sws++] = p_sw;
 	}
 
 	OSM_LOG(p_log, OSM_LOG_VERBOSE,
@@ -323,38 +447,28 @@ static int dnup_set_min_hop_table(IN dnup_t * p_dnup)
 	OSM_LOG(p_log, OSM_LOG_VERBOSE,
 		"BFS through all port guids in the subnet [\n");
 
-	for (item = cl_qmap_head(&p_dnup->p_osm->subn.sw_guid_tbl);
-	     item != cl_qmap_end(&p_dnup->p_osm->subn.sw_guid_tbl);
-	     item = cl_qmap_next(item)) {
-		p_sw = (osm_switch_t *)item;
-		dnup_bfs_by_node(p_log, p_subn, p_sw, 0, &max_hops);
-	}
-	if(p_subn->opt.connect_roots) {
+	num_threads = p_subn->opt.routing_threads;
+	if (!num_threads)
+		num_threads = cl_proc_count();
+	ret = dnup_bfs_all(p_log, sws, num_sws, num_threads, 0, &max_hops);
+	if (!ret && p_subn->opt.connect_roots) {
 		/*This is probably not necessary, by I am more comfortable
 		 * clearing any possible side effects from the previous
 		 * dnup routing pass
 		 */
-		for (item = cl_qmap_head(&p_dnup->p_osm->subn.sw_guid_tbl);
-		     item != cl_qmap_end(&p_dnup->p_osm->subn.sw_guid_tbl);
-		     item = cl_qmap_next(item)) {
-			p_sw = (osm_switch_t *)item;
-			osm_switch_clear_hops(p_sw);
-			u = (struct dnup_node *) p_sw->priv;
-			u->visited = 0;
-		}
-		for (item = cl_qmap_head(&p_dnup->p_osm->subn.sw_guid_tbl);
-		     item != cl_qmap_end(&p_dnup->p_osm->subn.sw_guid_tbl);
-		     item = cl_qmap_next(item)) {
-			p_sw = (osm_switch_t *)item;
-			dnup_bfs_by_node(p_log, p_subn, p_sw, max_hops + 1, NULL);
-		}
+		for (i = 0; i < num_sws; i++)
+			osm_switch_clear_hops(sws[i]);
+		ret = dnup_bfs_all(p_log, sws, num_sws, num_threads,
+				   max_hops + 1, NULL);
 	}
 
 	OSM_LOG(p_log, OSM_LOG_VERBOSE,
 		"BFS through all port guids in the subnet ]\n");
 	/* Cleanup */
+	free(sws);
+Exit:
 	OSM_LOG_EXIT(p_log);
-	return 0;
+	return ret;
 }
 
 static int dnup_build_lid_matrices(IN dnup_t * p_dnup)
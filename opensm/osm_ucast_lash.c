@@ -126,46 +126,153 @@ static osm_switch_t *get_osm_switch_from_port(const osm_port_t * port)
 	return NULL;
 }
 
-static int cycle_exists(cdg_vertex_t * start, cdg_vertex_t * current,
-			cdg_vertex_t * prev, int visit_num)
+static void cdg_topo_compact(cdg_topo_t * t)
 {
-	int i, new_visit_num;
-	int cycle_found = 0;
+	int i, n = 0;
+
+	for (i = 0; i < t->len; i++)
+		if (t->order[i]) {
+			t->order[n] = t->order[i];
+			t->order[n]->topo_index = n;
+			n++;
+		}
+	t->len = n;
+}
 
-	if (current != NULL && current->visiting_number > 0) {
-		if (visit_num > current->visiting_number && current->seen == 0) {
-			cycle_found = 1;
+/* new vertices have no dependencies yet, so they go at the end */
+static int cdg_topo_add_vertex(lash_t * p_lash, int lane, cdg_vertex_t * v)
+{
+	cdg_topo_t *t = &p_lash->topo[lane];
+	cdg_vertex_t **order;
+	int size;
+
+	if (t->len == t->size) {
+		cdg_topo_compact(t);
+		if (t->len >= t->size / 2) {
+			size = t->size ? 2 * t->size : 64;
+			order = realloc(t->order, size * sizeof(*order));
+			if (!order)
+				return -1;
+			t->order = order;
+			t->size = size;
 		}
-	} else {
-		if (current == NULL) {
-			current = start;
-			CL_ASSERT(prev == NULL);
+		if (t->size > p_lash->topo_scratch_size) {
+			order = realloc(p_lash->topo_stack,
+					t->size * sizeof(*order));
+			if (!order)
+				return -1;
+			p_lash->topo_stack = order;
+			order = realloc(p_lash->topo_buf,
+					t->size * sizeof(*order));
+			if (!order)
+				return -1;
+			p_lash->topo_buf = order;
+			p_lash->topo_scratch_size = t->size;
 		}
+	}
 
-		current->visiting_number = visit_num;
+	v->topo_index = t->len;
+	t->order[t->len++] = v;
+	return 0;
+}
 
-		if (prev != NULL) {
-			prev->next = current;
-			CL_ASSERT(prev->to == current->from);
-			CL_ASSERT(prev->visiting_number > 0);
-		}
+static void cdg_topo_remove_vertex(lash_t * p_lash, int lane, cdg_vertex_t * v)
+{
+	p_lash->topo[lane].order[v->topo_index] = NULL;
+}
 
-		new_visit_num = visit_num + 1;
+/*
+  new vertices start with visit 0, so 0 is never handed out as a stamp;
+  should the counter wrap all the stamps are cleared first
+*/
+static unsigned cdg_topo_next_visit(lash_t * p_lash)
+{
+	cdg_topo_t *t;
+	int lane, i;
+
+	if (++p_lash->topo_visit)
+		return p_lash->topo_visit;
+
+	for (lane = 0; lane < IB_MAX_NUM_VLS; lane++) {
+		t = &p_lash->topo[lane];
+		for (i = 0; i < t->len; i++)
+			if (t->order[i])
+				t->order[i]->visit = 0;
+	}
+	return ++p_lash->topo_visit;
+}
 
-		for (i = 0; i < current->num_deps; i++) {
-			cycle_found =
-			    cycle_exists(start, current->deps[i].v, current,
-					 new_visit_num);
-			if (cycle_found == 1)
-				i = current->num_deps;
+/*
+  the dependency from -> to was just added; when it goes against the
+  current order, search forward from 'to' among the vertices placed
+  before 'from': reaching 'from' means a cycle, otherwise the reached
+  vertices are moved right behind 'from' and the order stays valid.
+  After a cycle the order is only maintained again once the tentative
+  dependencies have been removed, so the search is skipped until then.
+*/
+static void cdg_topo_add_dep(lash_t * p_lash, int lane, cdg_vertex_t * from,
+			     cdg_vertex_t * to)
+{
+	cdg_topo_t *t = &p_lash->topo[lane];
+	cdg_vertex_t **stack = p_lash->topo_stack, **buf = p_lash->topo_buf;
+	cdg_vertex_t *v, *w;
+	int lb = to->topo_index, ub = from->topo_index;
+	int i, n, pos, num_reached = 0;
+	unsigned visit;
+
+	if (t->cycle || lb > ub)
+		return;
+	if (lb == ub) {
+		t->cycle = 1;
+		return;
+	}
+
+	visit = cdg_topo_next_visit(p_lash);
+	to->visit = visit;
+	stack[0] = to;
+	n = 1;
+	while (n) {
+		v = stack[--n];
+		for (i = 0; i < v->num_deps; i++) {
+			w = v->deps[i].v;
+			if (w == from) {
+				t->cycle = 1;
+				return;
+			}
+			if (w->visit != visit && w->topo_index < ub) {
+				w->visit = visit;
+				stack[n++] = w;
+			}
 		}
+	}
 
-		current->seen = 1;
-		if (prev != NULL)
-			prev->next = NULL;
+	for (i = lb, pos = lb; i <= ub; i++) {
+		v = t->order[i];
+		if (!v)
+			continue;
+		if (v->visit == visit)
+			buf[num_reached++] = v;
+		else {
+			v->topo_index = pos;
+			t->order[pos++] = v;
+		}
 	}
+	for (i = 0; i < num_reached; i++) {
+		buf[i]->topo_index = pos;
+		t->order[pos++] = buf[i];
+	}
+	for (; pos <= ub; pos++)
+		t->order[pos] = NULL;
+}
+
+/* report whether the dependencies added since the last call closed a
+   cycle in this lane */
+static int cdg_topo_take_cycle(lash_t * p_lash, int lane)
+{
+	int cycle = p_lash->topo[lane].cycle;
 
-	return cycle_found;
+	p_lash->topo[lane].cycle = 0;
+	return cycle;
 }
 
 static inline int get_next_switch(lash_t *p_lash, int sw, int link)
@@ -173,26 +280,34 @@ static inline int get_next_switch(lash_t *p_lash, int sw, int link)
 	return p_lash->switches[sw]->node->links[link]->switch_id;
 }
 
+/* CDG vertices are the channels leaving sw through one of its links */
+static inline cdg_vertex_t **get_cdg_vertex(lash_t * p_lash, int lane, int sw,
+					    int link)
+{
+	return &p_lash->cdg_vertices[lane][p_lash->switches[sw]->chan_base +
+					   link];
+}
+
 static void remove_semipermanent_depend_for_sp(lash_t * p_lash, int sw,
 					       int dest_switch, int lane)
 {
 	switch_t **switches = p_lash->switches;
-	cdg_vertex_t ****cdg_vertex_matrix = p_lash->cdg_vertex_matrix;
-	int i_next_switch, output_link, i, next_link, i_next_next_switch,
-	    depend = 0;
-	cdg_vertex_t *v;
+	int i_next_switch, output_link, i, next_link, depend = 0;
+	cdg_vertex_t **pv, *v, *next_v;
 	int __attribute__((unused)) found;
 
 	output_link = switches[sw]->routing_table[dest_switch].out_link;
 	i_next_switch = get_next_switch(p_lash, sw, output_link);
 
 	while (sw != dest_switch) {
-		v = cdg_vertex_matrix[lane][sw][i_next_switch];
+		pv = get_cdg_vertex(p_lash, lane, sw, output_link);
+		v = *pv;
 		CL_ASSERT(v != NULL);
 
 		if (v->num_using_vertex == 1) {
 
-			cdg_vertex_matrix[lane][sw][i_next_switch] = NULL;
+			*pv = NULL;
+			cdg_topo_remove_vertex(p_lash, lane, v);
 
 			free(v);
 		} else {
@@ -200,13 +315,13 @@ static void remove_semipermanent_depend_for_sp(lash_t * p_lash, int sw,
 			if (i_next_switch != dest_switch) {
 				next_link =
 				    switches[i_next_switch]->routing_table[dest_switch].out_link;
-				i_next_next_switch = get_next_switch(p_lash, i_next_switch, next_link);
+				next_v = *get_cdg_vertex(p_lash, lane,
+							 i_next_switch,
+							 next_link);
 				found = 0;
 
 				for (i = 0; i < v->num_deps; i++)
-					if (v->deps[i].v ==
-					    cdg_vertex_matrix[lane][i_next_switch]
-					    [i_next_next_switch]) {
+					if (v->deps[i].v == next_v) {
 						found = 1;
 						depend = i;
 					}
@@ -327,27 +442,34 @@ static int generate_routing_func_for_mst(lash_t * p_lash, int sw_id,
 static int generate_cdg_for_sp(lash_t * p_lash, int sw, int dest_switch,
 			       int lane)
 {
-	unsigned num_switches = p_lash->num_switches;
 	switch_t **switches = p_lash->switches;
-	cdg_vertex_t ****cdg_vertex_matrix = p_lash->cdg_vertex_matrix;
 	int next_switch, output_link, j, exists;
-	cdg_vertex_t *v, *prev = NULL;
+	cdg_vertex_t **pv, *v, *prev = NULL;
 
 	output_link = switches[sw]->routing_table[dest_switch].out_link;
 	next_switch = get_next_switch(p_lash, sw, output_link);
 
 	while (sw != dest_switch) {
 
-		if (cdg_vertex_matrix[lane][sw][next_switch] == NULL) {
-			v = calloc(1, sizeof(*v) + (num_switches - 1) * sizeof(v->deps[0]));
+		pv = get_cdg_vertex(p_lash, lane, sw, output_link);
+		if (*pv == NULL) {
+			/* a channel only depends on channels leaving the
+			   switch it leads to */
+			v = calloc(1, sizeof(*v) +
+				   switches[next_switch]->node->num_links *
+				   sizeof(v->deps[0]));
 			if (!v)
 				return -1;
 			v->from = sw;
 			v->to = next_switch;
 			v->temp = 1;
-			cdg_vertex_matrix[lane][sw][next_switch] = v;
+			if (cdg_topo_add_vertex(p_lash, lane, v)) {
+				free(v);
+				return -1;
+			}
+			*pv = v;
 		} else
-			v = cdg_vertex_matrix[lane][sw][next_switch];
+			v = *pv;
 
 		v->num_using_vertex++;
 
@@ -361,15 +483,17 @@ static int generate_cdg_for_sp(lash_t * p_lash, int sw, int dest_switch,
 				}
 
 			if (exists == 0) {
+				CL_ASSERT(prev->num_deps <
+					  (int)switches[sw]->node->num_links);
+
 				prev->deps[prev->num_deps].v = v;
 				prev->deps[prev->num_deps].num_used++;
 				prev->num_deps++;
 
-				CL_ASSERT(prev->num_deps < (int)num_switches);
-
 				if (prev->temp == 0)
 					prev->num_temp_depend++;
 
+				cdg_topo_add_dep(p_lash, lane, prev, v);
 			}
 		}
 
@@ -390,15 +514,13 @@ static void set_temp_depend_to_permanent_for_sp(lash_t * p_lash, int sw,
 						int dest_switch, int lane)
 {
 	switch_t **switches = p_lash->switches;
-	cdg_vertex_t ****cdg_vertex_matrix = p_lash->cdg_vertex_matrix;
-	int next_switch, output_link;
+	int output_link;
 	cdg_vertex_t *v;
 
 	output_link = switches[sw]->routing_table[dest_switch].out_link;
-	next_switch = get_next_switch(p_lash, sw, output_link);
 
 	while (sw != dest_switch) {
-		v = cdg_vertex_matrix[lane][sw][next_switch];
+		v = *get_cdg_vertex(p_lash, lane, sw, output_link);
 		CL_ASSERT(v != NULL);
 
 		if (v->temp == 1)
@@ -406,11 +528,8 @@ static void set_temp_depend_to_permanent_for_sp(lash_t * p_lash, int sw,
 		else
 			v->num_temp_depend = 0;
 
-		sw = next_switch;
+		sw = get_next_switch(p_lash, sw, output_link);
 		output_link = switches[sw]->routing_table[dest_switch].out_link;
-
-		if (sw != dest_switch)
-			next_switch = get_next_switch(p_lash, sw, output_link);
 	}
 
 }
@@ -419,19 +538,19 @@ static void remove_temp_depend_for_sp(lash_t * p_lash, int sw, int dest_switch,
 				      int lane)
 {
 	switch_t **switches = p_lash->switches;
-	cdg_vertex_t ****cdg_vertex_matrix = p_lash->cdg_vertex_matrix;
-	int next_switch, output_link, i;
-	cdg_vertex_t *v;
+	int output_link, i;
+	cdg_vertex_t **pv, *v;
 
 	output_link = switches[sw]->routing_table[dest_switch].out_link;
-	next_switch = get_next_switch(p_lash, sw, output_link);
 
 	while (sw != dest_switch) {
-		v = cdg_vertex_matrix[lane][sw][next_switch];
+		pv = get_cdg_vertex(p_lash, lane, sw, output_link);
+		v = *pv;
 		CL_ASSERT(v != NULL);
 
 		if (v->temp == 1) {
-			cdg_vertex_matrix[lane][sw][next_switch] = NULL;
+			*pv = NULL;
+			cdg_topo_remove_vertex(p_lash, lane, v);
 			free(v);
 		} else {
 			CL_ASSERT(v->num_temp_depend <= v->num_deps);
@@ -439,34 +558,37 @@ static void remove_temp_depend_for_sp(lash_t * p_lash, int sw, int dest_switch,
 			v->num_temp_depend = 0;
 			v->num_using_vertex--;
 
-			for (i = v->num_deps; i < p_lash->num_switches - 1; i++)
+			for (i = v->num_deps;
+			     i < (int)switches[v->to]->node->num_links; i++)
 				v->deps[i].num_used = 0;
 		}
 
-		sw = next_switch;
+		sw = get_next_switch(p_lash, sw, output_link);
 		output_link = switches[sw]->routing_table[dest_switch].out_link;
-
-		if (sw != dest_switch)
-			next_switch = get_next_switch(p_lash, sw, output_link);
-
 	}
 }
 
+/* pair currently routed on lane which was not yet tried in this round */
+static inline int pair_movable(lash_t * p_lash, uint8_t * failed, int src,
+			       int dest, int lane)
+{
+	return src != dest && !failed[src * p_lash->num_switches + dest] &&
+	    p_lash->switches[src]->routing_table[dest].lane ==
+	    lane + p_lash->p_osm->subn.opt.lash_start_vl;
+}
+
 static int balance_virtual_lanes(lash_t * p_lash, unsigned lanes_needed)
 {
 	unsigned num_switches = p_lash->num_switches;
-	cdg_vertex_t ****cdg_vertex_matrix = p_lash->cdg_vertex_matrix;
 	int *num_mst_in_lane = p_lash->num_mst_in_lane;
-	int ***virtual_location = p_lash->virtual_location;
 	int min_filled_lane, max_filled_lane, trials;
 	int old_min_filled_lane, old_max_filled_lane, new_num_min_lane,
 	    new_num_max_lane;
-	unsigned int i, j;
-	int src, dest, start, next_switch, output_link;
-	int next_switch2, output_link2;
+	unsigned int i;
+	int src, dest, start;
 	int stop = 0, cycle_found;
-	int cycle_found2;
 	unsigned start_vl = p_lash->p_osm->subn.opt.lash_start_vl;
+	uint8_t *failed = NULL;	/* pairs which could not be moved */
 
 	max_filled_lane = 0;
 	min_filled_lane = lanes_needed - 1;
@@ -474,12 +596,18 @@ static int balance_virtual_lanes(lash_t * p_lash, unsigned lanes_needed)
 	trials = num_mst_in_lane[max_filled_lane];
 	if (lanes_needed == 1)
 		stop = 1;
+	else {
+		failed = calloc(num_switches * num_switches, sizeof(*failed));
+		if (!failed)
+			return -1;
+	}
 
 	while (stop == 0) {
 		src = abs(rand()) % (num_switches);
 		dest = abs(rand()) % (num_switches);
 
-		while (virtual_location[src][dest][max_filled_lane] != 1) {
+		while (!pair_movable(p_lash, failed, src, dest,
+				     max_filled_lane)) {
 			start = dest;
 			if (dest == num_switches - 1)
 				dest = 0;
@@ -487,15 +615,16 @@ static int balance_virtual_lanes(lash_t * p_lash, unsigned lanes_needed)
 				dest++;
 
 			while (dest != start
-			       && virtual_location[src][dest][max_filled_lane]
-			       != 1) {
+			       && !pair_movable(p_lash, failed, src, dest,
+						max_filled_lane)) {
 				if (dest == num_switches - 1)
 					dest = 0;
 				else
 					dest++;
 			}
 
-			if (virtual_location[src][dest][max_filled_lane] != 1) {
+			if (!pair_movable(p_lash, failed, src, dest,
+					  max_filled_lane)) {
 				if (src == num_switches - 1)
 					src = 0;
 				else
@@ -504,39 +633,19 @@ static int balance_virtual_lanes(lash_t * p_lash, unsigned lanes_needed)
 		}
 
 		if (generate_cdg_for_sp(p_lash, src, dest, min_filled_lane) ||
-		    generate_cdg_for_sp(p_lash, dest, src, min_filled_lane))
+		    generate_cdg_for_sp(p_lash, dest, src, min_filled_lane)) {
+			free(failed);
 			return -1;
+		}
 
-		output_link = p_lash->switches[src]->routing_table[dest].out_link;
-		next_switch = get_next_switch(p_lash, src, output_link);
-
-		output_link2 = p_lash->switches[dest]->routing_table[src].out_link;
-		next_switch2 = get_next_switch(p_lash, dest, output_link2);
-
-		CL_ASSERT(cdg_vertex_matrix[min_filled_lane][src][next_switch] != NULL);
-		CL_ASSERT(cdg_vertex_matrix[min_filled_lane][dest][next_switch2] != NULL);
-
-		cycle_found =
-		    cycle_exists(cdg_vertex_matrix[min_filled_lane][src][next_switch], NULL, NULL,
-				 1);
-		cycle_found2 =
-		    cycle_exists(cdg_vertex_matrix[min_filled_lane][dest][next_switch2], NULL, NULL,
-				 1);
-
-		for (i = 0; i < num_switches; i++)
-			for (j = 0; j < num_switches; j++)
-				if (cdg_vertex_matrix[min_filled_lane][i][j] != NULL) {
-					cdg_vertex_matrix[min_filled_lane][i][j]->visiting_number =
-					    0;
-					cdg_vertex_matrix[min_filled_lane][i][j]->seen = 0;
-				}
+		cycle_found = cdg_topo_take_cycle(p_lash, min_filled_lane);
 
-		if (cycle_found == 1 || cycle_found2 == 1) {
+		if (cycle_found == 1) {
 			remove_temp_depend_for_sp(p_lash, src, dest, min_filled_lane);
 			remove_temp_depend_for_sp(p_lash, dest, src, min_filled_lane);
 
-			virtual_location[src][dest][max_filled_lane] = 2;
-			virtual_location[dest][src][max_filled_lane] = 2;
+			failed[src * num_switches + dest] = 1;
+			failed[dest * num_switches + src] = 1;
 			trials--;
 			trials--;
 		} else {
@@ -550,10 +659,6 @@ static int balance_virtual_lanes(lash_t * p_lash, unsigned lanes_needed)
 
 			remove_semipermanent_depend_for_sp(p_lash, src, dest, max_filled_lane);
 			remove_semipermanent_depend_for_sp(p_lash, dest, src, max_filled_lane);
-			virtual_location[src][dest][max_filled_lane] = 0;
-			virtual_location[dest][src][max_filled_lane] = 0;
-			virtual_location[src][dest][min_filled_lane] = 1;
-			virtual_location[dest][src][min_filled_lane] = 1;
 			p_lash->switches[src]->routing_table[dest].lane = min_filled_lane + start_vl;
 			p_lash->switches[dest]->routing_table[src].lane = min_filled_lane + start_vl;
 		}
@@ -585,22 +690,15 @@ static int balance_virtual_lanes(lash_t * p_lash, unsigned lanes_needed)
 			}
 		}
 
-		if (old_min_filled_lane != min_filled_lane) {
+		/* the failed pairs all belong to the old fullest lane */
+		if (old_min_filled_lane != min_filled_lane ||
+		    old_max_filled_lane != max_filled_lane) {
 			trials = num_mst_in_lane[max_filled_lane];
-			for (i = 0; i < num_switches; i++)
-				for (j = 0; j < num_switches; j++)
-					if (virtual_location[i][j][max_filled_lane] == 2)
-						virtual_location[i][j][max_filled_lane] = 1;
-		}
-
-		if (old_max_filled_lane != max_filled_lane) {
-			trials = num_mst_in_lane[max_filled_lane];
-			for (i = 0; i < num_switches; i++)
-				for (j = 0; j < num_switches; j++)
-					if (virtual_location[i][j][old_max_filled_lane] == 2)
-						virtual_location[i][j][old_max_filled_lane] = 1;
+			memset(failed, 0,
+			       num_switches * num_switches * sizeof(*failed));
 		}
 	}
+	free(failed);
 	return 0;
 }
 
@@ -660,41 +758,36 @@ static void delete_mesh_switches(lash_t *p_lash)
 
 static void free_lash_structures(lash_t * p_lash)
 {
-	unsigned int i, j, k;
-	unsigned num_switches = p_lash->num_switches;
+	unsigned int i, j;
 	osm_log_t *p_log = &p_lash->p_osm->log;
 
 	OSM_LOG_ENTER(p_log);
 
 	delete_mesh_switches(p_lash);
 
-	/* free cdg_vertex_matrix */
-	for (i = 0; i < p_lash->vl_min; i++) {
-		for (j = 0; j < num_switches; j++) {
-			for (k = 0; k < num_switches; k++)
-				if (p_lash->cdg_vertex_matrix[i][j][k])
-					free(p_lash->cdg_vertex_matrix[i][j][k]);
-			if (p_lash->cdg_vertex_matrix[i][j])
-				free(p_lash->cdg_vertex_matrix[i][j]);
+	/* free cdg_vertices */
+	if (p_lash->cdg_vertices) {
+		for (i = 0; i < p_lash->vl_min; i++) {
+			if (!p_lash->cdg_vertices[i])
+				continue;
+			for (j = 0; j < p_lash->num_channels; j++)
+				if (p_lash->cdg_vertices[i][j])
+					free(p_lash->cdg_vertices[i][j]);
+			free(p_lash->cdg_vertices[i]);
 		}
-		if (p_lash->cdg_vertex_matrix[i])
-			free(p_lash->cdg_vertex_matrix[i]);
+		free(p_lash->cdg_vertices);
+		p_lash->cdg_vertices = NULL;
 	}
 
-	if (p_lash->cdg_vertex_matrix)
-		free(p_lash->cdg_vertex_matrix);
-
-	/* free virtual_location */
-	for (i = 0; i < num_switches; i++) {
-		for (j = 0; j < num_switches; j++) {
-			if (p_lash->virtual_location[i][j])
-				free(p_lash->virtual_location[i][j]);
-		}
-		if (p_lash->virtual_location[i])
-			free(p_lash->virtual_location[i]);
-	}
-	if (p_lash->virtual_location)
-		free(p_lash->virtual_location);
+	/* free the per lane topological orders */
+	for (i = 0; i < IB_MAX_NUM_VLS; i++)
+		free(p_lash->topo[i].order);
+	memset(p_lash->topo, 0, sizeof(p_lash->topo));
+	free(p_lash->topo_stack);
+	free(p_lash->topo_buf);
+	p_lash->topo_stack = p_lash->topo_buf = NULL;
+	p_lash->topo_scratch_size = 0;
+	p_lash->topo_visit = 0;
 
 	OSM_LOG_EXIT(p_log);
 }
@@ -705,62 +798,29 @@ static int init_lash_structures(lash_t * p_lash)
 	unsigned num_switches = p_lash->num_switches;
 	osm_log_t *p_log = &p_lash->p_osm->log;
 	int status = 0;
-	unsigned int i, j, k;
+	unsigned int i;
 
 	OSM_LOG_ENTER(p_log);
 
-	/* initialise cdg_vertex_matrix[num_layers][num_switches][num_switches] */
-	p_lash->cdg_vertex_matrix =
-	    (cdg_vertex_t ****) malloc(vl_min * sizeof(cdg_vertex_t ***));
-	if (p_lash->cdg_vertex_matrix == NULL)
-		goto Exit_Mem_Error;
-	for (i = 0; i < vl_min; i++) {
-		p_lash->cdg_vertex_matrix[i] =
-		    (cdg_vertex_t ***) malloc(num_switches *
-					      sizeof(cdg_vertex_t **));
-
-		if (p_lash->cdg_vertex_matrix[i] == NULL)
-			goto Exit_Mem_Error;
-	}
-
-	for (i = 0; i < vl_min; i++) {
-		for (j = 0; j < num_switches; j++) {
-			p_lash->cdg_vertex_matrix[i][j] =
-			    (cdg_vertex_t **) malloc(num_switches *
-						     sizeof(cdg_vertex_t *));
-			if (p_lash->cdg_vertex_matrix[i][j] == NULL)
-				goto Exit_Mem_Error;
-
-			for (k = 0; k < num_switches; k++)
-				p_lash->cdg_vertex_matrix[i][j][k] = NULL;
-		}
-	}
-
 	/*
-	 * initialise virtual_location[num_switches][num_switches][num_layers],
-	 * default value = 0
+	 * number the channels, i.e. the switch to switch links, so that
+	 * the CDG of each lane only holds a slot per physical channel
 	 */
-	p_lash->virtual_location =
-	    (int ***)malloc(num_switches * sizeof(int ***));
-	if (p_lash->virtual_location == NULL)
-		goto Exit_Mem_Error;
-
+	p_lash->num_channels = 0;
 	for (i = 0; i < num_switches; i++) {
-		p_lash->virtual_location[i] =
-		    (int **)malloc(num_switches * sizeof(int **));
-		if (p_lash->virtual_location[i] == NULL)
-			goto Exit_Mem_Error;
+		p_lash->switches[i]->chan_base = p_lash->num_channels;
+		p_lash->num_channels += p_lash->switches[i]->node->num_links;
 	}
 
-	for (i = 0; i < num_switches; i++) {
-		for (j = 0; j < num_switches; j++) {
-			p_lash->virtual_location[i][j] =
-			    (int *)malloc(vl_min * sizeof(int *));
-			if (p_lash->virtual_location[i][j] == NULL)
-				goto Exit_Mem_Error;
-			for (k = 0; k < vl_min; k++)
-				p_lash->virtual_location[i][j][k] = 0;
-		}
+	/* initialise cdg_vertices[num_layers][num_channels] */
+	p_lash->cdg_vertices = calloc(vl_min, sizeof(cdg_vertex_t **));
+	if (p_lash->cdg_vertices == NULL)
+		goto Exit_Mem_Error;
+	for (i = 0; i < vl_min; i++) {
+		p_lash->cdg_vertices[i] = calloc(p_lash->num_channels,
+						 sizeof(cdg_vertex_t *));
+		if (p_lash->cdg_vertices[i] == NULL)
+			goto Exit_Mem_Error;
 	}
 
 	/* initialise num_mst_in_lane[num_switches], default 0 */
@@ -786,15 +846,12 @@ static int lash_core(lash_t * p_lash)
 	unsigned num_switches = p_lash->num_switches;
 	switch_t **switches = p_lash->switches;
 	unsigned lanes_needed = 1;
-	unsigned int i, j, k, dest_switch = 0;
+	unsigned int i, j, dest_switch = 0;
 	reachable_dest_t *dests, *idest;
 	int cycle_found = 0;
 	unsigned v_lane;
-	int stop = 0, output_link, i_next_switch;
-	int output_link2, i_next_switch2;
-	int cycle_found2 = 0;
+	int stop = 0;
 	int status = -1;
-	int *switch_bitmap = NULL;	/* Bitmap to check if we have processed this pair */
 	unsigned start_vl = p_lash->p_osm->subn.opt.lash_start_vl;
 
 	OSM_LOG_ENTER(p_log);
@@ -826,16 +883,10 @@ static int lash_core(lash_t * p_lash)
 		}
 	}
 
-	switch_bitmap = calloc(num_switches * num_switches, sizeof(int));
-	if (!switch_bitmap) {
-		OSM_LOG(p_log, OSM_LOG_ERROR, "ERR 4D04: "
-			"Failed allocating switch_bitmap - out of memory\n");
-		goto Exit;
-	}
-
 	for (i = 0; i < num_switches; i++) {
 		for (dest_switch = 0; dest_switch < num_switches; dest_switch++)
-			if (dest_switch != i && switch_bitmap[i * num_switches + dest_switch] == 0) {
+			if (dest_switch != i &&
+			    switches[i]->routing_table[dest_switch].lane == NONE) {
 				v_lane = 0;
 				stop = 0;
 				while (v_lane < lanes_needed && stop == 0) {
@@ -846,44 +897,9 @@ static int lash_core(lash_t * p_lash)
 						goto Exit;
 					}
 
-					output_link =
-					    switches[i]->routing_table[dest_switch].out_link;
-					output_link2 =
-					    switches[dest_switch]->routing_table[i].out_link;
-
-					i_next_switch = get_next_switch(p_lash, i, output_link);
-					i_next_switch2 = get_next_switch(p_lash, dest_switch, output_link2);
-
-					CL_ASSERT(p_lash->
-						  cdg_vertex_matrix[v_lane][i][i_next_switch] !=
-						  NULL);
-					CL_ASSERT(p_lash->
-						  cdg_vertex_matrix[v_lane][dest_switch]
-						  [i_next_switch2] != NULL);
-
-					cycle_found =
-					    cycle_exists(p_lash->
-							 cdg_vertex_matrix[v_lane][i]
-							 [i_next_switch], NULL, NULL, 1);
-					cycle_found2 =
-					    cycle_exists(p_lash->
-							 cdg_vertex_matrix[v_lane][dest_switch]
-							 [i_next_switch2], NULL, NULL, 1);
-
-					for (j = 0; j < num_switches; j++)
-						for (k = 0; k < num_switches; k++)
-							if (p_lash->
-							    cdg_vertex_matrix[v_lane][j][k] !=
-							    NULL) {
-								p_lash->
-								    cdg_vertex_matrix[v_lane][j]
-								    [k]->visiting_number = 0;
-								p_lash->
-								    cdg_vertex_matrix[v_lane][j]
-								    [k]->seen = 0;
-							}
-
-					if (cycle_found == 1 || cycle_found2 == 1) {
+					cycle_found = cdg_topo_take_cycle(p_lash, v_lane);
+
+					if (cycle_found == 1) {
 						remove_temp_depend_for_sp(p_lash, i, dest_switch,
 									  v_lane);
 						remove_temp_depend_for_sp(p_lash, dest_switch, i,
@@ -905,7 +921,7 @@ static int lash_core(lash_t * p_lash)
 				switches[i]->routing_table[dest_switch].lane = v_lane + start_vl;
 				switches[dest_switch]->routing_table[i].lane = v_lane + start_vl;
 
-				if (cycle_found == 1 || cycle_found2 == 1) {
+				if (cycle_found == 1) {
 					if (++lanes_needed > p_lash->vl_min)
 						goto Error_Not_Enough_Lanes;
 
@@ -915,6 +931,8 @@ static int lash_core(lash_t * p_lash)
 							"ERR 4D08: generate_cdg_for_sp failed\n");
 						goto Exit;
 					}
+					/* a single pair on an empty lane is acyclic */
+					cdg_topo_take_cycle(p_lash, v_lane);
 
 					set_temp_depend_to_permanent_for_sp(p_lash, i, dest_switch,
 									    v_lane);
@@ -924,11 +942,6 @@ static int lash_core(lash_t * p_lash)
 					p_lash->num_mst_in_lane[v_lane]++;
 					p_lash->num_mst_in_lane[v_lane]++;
 				}
-				p_lash->virtual_location[i][dest_switch][v_lane] = 1;
-				p_lash->virtual_location[dest_switch][i][v_lane] = 1;
-
-				switch_bitmap[i * num_switches + dest_switch] = 1;
-				switch_bitmap[dest_switch * num_switches + i] = 1;
 			}
 	}
 
@@ -957,8 +970,6 @@ Error_Not_Enough_Lanes:
 		" with starting lane (%d)\n",
 		lanes_needed, p_lash->vl_min, start_vl);
 Exit:
-	if (switch_bitmap)
-		free(switch_bitmap);
 	OSM_LOG_EXIT(p_log);
 	return status;
 }
@@ -1230,12 +1241,12 @@ static int lash_process(void *context)
 	if (status)
 		goto Exit;
 
+	process_switches(p_lash);
+
 	status = init_lash_structures(p_lash);
 	if (status)
 		goto Exit;
 
-	process_switches(p_lash);
-
 	status = lash_core(p_lash);
 	if (status)
 		goto Exit;
@@ -51,6 +51,7 @@
 #include <complib/cl_qmap.h>
 #include <complib/cl_debug.h>
 #include <complib/cl_qlist.h>
+#include <complib/cl_timer.h>
 #include <opensm/osm_file_ids.h>
 #define FILE_ID OSM_FILE_UCAST_MGR_C
 #include <opensm/osm_ucast_mgr.h>
@@ -444,6 +445,267 @@ static void ucast_mgr_process_neighbors(IN cl_map_item_t * p_map_item,
 	OSM_LOG_EXIT(p_mgr->p_log);
 }
 
+/**********************************************************************
+ Min hop tables propagation driven by dirty bitsets: a switch only
+ absorbs the LIDs of a neighbor whose least hop count has changed since
+ it last looked at that neighbor, instead of all LIDs of all neighbors.
+ The rounds visit the switches in the same order as the full iteration
+ and yield exactly the same hops tables after each round.
+**********************************************************************/
+typedef struct hop_frontier {
+	osm_switch_t **sw;	/* switch index -> switch */
+	uint32_t *sw_lid;	/* switch index -> LID index */
+	uint32_t *nbr_off;	/* switch index -> first entry in nbr */
+	uint32_t *nbr;		/* per port 1..num_ports-1: neighbor index */
+	uint8_t *healthy;	/* per port 1..num_ports-1: propagate over it */
+	uint16_t *lid;		/* LID index -> base LID (host order) */
+	uint32_t num_sw;
+	uint32_t num_lids;
+	uint32_t words;		/* 64 bit words per switch bitset */
+	uint64_t *dirty;	/* LIDs changed in the previous round */
+	uint64_t *next;		/* LIDs changed in the current round */
+} hop_frontier_t;
+
+static void hop_frontier_destroy(hop_frontier_t * f)
+{
+	free(f->sw);
+	free(f->sw_lid);
+	free(f->nbr_off);
+	free(f->nbr);
+	free(f->healthy);
+	free(f->lid);
+	free(f->dirty);
+	free(f->next);
+}
+
+static uint32_t hop_frontier_find(hop_frontier_t * f, osm_switch_t * p_sw)
+{
+	uint32_t i;
+
+	for (i = 0; i < f->num_sw; i++)
+		if (f->sw[i] == p_sw)
+			return i;
+	return UINT32_MAX;
+}
+
+static int hop_frontier_init(hop_frontier_t * f, cl_qmap_t * p_sw_guid_tbl)
+{
+	osm_switch_t *p_sw;
+	osm_node_t *p_remote_node;
+	osm_physp_t *p_physp;
+	uint32_t *lid_to_idx = NULL, *sw_by_lid = NULL;
+	uint32_t i, n, num_nbr = 0;
+	uint16_t lid, max_lid = 0;
+	uint8_t port_num, remote_port_num;
+
+	memset(f, 0, sizeof(*f));
+	f->num_sw = cl_qmap_count(p_sw_guid_tbl);
+
+	f->sw = malloc(f->num_sw * sizeof(f->sw[0]));
+	f->sw_lid = malloc(f->num_sw * sizeof(f->sw_lid[0]));
+	f->nbr_off = malloc((f->num_sw + 1) * sizeof(f->nbr_off[0]));
+	f->lid = malloc(f->num_sw * sizeof(f->lid[0]));
+	if (!f->sw || !f->sw_lid || !f->nbr_off || !f->lid)
+		goto ERROR;
+
+	i = 0;
+	for (p_sw = (osm_switch_t *) cl_qmap_head(p_sw_guid_tbl);
+	     p_sw != (osm_switch_t *) cl_qmap_end(p_sw_guid_tbl);
+	     p_sw = (osm_switch_t *) cl_qmap_next(&p_sw->map_item)) {
+		f->sw[i] = p_sw;
+		f->nbr_off[i] = num_nbr;
+		num_nbr += p_sw->num_ports ? p_sw->num_ports - 1 : 0;
+		lid = cl_ntoh16(osm_node_get_base_lid(p_sw->p_node, 0));
+		if (lid > max_lid)
+			max_lid = lid;
+		i++;
+	}
+	f->nbr_off[i] = num_nbr;
+
+	/* switches that don't have a LID yet all share the entry of LID 0,
+	   so the bitsets are indexed by distinct LID rather than by switch
+	 */
+	lid_to_idx = malloc((max_lid + 1) * sizeof(lid_to_idx[0]));
+	sw_by_lid = malloc((max_lid + 1) * sizeof(sw_by_lid[0]));
+	if (!lid_to_idx || !sw_by_lid)
+		goto ERROR;
+	memset(lid_to_idx, 0xff, (max_lid + 1) * sizeof(lid_to_idx[0]));
+	memset(sw_by_lid, 0xff, (max_lid + 1) * sizeof(sw_by_lid[0]));
+	for (i = 0; i < f->num_sw; i++) {
+		lid = cl_ntoh16(osm_node_get_base_lid(f->sw[i]->p_node, 0));
+		if (lid_to_idx[lid] == UINT32_MAX) {
+			lid_to_idx[lid] = f->num_lids;
+			f->lid[f->num_lids++] = lid;
+		}
+		f->sw_lid[i] = lid_to_idx[lid];
+		/* several switches may still have LID 0 */
+		if (lid && sw_by_lid[lid] == UINT32_MAX)
+			sw_by_lid[lid] = i;
+	}
+
+	f->words = (f->num_lids + 63) / 64;
+	f->dirty = calloc(f->num_sw * f->words, sizeof(f->dirty[0]));
+	f->next = calloc(f->num_sw * f->words, sizeof(f->next[0]));
+	f->nbr = malloc((num_nbr + 1) * sizeof(f->nbr[0]));
+	f->healthy = malloc(num_nbr + 1);
+	if (!f->dirty || !f->next || !f->nbr || !f->healthy)
+		goto ERROR;
+
+	/* resolve the neighbor switch behind each port once; the checks
+	   are the ones of ucast_mgr_process_hop_0_1 for the first round
+	   and of ucast_mgr_process_neighbors for the propagation
+	 */
+	for (i = 0; i < f->num_sw; i++) {
+		p_sw = f->sw[i];
+		for (port_num = 1; port_num < p_sw->num_ports; port_num++) {
+			n = f->nbr_off[i] + port_num - 1;
+			f->nbr[n] = UINT32_MAX;
+			f->healthy[n] = 0;
+
+			p_physp = osm_node_get_physp_ptr(p_sw->p_node,
+							 port_num);
+			p_remote_node = (p_physp && p_physp->p_remote_physp) ?
+			    p_physp->p_remote_physp->p_node : NULL;
+			if (!p_remote_node || !p_remote_node->sw
+			    || p_remote_node == p_sw->p_node)
+				continue;
+
+			lid = cl_ntoh16(osm_node_get_base_lid(p_remote_node,
+							      0));
+			if (lid && lid <= max_lid
+			    && sw_by_lid[lid] != UINT32_MAX
+			    && f->sw[sw_by_lid[lid]] == p_remote_node->sw)
+				f->nbr[n] = sw_by_lid[lid];
+			else
+				f->nbr[n] = hop_frontier_find(f,
+							      p_remote_node->sw);
+			if (f->nbr[n] == UINT32_MAX)
+				continue;
+
+			f->healthy[n] =
+			    osm_node_get_remote_node(p_sw->p_node, port_num,
+						     &remote_port_num) != NULL
+			    && osm_link_is_healthy(p_physp);
+		}
+	}
+
+	free(lid_to_idx);
+	free(sw_by_lid);
+	return 0;
+
+ERROR:
+	free(lid_to_idx);
+	free(sw_by_lid);
+	hop_frontier_destroy(f);
+	return -1;
+}
+
+static inline void hop_frontier_mark(uint64_t * bitset, hop_frontier_t * f,
+				     uint32_t sw_idx, uint32_t lid_idx)
+{
+	bitset[sw_idx * f->words + lid_idx / 64] |= 1ULL << (lid_idx % 64);
+}
+
+/* absorb the changed LIDs of the neighbor behind port_num */
+static void hop_frontier_pull(IN osm_ucast_mgr_t * p_mgr,
+			      IN hop_frontier_t * f, IN uint32_t sw_idx,
+			      IN uint8_t port_num, IN uint32_t remote_idx)
+{
+	osm_switch_t *p_sw = f->sw[sw_idx];
+	osm_switch_t *p_remote_sw = f->sw[remote_idx];
+	uint64_t *dirty = f->dirty + remote_idx * f->words;
+	uint64_t *next = f->next + remote_idx * f->words;
+	uint64_t word;
+	uint32_t w, lid_idx;
+	uint16_t lid_ho, hops;
+	uint8_t least_hops;
+	osm_physp_t *p = osm_node_get_physp_ptr(p_sw->p_node, port_num);
+
+	/* the neighbor changed since this switch last looked at it either
+	   later in the previous round or earlier in this one
+	 */
+	for (w = 0; w < f->words; w++) {
+		for (word = dirty[w] | next[w], lid_idx = w * 64; word;
+		     word >>= 1, lid_idx++) {
+			if (!(word & 1))
+				continue;
+			lid_ho = f->lid[lid_idx];
+			hops = osm_switch_get_least_hops(p_remote_sw, lid_ho);
+			if (hops == OSM_NO_PATH)
+				continue;
+			hops += p->hop_wf;
+			if (hops >=
+			    osm_switch_get_hop_count(p_sw, lid_ho, port_num))
+				continue;
+
+			least_hops = osm_switch_get_least_hops(p_sw, lid_ho);
+			if (osm_switch_set_hops(p_sw, lid_ho, port_num,
+						(uint8_t) hops) != 0) {
+				OSM_LOG(p_mgr->p_log, OSM_LOG_ERROR, "ERR 3A03: "
+					"cannot set hops for lid %u at switch 0x%"
+					PRIx64 "\n", lid_ho,
+					cl_ntoh64(osm_node_get_node_guid
+						  (p_sw->p_node)));
+				p_mgr->some_hop_count_set = TRUE;
+				continue;
+			}
+			p_mgr->some_hop_count_set = TRUE;
+			if (hops < least_hops)
+				hop_frontier_mark(f->next, f, sw_idx, lid_idx);
+		}
+	}
+}
+
+/* propagate the hop counts until no hop count changes anymore, for at
+   most iteration_max rounds; returns the number of rounds
+*/
+static uint32_t hop_frontier_propagate(IN osm_ucast_mgr_t * p_mgr,
+				       IN hop_frontier_t * f,
+				       IN uint32_t iteration_max)
+{
+	osm_switch_t *p_sw;
+	uint64_t *tmp;
+	uint32_t i, n, rounds;
+	uint8_t port_num;
+
+	/* ucast_mgr_process_hop_0_1 set each switch's own LID and the
+	   LIDs of the neighbor switches behind all of its ports
+	 */
+	for (i = 0; i < f->num_sw; i++) {
+		p_sw = f->sw[i];
+		hop_frontier_mark(f->dirty, f, i, f->sw_lid[i]);
+		for (port_num = 1; port_num < p_sw->num_ports; port_num++) {
+			n = f->nbr[f->nbr_off[i] + port_num - 1];
+			if (n != UINT32_MAX)
+				hop_frontier_mark(f->dirty, f, i,
+						  f->sw_lid[n]);
+		}
+	}
+
+	p_mgr->some_hop_count_set = TRUE;
+	for (rounds = 0;
+	     rounds < iteration_max && p_mgr->some_hop_count_set; rounds++) {
+		p_mgr->some_hop_count_set = FALSE;
+		for (i = 0; i < f->num_sw; i++) {
+			p_sw = f->sw[i];
+			for (port_num = 1; port_num < p_sw->num_ports;
+			     port_num++) {
+				n = f->nbr_off[i] + port_num - 1;
+				if (f->healthy[n])
+					hop_frontier_pull(p_mgr, f, i, port_num,
+							  f->nbr[n]);
+			}
+		}
+
+		tmp = f->dirty;
+		f->dirty = f->next;
+		f->next = tmp;
+		memset(f->next, 0, f->num_sw * f->words * sizeof(f->next[0]));
+	}
+
+	return rounds;
+}
+
 static int set_hop_wf(void *ctx, uint64_t guid, char *p)
 {
 	osm_ucast_mgr_t *m = ctx;
@@ -598,6 +860,7 @@ int osm_ucast_mgr_build_lid_matrices(IN osm_ucast_mgr_t * p_mgr)
 	uint32_t i;
 	uint32_t iteration_max;
 	cl_qmap_t *p_sw_guid_tbl;
+	hop_frontier_t frontier;
 
 	p_sw_guid_tbl = &p_mgr->p_subn->sw_guid_tbl;
 
@@ -660,12 +923,30 @@ int osm_ucast_mgr_build_lid_matrices(IN osm_ucast_mgr_t * p_mgr)
 		   if non of the switches was set will exit the
 		   while loop
 		 */
-		p_mgr->some_hop_count_set = TRUE;
-		for (i = 0; (i < iteration_max) && p_mgr->some_hop_count_set;
-		     i++) {
-			p_mgr->some_hop_count_set = FALSE;
-			cl_qmap_apply_func(p_sw_guid_tbl,
-					   ucast_mgr_process_neighbors, p_mgr);
+		/*
+		   Each round a switch only absorbs the LIDs of its
+		   neighbors whose least hop count changed since it last
+		   looked at them. If the bitsets for this can't be
+		   allocated, fall back to absorbing all LIDs of all
+		   neighbors in each iteration.
+		 */
+		if (!hop_frontier_init(&frontier, p_sw_guid_tbl)) {
+			i = hop_frontier_propagate(p_mgr, &frontier,
+						   iteration_max);
+			hop_frontier_destroy(&frontier);
+		} else {
+			OSM_LOG(p_mgr->p_log, OSM_LOG_ERROR, "ERR 3A11: "
+				"cannot allocate min hop propagation bitsets, "
+				"using full iterations\n");
+			p_mgr->some_hop_count_set = TRUE;
+			for (i = 0;
+			     (i < iteration_max) && p_mgr->some_hop_count_set;
+			     i++) {
+				p_mgr->some_hop_count_set = FALSE;
+				cl_qmap_apply_func(p_sw_guid_tbl,
+						   ucast_mgr_process_neighbors,
+						   p_mgr);
+			}
 		}
 		OSM_LOG(p_mgr->p_log, OSM_LOG_DEBUG,
 			"Min-hop propagated in %d steps\n", i);
@@ -971,40 +1252,160 @@ static void ucast_mgr_set_fwd_top(IN cl_map_item_t * p_map_item,
 	OSM_LOG_EXIT(p_mgr->p_log);
 }
 
-static int set_lft_block(IN osm_switch_t *p_sw, IN osm_ucast_mgr_t *p_mgr,
-			 IN uint16_t block_id_ho)
+/**********************************************************************
+ Returns TRUE if both the current and the new LFT of the switch forward
+ lid_ho to port_num, so the entry holds while the LFTs are updated.
+ **********************************************************************/
+static boolean_t lft_sched_entry_is(IN const osm_switch_t * p_sw,
+				    IN uint16_t lid_ho, IN uint8_t port_num)
 {
-	osm_madw_context_t context;
-	osm_dr_path_t *p_path;
-	osm_physp_t *p_physp;
-	ib_api_status_t status;
+	return !p_sw->need_update && p_sw->new_lft && lid_ho < p_sw->lft_size &&
+	    p_sw->lft[lid_ho] == port_num && p_sw->new_lft[lid_ho] == port_num;
+}
+
+/**********************************************************************
+ LFT blocks may be sent LID routed to a switch if every switch on the
+ directed route from the SM forwards the switch LID along that route
+ and the SM LID back along it, before and after the update.
+ **********************************************************************/
+static boolean_t lft_sched_is_lid_routable(IN osm_ucast_mgr_t * p_mgr,
+					   IN osm_switch_t * p_sw)
+{
+	osm_subn_t *p_subn = p_mgr->p_subn;
+	const osm_dr_path_t *p_path;
+	osm_physp_t *p_physp, *p_remote;
+	osm_port_t *p_sm_port;
+	osm_node_t *p_node;
+	uint16_t lid_ho, sm_lid_ho;
+	uint8_t hop;
+
+	if (!p_subn->opt.lft_lid_routed || p_subn->need_update ||
+	    !p_subn->sm_base_lid)
+		return FALSE;
+
+	p_physp = osm_node_get_physp_ptr(p_sw->p_node, 0);
+	if (!p_physp)
+		return FALSE;
+	p_path = osm_physp_get_dr_path_ptr(p_physp);
+	/* nothing to skip for the SM's own or a neighbour switch */
+	if (p_path->hop_count < 2)
+		return FALSE;
+
+	lid_ho = cl_ntoh16(osm_physp_get_base_lid(p_physp));
+	sm_lid_ho = cl_ntoh16(p_subn->sm_base_lid);
+	if (!lid_ho)
+		return FALSE;
+
+	p_sm_port = osm_get_port_by_guid(p_subn, p_subn->sm_port_guid);
+	if (!p_sm_port)
+		return FALSE;
+
+	p_node = p_sm_port->p_node;
+	if (p_node->sw) {
+		if (!lft_sched_entry_is(p_node->sw, lid_ho, p_path->path[1]) ||
+		    !lft_sched_entry_is(p_node->sw, sm_lid_ho, 0))
+			return FALSE;
+		p_physp = osm_node_get_physp_ptr(p_node, p_path->path[1]);
+	} else
+		p_physp = p_sm_port->p_physp;
+
+	for (hop = 2; hop <= p_path->hop_count + 1; hop++) {
+		if (!p_physp || !(p_remote = p_physp->p_remote_physp))
+			return FALSE;
+		p_node = p_remote->p_node;
+		if (!p_node->sw)
+			return FALSE;
+		if (hop == p_path->hop_count + 1)
+			return p_node->sw == p_sw &&
+			    lft_sched_entry_is(p_sw, lid_ho, 0) &&
+			    lft_sched_entry_is(p_sw, sm_lid_ho,
+					       p_remote->port_num);
+		if (!lft_sched_entry_is(p_node->sw, lid_ho, p_path->path[hop]) ||
+		    !lft_sched_entry_is(p_node->sw, sm_lid_ho,
+					p_remote->port_num))
+			return FALSE;
+		p_physp = osm_node_get_physp_ptr(p_node, p_path->path[hop]);
+	}
+
+	return FALSE;
+}
+
+/**********************************************************************
+ Collects the LFT blocks of the switch that need to be sent.
+ Returns the number of blocks, or -1 on failure.
+ **********************************************************************/
+static int lft_sched_prepare(IN osm_ucast_mgr_t * p_mgr,
+			     IN osm_switch_t * p_sw, IN unsigned max_block)
+{
+	osm_lft_sched_t *p_sched = &p_sw->lft_sched;
+	uint16_t *blocks;
+	unsigned i;
+
+	p_sched->num_blocks = 0;
+	p_sched->next = 0;
+	p_sched->outstanding = 0;
+	p_sched->failed = 0;
+	p_sched->lid_routed = FALSE;
 
-	/*
-	   Send linear forwarding table blocks to the switch
-	   as long as the switch indicates it has blocks needing
-	   configuration.
-	 */
 	if (!p_sw->new_lft) {
 		/* any routing should provide the new_lft */
 		CL_ASSERT(p_mgr->p_subn->opt.use_ucast_cache &&
 			  p_mgr->cache_valid && !p_sw->need_update);
-		return -1;
+		return 0;
 	}
 
-	p_physp = osm_node_get_physp_ptr(p_sw->p_node, 0);
-	if (!p_physp)
+	if (!osm_node_get_physp_ptr(p_sw->p_node, 0))
+		return 0;
+
+	blocks = realloc(p_sched->blocks, max_block * sizeof(*blocks));
+	if (!blocks) {
+		OSM_LOG(p_mgr->p_log, OSM_LOG_ERROR, "ERR 3A12: "
+			"Cannot allocate LFT block list of switch 0x%"
+			PRIx64 "\n", cl_ntoh64(osm_node_get_node_guid(p_sw->p_node)));
 		return -1;
+	}
+	p_sched->blocks = blocks;
 
+	for (i = 0; i < max_block; i++) {
+		if ((i + 1) * IB_SMP_DATA_SIZE > p_sw->lft_size)
+			break;
+		if (!p_sw->need_update && !p_mgr->p_subn->need_update &&
+		    !memcmp(p_sw->new_lft + i * IB_SMP_DATA_SIZE,
+			    p_sw->lft + i * IB_SMP_DATA_SIZE,
+			    IB_SMP_DATA_SIZE))
+			continue;
+		blocks[p_sched->num_blocks++] = i;
+	}
+
+	if (p_sched->num_blocks)
+		p_sched->lid_routed = lft_sched_is_lid_routable(p_mgr, p_sw);
+
+	return p_sched->num_blocks;
+}
+
+/**********************************************************************
+ Sends the next pending LFT block of the switch.
+ **********************************************************************/
+static void lft_sched_send(IN osm_ucast_mgr_t * p_mgr, IN osm_switch_t * p_sw)
+{
+	osm_lft_sched_t *p_sched = &p_sw->lft_sched;
+	osm_madw_context_t context;
+	osm_dr_path_t *p_path;
+	osm_physp_t *p_physp;
+	osm_madw_t *p_madw;
+	ib_smp_t *p_smp;
+	uint16_t block_id_ho;
+
+	CL_ASSERT(p_sched->next < p_sched->num_blocks);
+
+	block_id_ho = p_sched->blocks[p_sched->next++];
+
+	p_physp = osm_node_get_physp_ptr(p_sw->p_node, 0);
 	p_path = osm_physp_get_dr_path_ptr(p_physp);
 
 	context.lft_context.node_guid = osm_node_get_node_guid(p_sw->p_node);
 	context.lft_context.set_method = TRUE;
-
-	if (!p_sw->need_update && !p_mgr->p_subn->need_update &&
-	    !memcmp(p_sw->new_lft + block_id_ho * IB_SMP_DATA_SIZE,
-		    p_sw->lft + block_id_ho * IB_SMP_DATA_SIZE,
-		    IB_SMP_DATA_SIZE))
-		return 0;
+	context.lft_context.sched_gen = p_mgr->lft_gen;
 
 	/*
 	 * Zero the stored LFT block, so in case the MAD will end up
@@ -1014,37 +1415,183 @@ static int set_lft_block(IN osm_switch_t *p_sw, IN osm_ucast_mgr_t *p_mgr,
 	       IB_SMP_DATA_SIZE);
 
 	OSM_LOG(p_mgr->p_log, OSM_LOG_DEBUG,
-		"Writing FT block %u to switch 0x%" PRIx64 "\n", block_id_ho,
-		cl_ntoh64(context.lft_context.node_guid));
-
-	status = osm_req_set(p_mgr->sm, p_path,
-			     p_sw->new_lft + block_id_ho * IB_SMP_DATA_SIZE,
-			     IB_SMP_DATA_SIZE, IB_MAD_ATTR_LIN_FWD_TBL,
-			     cl_hton32(block_id_ho), FALSE,
-			     ib_port_info_get_m_key(&p_physp->port_info),
-			     0, CL_DISP_MSGID_NONE, &context);
-
-	if (status != IB_SUCCESS) {
+		"Writing FT block %u to switch 0x%" PRIx64 "%s\n", block_id_ho,
+		cl_ntoh64(context.lft_context.node_guid),
+		p_sched->lid_routed ? " (LID routed)" : "");
+
+	p_madw = osm_prepare_req_set(p_mgr->sm, p_path,
+				     p_sw->new_lft +
+				     block_id_ho * IB_SMP_DATA_SIZE,
+				     IB_SMP_DATA_SIZE, IB_MAD_ATTR_LIN_FWD_TBL,
+				     cl_hton32(block_id_ho), FALSE,
+				     ib_port_info_get_m_key(&p_physp->port_info),
+				     0, OSM_MSG_MAD_LFT, &context);
+	if (!p_madw) {
 		OSM_LOG(p_mgr->p_log, OSM_LOG_ERROR, "ERR 3A10: "
 			"Sending linear fwd. tbl. block failed (%s)\n",
-			ib_get_err_str(status));
-		return -1;
+			ib_get_err_str(IB_INSUFFICIENT_RESOURCES));
+		p_sched->failed++;
+		return;
 	}
 
-	return 0;
+	if (p_sched->lid_routed) {
+		/* same layout, only the DR fields become reserved */
+		p_smp = osm_madw_get_smp_ptr(p_madw);
+		p_smp->mgmt_class = IB_MCLASS_SUBN_LID;
+		p_smp->hop_ptr = 0;
+		p_smp->hop_count = 0;
+		p_smp->dr_slid = 0;
+		p_smp->dr_dlid = 0;
+		memset(p_smp->initial_path, 0, sizeof(p_smp->initial_path));
+		memset(p_smp->return_path, 0, sizeof(p_smp->return_path));
+		p_madw->mad_addr.dest_lid = osm_physp_get_base_lid(p_physp);
+		p_madw->mad_addr.addr_type.smi.source_lid =
+		    p_mgr->p_subn->sm_base_lid;
+	}
+
+	p_sched->outstanding++;
+	p_mgr->lft_num_blocks++;
+	osm_send_req_mad(p_mgr->sm, p_madw);
+}
+
+/**********************************************************************
+ Sends blocks of the switch until its window is full.
+ Returns TRUE if the switch has no more blocks to send or complete.
+ **********************************************************************/
+static boolean_t lft_sched_fill(IN osm_ucast_mgr_t * p_mgr,
+				IN osm_switch_t * p_sw, IN unsigned window)
+{
+	osm_lft_sched_t *p_sched = &p_sw->lft_sched;
+
+	while (p_sched->next < p_sched->num_blocks &&
+	       (!window || p_sched->outstanding < window))
+		lft_sched_send(p_mgr, p_sw);
+
+	return p_sched->next == p_sched->num_blocks && !p_sched->outstanding;
+}
+
+static void lft_sched_sw_done(IN osm_ucast_mgr_t * p_mgr,
+			      IN osm_switch_t * p_sw)
+{
+	osm_lft_sched_t *p_sched = &p_sw->lft_sched;
+	uint64_t now = cl_get_time_stamp();
+
+	OSM_LOG(p_mgr->p_log, OSM_LOG_VERBOSE,
+		"LFT of switch 0x%016" PRIx64 " (%s) programmed: %u blocks, "
+		"%u failed, %" PRIu64 " usec%s\n",
+		cl_ntoh64(osm_node_get_node_guid(p_sw->p_node)),
+		p_sw->p_node->print_desc, p_sched->num_blocks,
+		p_sched->failed, now - p_sched->start_time,
+		p_sched->lid_routed ? ", LID routed" : "");
+
+	CL_ASSERT(p_mgr->lft_sw_pending);
+	if (--p_mgr->lft_sw_pending == 0)
+		OSM_LOG(p_mgr->p_log, OSM_LOG_INFO,
+			"LFT distribution done: %u blocks in %" PRIu64
+			" usec\n", p_mgr->lft_num_blocks,
+			now - p_mgr->lft_start_time);
+}
+
+void osm_ucast_mgr_lft_block_done(IN osm_ucast_mgr_t * p_mgr,
+				  IN osm_switch_t * p_sw,
+				  IN uint32_t sched_gen, IN boolean_t success)
+{
+	osm_lft_sched_t *p_sched = &p_sw->lft_sched;
+
+	/* a block of an earlier distribution */
+	if (sched_gen != p_mgr->lft_gen || !p_sched->outstanding)
+		return;
+
+	p_sched->outstanding--;
+	if (!success)
+		p_sched->failed++;
+
+	if (lft_sched_fill(p_mgr, p_sw, p_mgr->p_subn->opt.lft_window))
+		lft_sched_sw_done(p_mgr, p_sw);
+}
+
+static int compar_sched_blocks(const void *a, const void *b)
+{
+	const osm_switch_t *sa = *(osm_switch_t * const *)a;
+	const osm_switch_t *sb = *(osm_switch_t * const *)b;
+
+	if (sa->lft_sched.num_blocks != sb->lft_sched.num_blocks)
+		return sa->lft_sched.num_blocks > sb->lft_sched.num_blocks ?
+		    -1 : 1;
+	return sa < sb ? -1 : sa > sb;
 }
 
 static void ucast_mgr_pipeline_fwd_tbl(osm_ucast_mgr_t * p_mgr)
 {
 	cl_qmap_t *tbl;
 	cl_map_item_t *item;
-	unsigned i, max_block = p_mgr->max_lid / IB_SMP_DATA_SIZE + 1;
+	osm_switch_t **sws, *p_sw;
+	unsigned i, num = 0, max_block = p_mgr->max_lid / IB_SMP_DATA_SIZE + 1;
+	unsigned window = p_mgr->p_subn->opt.lft_window;
+	boolean_t sent;
 
 	tbl = &p_mgr->p_subn->sw_guid_tbl;
-	for (i = 0; i < max_block; i++)
-		for (item = cl_qmap_head(tbl); item != cl_qmap_end(tbl);
-		     item = cl_qmap_next(item))
-			set_lft_block((osm_switch_t *)item, p_mgr, i);
+
+	p_mgr->lft_gen++;
+	p_mgr->lft_sw_pending = 0;
+	p_mgr->lft_num_blocks = 0;
+	p_mgr->lft_start_time = cl_get_time_stamp();
+
+	sws = malloc(cl_qmap_count(tbl) * sizeof(*sws));
+	if (!sws) {
+		OSM_LOG(p_mgr->p_log, OSM_LOG_ERROR, "ERR 3A13: "
+			"Cannot allocate LFT distribution switch list\n");
+		p_mgr->p_subn->subnet_initialization_error = TRUE;
+		return;
+	}
+
+	/*
+	   Collect the changed blocks of all the switches before sending
+	   any, the LID routing decision depends on the stored LFTs.
+	 */
+	for (item = cl_qmap_head(tbl); item != cl_qmap_end(tbl);
+	     item = cl_qmap_next(item)) {
+		p_sw = (osm_switch_t *) item;
+		switch (lft_sched_prepare(p_mgr, p_sw, max_block)) {
+		case -1:
+			p_mgr->p_subn->subnet_initialization_error = TRUE;
+			break;
+		case 0:
+			break;
+		default:
+			p_sw->lft_sched.start_time = p_mgr->lft_start_time;
+			sws[num++] = p_sw;
+		}
+	}
+
+	qsort(sws, num, sizeof(*sws), compar_sched_blocks);
+	p_mgr->lft_sw_pending = num;
+
+	OSM_LOG(p_mgr->p_log, OSM_LOG_VERBOSE,
+		"LFT distribution started: %u switches to update\n", num);
+
+	/*
+	   Fill the windows one block at a time across the switches, so
+	   the first SMPs on the wire reach as many switches as possible.
+	 */
+	do {
+		sent = FALSE;
+		for (i = 0; i < num; i++) {
+			p_sw = sws[i];
+			if (p_sw->lft_sched.next == p_sw->lft_sched.num_blocks ||
+			    (window && p_sw->lft_sched.outstanding >= window))
+				continue;
+			lft_sched_send(p_mgr, p_sw);
+			sent = TRUE;
+		}
+	} while (sent);
+
+	/* switches whose blocks all failed to be sent */
+	for (i = 0; i < num; i++)
+		if (!sws[i]->lft_sched.outstanding)
+			lft_sched_sw_done(p_mgr, sws[i]);
+
+	free(sws);
 }
 
 void osm_ucast_mgr_set_fwd_tables(osm_ucast_mgr_t * p_mgr)
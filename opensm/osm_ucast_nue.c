@@ -60,7 +60,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <search.h>
+#include <pthread.h>
 #include <complib/cl_heap.h>
+#include <complib/cl_thread.h>
 #include <opensm/osm_file_ids.h>
 #define FILE_ID OSM_FILE_UCAST_NUE_C
 #include <opensm/osm_ucast_mgr.h>
@@ -145,6 +147,10 @@ typedef struct network_node {
 	uint8_t num_adj_terminals_in_convex_hull;	/*!< Helper for betw. */
 	/* additionally needed for cCDG escape path assignment */
 	boolean_t has_adj_destinations;	/*!< Add reverse path to escape path. */
+	/* additionally needed for incremental rerouting */
+	uint8_t *lft;		/*!< Copy of the LFT calculated in last run. */
+	uint64_t *escape_weights;	/*!< Link weights per VL when the escape
+					   paths were calculated. */
 } network_node_t;
 
 /*! \struct network
@@ -215,6 +221,20 @@ typedef struct backtracking_candidate {
 	ccdg_node_t *orig_used_ccdg_node_for_adj_netw_node;
 } backtracking_candidate_t;
 
+/*! \struct nue_prev_routing
+ *  \brief Result of the last routing run, kept for incremental rerouting.
+ */
+typedef struct nue_prev_routing {
+	boolean_t valid;	/*!< TRUE if the stored routing is complete. */
+	network_t network;	/*!< Old network incl. link weights and LFTs. */
+	uint16_t num_destinations[IB_MAX_NUM_VLS];	/*!< Old #desti. */
+	ib_net16_t *destinations[IB_MAX_NUM_VLS];	/*!< Old desti per VL. */
+	uint8_t max_vl;		/*!< #VLs used by the old routing. */
+	uint8_t max_lmc;	/*!< Highest LMC during the old routing. */
+	uint16_t max_lid_ho;	/*!< Highest LID stored in the old LFTs. */
+	ib_net16_t central_node_lids[IB_MAX_NUM_VLS];	/*!< Old escape roots. */
+} nue_prev_routing_t;
+
 /*! \struct nue_context
  *  \brief Primary structure for Nue (storing graph, cCDG, destinations, etc).
  */
@@ -230,8 +250,28 @@ typedef struct nue_context {
 	uint8_t max_vl;		/*!< Highest common #VL supported by all. */
 	uint8_t max_lmc;	/*!< Highest supported LMC across fabric. */
 	uint8_t *dlid_to_vl_mapping;	/*!< Store VLs to serve path_sl requ. */
+	uint64_t init_weight;	/*!< Initial weight of all network links. */
+	uint16_t lft_max_lid_ho;	/*!< Highest LID in LFT copies (or 0). */
+	ib_net16_t central_node_lids[IB_MAX_NUM_VLS];	/*!< Escape path roots. */
+	nue_prev_routing_t prev;	/*!< Last routing for incremental mode. */
 } nue_context_t;
 
+/*! \struct nue_layer_worker
+ *  \brief Private copies of network and cCDG to route virtual layers in a
+ *         separate thread (layers first_vl, first_vl + vl_stride, ...).
+ */
+typedef struct nue_layer_worker {
+	nue_context_t *nue_ctx;	/*!< Context shared by all workers. */
+	cl_thread_t thread;	/*!< Thread routing the layers of this worker. */
+	network_t network;	/*!< Private copy of the network. */
+	ccdg_t ccdg;		/*!< Private copy of the complete CDG. */
+	uint8_t first_vl;	/*!< First virtual layer of this worker. */
+	uint8_t vl_stride;	/*!< Offset to the next layer of this worker. */
+	boolean_t include_switches;	/*!< Consider switches as desti. */
+	pthread_mutex_t *lft_lock;	/*!< Serializes the LFT updates. */
+	int err;		/*!< Result of the routing (0 on success). */
+} nue_layer_worker_t;
+
 #if defined (ENABLE_METIS_FOR_NUE)
 /*! \struct metis_context
  *  \brief Complete information about fabric graph to perform partitioning.
@@ -271,6 +311,25 @@ add_ccdg_edge_betw_nodes_to_colored_subccdg(const ccdg_t *,
 					    const ccdg_node_t *,
 					    ccdg_edge_t *);
 
+/*! \fn add_restored_paths_to_ccdg(const osm_ucast_mgr_t *,
+ *                                 const network_t *,
+ *                                 const ccdg_t *,
+ *                                 const ib_net16_t)
+ *  \brief This fn adds the channel dependencies of the paths towards a dlid,
+ *         as restored by restore_paths_from_prev_lfts, to the escape paths.
+ *
+ *  \param[in]     mgr     The management object of OpenSM.
+ *  \param[in]     network Nue's network object storing the subnet.
+ *  \param[in,out] ccdg    The cCDG object with marked escape paths.
+ *  \param[in]     dlid    Destination LID of the restored paths.
+ *  \return NONE
+ */
+static void
+add_restored_paths_to_ccdg(const osm_ucast_mgr_t *,
+			   const network_t *,
+			   const ccdg_t *,
+			   const ib_net16_t);
+
 /*! \fn add_ccdg_node_to_colored_subccdg(const ccdg_t *,
  *                                       const ccdg_node_t *,
  *                                       ccdg_node_t *)
@@ -301,6 +360,16 @@ static inline void
 add_link_to_stack_of_used_links(network_node_t *,
 				network_link_t *);
 
+/*! \fn alloc_escape_path_weights(nue_context_t *)
+ *  \brief This fn allocates the arrays in the network nodes which store the
+ *         link weights used for the escape paths of each virtual layer.
+ *
+ *  \param[in,out] nue_ctx Nue's context storing graph, cCDG, destinations, etc.
+ *  \return NONE
+ */
+static void
+alloc_escape_path_weights(nue_context_t *);
+
 /*! \fn attempt_local_backtracking(const osm_ucast_mgr_t *,
  *                                 const network_t *,
  *                                 const network_node_t *,
@@ -453,6 +522,34 @@ change_fake_ccdg_node_color(const ccdg_t *,
 			    ccdg_node_t *,
 			    const int32_t);
 
+/*! \fn clone_network_and_ccdg(const osm_ucast_mgr_t *,
+ *                             const network_t *,
+ *                             const ccdg_t *,
+ *                             network_t *,
+ *                             ccdg_t *)
+ *  \brief This fn creates private copies of the network and the complete CDG
+ *         (incl. link weights), so that a virtual layer can be routed in a
+ *         separate thread.
+ *
+ *  Function description: All pointers of the copies point into the copies,
+ *  except for the escape path weights, which are shared with the original
+ *  network (each layer only writes its own part). The copies have to be
+ *  destroyed by the caller, even if the fn fails.
+ *
+ *  \param[in]  mgr         The management object of OpenSM.
+ *  \param[in]  in_network  Nue's network object storing the subnet.
+ *  \param[in]  in_ccdg     Nue's internal object storing the complete CDG.
+ *  \param[out] out_network Copy of in_network.
+ *  \param[out] out_ccdg    Copy of in_ccdg.
+ *  \return Integer 0 if the copies were created, or -1 otherwise.
+ */
+static int
+clone_network_and_ccdg(const osm_ucast_mgr_t *,
+		       const network_t *,
+		       const ccdg_t *,
+		       network_t *,
+		       ccdg_t *);
+
 /*! \fn compare_backtracking_candidates_by_distance(const void *,
  *                                                  const void *)
  *  \brief Comparator for backtracking candidates of cCDG vertices w.r.t their
@@ -585,6 +682,16 @@ construct_network(network_t *);
 static inline void
 construct_network_node(network_node_t *);
 
+/*! \fn construct_prev_routing(nue_prev_routing_t *)
+ *  \brief This fn sets all values of the nue_prev_routing_t struct to 0, and
+ *         calls the constructor of the stored network.
+ *
+ *  \param[in,out] prev The stored result of the last routing run.
+ *  \return NONE
+ */
+static inline void
+construct_prev_routing(nue_prev_routing_t *);
+
 /*! \fn create_context(nue_context_t *)
  *  \brief This fn calls the constructors for the network and ccdg structs, as
  *         well as allocates arrays to store destinations and VL mappings.
@@ -654,6 +761,16 @@ destroy_network(network_t *);
 static inline void
 destroy_network_node(network_node_t *);
 
+/*! \fn destroy_prev_routing(nue_prev_routing_t *)
+ *  \brief All allocated memory within the nue_prev_routing_t struct is freed,
+ *         and the stored routing is marked as invalid.
+ *
+ *  \param[in,out] prev The stored result of the last routing run.
+ *  \return NONE
+ */
+static void
+destroy_prev_routing(nue_prev_routing_t *);
+
 /*! \fn determine_num_adj_terminals_in_convex_hull(const osm_ucast_mgr_t *,
  *                                                 const network_t *,
  *                                                 ib_net16_t *,
@@ -971,6 +1088,19 @@ get_lid(const ib_net16_t *,
 static uint8_t
 get_max_num_vls(const osm_ucast_mgr_t *);
 
+/*! \fn get_network_link_by_channel_id(const network_node_t *,
+ *                                     const channel_t)
+ *  \brief This fn searches the outgoing links of a network node for the link
+ *         with the given channel ID.
+ *
+ *  \param[in] network_node A network node (switch) of the subnet.
+ *  \param[in] channel_id   Channel ID of the link to search for.
+ *  \return Pointer to the network link, or NULL if the node has no such link.
+ */
+static network_link_t *
+get_network_link_by_channel_id(const network_node_t *,
+			       const channel_t);
+
 /*! \fn get_network_node_by_lid(const network_t *,
  *                              const ib_net16_t)
  *  \brief This fn uses the stdlib to find (via binary search) a network node
@@ -1190,12 +1320,27 @@ init_network_node(network_node_t *,
 		  network_link_t *,
 		  osm_switch_t *);
 
+/*! \fn is_colored_subccdg_acyclic(const osm_ucast_mgr_t *,
+ *                                 const ccdg_t *)
+ *  \brief This fn searches for cycles in the subgraph of the cCDG which is
+ *         formed by all colored (i.e., used and not blocked) edges.
+ *
+ *  \param[in] mgr  The management object of OpenSM.
+ *  \param[in] ccdg The cCDG object.
+ *  \return TRUE if the colored subgraph of the cCDG is acyclic, or FALSE
+ *          otherwise.
+ */
+static boolean_t
+is_colored_subccdg_acyclic(const osm_ucast_mgr_t *,
+			   const ccdg_t *);
+
 /*! \fn mark_escape_paths(const osm_ucast_mgr_t *,
  *                        network_t *,
  *                        const ccdg_t *,
  *                        ib_net16_t *,
  *                        const uint16_t,
- *                        const boolean_t)
+ *                        const boolean_t,
+ *                        ib_net16_t *)
  *  \brief Calculates a set of 'escape paths' for Nue as fallback option,
  *         similar to an Up/Down routing tree, in case of unsuccessful routing.
  *
@@ -1214,6 +1359,9 @@ init_network_node(network_node_t *,
  *  \param[in] num_destinations Number of destinations in the destination array.
  *  \param[in] verify_network_integrity If TRUE, a sanity check is performed to
  *                                      determine subnet connectivity issues.
+ *  \param[in,out] central_node_lid    LID of the root for the spanning tree;
+ *                                      if 0 or unknown, then the most central
+ *                                      node is determined and its LID stored.
  *  \return Integer 0 if calculation was sucessful, or any integer unequal to 0
  *          otherwise.
  */
@@ -1223,7 +1371,8 @@ mark_escape_paths(const osm_ucast_mgr_t *,
 		  const ccdg_t *,
 		  ib_net16_t *,
 		  const uint16_t,
-		  const boolean_t);
+		  const boolean_t,
+		  ib_net16_t *);
 
 /*! \fn mcast_cleanup(const network_t *,
  *                    cl_qlist_t *)
@@ -1510,6 +1659,28 @@ static void
 print_spanning_tree(const osm_ucast_mgr_t *,
 		    const network_t *);
 
+/*! \fn reroute_incrementally(nue_context_t *,
+ *                            const boolean_t)
+ *  \brief This fn reuses the routing of the last run, if the subnet only lost
+ *         switches, links or terminals, and reroutes only affected paths.
+ *
+ *  Function description: Destinations whose paths used a vanished channel (or
+ *  whose terminal moved to a different switch) are marked as affected. For each
+ *  virtual layer with affected destinations the escape paths are calculated for
+ *  the new network, the unaffected paths are restored from the saved LFTs and
+ *  added to the escape paths, and if this colored subgraph of the cCDG is still
+ *  acyclic, the affected destinations are routed with the modified Dijkstra's
+ *  algorithm. All other layers simply get the restored paths.
+ *
+ *  \param[in,out] nue_ctx          Nue's context with the stored last routing.
+ *  \param[in]     include_switches Are switches treated as traffic sinks.
+ *  \return Integer 0 if the incremental rerouting was sucessful, 1 if a full
+ *          run is required, or -1 on errors.
+ */
+static int
+reroute_incrementally(nue_context_t *,
+		      const boolean_t);
+
 /*! \fn reset_ccdg_color_array(const osm_ucast_mgr_t *,
  *                             ccdg_t *,
  *                             const uint16_t *,
@@ -1599,6 +1770,16 @@ reset_delta_for_betw_centrality(const network_t *);
 static void
 reset_mgrp_membership(const network_t *);
 
+/*! \fn reset_routing_results(nue_context_t *)
+ *  \brief This fn resets LFTs, hops, port profiles, link weights, and the VL
+ *         mapping after an aborted incremental rerouting.
+ *
+ *  \param[in,out] nue_ctx Nue's context storing graph, cCDG, destinations, etc.
+ *  \return NONE
+ */
+static void
+reset_routing_results(nue_context_t *);
+
 /*! \fn reset_sigma_distance_Ps_for_betw_centrality(const network_t *)
  *  \brief The fn iterates over all network nodes and resets three struct
  *         elementsof network_node_t back to 0 or INFINITY, respectively.
@@ -1609,6 +1790,29 @@ reset_mgrp_membership(const network_t *);
 static void
 reset_sigma_distance_Ps_for_betw_centrality(const network_t *);
 
+/*! \fn restore_paths_from_prev_lfts(const osm_ucast_mgr_t *,
+ *                                   const network_t *,
+ *                                   uint8_t **,
+ *                                   const osm_port_t *,
+ *                                   const ib_net16_t)
+ *  \brief This fn reconstructs the used_link and hops of all network nodes for
+ *         the paths towards a dlid from the LFTs of the last run.
+ *
+ *  \param[in]     mgr       The management object of OpenSM.
+ *  \param[in,out] network   Nue's network object storing the subnet.
+ *  \param[in]     prev_lfts Old LFT of each network node (same index).
+ *  \param[in]     dest_port OpenSM's port object of the destination.
+ *  \param[in]     dlid      Destination LID of the paths.
+ *  \return TRUE if all paths could be restored, or FALSE if an old path uses
+ *          a link which isn't available anymore.
+ */
+static boolean_t
+restore_paths_from_prev_lfts(const osm_ucast_mgr_t *,
+			     const network_t *,
+			     uint8_t **,
+			     const osm_port_t *,
+			     const ib_net16_t);
+
 /*! \fn route_via_modified_dijkstra_on_ccdg(const osm_ucast_mgr_t *,
  *                                          const network_t *,
  *                                          ccdg_t *,
@@ -1644,6 +1848,98 @@ route_via_modified_dijkstra_on_ccdg(const osm_ucast_mgr_t *,
 				    const int32_t,
 				    boolean_t *);
 
+/*! \fn route_virtual_layer(nue_context_t *,
+ *                          network_t *,
+ *                          ccdg_t *,
+ *                          const uint8_t,
+ *                          const boolean_t,
+ *                          pthread_mutex_t *)
+ *  \brief This fn calculates the escape paths of a virtual layer and then
+ *         routes all destinations of the layer on the complete CDG.
+ *
+ *  \param[in,out] nue_ctx          Nue's context storing graph, cCDG, etc.
+ *  \param[in,out] network          Network used for the layer (the one of
+ *                                   nue_ctx or a private copy).
+ *  \param[in,out] ccdg             Complete CDG used for the layer (the one
+ *                                   of nue_ctx or a private copy).
+ *  \param[in]     vl               The virtual layer.
+ *  \param[in]     include_switches Consider switches as destinations.
+ *  \param[in]     lft_lock         Mutex to serialize the LFT updates of
+ *                                   concurrently routed layers, or NULL.
+ *  \return Integer 0 if the routing was successful, or -1 otherwise.
+ */
+static int
+route_virtual_layer(nue_context_t *,
+		    network_t *,
+		    ccdg_t *,
+		    const uint8_t,
+		    const boolean_t,
+		    pthread_mutex_t *);
+
+/*! \fn route_virtual_layers_in_parallel(nue_context_t *,
+ *                                       const boolean_t,
+ *                                       const uint8_t)
+ *  \brief This fn routes the virtual layers with multiple threads, each with
+ *         private copies of network and complete CDG.
+ *
+ *  Function description: The layers are assigned round-robin to the workers,
+ *  and each worker balances its paths w.r.t. its own layers only. Hence, the
+ *  result only depends on the number of threads. Afterwards, the link weight
+ *  changes of all workers are added to the network of the context.
+ *
+ *  \param[in,out] nue_ctx          Nue's context storing graph, cCDG, etc.
+ *  \param[in]     include_switches Consider switches as destinations.
+ *  \param[in]     num_workers      Number of workers (incl. calling thread).
+ *  \return Integer 0 if the routing was successful, or -1 otherwise.
+ */
+static int
+route_virtual_layers_in_parallel(nue_context_t *,
+				 const boolean_t,
+				 const uint8_t);
+
+/*! \fn route_virtual_layers_of_worker(void *)
+ *  \brief Thread fn which routes all virtual layers assigned to a worker.
+ *
+ *  \param[in,out] context The nue_layer_worker_t of this thread.
+ *  \return NONE
+ */
+static void
+route_virtual_layers_of_worker(void *);
+
+/*! \fn save_escape_path_weights(network_t *,
+ *                               const uint8_t)
+ *  \brief This fn stores the current link weights, which are used to calculate
+ *         the escape paths of a virtual layer, in the network nodes (if the
+ *         nodes have an array for them, see alloc_escape_path_weights).
+ *
+ *  \param[in,out] network Nue's network object storing the subnet.
+ *  \param[in]     vl      Virtual layer of the escape paths.
+ *  \return NONE
+ */
+static void
+save_escape_path_weights(network_t *,
+			 const uint8_t);
+
+/*! \fn save_linear_forwarding_tables(nue_context_t *)
+ *  \brief This fn copies the calculated LFTs into the network nodes, so that
+ *         the next run can restore unaffected paths from them.
+ *
+ *  \param[in,out] nue_ctx Nue's context storing graph, cCDG, destinations, etc.
+ *  \return NONE
+ */
+static void
+save_linear_forwarding_tables(nue_context_t *);
+
+/*! \fn save_prev_routing(nue_context_t *)
+ *  \brief This fn moves the network (incl. LFT copies) and the destinations
+ *         per virtual layer of the last run into the nue_prev_routing_t struct.
+ *
+ *  \param[in,out] nue_ctx Nue's context storing graph, cCDG, destinations, etc.
+ *  \return NONE
+ */
+static void
+save_prev_routing(nue_context_t *);
+
 /*! \fn set_ccdg_edge_into_blocked_state(const ccdg_t *,
  *                                       ccdg_edge_t *)
  *  \brief Change a cCDG edge to set the color ID/Ptr into the BLOCKED state,
@@ -1702,6 +1998,19 @@ sort_destinations_by_lid(ib_net16_t *,
 static inline void
 sort_network_nodes_by_lid(const network_t *);
 
+/*! \fn swap_escape_path_weights(network_t *,
+ *                               const uint8_t)
+ *  \brief This fn exchanges the link weights with the escape path weights of
+ *         the given virtual layer, which were stored in the network nodes.
+ *
+ *  \param[in,out] network Nue's network object storing the subnet.
+ *  \param[in]     vl      Virtual layer of the escape paths.
+ *  \return NONE
+ */
+static void
+swap_escape_path_weights(network_t *,
+			 const uint8_t);
+
 /*! \fn update_ccdg_heap_index(const void *,
  *                             const size_t)
  *  \brief Callback fn for the cl_heap to update the heap index of a complete
@@ -2029,6 +2338,14 @@ static inline void destroy_network_node(network_node_t * node)
 		free(node->Ps);
 		node->Ps = NULL;
 	}
+	if (node->lft) {
+		free(node->lft);
+		node->lft = NULL;
+	}
+	if (node->escape_weights) {
+		free(node->escape_weights);
+		node->escape_weights = NULL;
+	}
 }
 
 static inline void construct_network(network_t * network)
@@ -2130,6 +2447,147 @@ static inline void destroy_ccdg(ccdg_t * ccdg)
 		cl_heap_destroy(&(ccdg->heap));
 }
 
+static inline void construct_prev_routing(nue_prev_routing_t * prev)
+{
+	CL_ASSERT(prev);
+	memset(prev, 0, sizeof(nue_prev_routing_t));
+	construct_network(&(prev->network));
+}
+
+static void destroy_prev_routing(nue_prev_routing_t * prev)
+{
+	uint8_t i = 0;
+
+	CL_ASSERT(prev);
+
+	destroy_network(&(prev->network));
+	for (i = 0; i < IB_MAX_NUM_VLS; i++) {
+		if (prev->destinations[i]) {
+			free(prev->destinations[i]);
+			prev->destinations[i] = NULL;
+		}
+		prev->num_destinations[i] = 0;
+	}
+	prev->valid = FALSE;
+}
+
+static int clone_network_and_ccdg(const osm_ucast_mgr_t * mgr,
+				  const network_t * in_network,
+				  const ccdg_t * in_ccdg,
+				  network_t * out_network, ccdg_t * out_ccdg)
+{
+	network_node_t *in_node = NULL, *out_node = NULL;
+	network_link_t *in_link = NULL, *out_link = NULL;
+	ccdg_node_t *in_ccdg_node = NULL, *out_ccdg_node = NULL;
+	ccdg_edge_t *out_ccdg_edge = NULL;
+	uint32_t i = 0, j = 0;
+
+	CL_ASSERT(mgr && in_network && in_ccdg && out_network && out_ccdg);
+
+	construct_network(out_network);
+	construct_ccdg(out_ccdg);
+
+	out_network->nodes =
+	    (network_node_t *) malloc(in_network->num_nodes *
+				      sizeof(network_node_t));
+	out_ccdg->nodes =
+	    (ccdg_node_t *) malloc(in_ccdg->num_nodes * sizeof(ccdg_node_t));
+	if ((in_network->num_nodes && !out_network->nodes)
+	    || (in_ccdg->num_nodes && !out_ccdg->nodes)) {
+		OSM_LOG(mgr->p_log, OSM_LOG_ERROR,
+			"ERR NUE54: cannot allocate memory for a copy of the"
+			" network or the complete CDG\n");
+		return -1;
+	}
+
+	/* first the shallow copies, which don't own anything yet (except for
+	   the shared escape path weights), so destroying them is always safe
+	 */
+	memcpy(out_network->nodes, in_network->nodes,
+	       in_network->num_nodes * sizeof(network_node_t));
+	for (i = 0, out_node = out_network->nodes; i < in_network->num_nodes;
+	     i++, out_node++) {
+		out_node->links = NULL;
+		out_node->stack_used_links = NULL;
+		out_node->Ps = NULL;
+		out_node->lft = NULL;
+		out_node->used_link = NULL;
+		out_node->escape_path = NULL;
+	}
+	out_network->num_nodes = in_network->num_nodes;
+
+	memcpy(out_ccdg->nodes, in_ccdg->nodes,
+	       in_ccdg->num_nodes * sizeof(ccdg_node_t));
+	for (i = 0, out_ccdg_node = out_ccdg->nodes; i < in_ccdg->num_nodes;
+	     i++, out_ccdg_node++) {
+		out_ccdg_node->edges = NULL;
+		out_ccdg_node->corresponding_netw_link = NULL;
+		out_ccdg_node->color = NULL;
+		out_ccdg_node->pre = NULL;
+	}
+	out_ccdg->num_nodes = in_ccdg->num_nodes;
+
+	/* and afterwards the deep copies with pointers into the copies */
+	for (i = 0, in_node = in_network->nodes, out_node = out_network->nodes;
+	     i < in_network->num_nodes; i++, in_node++, out_node++) {
+		out_node->links =
+		    (network_link_t *) malloc(in_node->num_links *
+					      sizeof(network_link_t));
+		out_node->stack_used_links =
+		    (network_link_t **) malloc(in_node->num_links *
+					       sizeof(network_link_t *));
+		if (in_node->num_links
+		    && (!out_node->links || !out_node->stack_used_links)) {
+			OSM_LOG(mgr->p_log, OSM_LOG_ERROR,
+				"ERR NUE55: cannot allocate memory for links of"
+				" a network node copy\n");
+			return -1;
+		}
+		memcpy(out_node->links, in_node->links,
+		       in_node->num_links * sizeof(network_link_t));
+
+		for (j = 0, in_link = in_node->links, out_link = out_node->links;
+		     j < in_node->num_links; j++, in_link++, out_link++) {
+			out_link->to_network_node =
+			    out_network->nodes + (in_link->to_network_node -
+						  in_network->nodes);
+			if (!in_link->corresponding_ccdg_node)
+				continue;
+			out_link->corresponding_ccdg_node =
+			    out_ccdg->nodes + (in_link->corresponding_ccdg_node -
+					       in_ccdg->nodes);
+			out_link->corresponding_ccdg_node->
+			    corresponding_netw_link = out_link;
+		}
+	}
+
+	for (i = 0, in_ccdg_node = in_ccdg->nodes, out_ccdg_node =
+	     out_ccdg->nodes; i < in_ccdg->num_nodes;
+	     i++, in_ccdg_node++, out_ccdg_node++) {
+		out_ccdg_node->edges =
+		    (ccdg_edge_t *) malloc(in_ccdg_node->num_edges *
+					   sizeof(ccdg_edge_t));
+		if (in_ccdg_node->num_edges && !out_ccdg_node->edges) {
+			OSM_LOG(mgr->p_log, OSM_LOG_ERROR,
+				"ERR NUE56: cannot allocate memory for edges of"
+				" a ccdg node copy\n");
+			return -1;
+		}
+		memcpy(out_ccdg_node->edges, in_ccdg_node->edges,
+		       in_ccdg_node->num_edges * sizeof(ccdg_edge_t));
+
+		for (j = 0, out_ccdg_edge = out_ccdg_node->edges;
+		     j < in_ccdg_node->num_edges; j++, out_ccdg_edge++) {
+			out_ccdg_edge->to_ccdg_node =
+			    out_ccdg->nodes + (out_ccdg_edge->to_ccdg_node -
+					       in_ccdg->nodes);
+			out_ccdg_edge->color = NULL;
+		}
+	}
+
+	return 0;
+}
+
 #if defined (ENABLE_METIS_FOR_NUE)
 static inline void construct_metis_context(metis_context_t * metis_ctx)
 {
@@ -2297,6 +2755,25 @@ static int compare_two_channel_id(const void *c1, const void *c2)
 		return 0;
 }
 
+static network_link_t *get_network_link_by_channel_id(const network_node_t *
+						      network_node,
+						      const channel_t
+						      channel_id)
+{
+	network_link_t *netw_link_iter = NULL;
+	uint8_t i = 0;
+
+	CL_ASSERT(network_node);
+
+	for (i = 0, netw_link_iter = network_node->links;
+	     i < network_node->num_links; i++, netw_link_iter++) {
+		if (0 == compare_two_channel_id(&channel_id,
+						&(netw_link_iter->link_info)))
+			return netw_link_iter;
+	}
+	return NULL;
+}
+
 static inline int compare_ccdg_nodes_by_channel_id(const void *cn1,
 						   const void *cn2)
 {
@@ -3133,7 +3610,7 @@ static int create_context(nue_context_t * nue_ctx)
 
 	/* and an array for the mapping of src/dest path to VL */
 	nue_ctx->dlid_to_vl_mapping =
-	    (uint8_t *) malloc(max_lid_ho * sizeof(uint8_t));
+	    (uint8_t *) malloc((max_lid_ho + 1) * sizeof(uint8_t));
 	if (!nue_ctx->dlid_to_vl_mapping) {
 		OSM_LOG(nue_ctx->mgr->p_log, OSM_LOG_ERROR,
 			"ERR NUE06: cannot allocate dlid_to_vl_mapping\n");
@@ -3141,7 +3618,11 @@ static int create_context(nue_context_t * nue_ctx)
 		return -1;
 	}
 	memset(nue_ctx->dlid_to_vl_mapping, OSM_DEFAULT_SL,
-	       max_lid_ho * sizeof(uint8_t));
+	       (max_lid_ho + 1) * sizeof(uint8_t));
+
+	/* no LFTs have been calculated (and saved) for this network yet */
+	nue_ctx->init_weight = 0;
+	nue_ctx->lft_max_lid_ho = 0;
 
 	return 0;
 }
@@ -3161,6 +3642,7 @@ static nue_context_t *nue_create_context(const osm_opensm_t * osm,
 		/* set initial values with stuff provided by caller */
 		nue_ctx->routing_type = routing_type;
 		nue_ctx->mgr = (osm_ucast_mgr_t *) & (osm->sm.ucast_mgr);
+		construct_prev_routing(&(nue_ctx->prev));
 		err = create_context(nue_ctx);
 		if (err) {
 			free(nue_ctx);
@@ -3175,6 +3657,34 @@ static nue_context_t *nue_create_context(const osm_opensm_t * osm,
 	return nue_ctx;
 }
 
+/* move the network (incl. the LFT copies) and the assignment of destinations
+   to virtual layers of the last run aside, so that nue_do_ucast_routing can
+   try to reroute only those destinations which are affected by a failure
+ */
+static void save_prev_routing(nue_context_t * nue_ctx)
+{
+	nue_prev_routing_t *prev = NULL;
+	uint8_t i = 0;
+
+	CL_ASSERT(nue_ctx && nue_ctx->lft_max_lid_ho);
+
+	prev = (nue_prev_routing_t *) & (nue_ctx->prev);
+	CL_ASSERT(!prev->valid && !prev->network.nodes);
+
+	prev->network = nue_ctx->network;
+	construct_network(&(nue_ctx->network));
+	for (i = 0; i < IB_MAX_NUM_VLS; i++) {
+		prev->num_destinations[i] = nue_ctx->num_destinations[i];
+		prev->destinations[i] = nue_ctx->destinations[i];
+		nue_ctx->destinations[i] = NULL;
+		prev->central_node_lids[i] = nue_ctx->central_node_lids[i];
+	}
+	prev->max_vl = nue_ctx->max_vl;
+	prev->max_lmc = nue_ctx->max_lmc;
+	prev->max_lid_ho = nue_ctx->lft_max_lid_ho;
+	prev->valid = TRUE;
+}
+
 /* count the total number of Hca/Tca (or LIDs for lmc>0) in the fabric
    (even include base/enhanced switch port 0; base SP0 will have lmc=0);
    and while we are already on it, we save the base lids for later
@@ -3424,9 +3934,14 @@ static int nue_discover_network(void *context)
 		"Building network graph for nue routing\n");
 
 	/* if this pointer isn't NULL, this is a reroute step;
-	   old context will be destroyed and we set up a new/clean context
+	   old context will be destroyed and we set up a new/clean context,
+	   but for incremental rerouting we keep the result of the last run
 	 */
+	destroy_prev_routing(&(nue_ctx->prev));
 	if (nue_ctx->network.nodes) {
+		if (mgr->p_subn->opt.nue_incremental_reroute &&
+		    nue_ctx->lft_max_lid_ho)
+			save_prev_routing(nue_ctx);
 		destroy_context(nue_ctx);
 		create_context(nue_ctx);
 	}
@@ -3443,6 +3958,7 @@ static int nue_discover_network(void *context)
 	}
 	total_num_destination_lids = get_base_lids_and_number_of_lids(nue_ctx);
 	init_weight = total_num_destination_lids * total_num_destination_lids;
+	nue_ctx->init_weight = init_weight;
 
 	switch_tbl = &(mgr->p_subn->sw_guid_tbl);
 	total_num_switches = cl_qmap_count(switch_tbl);
@@ -4372,7 +4888,8 @@ static int calculate_spanning_tree_in_network(const osm_ucast_mgr_t * mgr,
 static int mark_escape_paths(const osm_ucast_mgr_t * mgr, network_t * network,
 			     const ccdg_t * ccdg, ib_net16_t * destinations,
 			     const uint16_t num_destinations,
-			     const boolean_t verify_network_integrity)
+			     const boolean_t verify_network_integrity,
+			     ib_net16_t * central_node_lid)
 {
 	network_node_t *central_node = NULL, *netw_node_iter = NULL;
 	network_node_t *network_node1 = NULL, *network_node2 = NULL;
@@ -4386,7 +4903,7 @@ static int mark_escape_paths(const osm_ucast_mgr_t * mgr, network_t * network,
 	int err = 0;
 
 	CL_ASSERT(mgr && network && ccdg && destinations
-		  && num_destinations > 0);
+		  && num_destinations > 0 && central_node_lid);
 	OSM_LOG_ENTER(mgr->p_log);
 	OSM_LOG(mgr->p_log, OSM_LOG_INFO,
 		"Initialize complete CDG with escape paths\n");
@@ -4401,15 +4918,27 @@ static int mark_escape_paths(const osm_ucast_mgr_t * mgr, network_t * network,
 		return -1;
 	}
 
-	err =
-	    get_central_node_wrt_subnetwork(mgr, network, destinations,
-					    num_destinations, &central_node,
-					    &central_node_index);
-	if (err) {
-		OSM_LOG(mgr->p_log, OSM_LOG_ERROR,
-			"ERR NUE26: unable to find a central node; unable to"
-			" proceed\n");
-		return -1;
+	/* keep the root of the last run (if known), since a new root would
+	   change all escape paths
+	 */
+	if (*central_node_lid)
+		central_node = get_network_node_by_lid(network,
+						       *central_node_lid);
+	if (central_node) {
+		central_node_index = (uint16_t) (central_node - network->nodes);
+	} else {
+		err =
+		    get_central_node_wrt_subnetwork(mgr, network, destinations,
+						    num_destinations,
+						    &central_node,
+						    &central_node_index);
+		if (err) {
+			OSM_LOG(mgr->p_log, OSM_LOG_ERROR,
+				"ERR NUE26: unable to find a central node;"
+				" unable to proceed\n");
+			return -1;
+		}
+		*central_node_lid = central_node->lid;
 	}
 	OSM_LOG(mgr->p_log, OSM_LOG_INFO, "central node:\n");
 	print_network_node(mgr, central_node, central_node_index, FALSE);
@@ -5929,6 +6458,120 @@ static void init_linear_forwarding_tables(const osm_ucast_mgr_t * mgr,
 	OSM_LOG_EXIT(mgr->p_log);
 }
 
+/* the escape paths depend on the link weights at the time they were
+   calculated, so we keep these weights for each VL to be able to calculate
+   the same escape paths again during an incremental rerouting
+ */
+static void alloc_escape_path_weights(nue_context_t * nue_ctx)
+{
+	network_node_t *netw_node_iter = NULL;
+	uint16_t i = 0;
+
+	CL_ASSERT(nue_ctx);
+
+	for (i = 0, netw_node_iter = nue_ctx->network.nodes;
+	     i < nue_ctx->network.num_nodes; i++, netw_node_iter++) {
+		if (!netw_node_iter->num_links || netw_node_iter->escape_weights)
+			continue;
+		netw_node_iter->escape_weights =
+		    (uint64_t *) calloc(netw_node_iter->num_links *
+					nue_ctx->max_vl, sizeof(uint64_t));
+		if (!netw_node_iter->escape_weights) {
+			OSM_LOG(nue_ctx->mgr->p_log, OSM_LOG_INFO,
+				"WRN NUE52: cannot allocate memory for escape"
+				" path weights; next rerouting will be a full"
+				" run\n");
+			return;
+		}
+	}
+}
+
+static void save_escape_path_weights(network_t * network, const uint8_t vl)
+{
+	network_node_t *netw_node_iter = NULL;
+	network_link_t *netw_link_iter = NULL;
+	uint16_t i = 0;
+	uint8_t j = 0;
+
+	CL_ASSERT(network);
+
+	for (i = 0, netw_node_iter = network->nodes; i < network->num_nodes;
+	     i++, netw_node_iter++) {
+		if (!netw_node_iter->escape_weights)
+			continue;
+		for (j = 0, netw_link_iter = netw_node_iter->links;
+		     j < netw_node_iter->num_links; j++, netw_link_iter++)
+			netw_node_iter->escape_weights[vl *
+						       netw_node_iter->num_links +
+						       j] = netw_link_iter->weight;
+	}
+}
+
+/* exchange the current link weights with the saved escape path weights of
+   the given VL (calling it twice restores the original state)
+ */
+static void swap_escape_path_weights(network_t * network, const uint8_t vl)
+{
+	network_node_t *netw_node_iter = NULL;
+	network_link_t *netw_link_iter = NULL;
+	uint64_t *weight = NULL, tmp = 0;
+	uint16_t i = 0;
+	uint8_t j = 0;
+
+	CL_ASSERT(network);
+
+	for (i = 0, netw_node_iter = network->nodes; i < network->num_nodes;
+	     i++, netw_node_iter++) {
+		for (j = 0, netw_link_iter = netw_node_iter->links;
+		     j < netw_node_iter->num_links; j++, netw_link_iter++) {
+			weight = &(netw_node_iter->escape_weights
+				   [vl * netw_node_iter->num_links + j]);
+			tmp = netw_link_iter->weight;
+			netw_link_iter->weight = *weight;
+			*weight = tmp;
+		}
+	}
+}
+
+/* keep a copy of the calculated LFTs in the network nodes, which is needed to
+   restore unaffected paths when the next run is an incremental rerouting
+ */
+static void save_linear_forwarding_tables(nue_context_t * nue_ctx)
+{
+	network_node_t *netw_node_iter = NULL;
+	osm_switch_t *sw = NULL;
+	uint16_t i = 0, max_lid_ho = 0;
+	uint8_t *lft = NULL;
+
+	CL_ASSERT(nue_ctx && nue_ctx->network.nodes);
+
+	nue_ctx->lft_max_lid_ho = 0;
+
+	max_lid_ho = nue_ctx->mgr->p_subn->max_ucast_lid_ho;
+	for (i = 0, netw_node_iter = nue_ctx->network.nodes;
+	     i < nue_ctx->network.num_nodes; i++, netw_node_iter++) {
+		if (netw_node_iter->sw->max_lid_ho < max_lid_ho)
+			max_lid_ho = netw_node_iter->sw->max_lid_ho;
+	}
+
+	for (i = 0, netw_node_iter = nue_ctx->network.nodes;
+	     i < nue_ctx->network.num_nodes; i++, netw_node_iter++) {
+		sw = netw_node_iter->sw;
+		lft = (uint8_t *) realloc(netw_node_iter->lft,
+					  (max_lid_ho + 1) * sizeof(uint8_t));
+		if (!lft) {
+			OSM_LOG(nue_ctx->mgr->p_log, OSM_LOG_INFO,
+				"WRN NUE49: cannot allocate memory for LFT copy;"
+				" next rerouting will be a full run\n");
+			return;
+		}
+		memcpy(lft, sw->new_lft, (max_lid_ho + 1) * sizeof(uint8_t));
+		netw_node_iter->lft = lft;
+	}
+
+	nue_ctx->lft_max_lid_ho = max_lid_ho;
+}
+
 /* update the linear forwarding tables of all switches with the informations
    from the last routing step performed with our modified dijkstra on the ccdg
 */
@@ -6028,212 +6671,626 @@ static inline void update_dlid_to_vl_mapping(uint8_t * dlid_to_vl_mapping,
 	dlid_to_vl_mapping[cl_ntoh16(dlid)] = virtual_layer;
 }
 
-static int nue_do_ucast_routing(void *context)
+/* reconstruct the paths of all switches towards dlid, i.e., the used_link and
+   hops of each network node, from the LFTs calculated in the last run; this
+   fails if one of the old paths uses a link which isn't available anymore
+ */
+static boolean_t restore_paths_from_prev_lfts(const osm_ucast_mgr_t * mgr,
+					      const network_t * network,
+					      uint8_t ** prev_lfts,
+					      const osm_port_t * dest_port,
+					      const ib_net16_t dlid)
 {
-	nue_context_t *nue_ctx = (nue_context_t *) context;
-	osm_ucast_mgr_t *mgr = NULL;
-	osm_port_t *dest_port = NULL;
-	boolean_t include_switches = FALSE;
-	ib_net16_t *dlid_iter = NULL;
-	uint16_t lid = 0, min_lid_ho = 0, max_lid_ho = 0;
-	uint16_t i = 0;
-	uint8_t vl = 0;
-	uint8_t ntype = 0;
-	int err = 0;
-	int32_t color = 0;
-	boolean_t process_sw = FALSE, fallback_to_escape_paths = FALSE;
+	network_node_t *source_netw_node = NULL, *network_node = NULL;
 	network_node_t *netw_node_iter = NULL;
-#if defined (_DEBUG_)
-	ccdg_t verify_ccdg = {.num_nodes = 0, .nodes = NULL, .num_colors = 0,
-			      .color_array = NULL};
-#endif
+	network_link_t *link = NULL, *netw_link_iter = NULL;
+	uint16_t i = 0, depth = 0, hops = 0;
+	uint8_t j = 0, exit_port = 0;
 
-	if (nue_ctx)
-		mgr = (osm_ucast_mgr_t *) nue_ctx->mgr;
-	else
-		return -1;
+	CL_ASSERT(mgr && network && prev_lfts && dest_port && dlid > 0);
+
+	source_netw_node =
+	    get_network_node_by_lid(network, get_switch_lid(mgr, dlid));
+	CL_ASSERT(source_netw_node);
+
+	for (i = 0, netw_node_iter = network->nodes; i < network->num_nodes;
+	     i++, netw_node_iter++) {
+		netw_node_iter->used_link = NULL;
+		netw_node_iter->hops = UINT8_MAX;
+		if (netw_node_iter == source_netw_node)
+			continue;
+
+		/* search the link which leaves the switch thru the old port */
+		exit_port = prev_lfts[i][cl_ntoh16(dlid)];
+		link = NULL;
+		for (j = 0, netw_link_iter = netw_node_iter->links;
+		     j < netw_node_iter->num_links; j++, netw_link_iter++) {
+			if (netw_link_iter->link_info.local_port == exit_port) {
+				link = netw_link_iter;
+				break;
+			}
+		}
+		if (!link)
+			return FALSE;
+
+		/* Dijkstra's algo on the cCDG starts at the destination, so
+		   the used_link is the reverse of the link found above
+		 */
+		network_node = link->to_network_node;
+		for (j = 0, netw_link_iter = network_node->links;
+		     j < network_node->num_links; j++, netw_link_iter++) {
+			if (netw_link_iter->link_info.local_port ==
+			    link->link_info.remote_port) {
+				netw_node_iter->used_link = netw_link_iter;
+				break;
+			}
+		}
+		if (!netw_node_iter->used_link)
+			return FALSE;
+	}
+
+	source_netw_node->hops =
+	    (osm_node_get_type(dest_port->p_node) ==
+	     IB_NODE_TYPE_SWITCH) ? 0 : 1;
+	for (i = 0, netw_node_iter = network->nodes; i < network->num_nodes;
+	     i++, netw_node_iter++) {
+		/* walk towards the destination until the hops are known... */
+		depth = 0;
+		for (network_node = netw_node_iter;
+		     network_node->hops == UINT8_MAX;
+		     network_node =
+		     get_network_node_by_lid(network,
+					     network_node->used_link->link_info.
+					     local_lid)) {
+			/* the old LFTs are loop-free, but better be safe */
+			if (++depth > network->num_nodes)
+				return FALSE;
+		}
+		hops = network_node->hops + depth;
+		if (hops >= UINT8_MAX)
+			return FALSE;
+
+		/* ...and set them for all switches along the way */
+		for (network_node = netw_node_iter;
+		     network_node->hops == UINT8_MAX;
+		     network_node =
+		     get_network_node_by_lid(network,
+					     network_node->used_link->link_info.
+					     local_lid))
+			network_node->hops = (uint8_t) hops--;
+	}
+
+	return TRUE;
+}
+
+/* the paths towards dlid, which have been restored by the function above, are
+   fixed; hence, we add their channel dependencies to the acyclic subgraph of
+   the escape paths, so that new paths for other destinations will respect them
+ */
+static void add_restored_paths_to_ccdg(const osm_ucast_mgr_t * mgr,
+				       const network_t * network,
+				       const ccdg_t * ccdg,
+				       const ib_net16_t dlid)
+{
+	network_node_t *source_netw_node = NULL, *network_node = NULL;
+	network_node_t *netw_node_iter = NULL;
+	ccdg_node_t *source_ccdg_node = NULL, *ccdg_node = NULL;
+	ccdg_node_t *pre_ccdg_node = NULL;
+	channel_t source_channel_id;
+	uint16_t i = 0;
 
+	CL_ASSERT(mgr && network && ccdg && dlid > 0);
+
+	source_netw_node =
+	    get_network_node_by_lid(network, get_switch_lid(mgr, dlid));
+	CL_ASSERT(source_netw_node);
+
+	source_channel_id.local_lid = source_netw_node->lid;
+	source_channel_id.local_port = 0;
+	source_channel_id.remote_lid = source_netw_node->lid;
+	source_channel_id.remote_port = 0;
+	source_ccdg_node = get_ccdg_node_by_channel_id(ccdg, source_channel_id);
+	CL_ASSERT(source_ccdg_node);
+
+	for (i = 0, netw_node_iter = network->nodes; i < network->num_nodes;
+	     i++, netw_node_iter++) {
+		if (!netw_node_iter->used_link)
+			continue;
+
+		ccdg_node = netw_node_iter->used_link->corresponding_ccdg_node;
+		network_node =
+		    get_network_node_by_lid(network,
+					    netw_node_iter->used_link->
+					    link_info.local_lid);
+		CL_ASSERT(ccdg_node && network_node);
+
+		if (network_node == source_netw_node)
+			pre_ccdg_node = source_ccdg_node;
+		else
+			pre_ccdg_node =
+			    network_node->used_link->corresponding_ccdg_node;
+		CL_ASSERT(pre_ccdg_node);
+
+		init_ccdg_escape_path_node_color(ccdg, pre_ccdg_node);
+		init_ccdg_escape_path_node_color(ccdg, ccdg_node);
+		init_ccdg_escape_path_edge_color_betw_nodes(ccdg, pre_ccdg_node,
+							    ccdg_node);
+	}
+}
+
+/* search for cycles in the colored subgraph of the cCDG (ignoring all unused
+   and blocked edges) with an iterative depth-first search
+ */
+static boolean_t is_colored_subccdg_acyclic(const osm_ucast_mgr_t * mgr,
+					    const ccdg_t * ccdg)
+{
+	ccdg_node_t *ccdg_node_iter = NULL, *curr_node = NULL;
+	ccdg_node_t *next_node = NULL;
+	ccdg_edge_t *ccdg_edge_iter = NULL;
+	uint32_t i = 0;
+	uint8_t j = 0;
+	boolean_t acyclic = TRUE;
+
+	CL_ASSERT(mgr && ccdg && ccdg->nodes);
 	OSM_LOG_ENTER(mgr->p_log);
-	OSM_LOG(mgr->p_log, OSM_LOG_INFO, "Start routing process with nue\n");
 
+	for (i = 0, ccdg_node_iter = ccdg->nodes;
+	     i < ccdg->num_nodes && acyclic; i++, ccdg_node_iter++) {
+		if (WHITE != ccdg_node_iter->status
+		    || get_ccdg_node_color(ccdg, ccdg_node_iter) <= UNUSED)
+			continue;
+
+		curr_node = ccdg_node_iter;
+		curr_node->status = GRAY;
+		curr_node->next_edge_idx = 0;
+		curr_node->pre = NULL;
+		while (curr_node && acyclic) {
+			next_node = NULL;
+			for (j = curr_node->next_edge_idx, ccdg_edge_iter =
+			     curr_node->edges + curr_node->next_edge_idx;
+			     j < curr_node->num_edges; j++, ccdg_edge_iter++) {
+				if (get_ccdg_edge_color(ccdg, ccdg_edge_iter) <=
+				    UNUSED)
+					continue;
+				if (GRAY == ccdg_edge_iter->to_ccdg_node->status) {
+					acyclic = FALSE;
+					break;
+				} else if (WHITE ==
+					   ccdg_edge_iter->to_ccdg_node->status) {
+					next_node =
+					    ccdg_edge_iter->to_ccdg_node;
+					curr_node->next_edge_idx = j + 1;
+					break;
+				}
+			}
+
+			if (next_node) {
+				next_node->status = GRAY;
+				next_node->next_edge_idx = 0;
+				next_node->pre = curr_node;
+				curr_node = next_node;
+			} else if (acyclic) {
+				curr_node->status = BLACK;
+				curr_node = curr_node->pre;
+			}
+		}
+	}
+
+	/* reset changed status fields */
+	for (i = 0, ccdg_node_iter = ccdg->nodes; i < ccdg->num_nodes;
+	     i++, ccdg_node_iter++) {
+		ccdg_node_iter->status = WHITE;
+		ccdg_node_iter->pre = NULL;
+	}
+
+	OSM_LOG_EXIT(mgr->p_log);
+	return acyclic;
+}
+
+/* undo all changes of an aborted incremental rerouting before a full run */
+static void reset_routing_results(nue_context_t * nue_ctx)
+{
+	osm_ucast_mgr_t *mgr = NULL;
+	network_node_t *netw_node_iter = NULL;
+	network_link_t *netw_link_iter = NULL;
+	osm_switch_t *sw = NULL;
+	uint16_t i = 0;
+	uint8_t j = 0;
+
+	CL_ASSERT(nue_ctx);
+	mgr = (osm_ucast_mgr_t *) nue_ctx->mgr;
+
+	for (i = 0, netw_node_iter = nue_ctx->network.nodes;
+	     i < nue_ctx->network.num_nodes; i++, netw_node_iter++) {
+		sw = netw_node_iter->sw;
+		for (j = 0; j < sw->num_ports; j++)
+			osm_port_prof_construct(&(sw->p_prof[j]));
+		osm_switch_clear_hops(sw);
+
+		for (j = 0, netw_link_iter = netw_node_iter->links;
+		     j < netw_node_iter->num_links; j++, netw_link_iter++)
+			netw_link_iter->weight = nue_ctx->init_weight;
+	}
+
+	memset(nue_ctx->dlid_to_vl_mapping, OSM_DEFAULT_SL,
+	       (mgr->p_subn->max_ucast_lid_ho + 1) * sizeof(uint8_t));
 	init_linear_forwarding_tables(mgr, &(nue_ctx->network));
+}
 
-	if (mgr->p_subn->opt.nue_include_switches) {
+/* reuse the routing of the last run if the fabric only lost switches, links or
+   terminals since then: paths of unaffected destinations are restored from the
+   saved LFTs and added to the escape paths of their virtual layer, and only the
+   destinations whose paths used a vanished channel are routed on the cCDG;
+   returns 0 on success, 1 if a full run is required, and -1 on errors
+ */
+static int reroute_incrementally(nue_context_t * nue_ctx,
+				 const boolean_t include_switches)
+{
+	osm_ucast_mgr_t *mgr = NULL;
+	nue_prev_routing_t *prev = NULL;
+	network_t *network = NULL;
+	ccdg_t *ccdg = NULL;
+	network_node_t *netw_node_iter = NULL, *network_node = NULL;
+	network_link_t *netw_link_iter = NULL, *link = NULL;
+	osm_port_t *dest_port = NULL;
+	uint8_t **prev_lfts = NULL;
+	uint8_t *lft = NULL;
+	boolean_t *affected = NULL;
+	ib_net16_t *destinations[IB_MAX_NUM_VLS];
+	uint16_t num_destinations[IB_MAX_NUM_VLS];
+	uint32_t num_affected[IB_MAX_NUM_VLS];
+	ib_net16_t *dlid_iter = NULL;
+	uint16_t lid = 0, min_lid_ho = 0, max_lid_ho = 0;
+	uint16_t i = 0, num_new_destinations = 0, num_old_destinations = 0;
+	uint16_t num_kept_destinations = 0;
+	uint32_t total_num_lids = 0, total_num_affected = 0;
+	uint8_t vl = 0, j = 0, exit_port = 0;
+	int32_t color = 0;
+	boolean_t process_sw = FALSE, fallback_to_escape_paths = FALSE;
+	boolean_t verify_network_integrity = TRUE;
+	int err = 0, ret = 1;
+
+	CL_ASSERT(nue_ctx && nue_ctx->prev.valid);
+
+	mgr = (osm_ucast_mgr_t *) nue_ctx->mgr;
+	prev = (nue_prev_routing_t *) & (nue_ctx->prev);
+	network = (network_t *) & (nue_ctx->network);
+	ccdg = (ccdg_t *) & (nue_ctx->ccdg);
+
+	OSM_LOG_ENTER(mgr->p_log);
+
+	memset(destinations, 0, IB_MAX_NUM_VLS * sizeof(ib_net16_t *));
+	memset(num_destinations, 0, IB_MAX_NUM_VLS * sizeof(uint16_t));
+	memset(num_affected, 0, IB_MAX_NUM_VLS * sizeof(uint32_t));
+
+	if (prev->max_vl != nue_ctx->max_vl
+	    || prev->max_lmc != nue_ctx->max_lmc) {
 		OSM_LOG(mgr->p_log, OSM_LOG_INFO,
-			" ...and consider switches as traffic sinks\n");
-		include_switches = mgr->p_subn->opt.nue_include_switches;
+			"Number of VLs or LMC changed; full rerouting required\n");
+		goto Exit;
 	}
 
-	/* assign destination lids to different virtual layers */
-	err = distribute_lids_onto_virtual_layers(nue_ctx, include_switches);
-	if (err) {
-		destroy_context(nue_ctx);
-		return -1;
+	prev_lfts = (uint8_t **) calloc(network->num_nodes, sizeof(uint8_t *));
+	affected = (boolean_t *) calloc(prev->max_lid_ho + 1,
+					sizeof(boolean_t));
+	if ((network->num_nodes && !prev_lfts) || !affected) {
+		OSM_LOG(mgr->p_log, OSM_LOG_ERROR,
+			"ERR NUE50: cannot allocate memory for incremental"
+			" rerouting\n");
+		ret = -1;
+		goto Exit;
+	}
+
+	/* every switch and channel has to be known from the last run, and
+	   we continue with the link weights where the last run stopped
+	 */
+	for (i = 0, netw_node_iter = network->nodes; i < network->num_nodes;
+	     i++, netw_node_iter++) {
+		network_node =
+		    get_network_node_by_lid(&(prev->network),
+					    netw_node_iter->lid);
+		if (!network_node || network_node->guid != netw_node_iter->guid) {
+			OSM_LOG(mgr->p_log, OSM_LOG_INFO,
+				"New switch 0x%016" PRIx64 " found; full"
+				" rerouting required\n",
+				cl_ntoh64(netw_node_iter->guid));
+			goto Exit;
+		}
+		prev_lfts[i] = network_node->lft;
+		CL_ASSERT(prev_lfts[i]);
+		if (netw_node_iter->num_links && !network_node->escape_weights) {
+			OSM_LOG(mgr->p_log, OSM_LOG_INFO,
+				"No escape path weights of switch 0x%016" PRIx64
+				" known; full rerouting required\n",
+				cl_ntoh64(netw_node_iter->guid));
+			goto Exit;
+		}
+		if (netw_node_iter->num_links) {
+			netw_node_iter->escape_weights =
+			    (uint64_t *) calloc(netw_node_iter->num_links *
+						nue_ctx->max_vl,
+						sizeof(uint64_t));
+			if (!netw_node_iter->escape_weights) {
+				OSM_LOG(mgr->p_log, OSM_LOG_ERROR,
+					"ERR NUE53: cannot allocate memory for"
+					" escape path weights\n");
+				ret = -1;
+				goto Exit;
+			}
+		}
+
+		for (j = 0, netw_link_iter = netw_node_iter->links;
+		     j < netw_node_iter->num_links; j++, netw_link_iter++) {
+			link =
+			    get_network_link_by_channel_id(network_node,
+							   netw_link_iter->
+							   link_info);
+			if (!link) {
+				OSM_LOG(mgr->p_log, OSM_LOG_INFO,
+					"New link at switch 0x%016" PRIx64
+					" port %" PRIu8 " found; full rerouting"
+					" required\n",
+					cl_ntoh64(netw_node_iter->guid),
+					(uint8_t) netw_link_iter->link_info.
+					local_port);
+				goto Exit;
+			}
+			netw_link_iter->weight = link->weight;
+			for (vl = 0; vl < nue_ctx->max_vl; vl++)
+				netw_node_iter->escape_weights[vl *
+							       netw_node_iter->
+							       num_links + j] =
+				    network_node->escape_weights[vl *
+								 network_node->
+								 num_links +
+								 (link -
+								  network_node->
+								  links)];
+		}
 	}
-	if (OSM_LOG_IS_ACTIVE_V2(mgr->p_log, OSM_LOG_DEBUG))
-		print_destination_distribution(mgr, nue_ctx->destinations,
-					       nue_ctx->num_destinations);
+
+	/* paths which used a vanished channel have to be rerouted, i.e., all
+	   destinations for which the remote switch of this channel forwarded
+	   traffic thru the remote port
+	 */
+	for (i = 0, netw_node_iter = prev->network.nodes;
+	     i < prev->network.num_nodes; i++, netw_node_iter++) {
+		network_node =
+		    get_network_node_by_lid(network, netw_node_iter->lid);
+		for (j = 0, netw_link_iter = netw_node_iter->links;
+		     j < netw_node_iter->num_links; j++, netw_link_iter++) {
+			if (!get_network_node_by_lid(network,
+						     netw_link_iter->link_info.
+						     remote_lid))
+				continue;
+			if (network_node
+			    && get_network_link_by_channel_id(network_node,
+							      netw_link_iter->
+							      link_info))
+				continue;
+
+			exit_port = netw_link_iter->link_info.remote_port;
+			lft = netw_link_iter->to_network_node->lft;
+			for (lid = 1; lid <= prev->max_lid_ho; lid++)
+				if (lft[lid] == exit_port)
+					affected[lid] = TRUE;
+		}
+	}
+
+	/* only destinations of the last run can be rerouted incrementally */
+	for (i = 0, dlid_iter = nue_ctx->destinations[0];
+	     i < nue_ctx->num_destinations[0]; i++, dlid_iter++) {
+		dest_port = osm_get_port_by_lid(mgr->p_subn, *dlid_iter);
+		if (include_switches
+		    || osm_node_get_type(dest_port->p_node) !=
+		    IB_NODE_TYPE_SWITCH)
+			num_new_destinations++;
+	}
+	for (vl = 0; vl < prev->max_vl; vl++) {
+		if (!prev->num_destinations[vl])
+			continue;
+		destinations[vl] =
+		    (ib_net16_t *) malloc(prev->num_destinations[vl] *
+					  sizeof(ib_net16_t));
+		if (!destinations[vl]) {
+			OSM_LOG(mgr->p_log, OSM_LOG_ERROR,
+				"ERR NUE51: cannot allocate memory for"
+				" destinations[%" PRIu8 "]\n", vl);
+			ret = -1;
+			goto Exit;
+		}
+		for (i = 0, dlid_iter = prev->destinations[vl];
+		     i < prev->num_destinations[vl]; i++, dlid_iter++) {
+			num_old_destinations++;
+			dest_port = osm_get_port_by_lid(mgr->p_subn, *dlid_iter);
+			if (!dest_port
+			    || osm_port_get_base_lid(dest_port) != *dlid_iter)
+				continue;
+			osm_port_get_lid_range_ho(dest_port, &min_lid_ho,
+						  &max_lid_ho);
+			if (max_lid_ho > prev->max_lid_ho)
+				continue;
+			destinations[vl][num_destinations[vl]++] = *dlid_iter;
+
+			/* a terminal could have moved to a different switch */
+			if (osm_node_get_type(dest_port->p_node) ==
+			    IB_NODE_TYPE_CA) {
+				network_node =
+				    get_network_node_by_lid(network,
+							    get_switch_lid(mgr,
+									   *dlid_iter));
+				CL_ASSERT(network_node);
+				(void)osm_node_get_remote_node(dest_port->
+							       p_node,
+							       dest_port->
+							       p_physp->
+							       port_num,
+							       &exit_port);
+				lft = prev_lfts[network_node - network->nodes];
+				for (lid = min_lid_ho; lid <= max_lid_ho; lid++)
+					if (lft[lid] != exit_port)
+						affected[lid] = TRUE;
+			}
+
+			for (lid = min_lid_ho; lid <= max_lid_ho; lid++) {
+				total_num_lids++;
+				if (affected[lid])
+					num_affected[vl]++;
+			}
+		}
+		total_num_affected += num_affected[vl];
+	}
+	for (vl = 0; vl < prev->max_vl; vl++)
+		num_kept_destinations += num_destinations[vl];
+	if (num_kept_destinations != num_new_destinations) {
+		OSM_LOG(mgr->p_log, OSM_LOG_INFO,
+			"New destinations found; full rerouting required\n");
+		goto Exit;
+	}
+	if (!include_switches) {
+		for (i = 0, netw_node_iter = network->nodes;
+		     i < network->num_nodes; i++, netw_node_iter++) {
+			dest_port =
+			    osm_get_port_by_lid(mgr->p_subn,
+						netw_node_iter->lid);
+			osm_port_get_lid_range_ho(dest_port, &min_lid_ho,
+						  &max_lid_ho);
+			for (lid = min_lid_ho; lid <= max_lid_ho; lid++) {
+				total_num_lids++;
+				if (lid > prev->max_lid_ho || affected[lid])
+					total_num_affected++;
+			}
+		}
+	}
+
+	OSM_LOG(mgr->p_log, OSM_LOG_INFO,
+		"Rerouting %" PRIu32 " of %" PRIu32 " destination LIDs"
+		" incrementally (%" PRIu16 " destinations vanished)\n",
+		total_num_affected, total_num_lids,
+		num_old_destinations - num_kept_destinations);
 
 	for (vl = 0; vl < nue_ctx->max_vl; vl++) {
 		OSM_LOG(mgr->p_log, OSM_LOG_DEBUG,
 			"Processing virtual layer %" PRIu8 "\n", vl);
 
-		if (!nue_ctx->num_destinations[vl]) {
-			OSM_LOG(mgr->p_log, OSM_LOG_INFO,
-				"WRN NUE43: no desti in this VL; skipping\n");
+		if (!num_destinations[vl])
 			continue;
+		nue_ctx->central_node_lids[vl] = prev->central_node_lids[vl];
+
+		/* the cCDG is only needed if we have to find new paths */
+		if (num_affected[vl]) {
+			if (reset_ccdg_color_array(mgr, ccdg, num_destinations,
+						   nue_ctx->max_vl,
+						   nue_ctx->max_lmc)) {
+				ret = -1;
+				goto Exit;
+			}
+			init_ccdg_colors(ccdg);
+			/* use the same weights as the last run for the escape
+			   paths to keep them (and the old paths) compatible
+			 */
+			swap_escape_path_weights(network, vl);
+			err = mark_escape_paths(mgr, network, ccdg,
+						destinations[vl],
+						num_destinations[vl],
+						verify_network_integrity,
+						&(nue_ctx->central_node_lids
+						  [vl]));
+			swap_escape_path_weights(network, vl);
+			if (err) {
+				ret = -1;
+				goto Exit;
+			}
+			verify_network_integrity = FALSE;
 		}
 
-		color = ESCAPEPATHCOLOR + 1;
-		err =
-		    reset_ccdg_color_array(mgr, &(nue_ctx->ccdg),
-					   nue_ctx->num_destinations,
-					   nue_ctx->max_vl, nue_ctx->max_lmc);
-		if (err) {
-			destroy_context(nue_ctx);
-			return -1;
+		/* restore the unaffected paths (incl. their VL mapping) */
+		for (i = 0, dlid_iter = destinations[vl];
+		     i < num_destinations[vl]; i++, dlid_iter++) {
+			dest_port = osm_get_port_by_lid(mgr->p_subn, *dlid_iter);
+			osm_port_get_lid_range_ho(dest_port, &min_lid_ho,
+						  &max_lid_ho);
+			for (lid = min_lid_ho; lid <= max_lid_ho; lid++) {
+				if (affected[lid])
+					continue;
+				if (!restore_paths_from_prev_lfts
+				    (mgr, network, prev_lfts, dest_port,
+				     cl_hton16(lid))) {
+					OSM_LOG(mgr->p_log, OSM_LOG_INFO,
+						"Cannot restore paths towards"
+						" LID %" PRIu16 "; full"
+						" rerouting required\n", lid);
+					goto Exit;
+				}
+				update_linear_forwarding_tables(mgr, network,
+								dest_port,
+								cl_hton16(lid));
+				update_dlid_to_vl_mapping(nue_ctx->
+							  dlid_to_vl_mapping,
+							  cl_hton16(lid), vl);
+				if (num_affected[vl])
+					add_restored_paths_to_ccdg(mgr, network,
+								   ccdg,
+								   cl_hton16
+								   (lid));
+			}
 		}
-		init_ccdg_colors(&(nue_ctx->ccdg));
 
-		err =
-		    mark_escape_paths(mgr, &(nue_ctx->network),
-				      &(nue_ctx->ccdg),
-				      nue_ctx->destinations[vl],
-				      nue_ctx->num_destinations[vl],
-				      (0 == vl) ? TRUE : FALSE);
-		if (err) {
-			destroy_context(nue_ctx);
-			return -1;
-		}
-		if (OSM_LOG_IS_ACTIVE_V2(mgr->p_log, OSM_LOG_DEBUG)) {
-			OSM_LOG(mgr->p_log, OSM_LOG_DEBUG,
-				"Complete CDG including escape paths for"
-				" virtual layer %" PRIu8 "\n", vl);
-			print_ccdg(mgr, &(nue_ctx->ccdg), TRUE);
-		}
+		if (!num_affected[vl])
+			continue;
 
-		/* in the debug mode we monitor the correctness more closely */
-		CL_ASSERT(deep_cpy_ccdg(mgr, &(nue_ctx->ccdg), &verify_ccdg));
+		/* the old paths were deadlock-free with the old escape paths,
+		   but the escape paths changed with the topology; if they close
+		   a cycle now, then we cannot guarantee deadlock-freedom anymore
+		 */
+		if (!is_colored_subccdg_acyclic(mgr, ccdg)) {
+			OSM_LOG(mgr->p_log, OSM_LOG_INFO,
+				"Restored paths and escape paths of virtual"
+				" layer %" PRIu8 " induce a cycle; full"
+				" rerouting required\n", vl);
+			goto Exit;
+		}
 
+		/* and route the affected destinations in the same order as a
+		   full run would do, i.e., terminals first and switches last
+		 */
+		color = ESCAPEPATHCOLOR + 1;
 		process_sw = FALSE;
 		do {
-			dlid_iter = (ib_net16_t *) nue_ctx->destinations[vl];
-			for (i = 0; i < nue_ctx->num_destinations[vl];
-			     i++, dlid_iter++) {
+			for (i = 0, dlid_iter = destinations[vl];
+			     i < num_destinations[vl]; i++, dlid_iter++) {
 				dest_port =
 				    osm_get_port_by_lid(mgr->p_subn,
 							*dlid_iter);
-				ntype = osm_node_get_type(dest_port->p_node);
-				if (ntype == IB_NODE_TYPE_CA) {
-					if (process_sw)
-						continue;
-					OSM_LOG(mgr->p_log, OSM_LOG_DEBUG,
-						"Processing Hca with GUID"
-						" 0x%016" PRIx64 "\n",
-						cl_ntoh64(osm_node_get_node_guid
-							  (dest_port->p_node)));
-				} else if (ntype == IB_NODE_TYPE_SWITCH) {
-					if (!process_sw)
-						continue;
-					OSM_LOG(mgr->p_log, OSM_LOG_DEBUG,
-						"Processing switch with GUID"
-						" 0x%016" PRIx64 "\n",
-						cl_ntoh64(osm_node_get_node_guid
-							  (dest_port->p_node)));
-				}
-
-				/* distribute the LID range across the ports
-				   that can reach those LIDs to have disjoint
-				   paths for one destination port with lmc>0;
-				   for switches with bsp0: min=max; with esp0:
-				   max>min if lmc>0
-				 */
+				if (process_sw !=
+				    (osm_node_get_type(dest_port->p_node) ==
+				     IB_NODE_TYPE_SWITCH))
+					continue;
 				osm_port_get_lid_range_ho(dest_port,
 							  &min_lid_ho,
 							  &max_lid_ho);
-				for (lid = min_lid_ho; lid <= max_lid_ho; lid++) {
-					/* search a path from all nodes to dlid
-					   without closing a cycle in the ccdg
-					 */
-					err =
-					    route_via_modified_dijkstra_on_ccdg
-					    (mgr, &(nue_ctx->network),
-					     &(nue_ctx->ccdg), dest_port,
+				for (lid = min_lid_ho; lid <= max_lid_ho;
+				     lid++) {
+					if (!affected[lid])
+						continue;
+					if (route_via_modified_dijkstra_on_ccdg
+					    (mgr, network, ccdg, dest_port,
 					     cl_hton16(lid), color++,
-					     &fallback_to_escape_paths);
-					if (err) {
-						destroy_context(nue_ctx);
-						return -1;
-					}
-					/* check intermediate steps for cycles
-					   in the complete cdg
-					 */
-					CL_ASSERT(add_paths_to_verify_ccdg
-						  (mgr, &(nue_ctx->network),
-						   get_switch_lid(mgr,
-								  cl_hton16
-								  (lid)),
-						   &(nue_ctx->ccdg),
-						   &verify_ccdg,
-						   fallback_to_escape_paths));
-					CL_ASSERT(is_ccdg_cycle_free
-						  (mgr, &verify_ccdg));
-					/* print the updated complete cdg after
-					   the routing for this desti is done
-					 */
-					if (OSM_LOG_IS_ACTIVE_V2
-					    (mgr->p_log, OSM_LOG_DEBUG)) {
-						OSM_LOG(mgr->p_log,
-							OSM_LOG_DEBUG,
-							"Complete CDG after routing destination LID %"
-							PRIu16
-							" for virtual layer %"
-							PRIu8 "\n", lid, vl);
-						print_ccdg(mgr,
-							   &(nue_ctx->ccdg),
-							   TRUE);
+					     &fallback_to_escape_paths)) {
+						ret = -1;
+						goto Exit;
 					}
-
-					/* and print the calculated routes */
-					if (OSM_LOG_IS_ACTIVE_V2
-					    (mgr->p_log, OSM_LOG_DEBUG)) {
-						OSM_LOG(mgr->p_log,
-							OSM_LOG_DEBUG,
-							"Calculated paths towards destination LID %"
-							PRIu16 "\n", lid);
-						print_routes(mgr,
-							     &(nue_ctx->
-							       network),
-							     dest_port,
-							     cl_hton16(lid));
-					}
-
-					/* update linear forwarding tables of
-					   all switches towards this desti
-					 */
 					update_linear_forwarding_tables(mgr,
-									&
-									(nue_ctx->
-									 network),
+									network,
 									dest_port,
 									cl_hton16
 									(lid));
-
-					/* traverse the calculated paths and
-					   update link weights for the next
-					   step to increase the path balancing
-					 */
 					update_network_link_weights(mgr,
-								    &(nue_ctx->
-								      network),
+								    network,
 								    get_switch_lid
 								    (mgr,
 								     cl_hton16
 								     (lid)));
-
-					/* and finally update the mapping of
-					   'destination to virtual layer'
-					 */
 					update_dlid_to_vl_mapping(nue_ctx->
 								  dlid_to_vl_mapping,
 								  cl_hton16
@@ -6245,9 +7302,467 @@ static int nue_do_ucast_routing(void *context)
 			else
 				break;
 		} while (TRUE);
+	}
 
-		/* do a final check if ccdg is acyclic after processing all */
-		CL_ASSERT(is_ccdg_cycle_free(mgr, &verify_ccdg));
+	/* switch<->switch paths (if not included above) are handled the same
+	   way as in the full run, but again only if they are affected
+	 */
+	if (!include_switches) {
+		for (i = 0, netw_node_iter = network->nodes;
+		     i < network->num_nodes; i++, netw_node_iter++) {
+			dest_port =
+			    osm_get_port_by_lid(mgr->p_subn,
+						netw_node_iter->lid);
+			osm_port_get_lid_range_ho(dest_port, &min_lid_ho,
+						  &max_lid_ho);
+			for (lid = min_lid_ho; lid <= max_lid_ho; lid++) {
+				if (lid <= prev->max_lid_ho && !affected[lid]) {
+					if (!restore_paths_from_prev_lfts
+					    (mgr, network, prev_lfts, dest_port,
+					     cl_hton16(lid))) {
+						OSM_LOG(mgr->p_log,
+							OSM_LOG_INFO,
+							"Cannot restore paths"
+							" towards LID %" PRIu16
+							"; full rerouting"
+							" required\n", lid);
+						goto Exit;
+					}
+				} else {
+					if (calculate_spanning_tree_in_network
+					    (mgr, network, netw_node_iter)) {
+						ret = -1;
+						goto Exit;
+					}
+					use_escape_paths_to_solve_impass(mgr,
+									 network,
+									 dest_port,
+									 cl_hton16
+									 (lid));
+					update_network_link_weights(mgr,
+								    network,
+								    cl_hton16
+								    (lid));
+				}
+				update_linear_forwarding_tables(mgr, network,
+								dest_port,
+								cl_hton16(lid));
+				update_dlid_to_vl_mapping(nue_ctx->
+							  dlid_to_vl_mapping,
+							  cl_hton16(lid), 0);
+			}
+		}
+	}
+
+	/* the filtered VL assignment of the destinations is the new one */
+	free(nue_ctx->destinations[0]);
+	for (vl = 0; vl < IB_MAX_NUM_VLS; vl++) {
+		nue_ctx->destinations[vl] = destinations[vl];
+		nue_ctx->num_destinations[vl] = num_destinations[vl];
+		destinations[vl] = NULL;
+	}
+
+	ret = 0;
+Exit:
+	for (vl = 0; vl < IB_MAX_NUM_VLS; vl++)
+		if (destinations[vl])
+			free(destinations[vl]);
+	if (affected)
+		free(affected);
+	if (prev_lfts)
+		free(prev_lfts);
+
+	OSM_LOG_EXIT(mgr->p_log);
+	return ret;
+}
+
+/* route all destinations of one virtual layer on the complete CDG; the
+   network and cCDG are either the ones of the context or private copies
+   of a worker thread, while the osm switches are always shared
+ */
+static int route_virtual_layer(nue_context_t * nue_ctx, network_t * network,
+			       ccdg_t * ccdg, const uint8_t vl,
+			       const boolean_t include_switches,
+			       pthread_mutex_t * lft_lock)
+{
+	osm_ucast_mgr_t *mgr = NULL;
+	osm_port_t *dest_port = NULL;
+	ib_net16_t *dlid_iter = NULL;
+	uint16_t lid = 0, min_lid_ho = 0, max_lid_ho = 0;
+	uint16_t i = 0;
+	uint8_t ntype = 0;
+	int err = 0;
+	int32_t color = 0;
+	boolean_t process_sw = FALSE, fallback_to_escape_paths = FALSE;
+#if defined (_DEBUG_)
+	ccdg_t verify_ccdg = {.num_nodes = 0, .nodes = NULL, .num_colors = 0,
+			      .color_array = NULL};
+#endif
+
+	CL_ASSERT(nue_ctx && network && ccdg && vl < nue_ctx->max_vl);
+
+	mgr = (osm_ucast_mgr_t *) nue_ctx->mgr;
+	OSM_LOG_ENTER(mgr->p_log);
+
+	OSM_LOG(mgr->p_log, OSM_LOG_DEBUG,
+		"Processing virtual layer %" PRIu8 "\n", vl);
+
+	if (!nue_ctx->num_destinations[vl]) {
+		OSM_LOG(mgr->p_log, OSM_LOG_INFO,
+			"WRN NUE43: no desti in this VL; skipping\n");
+		OSM_LOG_EXIT(mgr->p_log);
+		return 0;
+	}
+
+	color = ESCAPEPATHCOLOR + 1;
+	err =
+	    reset_ccdg_color_array(mgr, ccdg, nue_ctx->num_destinations,
+				   nue_ctx->max_vl, nue_ctx->max_lmc);
+	if (err)
+		return -1;
+	init_ccdg_colors(ccdg);
+
+	if (mgr->p_subn->opt.nue_incremental_reroute)
+		save_escape_path_weights(network, vl);
+	nue_ctx->central_node_lids[vl] = 0;
+	err =
+	    mark_escape_paths(mgr, network, ccdg, nue_ctx->destinations[vl],
+			      nue_ctx->num_destinations[vl],
+			      (0 == vl) ? TRUE : FALSE,
+			      &(nue_ctx->central_node_lids[vl]));
+	if (err)
+		return -1;
+	if (OSM_LOG_IS_ACTIVE_V2(mgr->p_log, OSM_LOG_DEBUG)) {
+		OSM_LOG(mgr->p_log, OSM_LOG_DEBUG,
+			"Complete CDG including escape paths for"
+			" virtual layer %" PRIu8 "\n", vl);
+		print_ccdg(mgr, ccdg, TRUE);
+	}
+
+	/* in the debug mode we monitor the correctness more closely */
+	CL_ASSERT(deep_cpy_ccdg(mgr, ccdg, &verify_ccdg));
+
+	process_sw = FALSE;
+	do {
+		dlid_iter = (ib_net16_t *) nue_ctx->destinations[vl];
+		for (i = 0; i < nue_ctx->num_destinations[vl];
+		     i++, dlid_iter++) {
+			dest_port =
+			    osm_get_port_by_lid(mgr->p_subn,
+						*dlid_iter);
+			ntype = osm_node_get_type(dest_port->p_node);
+			if (ntype == IB_NODE_TYPE_CA) {
+				if (process_sw)
+					continue;
+				OSM_LOG(mgr->p_log, OSM_LOG_DEBUG,
+					"Processing Hca with GUID"
+					" 0x%016" PRIx64 "\n",
+					cl_ntoh64(osm_node_get_node_guid
+						  (dest_port->p_node)));
+			} else if (ntype == IB_NODE_TYPE_SWITCH) {
+				if (!process_sw)
+					continue;
+				OSM_LOG(mgr->p_log, OSM_LOG_DEBUG,
+					"Processing switch with GUID"
+					" 0x%016" PRIx64 "\n",
+					cl_ntoh64(osm_node_get_node_guid
+						  (dest_port->p_node)));
+			}
+
+			/* distribute the LID range across the ports
+			   that can reach those LIDs to have disjoint
+			   paths for one destination port with lmc>0;
+			   for switches with bsp0: min=max; with esp0:
+			   max>min if lmc>0
+			 */
+			osm_port_get_lid_range_ho(dest_port,
+						  &min_lid_ho,
+						  &max_lid_ho);
+			for (lid = min_lid_ho; lid <= max_lid_ho; lid++) {
+				/* search a path from all nodes to dlid
+				   without closing a cycle in the ccdg
+				 */
+				err =
+				    route_via_modified_dijkstra_on_ccdg
+				    (mgr, network, ccdg, dest_port,
+				     cl_hton16(lid), color++,
+				     &fallback_to_escape_paths);
+				if (err)
+					return -1;
+				/* check intermediate steps for cycles
+				   in the complete cdg
+				 */
+				CL_ASSERT(add_paths_to_verify_ccdg
+					  (mgr, network,
+					   get_switch_lid(mgr,
+							  cl_hton16
+							  (lid)),
+					   ccdg, &verify_ccdg,
+					   fallback_to_escape_paths));
+				CL_ASSERT(is_ccdg_cycle_free
+					  (mgr, &verify_ccdg));
+				/* print the updated complete cdg after
+				   the routing for this desti is done
+				 */
+				if (OSM_LOG_IS_ACTIVE_V2
+				    (mgr->p_log, OSM_LOG_DEBUG)) {
+					OSM_LOG(mgr->p_log,
+						OSM_LOG_DEBUG,
+						"Complete CDG after routing destination LID %"
+						PRIu16
+						" for virtual layer %"
+						PRIu8 "\n", lid, vl);
+					print_ccdg(mgr, ccdg, TRUE);
+				}
+
+				/* and print the calculated routes */
+				if (OSM_LOG_IS_ACTIVE_V2
+				    (mgr->p_log, OSM_LOG_DEBUG)) {
+					OSM_LOG(mgr->p_log,
+						OSM_LOG_DEBUG,
+						"Calculated paths towards destination LID %"
+						PRIu16 "\n", lid);
+					print_routes(mgr, network,
+						     dest_port,
+						     cl_hton16(lid));
+				}
+
+				/* update linear forwarding tables of
+				   all switches towards this desti (the
+				   osm switches are shared by all VLs)
+				 */
+				if (lft_lock)
+					pthread_mutex_lock(lft_lock);
+				update_linear_forwarding_tables(mgr,
+								network,
+								dest_port,
+								cl_hton16
+								(lid));
+				if (lft_lock)
+					pthread_mutex_unlock(lft_lock);
+
+				/* traverse the calculated paths and
+				   update link weights for the next
+				   step to increase the path balancing
+				 */
+				update_network_link_weights(mgr,
+							    network,
+							    get_switch_lid
+							    (mgr,
+							     cl_hton16
+							     (lid)));
+
+				/* and finally update the mapping of
+				   'destination to virtual layer'
+				 */
+				update_dlid_to_vl_mapping(nue_ctx->
+							  dlid_to_vl_mapping,
+							  cl_hton16
+							  (lid), vl);
+			}
+		}
+		if (!process_sw && include_switches)
+			process_sw = TRUE;
+		else
+			break;
+	} while (TRUE);
+
+	/* do a final check if ccdg is acyclic after processing all */
+	CL_ASSERT(is_ccdg_cycle_free(mgr, &verify_ccdg));
+
+	OSM_LOG_EXIT(mgr->p_log);
+	return 0;
+}
+
+static void route_virtual_layers_of_worker(void *context)
+{
+	nue_layer_worker_t *worker = (nue_layer_worker_t *) context;
+	uint8_t vl = 0;
+
+	for (vl = worker->first_vl;
+	     vl < worker->nue_ctx->max_vl && !worker->err;
+	     vl += worker->vl_stride)
+		worker->err =
+		    route_virtual_layer(worker->nue_ctx, &(worker->network),
+					&(worker->ccdg), vl,
+					worker->include_switches,
+					worker->lft_lock);
+}
+
+static int route_virtual_layers_in_parallel(nue_context_t * nue_ctx,
+					    const boolean_t include_switches,
+					    const uint8_t num_workers)
+{
+	osm_ucast_mgr_t *mgr = NULL;
+	nue_layer_worker_t *workers = NULL, *worker = NULL;
+	network_node_t *netw_node_iter = NULL, *worker_node = NULL;
+	network_link_t *netw_link_iter = NULL;
+	pthread_mutex_t lft_lock;
+	uint64_t weight = 0;
+	uint16_t i = 0;
+	uint8_t j = 0, k = 0;
+	int err = 0;
+
+	CL_ASSERT(nue_ctx && num_workers > 1);
+
+	mgr = (osm_ucast_mgr_t *) nue_ctx->mgr;
+	OSM_LOG_ENTER(mgr->p_log);
+	OSM_LOG(mgr->p_log, OSM_LOG_VERBOSE,
+		"Using %" PRIu8 " threads to route the virtual layers\n",
+		num_workers);
+
+	workers =
+	    (nue_layer_worker_t *) calloc(num_workers,
+					  sizeof(nue_layer_worker_t));
+	if (!workers) {
+		OSM_LOG(mgr->p_log, OSM_LOG_ERROR,
+			"ERR NUE57: cannot allocate memory for nue workers\n");
+		OSM_LOG_EXIT(mgr->p_log);
+		return -1;
+	}
+	pthread_mutex_init(&lft_lock, NULL);
+
+	for (k = 0, worker = workers; k < num_workers; k++, worker++) {
+		worker->nue_ctx = nue_ctx;
+		worker->first_vl = k;
+		worker->vl_stride = num_workers;
+		worker->include_switches = include_switches;
+		worker->lft_lock = &lft_lock;
+		cl_thread_construct(&(worker->thread));
+		err = clone_network_and_ccdg(mgr, &(nue_ctx->network),
+					     &(nue_ctx->ccdg),
+					     &(worker->network),
+					     &(worker->ccdg));
+		if (err)
+			goto Exit;
+	}
+
+	for (k = 1, worker = workers + 1; k < num_workers; k++, worker++) {
+		if (cl_thread_init(&(worker->thread),
+				   route_virtual_layers_of_worker, worker,
+				   "nue worker") != CL_SUCCESS) {
+			OSM_LOG(mgr->p_log, OSM_LOG_ERROR,
+				"ERR NUE58: cannot start nue worker thread\n");
+			worker->err = -1;
+		}
+	}
+	route_virtual_layers_of_worker(workers);
+	for (k = 1, worker = workers + 1; k < num_workers; k++, worker++)
+		cl_thread_destroy(&(worker->thread));
+
+	for (k = 0, worker = workers; k < num_workers; k++, worker++) {
+		if (worker->err) {
+			err = -1;
+			goto Exit;
+		}
+	}
+
+	/* the link weights of the context include the changes of all VLs */
+	for (i = 0, netw_node_iter = nue_ctx->network.nodes;
+	     i < nue_ctx->network.num_nodes; i++, netw_node_iter++) {
+		for (j = 0, netw_link_iter = netw_node_iter->links;
+		     j < netw_node_iter->num_links; j++, netw_link_iter++) {
+			weight = netw_link_iter->weight;
+			for (k = 0, worker = workers; k < num_workers;
+			     k++, worker++) {
+				worker_node = &(worker->network.nodes[i]);
+				weight += worker_node->links[j].weight -
+				    netw_link_iter->weight;
+			}
+			netw_link_iter->weight = weight;
+		}
+	}
+
+Exit:
+	for (k = 0, worker = workers; k < num_workers; k++, worker++) {
+		/* the escape path weights belong to the context */
+		for (i = 0, worker_node = worker->network.nodes;
+		     i < worker->network.num_nodes; i++, worker_node++)
+			worker_node->escape_weights = NULL;
+		destroy_network(&(worker->network));
+		destroy_ccdg(&(worker->ccdg));
+	}
+	pthread_mutex_destroy(&lft_lock);
+	free(workers);
+
+	OSM_LOG_EXIT(mgr->p_log);
+	return err;
+}
+
+static int nue_do_ucast_routing(void *context)
+{
+	nue_context_t *nue_ctx = (nue_context_t *) context;
+	osm_ucast_mgr_t *mgr = NULL;
+	osm_port_t *dest_port = NULL;
+	boolean_t include_switches = FALSE;
+	uint16_t lid = 0, min_lid_ho = 0, max_lid_ho = 0;
+	uint16_t i = 0;
+	uint32_t num_threads = 0;
+	uint8_t vl = 0;
+	int err = 0;
+	network_node_t *netw_node_iter = NULL;
+
+	if (nue_ctx)
+		mgr = (osm_ucast_mgr_t *) nue_ctx->mgr;
+	else
+		return -1;
+
+	OSM_LOG_ENTER(mgr->p_log);
+	OSM_LOG(mgr->p_log, OSM_LOG_INFO, "Start routing process with nue\n");
+
+	init_linear_forwarding_tables(mgr, &(nue_ctx->network));
+
+	if (mgr->p_subn->opt.nue_include_switches) {
+		OSM_LOG(mgr->p_log, OSM_LOG_INFO,
+			" ...and consider switches as traffic sinks\n");
+		include_switches = mgr->p_subn->opt.nue_include_switches;
+	}
+
+	/* try to keep the routing of the last run for unaffected paths */
+	if (nue_ctx->prev.valid) {
+		err = reroute_incrementally(nue_ctx, include_switches);
+		destroy_prev_routing(&(nue_ctx->prev));
+		if (err < 0) {
+			destroy_context(nue_ctx);
+			return -1;
+		} else if (!err)
+			goto Exit;
+		reset_routing_results(nue_ctx);
+	}
+
+	/* assign destination lids to different virtual layers */
+	err = distribute_lids_onto_virtual_layers(nue_ctx, include_switches);
+	if (err) {
+		destroy_context(nue_ctx);
+		return -1;
+	}
+	if (OSM_LOG_IS_ACTIVE_V2(mgr->p_log, OSM_LOG_DEBUG))
+		print_destination_distribution(mgr, nue_ctx->destinations,
+					       nue_ctx->num_destinations);
+
+	/* each VL is routed on its own (private) copy of network and cCDG
+	   if more than one routing thread is requested
+	 */
+	if (mgr->p_subn->opt.nue_incremental_reroute)
+		alloc_escape_path_weights(nue_ctx);
+	num_threads = mgr->p_subn->opt.routing_threads;
+	if (!num_threads)
+		num_threads = cl_proc_count();
+	if (num_threads > nue_ctx->max_vl)
+		num_threads = nue_ctx->max_vl;
+	if (num_threads > 1) {
+		err = route_virtual_layers_in_parallel(nue_ctx,
+						       include_switches,
+						       (uint8_t) num_threads);
+	} else {
+		for (vl = 0; vl < nue_ctx->max_vl && !err; vl++)
+			err = route_virtual_layer(nue_ctx, &(nue_ctx->network),
+						  &(nue_ctx->ccdg), vl,
+						  include_switches, NULL);
+	}
+	if (err) {
+		destroy_context(nue_ctx);
+		return -1;
 	}
 
 	/* if switches haven't been included in the original destinations set
@@ -6315,6 +7830,11 @@ static int nue_do_ucast_routing(void *context)
 		}
 	}
 
+Exit:
+	/* the next run may only need to reroute a few destinations */
+	if (mgr->p_subn->opt.nue_incremental_reroute)
+		save_linear_forwarding_tables(nue_ctx);
+
 	OSM_LOG_EXIT(mgr->p_log);
 	return 0;
 }
@@ -6709,6 +8229,7 @@ static void nue_destroy_context(void *context)
 	if (!nue_ctx)
 		return;
 	destroy_context(nue_ctx);
+	destroy_prev_routing(&(nue_ctx->prev));
 	free(context);
 }
 
@@ -48,6 +48,8 @@
 #include <ctype.h>
 #include <complib/cl_debug.h>
 #include <complib/cl_qmap.h>
+#include <complib/cl_atomic.h>
+#include <complib/cl_thread.h>
 #include <opensm/osm_file_ids.h>
 #define FILE_ID OSM_FILE_UCAST_UPDN_C
 #include <opensm/osm_switch.h>
@@ -74,11 +76,29 @@ struct updn_node {
 	cl_list_item_t list;
 	osm_switch_t *sw;
 	uint64_t id;
-	updn_switch_dir_t dir;
 	unsigned rank;
-	unsigned visited;
+	unsigned index;
 };
 
+/* the min hop BFS runs, one per switch, only write the hop row of the
+   starting switch lid, so they are run concurrently; each worker keeps
+   its own BFS queue and direction marks indexed by updn_node.index
+*/
+typedef struct updn_bfs_pool {
+	osm_log_t *p_log;
+	osm_switch_t **sws;
+	unsigned num_sws;
+	atomic32_t next;
+} updn_bfs_pool_t;
+
+typedef struct updn_bfs_worker {
+	cl_thread_t thread;
+	updn_bfs_pool_t *pool;
+	unsigned *queue;	/* ring of num_sws + 1 switch indexes */
+	uint8_t *dir;
+	uint8_t *queued;
+} updn_bfs_worker_t;
+
 /* This function returns direction based on rank and guid info of current &
    remote ports */
 static updn_switch_dir_t updn_get_dir(unsigned cur_rank, unsigned rem_rank,
@@ -108,11 +128,12 @@ static updn_switch_dir_t updn_get_dir(unsigned cur_rank, unsigned rem_rank,
  * This function does the bfs of min hop table calculation by guid index
  * as a starting point.
  **********************************************************************/
-static int updn_bfs_by_node(IN osm_log_t * p_log, IN osm_subn_t * p_subn,
-			    IN osm_switch_t * p_sw)
+static int updn_bfs_by_node(IN updn_bfs_worker_t * w, IN osm_switch_t * p_sw)
 {
+	osm_log_t *p_log = w->pool->p_log;
+	unsigned ring_size = w->pool->num_sws + 1;
+	unsigned head = 0, tail = 0;
 	uint8_t pn, pn_rem;
-	cl_qlist_t list;
 	uint16_t lid;
 	struct updn_node *u;
 	updn_switch_dir_t next_dir, current_dir;
@@ -128,17 +149,20 @@ static int updn_bfs_by_node(IN osm_log_t * p_log, IN osm_subn_t * p_subn,
 		cl_ntoh64(p_sw->p_node->node_info.port_guid), lid);
 
 	u = p_sw->priv;
-	u->dir = UP;
+	w->dir[u->index] = UP;
 
 	/* Update list with the new element */
-	cl_qlist_init(&list);
-	cl_qlist_insert_tail(&list, &u->list);
-
-	/* BFS the list till no next element */
-	while (!cl_is_qlist_empty(&list)) {
-		u = (struct updn_node *)cl_qlist_remove_head(&list);
-		u->visited = 0;	/* cleanup */
-		current_dir = u->dir;
+	w->queue[tail++] = u->index;
+
+	/* BFS the list till no next element; a switch is queued at most
+	   once at a time, so with a spare slot the ring never looks empty
+	   when it is full */
+	while (head != tail) {
+		u = w->pool->sws[w->queue[head]]->priv;
+		if (++head == ring_size)
+			head = 0;
+		w->queued[u->index] = 0;	/* cleanup */
+		current_dir = w->dir[u->index];
 		/* Go over all ports of the switch and find unvisited remote nodes */
 		for (pn = 1; pn < u->sw->num_ports; pn++) {
 			osm_node_t *p_remote_node;
@@ -189,12 +213,13 @@ static int updn_bfs_by_node(IN osm_log_t * p_log, IN osm_subn_t * p_subn,
 						set_hop_return_value);
 				}
 				/* Check if remote port has already been visited */
-				if (!rem_u->visited) {
+				if (!w->queued[rem_u->index]) {
 					/* Insert updn_switch item into the list */
-					rem_u->dir = next_dir;
-					rem_u->visited = 1;
-					cl_qlist_insert_tail(&list,
-							     &rem_u->list);
+					w->dir[rem_u->index] = next_dir;
+					w->queued[rem_u->index] = 1;
+					w->queue[tail] = rem_u->index;
+					if (++tail == ring_size)
+						tail = 0;
 				}
 			}
 		}
@@ -204,6 +229,84 @@ static int updn_bfs_by_node(IN osm_log_t * p_log, IN osm_subn_t * p_subn,
 	return 0;
 }
 
+static void updn_bfs_worker_run(void *context)
+{
+	updn_bfs_worker_t *w = context;
+	updn_bfs_pool_t *pool = w->pool;
+	unsigned i;
+
+	while ((i = (unsigned)cl_atomic_inc(&pool->next) - 1) < pool->num_sws)
+		updn_bfs_by_node(w, pool->sws[i]);
+}
+
+/* run updn_bfs_by_node for all switches on num_workers threads (the
+   calling thread included)
+*/
+static int updn_bfs_all(IN osm_log_t * p_log, IN osm_switch_t ** sws,
+			IN unsigned num_sws, IN unsigned num_workers)
+{
+	updn_bfs_pool_t pool;
+	updn_bfs_worker_t *workers, *w;
+	unsigned i, started = 0;
+	int ret = 0;
+
+	if (num_workers > num_sws)
+		num_workers = num_sws;
+	if (!num_workers)
+		return 0;
+
+	pool.p_log = p_log;
+	pool.sws = sws;
+	pool.num_sws = num_sws;
+	pool.next = 0;
+
+	workers = calloc(num_workers, sizeof(*workers));
+	if (!workers)
+		goto ErrorMem;
+	for (i = 0, w = workers; i < num_workers; i++, w++) {
+		w->pool = &pool;
+		cl_thread_construct(&w->thread);
+		w->queue = malloc((num_sws + 1) * sizeof(*w->queue));
+		w->dir = malloc(num_sws);
+		w->queued = calloc(num_sws, 1);
+		if (!w->queue || !w->dir || !w->queued)
+			goto ErrorMem;
+	}
+
+	if (num_workers > 1)
+		OSM_LOG(p_log, OSM_LOG_VERBOSE,
+			"Using %u threads for the min hop BFS\n", num_workers);
+
+	for (i = 1, w = workers + 1; i < num_workers; i++, w++) {
+		if (cl_thread_init(&w->thread, updn_bfs_worker_run, w,
+				   "updn bfs") != CL_SUCCESS) {
+			OSM_LOG(p_log, OSM_LOG_ERROR, "ERR AA15: "
+				"cannot start updn BFS thread, "
+				"continuing with %u threads\n", started + 1);
+			break;
+		}
+		started++;
+	}
+	updn_bfs_worker_run(workers);
+	for (i = 1; i <= started; i++)
+		cl_thread_destroy(&workers[i].thread);
+	goto Exit;
+
+ErrorMem:
+	OSM_LOG(p_log, OSM_LOG_ERROR, "ERR AA16: "
+		"cannot allocate memory for the min hop BFS\n");
+	ret = -1;
+Exit:
+	if (workers)
+		for (i = 0; i < num_workers; i++) {
+			free(workers[i].queue);
+			free(workers[i].dir);
+			free(workers[i].queued);
+		}
+	free(workers);
+	return ret;
+}
+
 /* NOTE : PLS check if we need to decide that the first */
 /*        rank is a SWITCH for BFS purpose */
 static int updn_subn_rank(IN updn_t * p_updn)
@@ -287,25 +390,35 @@ static void updn_clear_non_root_hops(updn_t * updn, osm_switch_t * sw)
 	osm_port_t *port;
 	unsigned i;
 
-	for (i = 0; i < sw->num_hops; i++)
-		if (sw->hops[i]) {
-			port = osm_get_port_by_lid_ho(&updn->p_osm->subn, i);
-			if (!port || !port->p_node->sw
-			    || ((struct updn_node *)port->p_node->sw->priv)->
-			    rank != 0)
-				memset(sw->hops[i], 0xff, sw->num_ports);
-		}
+	for (i = 0; i < sw->num_hops; i++) {
+		port = osm_get_port_by_lid_ho(&updn->p_osm->subn, i);
+		if (!port || !port->p_node->sw
+		    || ((struct updn_node *)port->p_node->sw->priv)->
+		    rank != 0)
+			memset(sw->hops + i * sw->num_ports, 0xff,
+			       sw->num_ports);
+	}
 }
 
 static int updn_set_min_hop_table(IN updn_t * p_updn)
 {
 	osm_subn_t *p_subn = &p_updn->p_osm->subn;
 	osm_log_t *p_log = &p_updn->p_osm->log;
-	osm_switch_t *p_sw;
+	osm_switch_t *p_sw, **sws;
 	cl_map_item_t *item;
+	unsigned num_sws = 0, num_threads;
+	int ret;
 
 	OSM_LOG_ENTER(p_log);
 
+	sws = malloc(cl_qmap_count(&p_subn->sw_guid_tbl) * sizeof(*sws));
+	if (!sws) {
+		OSM_LOG(p_log, OSM_LOG_ERROR, "ERR AA17: "
+			"cannot allocate memory for the min hop BFS\n");
+		ret = -1;
+		goto Exit;
+	}
+
 	/* Go over all the switches in the subnet - for each init their Min Hop
 	   Table */
 	OSM_LOG(p_log, OSM_LOG_VERBOSE,
@@ -320,6 +433,8 @@ static int updn_set_min_hop_table(IN updn_t * p_updn)
 			updn_clear_non_root_hops(p_updn, p_sw);
 		else
 			osm_switch_clear_hops(p_sw);
+		((struct updn_node *)p_sw->priv)->index = num_sws;
+		sws[num_sws++] = p_sw;
 	}
 
 	OSM_LOG(p_log, OSM_LOG_VERBOSE,
@@ -329,18 +444,18 @@ static int updn_set_min_hop_table(IN updn_t * p_updn)
 	OSM_LOG(p_log, OSM_LOG_VERBOSE,
 		"BFS through all port guids in the subnet [\n");
 
-	for (item = cl_qmap_head(&p_updn->p_osm->subn.sw_guid_tbl);
-	     item != cl_qmap_end(&p_updn->p_osm->subn.sw_guid_tbl);
-	     item = cl_qmap_next(item)) {
-		p_sw = (osm_switch_t *)item;
-		updn_bfs_by_node(p_log, p_subn, p_sw);
-	}
+	num_threads = p_subn->opt.routing_threads;
+	if (!num_threads)
+		num_threads = cl_proc_count();
+	ret = updn_bfs_all(p_log, sws, num_sws, num_threads);
 
 	OSM_LOG(p_log, OSM_LOG_VERBOSE,
 		"BFS through all port guids in the subnet ]\n");
 	/* Cleanup */
+	free(sws);
+Exit:
 	OSM_LOG_EXIT(p_log);
-	return 0;
+	return ret;
 }
 
 static int updn_build_lid_matrices(IN updn_t * p_updn)
@@ -45,9 +45,11 @@
 #  include <config.h>
 #endif				/* HAVE_CONFIG_H */
 
+#include <stdlib.h>
 #include <string.h>
 #include <iba/ib_types.h>
 #include <complib/cl_thread.h>
+#include <complib/cl_timer.h>
 #include <opensm/osm_file_ids.h>
 #define FILE_ID OSM_FILE_VL15INTF_C
 #include <vendor/osm_vendor_api.h>
@@ -56,6 +58,162 @@
 #include <opensm/osm_log.h>
 #include <opensm/osm_helper.h>
 
+/* targets are garbage collected once there are more than this */
+#define VL15_MIN_TARGETS_GC	1024
+/* window units: 1/256 of a MAD */
+#define VL15_WIN_SHIFT		8
+/* allowed response time above the lowest one before backing off */
+#define VL15_RTT_SLACK_US	100
+
+/* targets are keyed by their full address */
+static int vl15_target_compare(IN const void *p_key1, IN const void *p_key2)
+{
+	const osm_vl15_target_t *p_tgt1 = p_key1, *p_tgt2 = p_key2;
+
+	if (p_tgt1->dlid != p_tgt2->dlid)
+		return p_tgt1->dlid < p_tgt2->dlid ? -1 : 1;
+	if (p_tgt1->hop_count != p_tgt2->hop_count)
+		return p_tgt1->hop_count < p_tgt2->hop_count ? -1 : 1;
+	return memcmp(p_tgt1->path + 1, p_tgt2->path + 1, p_tgt1->hop_count);
+}
+
+static void vl15_target_set_addr(OUT osm_vl15_target_t * p_tgt,
+				 IN const osm_madw_t * p_madw,
+				 IN const ib_smp_t * p_smp)
+{
+	p_tgt->dlid = p_madw->mad_addr.dest_lid;
+	p_tgt->hop_count = 0;
+	if (p_smp->mgmt_class == IB_MCLASS_SUBN_DIR) {
+		p_tgt->hop_count = p_smp->hop_count;
+		if (p_tgt->hop_count >= IB_SUBNET_PATH_HOPS_MAX)
+			p_tgt->hop_count = IB_SUBNET_PATH_HOPS_MAX - 1;
+		memcpy(p_tgt->path + 1, p_smp->initial_path + 1,
+		       p_tgt->hop_count);
+	}
+}
+
+static osm_vl15_target_t *vl15_get_target(IN osm_vl15_t * p_vl,
+					  IN osm_madw_t * p_madw)
+{
+	const ib_smp_t *p_smp = osm_madw_get_smp_ptr(p_madw);
+	osm_vl15_target_t key, *p_tgt;
+
+	vl15_target_set_addr(&key, p_madw, p_smp);
+	p_tgt = (osm_vl15_target_t *) cl_fmap_get(&p_vl->targets, &key);
+	if (p_tgt != (osm_vl15_target_t *) cl_fmap_end(&p_vl->targets))
+		return p_tgt;
+
+	p_tgt = calloc(1, sizeof(*p_tgt));
+	if (!p_tgt)
+		return NULL;
+	cl_qlist_init(&p_tgt->queue);
+	vl15_target_set_addr(p_tgt, p_madw, p_smp);
+	p_tgt->cwnd = 1 << VL15_WIN_SHIFT;
+	p_tgt->ssthresh = p_vl->max_smps_per_target << VL15_WIN_SHIFT;
+	cl_fmap_insert(&p_vl->targets, p_tgt, &p_tgt->map_item);
+	return p_tgt;
+}
+
+/* free the targets with nothing queued or outstanding */
+static void vl15_gc_targets(IN osm_vl15_t * p_vl)
+{
+	osm_vl15_target_t *p_tgt, *p_next;
+
+	p_next = (osm_vl15_target_t *) cl_fmap_head(&p_vl->targets);
+	while (p_next != (osm_vl15_target_t *) cl_fmap_end(&p_vl->targets)) {
+		p_tgt = p_next;
+		p_next = (osm_vl15_target_t *) cl_fmap_next(&p_tgt->map_item);
+		if (p_tgt->outstanding || cl_qlist_count(&p_tgt->queue))
+			continue;
+		cl_fmap_remove_item(&p_vl->targets, &p_tgt->map_item);
+		free(p_tgt);
+	}
+
+	p_vl->targets_gc = 2 * cl_fmap_count(&p_vl->targets);
+	if (p_vl->targets_gc < VL15_MIN_TARGETS_GC)
+		p_vl->targets_gc = VL15_MIN_TARGETS_GC;
+}
+
+static void vl15_target_update_ready(IN osm_vl15_t * p_vl,
+				     IN osm_vl15_target_t * p_tgt)
+{
+	if (!p_tgt->ready && cl_qlist_count(&p_tgt->queue) &&
+	    p_tgt->outstanding < p_tgt->cwnd >> VL15_WIN_SHIFT) {
+		cl_qlist_insert_tail(&p_vl->ready, &p_tgt->ready_item);
+		p_tgt->ready = TRUE;
+	}
+}
+
+/* take the next MAD from the targets in round robin order */
+static osm_madw_t *vl15_sched_next(IN osm_vl15_t * p_vl)
+{
+	osm_vl15_target_t *p_tgt;
+	cl_list_item_t *p_item;
+	osm_madw_t *p_madw;
+
+	while ((p_item = cl_qlist_remove_head(&p_vl->ready)) !=
+	       cl_qlist_end(&p_vl->ready)) {
+		p_tgt = PARENT_STRUCT(p_item, osm_vl15_target_t, ready_item);
+		p_tgt->ready = FALSE;
+		/* the window may have shrunk since the target got ready */
+		if (p_tgt->outstanding >= p_tgt->cwnd >> VL15_WIN_SHIFT)
+			continue;
+
+		p_madw = (osm_madw_t *) cl_qlist_remove_head(&p_tgt->queue);
+		p_tgt->outstanding++;
+		p_tgt->sent++;
+		p_madw->p_vl15_target = p_tgt;
+		p_madw->vl15_send_time = cl_get_time_stamp();
+		vl15_target_update_ready(p_vl, p_tgt);
+		return p_madw;
+	}
+
+	return NULL;
+}
+
+static void vl15_target_ack(IN osm_vl15_t * p_vl,
+			    IN osm_vl15_target_t * p_tgt, IN uint64_t rtt)
+{
+	uint32_t max = p_vl->max_smps_per_target << VL15_WIN_SHIFT;
+	unsigned bucket = 0;
+
+	while (bucket < OSM_VL15_HIST_BUCKETS - 1 && rtt >> (bucket + 1))
+		bucket++;
+	p_tgt->hist[bucket]++;
+
+	if (!p_tgt->min_rtt || rtt < p_tgt->min_rtt)
+		p_tgt->min_rtt = rtt;
+	p_tgt->srtt = p_tgt->srtt ? (7 * p_tgt->srtt + rtt) / 8 : rtt;
+
+	if (p_tgt->srtt > 2 * p_tgt->min_rtt + VL15_RTT_SLACK_US) {
+		/* responses queue up at the target: back off once per window */
+		if (p_tgt->acks_since_cut >= p_tgt->cwnd >> VL15_WIN_SHIFT) {
+			p_tgt->cwnd -= p_tgt->cwnd / 8;
+			p_tgt->ssthresh = p_tgt->cwnd;
+			p_tgt->acks_since_cut = 0;
+		}
+	} else if (p_tgt->cwnd < p_tgt->ssthresh)
+		p_tgt->cwnd += 1 << VL15_WIN_SHIFT;
+	else
+		p_tgt->cwnd += (1 << (2 * VL15_WIN_SHIFT)) / p_tgt->cwnd;
+	p_tgt->acks_since_cut++;
+
+	if (p_tgt->cwnd > max)
+		p_tgt->cwnd = max;
+	if (p_tgt->cwnd < 1 << VL15_WIN_SHIFT)
+		p_tgt->cwnd = 1 << VL15_WIN_SHIFT;
+}
+
+static void vl15_target_timeout(IN osm_vl15_target_t * p_tgt)
+{
+	p_tgt->timeouts++;
+	p_tgt->ssthresh = p_tgt->cwnd / 2;
+	if (p_tgt->ssthresh < 1 << VL15_WIN_SHIFT)
+		p_tgt->ssthresh = 1 << VL15_WIN_SHIFT;
+	p_tgt->cwnd = 1 << VL15_WIN_SHIFT;
+	p_tgt->acks_since_cut = 0;
+}
+
 static void vl15_send_mad(osm_vl15_t * p_vl, osm_madw_t * p_madw)
 {
 	ib_api_status_t status;
@@ -133,7 +291,6 @@ static void vl15_poller(IN void *p_ptr)
 	ib_api_status_t status;
 	osm_madw_t *p_madw;
 	osm_vl15_t *p_vl = p_ptr;
-	cl_qlist_t *p_fifo;
 	int32_t max_smps = p_vl->max_wire_smps;
 	int32_t max_smps2 = p_vl->max_wire_smps2;
 
@@ -154,15 +311,17 @@ static void vl15_poller(IN void *p_ptr)
 		cl_spinlock_acquire(&p_vl->lock);
 
 		if (cl_qlist_count(&p_vl->ufifo) != 0)
-			p_fifo = &p_vl->ufifo;
+			p_madw = (osm_madw_t *)
+			    cl_qlist_remove_head(&p_vl->ufifo);
+		else if (cl_qlist_count(&p_vl->rfifo) != 0)
+			p_madw = (osm_madw_t *)
+			    cl_qlist_remove_head(&p_vl->rfifo);
 		else
-			p_fifo = &p_vl->rfifo;
-
-		p_madw = (osm_madw_t *) cl_qlist_remove_head(p_fifo);
+			p_madw = vl15_sched_next(p_vl);
 
 		cl_spinlock_release(&p_vl->lock);
 
-		if (p_madw != (osm_madw_t *) cl_qlist_end(p_fifo)) {
+		if (p_madw) {
 			OSM_LOG(p_vl->p_log, OSM_LOG_DEBUG,
 				"Servicing p_madw = %p\n", p_madw);
 			if (OSM_LOG_IS_ACTIVE_V2(p_vl->p_log, OSM_LOG_FRAMES))
@@ -173,7 +332,9 @@ static void vl15_poller(IN void *p_ptr)
 			vl15_send_mad(p_vl, p_madw);
 		} else
 			/*
-			   The VL15 FIFO is empty, so we have nothing left to do.
+			   The VL15 FIFOs are empty or all the targets with
+			   queued MADs have their window full, so we have
+			   nothing left to do.
 			 */
 			status = cl_event_wait_on(&p_vl->signal,
 						  EVENT_NO_TIMEOUT, TRUE);
@@ -215,9 +376,37 @@ void osm_vl15_construct(IN osm_vl15_t * p_vl)
 	cl_spinlock_construct(&p_vl->lock);
 	cl_qlist_init(&p_vl->rfifo);
 	cl_qlist_init(&p_vl->ufifo);
+	cl_fmap_init(&p_vl->targets, vl15_target_compare);
+	cl_qlist_init(&p_vl->ready);
 	cl_thread_construct(&p_vl->poller);
 }
 
+/* return the MADs queued on the targets to the pool and drop the targets */
+static void vl15_flush_targets(IN osm_vl15_t * p_vl, IN osm_mad_pool_t * p_pool,
+			       IN boolean_t free_targets)
+{
+	osm_vl15_target_t *p_tgt, *p_next;
+	osm_madw_t *p_madw;
+
+	cl_qlist_init(&p_vl->ready);
+	p_next = (osm_vl15_target_t *) cl_fmap_head(&p_vl->targets);
+	while (p_next != (osm_vl15_target_t *) cl_fmap_end(&p_vl->targets)) {
+		p_tgt = p_next;
+		p_next = (osm_vl15_target_t *) cl_fmap_next(&p_tgt->map_item);
+		p_tgt->ready = FALSE;
+		while (!cl_is_qlist_empty(&p_tgt->queue)) {
+			p_madw = (osm_madw_t *)
+			    cl_qlist_remove_head(&p_tgt->queue);
+			osm_mad_pool_put(p_pool, p_madw);
+			osm_stats_dec_qp0_outstanding(p_vl->p_stats);
+		}
+		if (free_targets)
+			free(p_tgt);
+	}
+	if (free_targets)
+		cl_fmap_remove_all(&p_vl->targets);
+}
+
 void osm_vl15_destroy(IN osm_vl15_t * p_vl, IN struct osm_mad_pool *p_pool)
 {
 	osm_madw_t *p_madw;
@@ -252,6 +441,7 @@ void osm_vl15_destroy(IN osm_vl15_t * p_vl, IN struct osm_mad_pool *p_pool)
 		p_madw = (osm_madw_t *) cl_qlist_remove_head(&p_vl->ufifo);
 		osm_mad_pool_put(p_pool, p_madw);
 	}
+	vl15_flush_targets(p_vl, p_pool, TRUE);
 
 	cl_spinlock_release(&p_vl->lock);
 
@@ -267,7 +457,8 @@ ib_api_status_t osm_vl15_init(IN osm_vl15_t * p_vl, IN osm_vendor_t * p_vend,
 			      IN osm_subn_t * p_subn,
 			      IN int32_t max_wire_smps,
 			      IN int32_t max_wire_smps2,
-			      IN uint32_t max_smps_timeout)
+			      IN uint32_t max_smps_timeout,
+			      IN uint32_t max_smps_per_target)
 {
 	ib_api_status_t status = IB_SUCCESS;
 
@@ -281,6 +472,8 @@ ib_api_status_t osm_vl15_init(IN osm_vl15_t * p_vl, IN osm_vendor_t * p_vend,
 	p_vl->max_wire_smps2 = max_wire_smps2;
 	p_vl->max_smps_timeout = max_wire_smps < max_wire_smps2 ?
 				 max_smps_timeout : EVENT_NO_TIMEOUT;
+	p_vl->max_smps_per_target = max_smps_per_target;
+	p_vl->targets_gc = VL15_MIN_TARGETS_GC;
 
 	status = cl_event_init(&p_vl->signal, FALSE);
 	if (status != IB_SUCCESS)
@@ -330,6 +523,8 @@ void osm_vl15_poll(IN osm_vl15_t * p_vl)
 
 void osm_vl15_post(IN osm_vl15_t * p_vl, IN osm_madw_t * p_madw)
 {
+	osm_vl15_target_t *p_tgt;
+
 	OSM_LOG_ENTER(p_vl->p_log);
 
 	CL_ASSERT(p_vl->state == OSM_VL15_STATE_READY);
@@ -341,7 +536,18 @@ void osm_vl15_post(IN osm_vl15_t * p_vl, IN osm_madw_t * p_madw)
 	 */
 	cl_spinlock_acquire(&p_vl->lock);
 	if (p_madw->resp_expected == TRUE) {
-		cl_qlist_insert_tail(&p_vl->rfifo, &p_madw->list_item);
+		p_tgt = NULL;
+		if (p_vl->max_smps_per_target) {
+			if (cl_fmap_count(&p_vl->targets) >= p_vl->targets_gc)
+				vl15_gc_targets(p_vl);
+			p_tgt = vl15_get_target(p_vl, p_madw);
+		}
+		if (p_tgt) {
+			cl_qlist_insert_tail(&p_tgt->queue,
+					     &p_madw->list_item);
+			vl15_target_update_ready(p_vl, p_tgt);
+		} else
+			cl_qlist_insert_tail(&p_vl->rfifo, &p_madw->list_item);
 		osm_stats_inc_qp0_outstanding(p_vl->p_stats);
 	} else
 		cl_qlist_insert_tail(&p_vl->ufifo, &p_madw->list_item);
@@ -394,8 +600,96 @@ void osm_vl15_shutdown(IN osm_vl15_t * p_vl, IN osm_mad_pool_t * p_mad_pool)
 		p_madw = (osm_madw_t *) cl_qlist_remove_head(&p_vl->rfifo);
 	}
 
+	/* and the request MADs still queued on the targets */
+	vl15_flush_targets(p_vl, p_mad_pool, FALSE);
+
 	/* free the lock */
 	cl_spinlock_release(&p_vl->lock);
 
 	OSM_LOG_EXIT(p_vl->p_log);
 }
+
+void osm_vl15_complete(IN osm_vl15_t * p_vl, IN osm_madw_t * p_madw,
+		       IN boolean_t timed_out)
+{
+	osm_vl15_target_t *p_tgt = p_madw->p_vl15_target;
+
+	if (!p_tgt)
+		return;
+
+	cl_spinlock_acquire(&p_vl->lock);
+
+	p_madw->p_vl15_target = NULL;
+	CL_ASSERT(p_tgt->outstanding);
+	p_tgt->outstanding--;
+	if (timed_out)
+		vl15_target_timeout(p_tgt);
+	else
+		vl15_target_ack(p_vl, p_tgt,
+				cl_get_time_stamp() - p_madw->vl15_send_time);
+	vl15_target_update_ready(p_vl, p_tgt);
+
+	cl_spinlock_release(&p_vl->lock);
+}
+
+static void dump_target_addr(IN const osm_vl15_target_t * p_tgt,
+			     OUT char *buf, IN size_t size)
+{
+	int i, n;
+
+	if (!p_tgt->hop_count && p_tgt->dlid != IB_LID_PERMISSIVE) {
+		snprintf(buf, size, "LID %u", cl_ntoh16(p_tgt->dlid));
+		return;
+	}
+
+	n = snprintf(buf, size, "DR 0");
+	for (i = 1; i <= p_tgt->hop_count && i < IB_SUBNET_PATH_HOPS_MAX &&
+	     n < size; i++)
+		n += snprintf(buf + n, size - n, ",%u", p_tgt->path[i]);
+}
+
+void osm_vl15_dump_targets(IN osm_vl15_t * p_vl, IN FILE * out)
+{
+	osm_vl15_target_t *p_tgt;
+	char addr[80];
+	int i;
+
+	if (!p_vl->max_smps_per_target) {
+		fprintf(out, "Per target VL15 scheduling is disabled "
+			"(max_wire_smps_per_target 0)\n");
+		return;
+	}
+
+	cl_spinlock_acquire(&p_vl->lock);
+
+	fprintf(out, "%zu targets, up to %u SMPs outstanding per target\n",
+		cl_fmap_count(&p_vl->targets), p_vl->max_smps_per_target);
+	fprintf(out, "%-28s %5s %6s %5s %8s %8s %10s %8s\n", "Target",
+		"Out", "Queued", "Win", "SRTT(us)", "Min(us)", "Sent",
+		"Timeouts");
+
+	for (p_tgt = (osm_vl15_target_t *) cl_fmap_head(&p_vl->targets);
+	     p_tgt != (osm_vl15_target_t *) cl_fmap_end(&p_vl->targets);
+	     p_tgt = (osm_vl15_target_t *) cl_fmap_next(&p_tgt->map_item)) {
+		dump_target_addr(p_tgt, addr, sizeof(addr));
+		fprintf(out, "%-28s %5u %6u %5u %8" PRIu64 " %8" PRIu64
+			" %10" PRIu64 " %8" PRIu64 "\n", addr,
+			p_tgt->outstanding, cl_qlist_count(&p_tgt->queue),
+			p_tgt->cwnd >> VL15_WIN_SHIFT, p_tgt->srtt,
+			p_tgt->min_rtt, p_tgt->sent, p_tgt->timeouts);
+		fprintf(out, "    latency(us):");
+		for (i = 0; i < OSM_VL15_HIST_BUCKETS; i++) {
+			if (!p_tgt->hist[i])
+				continue;
+			if (i == OSM_VL15_HIST_BUCKETS - 1)
+				fprintf(out, " >=%u:%" PRIu64, 1 << i,
+					p_tgt->hist[i]);
+			else
+				fprintf(out, " <%u:%" PRIu64, 1 << (i + 1),
+					p_tgt->hist[i]);
+		}
+		fprintf(out, "\n");
+	}
+
+	cl_spinlock_release(&p_vl->lock);
+}
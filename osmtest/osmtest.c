@@ -509,7 +509,7 @@ osmtest_init(IN osmtest_t * const p_osmt,
 	}
 
 	osm_mad_pool_construct(&p_osmt->mad_pool);
-	status = osm_mad_pool_init(&p_osmt->mad_pool);
+	status = osm_mad_pool_init(&p_osmt->mad_pool, 0);
 	if (status != IB_SUCCESS)
 		goto Exit;
 